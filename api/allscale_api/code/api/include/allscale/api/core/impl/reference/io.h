@@ -1,10 +1,19 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #include <sys/types.h>
@@ -62,6 +71,214 @@ namespace reference {
 		bool operator<(const Entry& other) const { return id < other.id; }
 	};
 
+	namespace detail {
+
+		/**
+		 * Determines whether values of type T are numbers taking the fast path of text IO
+		 * (characters and booleans retain the formatting of the standard streams).
+		 */
+		template<typename T>
+		struct is_text_number : public std::integral_constant<bool,
+				std::is_floating_point<T>::value || (std::is_integral<T>::value
+					&& !std::is_same<T,bool>::value && !std::is_same<T,char>::value
+					&& !std::is_same<T,signed char>::value && !std::is_same<T,unsigned char>::value
+					&& !std::is_same<T,wchar_t>::value && !std::is_same<T,char16_t>::value
+					&& !std::is_same<T,char32_t>::value)> {};
+
+		/**
+		 * The capacity of the buffer for a formatted or parsed number.
+		 */
+		enum { number_buffer_size = 64 };
+
+		template<typename T>
+		bool isNegative(T value, std::true_type) { return value < 0; }
+
+		template<typename T>
+		bool isNegative(T, std::false_type) { return false; }
+
+		/**
+		 * Formats the given integer into the given buffer, returns the number of characters.
+		 */
+		template<typename T>
+		typename std::enable_if<std::is_integral<T>::value,std::size_t>::type
+		formatNumber(char* buffer, T value, std::streamsize) {
+			using U = typename std::make_unsigned<T>::type;
+			bool negative = isNegative(value, std::is_signed<T>());
+			U u = static_cast<U>(value);
+			if (negative) u = static_cast<U>(U(0) - u);
+			char digits[number_buffer_size];
+			std::size_t n = 0;
+			do {
+				digits[n++] = static_cast<char>('0' + u % 10);
+				u = static_cast<U>(u / 10);
+			} while (u != 0);
+			std::size_t len = 0;
+			if (negative) buffer[len++] = '-';
+			while (n > 0) buffer[len++] = digits[--n];
+			return len;
+		}
+
+		/**
+		 * Formats the given floating point value into the given buffer as the standard
+		 * streams do by default (%g), returns the number of characters.
+		 */
+		template<typename T>
+		typename std::enable_if<std::is_floating_point<T>::value,std::size_t>::type
+		formatNumber(char* buffer, T value, std::streamsize precision) {
+			int len = std::is_same<T,long double>::value
+					? std::snprintf(buffer, number_buffer_size, "%.*Lg", int(precision), static_cast<long double>(value))
+					: std::snprintf(buffer, number_buffer_size, "%.*g", int(precision), static_cast<double>(value));
+			return (len > 0) ? std::min(std::size_t(len), std::size_t(number_buffer_size) - 1) : 0;
+		}
+
+		/**
+		 * Writes the given number into the given stream; the formatting of the standard streams
+		 * is bypassed unless it was customized (by flags, width or precision).
+		 */
+		template<typename T>
+		void writeNumber(std::ostream& out, T value) {
+			const std::ios_base::fmtflags defaults = std::ios_base::skipws | std::ios_base::dec;
+			if (out.flags() != defaults || out.width() != 0 || out.precision() > 20) {
+				out << value;
+				return;
+			}
+			char buffer[number_buffer_size];
+			out.write(buffer, static_cast<std::streamsize>(formatNumber(buffer, value, out.precision())));
+		}
+
+		/**
+		 * Scans the characters of a number off the given stream, skipping white spaces in front of it.
+		 * The characters are stored as a null-terminated string in the given buffer.
+		 *
+		 * @return the number of characters, 0 if there is no number or it does not fit into the buffer
+		 */
+		inline std::size_t scanNumber(std::istream& in, char* buffer, bool floating) {
+			using traits = std::char_traits<char>;
+			std::streambuf* sb = in.rdbuf();
+			auto c = sb->sgetc();
+			while (c != traits::eof() && std::isspace(c)) c = sb->snextc();
+
+			std::size_t n = 0;
+			bool digits = false;
+			auto take = [&]() {
+				if (n + 1 < number_buffer_size) buffer[n] = traits::to_char_type(c);
+				++n;
+				c = sb->snextc();
+			};
+			auto takeDigits = [&]() {
+				while (c != traits::eof() && std::isdigit(c)) { take(); digits = true; }
+			};
+
+			if (c == '+' || c == '-') take();
+			takeDigits();
+			if (floating) {
+				if (c == '.') {
+					take();
+					takeDigits();
+				}
+				if (digits && (c == 'e' || c == 'E')) {
+					take();
+					if (c == '+' || c == '-') take();
+					bool mantissa = digits;
+					digits = false;
+					takeDigits();
+					digits = digits && mantissa;
+				}
+			}
+
+			// update the state of the stream
+			if (c == traits::eof()) in.setstate(std::ios_base::eofbit);
+			if (!digits || n >= number_buffer_size) {
+				in.setstate(std::ios_base::failbit);
+				return 0;
+			}
+			buffer[n] = '\0';
+			return n;
+		}
+
+		inline bool parseNumber(const char* str, long long& res) {
+			char* end; errno = 0; res = std::strtoll(str, &end, 10); return errno == 0 && *end == '\0';
+		}
+
+		inline bool parseNumber(const char* str, unsigned long long& res) {
+			char* end; errno = 0; res = std::strtoull(str, &end, 10); return errno == 0 && *end == '\0';
+		}
+
+		inline bool parseNumber(const char* str, float& res) {
+			char* end; errno = 0; res = std::strtof(str, &end); return errno == 0 && *end == '\0';
+		}
+
+		inline bool parseNumber(const char* str, double& res) {
+			char* end; errno = 0; res = std::strtod(str, &end); return errno == 0 && *end == '\0';
+		}
+
+		inline bool parseNumber(const char* str, long double& res) {
+			char* end; errno = 0; res = std::strtold(str, &end); return errno == 0 && *end == '\0';
+		}
+
+		template<typename T>
+		using parse_type = typename std::conditional<std::is_floating_point<T>::value, T,
+				typename std::conditional<std::is_signed<T>::value, long long, unsigned long long>::type>::type;
+
+		/**
+		 * Reads a number from the given stream, bypassing the parsing of the standard streams.
+		 * On failure, the fail bit of the stream is set and the value remains unchanged.
+		 */
+		template<typename T>
+		void readNumber(std::istream& in, T& value) {
+			if (!in.good()) {
+				in.setstate(std::ios_base::failbit);
+				return;
+			}
+			char buffer[number_buffer_size];
+			parse_type<T> res;
+			if (scanNumber(in, buffer, std::is_floating_point<T>::value) == 0) return;
+			if (!parseNumber(buffer, res) || (std::is_integral<T>::value
+					&& (res < parse_type<T>(std::numeric_limits<T>::lowest())
+						|| res > parse_type<T>(std::numeric_limits<T>::max())))) {
+				in.setstate(std::ios_base::failbit);
+				return;
+			}
+			value = static_cast<T>(res);
+		}
+
+		/**
+		 * A growing in-memory stream buffer, merely appending the written characters.
+		 */
+		class AppendBuffer : public std::streambuf {
+
+			std::string data;
+
+		protected:
+
+			int_type overflow(int_type c) override {
+				if (!traits_type::eq_int_type(c, traits_type::eof())) data.push_back(traits_type::to_char_type(c));
+				return traits_type::not_eof(c);
+			}
+
+			std::streamsize xsputn(const char* s, std::streamsize n) override {
+				data.append(s, static_cast<std::size_t>(n));
+				return n;
+			}
+
+		public:
+
+			const char* begin() const {
+				return data.data();
+			}
+
+			std::size_t size() const {
+				return data.size();
+			}
+
+			void clear() {
+				data.clear();
+			}
+
+		};
+
+	} // end namespace detail
+
 	/**
 	 * A common base class for Input and Output Streams.
 	 */
@@ -70,12 +287,14 @@ namespace reference {
 
 		Entry entry;
 
+		Mode mode;
+
 		std::mutex operation_lock;
 
-		IOStream(const Entry& entry) : entry(entry) {}
+		IOStream(const Entry& entry, Mode mode) : entry(entry), mode(mode) {}
 
 		IOStream(IOStream&& other)
-			: entry(other.entry) {}
+			: entry(other.entry), mode(other.mode) {}
 
 	public:
 
@@ -83,6 +302,10 @@ namespace reference {
 			return entry;
 		}
 
+		Mode getMode() const {
+			return mode;
+		}
+
 	};
 
 	/**
@@ -96,13 +319,21 @@ namespace reference {
 	public:
 		struct IStreamWrapper {
 			std::istream& in;
-			IStreamWrapper(std::istream& in) : in(in) {}
+			Mode mode;
+			IStreamWrapper(std::istream& in, Mode mode = Mode::Text) : in(in), mode(mode) {}
 			template<typename T>
-			IStreamWrapper& operator>>(T& value) {
+			typename std::enable_if<!detail::is_text_number<T>::value,IStreamWrapper&>::type
+			operator>>(T& value) {
 				in >> value;
 				return *this;
 			}
 			template<typename T>
+			typename std::enable_if<detail::is_text_number<T>::value,IStreamWrapper&>::type
+			operator>>(T& value) {
+				detail::readNumber(in, value);
+				return *this;
+			}
+			template<typename T>
 			T read() {
 				T value;
 				in.read((char*)&value, sizeof(T));
@@ -113,13 +344,28 @@ namespace reference {
 				in.read((char*)&res, sizeof(T));
 				return *this;
 			}
+			/**
+			 * Reads up to n values into the given array: the raw data in binary mode, or
+			 * values separated by white spaces in text mode. Returns the number of values read.
+			 */
+			template<typename T>
+			std::size_t readSpan(T* data, std::size_t n) {
+				static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values supported!");
+				if (mode == Mode::Binary) {
+					in.read((char*)data, static_cast<std::streamsize>(n * sizeof(T)));
+					return static_cast<std::size_t>(in.gcount()) / sizeof(T);
+				}
+				std::size_t i = 0;
+				while (i < n && (*this >> data[i]).in) ++i;
+				return i;
+			}
 		};
 
 	private:
 		IStreamWrapper in;
 
-		InputStream(const Entry& entry, std::istream& in)
-			: IOStream(entry), in(in) {}
+		InputStream(const Entry& entry, std::istream& in, Mode mode)
+			: IOStream(entry, mode), in(in, mode) {}
 
 	public:
 
@@ -151,6 +397,18 @@ namespace reference {
 			return res;
 		}
 
+		/**
+		 * Reads up to n values into the given array at once (see IStreamWrapper::readSpan).
+		 */
+		template<typename T>
+		std::size_t readSpan(T* data, std::size_t n) {
+			std::size_t res = 0;
+			atomic([&](IStreamWrapper& in) {
+				res = in.readSpan(data, n);
+			});
+			return res;
+		}
+
 		operator bool() const {
 			return (bool)in.in;
 		}
@@ -166,7 +424,14 @@ namespace reference {
 	};
 
 	/**
-	 * A stream to store data in the form of a stream of entries.
+	 * A stream to store data in the form of a stream of entries. Every thread writes into
+	 * a buffer of its own, such that the lock of the stream is rarely taken. Each atomic
+	 * operation draws a ticket from a counter of the stream, and the buffers of all threads
+	 * are drained together, in the order of tickets, once any of them gets large, on flush
+	 * and on close. Thus the atomic operations appear in the stream in a single order which
+	 * is consistent with the order of the program: an operation completed before another
+	 * one starts -- by the same thread, or by a thread joined or a task waited for by the
+	 * other one -- precedes it in the stream. Concurrent operations are ordered arbitrarily.
 	 */
 	class OutputStream : public IOStream {
 
@@ -176,12 +441,20 @@ namespace reference {
 	public:
 		struct OStreamWrapper {
 			std::ostream& out;
-			OStreamWrapper(std::ostream& out) : out(out) {}
+			Mode mode;
+			OStreamWrapper(std::ostream& out, Mode mode = Mode::Text) : out(out), mode(mode) {}
 			template<typename T>
-			OStreamWrapper& operator<<(const T& value) {
+			typename std::enable_if<!detail::is_text_number<T>::value,OStreamWrapper&>::type
+			operator<<(const T& value) {
 				out << value;
 				return *this;
 			}
+			template<typename T>
+			typename std::enable_if<detail::is_text_number<T>::value,OStreamWrapper&>::type
+			operator<<(const T& value) {
+				detail::writeNumber(out, value);
+				return *this;
+			}
 			OStreamWrapper& operator<<(const char* value) {
 				out << value;
 				return *this;
@@ -191,28 +464,146 @@ namespace reference {
 				out.write((char*)&value, sizeof(T));
 				return *this;
 			}
+			/**
+			 * Writes the given array of n values: the raw data in binary mode, or a line
+			 * of values separated by blanks in text mode.
+			 */
+			template<typename T>
+			OStreamWrapper& writeSpan(const T* data, std::size_t n) {
+				static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values supported!");
+				if (mode == Mode::Binary) {
+					out.write((const char*)data, static_cast<std::streamsize>(n * sizeof(T)));
+					return *this;
+				}
+				for(std::size_t i = 0; i < n; ++i) {
+					if (i > 0) out.put(' ');
+					*this << data[i];
+				}
+				out.put('\n');
+				return *this;
+			}
 		};
 
 	private:
-		OStreamWrapper out;
 
-		OutputStream(const Entry& entry, std::ostream& out)
-			: IOStream(entry), out(out) {}
+		/**
+		 * The buffer of a single thread.
+		 */
+		struct ThreadBuffer {
+			// taken by the owner while writing, and by draining
+			std::mutex lock;
+			detail::AppendBuffer buffer;
+			std::ostream stream;
+			OStreamWrapper out;
+			// the tickets of the atomic operations in the buffer and the ends of their data
+			std::vector<std::pair<std::size_t,std::size_t>> ops;
+			ThreadBuffer(Mode mode) : buffer(), stream(&buffer), out(stream, mode) {}
+		};
+
+		// buffers are appended to the underlying stream once one of them exceeds this size
+		enum { flush_threshold = 1 << 16 };
+
+		std::ostream& target;
+
+		// the identifier of this stream, unique throughout the process
+		std::size_t uid;
+
+		// the number of atomic operations started on this stream
+		std::atomic<std::size_t> tickets;
+
+		std::mutex buffers_lock;
+
+		std::map<std::thread::id,std::unique_ptr<ThreadBuffer>> buffers;
+
+		OutputStream(const Entry& entry, std::ostream& out, Mode mode)
+			: IOStream(entry, mode), target(out), uid(nextUid()), tickets(0) {}
+
+		static std::size_t nextUid() {
+			static std::atomic<std::size_t> counter(0);
+			return ++counter;
+		}
+
+		ThreadBuffer& getLocalBuffer() {
+			// the buffer of the calling thread is cached for the stream last used by it
+			struct Cache { std::size_t uid; ThreadBuffer* buffer; };
+			static thread_local Cache cache = { 0, nullptr };
+			if (cache.uid == uid) return *cache.buffer;
+
+			std::lock_guard<std::mutex> lease(buffers_lock);
+			auto& res = buffers[std::this_thread::get_id()];
+			if (!res) res.reset(new ThreadBuffer(mode));
+			cache = { uid, res.get() };
+			return *res;
+		}
+
+		/**
+		 * Appends the buffers of all threads to the underlying stream, in the order of tickets.
+		 * Once all the buffers are locked, no atomic operation is in progress, thus all the
+		 * tickets drawn so far are either in the buffers or have been drained before.
+		 */
+		void drain() {
+			std::lock_guard<std::mutex> lease(operation_lock);
+			std::lock_guard<std::mutex> list(buffers_lock);
+			std::vector<std::unique_lock<std::mutex>> locks;
+			for(auto& cur : buffers) {
+				locks.emplace_back(cur.second->lock);
+			}
+
+			// the ticket, buffer and data of every buffered operation
+			struct Op { std::size_t ticket; const ThreadBuffer* owner; const char* begin; const char* end; };
+			std::vector<Op> ops;
+			for(auto& cur : buffers) {
+				ThreadBuffer& local = *cur.second;
+				std::size_t begin = 0;
+				for(const auto& op : local.ops) {
+					ops.push_back({ op.first, &local, local.buffer.begin() + begin, local.buffer.begin() + op.second });
+					begin = op.second;
+				}
+			}
+			std::sort(ops.begin(), ops.end(), [](const Op& a, const Op& b) { return a.ticket < b.ticket; });
+
+			// consecutive operations of the same thread are written at once
+			for(std::size_t i = 0; i < ops.size(); ) {
+				std::size_t j = i + 1;
+				while(j < ops.size() && ops[j].owner == ops[i].owner && ops[j].begin == ops[j-1].end) ++j;
+				target.write(ops[i].begin, static_cast<std::streamsize>(ops[j-1].end - ops[i].begin));
+				i = j;
+			}
+
+			for(auto& cur : buffers) {
+				cur.second->buffer.clear();
+				cur.second->ops.clear();
+			}
+		}
+
+		// appends the buffers of all threads to the underlying stream -- not thread safe
+		void flushAll() {
+			drain();
+			target.flush();
+		}
 
 	public:
 
 		OutputStream(OutputStream&& other)
-			: IOStream(std::move(other)), out(other.out) {}
+			: IOStream(std::move(other)), target(other.target), uid(other.uid),
+			  tickets(other.tickets.load()), buffers(std::move(other.buffers)) {}
 
 		template<typename Body>
 		void atomic(const Body& body) {
-			// protect output by locking it
-			std::lock_guard<std::mutex> lease(operation_lock);
-
-			// let the body write it's information
-			body(out);
+			ThreadBuffer& local = getLocalBuffer();
+			bool full;
+			{
+				std::lock_guard<std::mutex> lease(local.lock);
+
+				// let the body write it's information into the local buffer
+				const std::size_t ticket = tickets++;
+				body(local.out);
+				local.ops.emplace_back(ticket, local.buffer.size());
+				full = local.buffer.size() >= flush_threshold;
+			}
 
-			// free the lock - automatically
+			// pass on the buffers once one of them is large enough
+			if (full) drain();
 		}
 
 		template<typename T>
@@ -234,8 +625,25 @@ namespace reference {
 			});
 		}
 
-		operator bool() const {
-			return (bool)out.out;
+		/**
+		 * Writes the given array of n values at once (see OStreamWrapper::writeSpan).
+		 */
+		template<typename T>
+		void writeSpan(const T* data, std::size_t n) {
+			atomic([&](OStreamWrapper& out) {
+				out.writeSpan(data, n);
+			});
+		}
+
+		/**
+		 * Appends the data buffered by all threads to the underlying stream, in order.
+		 */
+		void flush() {
+			drain();
+		}
+
+		operator bool() {
+			return (bool)target && (bool)getLocalBuffer().stream;
 		}
 
 		static OutputStream& load(utils::ArchiveReader&) {
@@ -248,9 +656,6 @@ namespace reference {
 		}
 	};
 
-
-
-
 	class MemoryMappedIO {
 
 		Entry entry;
@@ -406,7 +811,7 @@ namespace reference {
 			if (pos != inputStreams.end()) return pos->second;
 
 			// create new input stream
-			InputStream res(entry, *store.createInputStream(entry));
+			InputStream res(entry, *store.createInputStream(entry), store.getMode(entry));
 
 			// register stream
 			inputStreams.emplace(entry, std::move(res));
@@ -430,7 +835,7 @@ namespace reference {
 			if (pos != outputStreams.end()) return pos->second;
 
 			// create new input stream
-			OutputStream res(entry, *store.createOutputStream(entry));
+			OutputStream res(entry, *store.createOutputStream(entry), store.getMode(entry));
 
 			// register stream
 			outputStreams.emplace(entry, std::move(res));
@@ -640,8 +1045,9 @@ namespace reference {
 		 * Closes the given output stream.
 		 */
 		void closeStream(OutputStream& out) {
-			// closes the stream
-			store.close(out.out.out);
+			// passes on the buffered data and closes the stream
+			out.flushAll();
+			store.close(out.target);
 		}
 
 		/**
@@ -784,6 +1190,12 @@ namespace reference {
 			// nothing to do
 		}
 
+		Mode getMode(Entry entry) const {
+			auto pos = buffers.find(entry);
+			assert_true(pos != buffers.end()) << "Unknown buffer entry: " << entry.id;
+			return (pos != buffers.end()) ? pos->second.mode : Mode::Text;
+		}
+
 		bool exists(Entry entry) const {
 			return buffers.find(entry) != buffers.end();
 		}
@@ -946,6 +1358,11 @@ namespace reference {
 			close(mmo, true);
 		}
 
+		Mode getMode(Entry entry) const {
+			assert_lt(entry.id, files.size()) << "Unknown file entry: " << entry.id;
+			return (entry.id < files.size()) ? files[entry.id].mode : Mode::Text;
+		}
+
 		bool exists(Entry entry) const {
 			if (entry.id >= files.size()) return false;
 			struct stat buffer;
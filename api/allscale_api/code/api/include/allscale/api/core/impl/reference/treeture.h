@@ -2500,10 +2500,16 @@ namespace reference {
 
 			std::vector<Worker*> workers;
 
+			// the number of workers processing tasks (the others are parked)
+			std::atomic<int> numActive;
+
 			// tools for managing idle threads
 			std::mutex m;
 			std::condition_variable cv;
 
+			// tools for managing parked threads
+			std::condition_variable parked;
+
 		public:
 
 			WorkerPool() {
@@ -2523,6 +2529,7 @@ namespace reference {
 				for(int i=0; i<numWorkers; ++i) {
 					workers.push_back(new Worker(*this,i));
 				}
+				numActive = numWorkers;
 
 				// start additional workers (worker 0 is main thread)
 				for(int i=1; i<numWorkers; ++i) {
@@ -2552,6 +2559,7 @@ namespace reference {
 
 					// make work available
 					workAvailable();
+					parked.notify_all();
 				}
 
 				// wait for their death
@@ -2572,9 +2580,35 @@ namespace reference {
 			}
 
 			int getNumWorkers() const {
+				return numActive;
+			}
+
+			int getMaxNumWorkers() const {
 				return (int)workers.size();
 			}
 
+			/**
+			 * Changes the number of workers processing tasks within the range
+			 * [1..getMaxNumWorkers()]; the remaining ones are parked. Worker 0
+			 * (the main thread) is always active.
+			 *
+			 *  NOTE: this method may only be called while there are no tasks in
+			 *        the system, e.g. between two parallel computations!
+			 *
+			 * @param num the requested number of workers
+			 * @return the actual number of workers
+			 */
+			int setNumWorkers(int num) {
+				num = std::max(1, std::min(num, getMaxNumWorkers()));
+				{
+					std::lock_guard<std::mutex> guard(m);
+					numActive = num;
+					initialLimit = std::numeric_limits<std::size_t>::max();
+				}
+				parked.notify_all();
+				return num;
+			}
+
 		private:
 
 			mutable std::size_t initialLimit = std::numeric_limits<std::size_t>::max();
@@ -2630,6 +2664,17 @@ namespace reference {
 				cv.notify_all();
 			}
 
+			bool isActive(unsigned id) const {
+				return (int)id < numActive;
+			}
+
+			void waitForActivation(volatile bool& alive, unsigned id) {
+				std::unique_lock<std::mutex> lk(m);
+				while (alive && !isActive(id)) {
+					parked.wait(lk);
+				}
+			}
+
 		};
 
 		static Worker& getCurrentWorker() {
@@ -2670,11 +2715,17 @@ namespace reference {
 			// start processing loop
 			while(alive) {
 
+				// parked workers wait until the pool gets enlarged
+				if (!pool.isActive(id)) {
+					pool.waitForActivation(alive, id);
+					continue;
+				}
+
 				// count number of idle cycles
 				int idle_cycles = 0;
 
 				// conduct a schedule step
-				while(alive && !schedule_step()) {
+				while(alive && pool.isActive(id) && !schedule_step()) {
 					// increment idle counter
 					++idle_cycles;
 
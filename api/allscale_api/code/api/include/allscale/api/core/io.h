@@ -153,6 +153,17 @@ namespace core {
 			return istream.read<T>();
 		}
 
+		/**
+		 * Reads up to n values into the given array within a single atomic operation: the raw
+		 * data in binary mode, or values separated by white spaces in text mode.
+		 *
+		 * @return the number of values read, less than n if the end of the data was reached
+		 */
+		template<typename T>
+		std::size_t readSpan(T* data, std::size_t n) {
+			return istream.readSpan(data, n);
+		}
+
 		/**
 		 * An idiomatic overload of the read operation.
 		 */
@@ -214,7 +225,8 @@ namespace core {
 		/**
 		 * Provides atomic access to this stream, allowing the given body to
 		 * to perform a sequence of write operations without potential interference
-		 * of other threads.
+		 * of other threads. An atomic operation completed before another one starts,
+		 * on any thread, precedes it in the stream.
 		 */
 		template<typename Body>
 		OutputStream& atomic(const Body& body) {
@@ -231,6 +243,26 @@ namespace core {
 			return *this;
 		}
 
+		/**
+		 * Writes the given array of n values within a single atomic operation: the raw data in
+		 * binary mode, or a line of values separated by blanks in text mode.
+		 */
+		template<typename T>
+		OutputStream& writeSpan(const T* data, std::size_t n) {
+			ostream.writeSpan(data, n);
+			return *this;
+		}
+
+		/**
+		 * Passes the data written so far by all threads on to the underlying storage. Writes
+		 * are buffered per thread, and the buffers are passed on in the order of the atomic
+		 * operations once one of them gets large, on flush and when the stream is closed.
+		 */
+		OutputStream& flush() {
+			ostream.flush();
+			return *this;
+		}
+
 		/**
 		 * An idiomatic overload of the write operation.
 		 */
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <utility>
 
 #include "allscale/api/core/prec.h"
@@ -199,6 +200,116 @@ namespace algorithm {
 
 	}
 
+	// ----- multi-dimensional reduction ------
+
+	namespace detail {
+
+		/**
+		 * The maximum number of leaves of the splitting tree of multi-dimensional reductions. The
+		 * leaves are folded sequentially, thus this bounds the number of partial results to be combined.
+		 */
+		enum { max_reduction_leaves = 4096 };
+
+	} // end namespace detail
+
+	/**
+	 * A parallel reduction over the points of the hyper-box limited by the given vectors. The box is
+	 * split recursively as by the pfor operator, down to leaves of a size depending on the volume of
+	 * the box only. Every leaf is folded into a local state, and the partial results are combined along
+	 * the splitting tree, the left before the right one. The shape of the tree does not depend on the
+	 * scheduling of tasks, thus the result is deterministic, even for non-associative operations like
+	 * floating point sums.
+	 */
+	template<
+		typename Elem,
+		std::size_t Dims,
+		typename FoldOp,
+		typename ReduceOp,
+		typename InitLocalState,
+		typename FinishLocalState
+	>
+	core::treeture<typename utils::lambda_traits<ReduceOp>::result_type>
+	preduce(
+			const utils::Vector<Elem,Dims>& a,
+			const utils::Vector<Elem,Dims>& b,
+			const FoldOp& fold,
+			const ReduceOp& reduce,
+			const InitLocalState& init,
+			const FinishLocalState& finish
+		) {
+
+		using Iter = utils::Vector<Elem,Dims>;
+		using res_type = typename utils::lambda_traits<ReduceOp>::result_type;
+
+		// define the argument struct
+		struct RecArgs {
+			std::size_t depth;
+			algorithm::detail::range<Iter> range;
+		};
+
+		// fix the size of the leaves
+		algorithm::detail::range<Iter> full(a,b);
+		const std::size_t grain = std::max<std::size_t>(1, full.size() / detail::max_reduction_leaves);
+
+		return core::prec(
+			[grain](const RecArgs& r) {
+				return r.range.size() <= grain;
+			},
+			[init,fold,finish](const RecArgs& r)->res_type {
+				auto res = init();
+				r.range.forEach([&](const auto& cur){
+					fold(cur,res);
+				});
+				return finish(std::move(res));
+			},
+			// no sequential alternative folding larger ranges -- it would alter the order of operations
+			[reduce](const RecArgs& r, const auto& nested) {
+				auto fragments = r.range.split(r.depth);
+				return core::combine(nested(RecArgs{ r.depth+1, fragments.left }),nested(RecArgs{ r.depth+1, fragments.right }),reduce);
+			}
+		)(RecArgs{ 0, full });
+	}
+
+	template<
+		typename Elem,
+		std::size_t Dims,
+		typename FoldOp,
+		typename ReduceOp,
+		typename InitLocalState
+	>
+	core::treeture<typename utils::lambda_traits<ReduceOp>::result_type>
+	preduce(
+			const utils::Vector<Elem,Dims>& a,
+			const utils::Vector<Elem,Dims>& b,
+			const FoldOp& fold,
+			const ReduceOp& reduce,
+			const InitLocalState& init
+		) {
+
+		return preduce(a, b, fold, reduce, init, ([](typename utils::lambda_traits<ReduceOp>::result_type r) { return r; } ));
+	}
+
+	/**
+	 * A parallel reduction over the points of the hyper-box limited by the given vector.
+	 */
+	template<
+		typename Elem,
+		std::size_t Dims,
+		typename FoldOp,
+		typename ReduceOp,
+		typename InitLocalState
+	>
+	core::treeture<typename utils::lambda_traits<ReduceOp>::result_type>
+	preduce(
+			const utils::Vector<Elem,Dims>& a,
+			const FoldOp& fold,
+			const ReduceOp& reduce,
+			const InitLocalState& init
+		) {
+
+		return preduce(utils::Vector<Elem,Dims>(0), a, fold, reduce, init);
+	}
+
 } // end namespace algorithm
 } // end namespace user
 } // end namespace api
@@ -39,7 +39,16 @@ namespace algorithm {
 
 		struct coarse_grained_iterative;
 
-		struct fine_grained_iterative;
+		struct full_neighborhood_sync_policy;
+
+		struct small_neighborhood_sync_policy;
+
+		template<typename SyncPolicy>
+		struct basic_fine_grained_iterative;
+
+		using fine_grained_iterative = basic_fine_grained_iterative<full_neighborhood_sync_policy>;
+
+		using neighborhood_sync_iterative = basic_fine_grained_iterative<small_neighborhood_sync_policy>;
 
 		struct sequential_recursive;
 
@@ -398,10 +407,42 @@ namespace algorithm {
 		};
 
 
-		struct fine_grained_iterative {
+		/**
+		 * The dependencies of an element of time step t+1 on the elements of time step t in
+		 * the fine grained iterative implementation: the full neighborhood (including the
+		 * diagonal neighbors) of the element.
+		 */
+		struct full_neighborhood_sync_policy {
+			template<typename Iter>
+			static auto dependency(const user::algorithm::detail::loop_reference<Iter>& ref) {
+				return full_neighborhood_sync(ref);
+			}
+		};
+
+		/**
+		 * The dependencies of an element of time step t+1 on the elements of time step t
+		 * restricted to the element itself and its 2*dims direct (non-diagonal) neighbors.
+		 * Thus, neighboring tasks are synchronized point-to-point and no global barrier is
+		 * introduced between time steps. Update operations utilizing this policy may only
+		 * read the center element and its direct neighbors.
+		 */
+		struct small_neighborhood_sync_policy {
+			template<typename Iter>
+			static auto dependency(const user::algorithm::detail::loop_reference<Iter>& ref) {
+				return small_neighborhood_sync(ref);
+			}
+		};
+
+		/**
+		 * The fine grained iterative implementation: every time step is a parallel loop, and
+		 * an element of time step t+1 waits for the elements of time step t given by the
+		 * synchronization policy (see fine_grained_iterative and neighborhood_sync_iterative).
+		 */
+		template<typename SyncPolicy>
+		struct basic_fine_grained_iterative {
 
 			template<typename Container, typename InnerUpdate, typename BoundaryUpdate, typename ... Observers>
-			stencil_reference<fine_grained_iterative> processWithBoundary(Container& a, std::size_t steps, const InnerUpdate& inner, const BoundaryUpdate& boundary, const Observers& ... observers) {
+			stencil_reference<basic_fine_grained_iterative> processWithBoundary(Container& a, std::size_t steps, const InnerUpdate& inner, const BoundaryUpdate& boundary, const Observers& ... observers) {
 				
 				// mark this task as having no dependencies (to speed up analysis)
 				core::sema::no_dependencies();
@@ -429,7 +470,7 @@ namespace algorithm {
 						[&,t,boundary](const iter_type& i){
 							b[i] = boundary(t,i,a);
 						},
-						full_neighborhood_sync(ref)
+						SyncPolicy::dependency(ref)
 					);
 
 					// check observers
@@ -468,7 +509,7 @@ namespace algorithm {
 			}
 
 			template<typename Container, typename Update, typename ... Observers>
-			stencil_reference<fine_grained_iterative> process(Container& a, std::size_t steps, const Update& update, const Observers& ... observers) {
+			stencil_reference<basic_fine_grained_iterative> process(Container& a, std::size_t steps, const Update& update, const Observers& ... observers) {
 
 				// mark this task as having no dependencies (to speed up analysis)
 				core::sema::no_dependencies();
@@ -493,7 +534,7 @@ namespace algorithm {
 										  [&, t, update](const iter_type& i) {
 						b[i] = update(t, i, a);
 					},
-										  full_neighborhood_sync(ref)
+										  SyncPolicy::dependency(ref)
 						);
 
 					// check observers
@@ -533,7 +574,6 @@ namespace algorithm {
 		};
 
 
-
 		// -- Recursive Stencil Implementation ---------------------------------------------------------
 
 		namespace detail {
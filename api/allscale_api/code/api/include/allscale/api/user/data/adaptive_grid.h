@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cstring>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 #include "allscale/api/core/data.h"
 
@@ -64,6 +67,87 @@ namespace data {
 		Up, Down, Left, Right
 	};
 
+	/**
+	 * A non-owning view on a one-dimensional, equally spaced strip of elements, e.g. the
+	 * boundary of a grid layer. The view does not allocate any memory and remains valid
+	 * as long as the viewed layer is alive.
+	 */
+	template<typename T>
+	class StridedView {
+
+		T* first;
+
+		std::ptrdiff_t stride;
+
+		std::size_t length;
+
+	public:
+
+		StridedView() : first(nullptr), stride(0), length(0) {}
+
+		StridedView(T* first, std::ptrdiff_t stride, std::size_t length)
+			: first(first), stride(stride), length(length) {}
+
+		// a view on mutable elements may be converted to a read-only view
+		template<typename U, typename = std::enable_if_t<std::is_convertible<U*,T*>::value>>
+		StridedView(const StridedView<U>& other)
+			: first(other.data()), stride(other.getStride()), length(other.size()) {}
+
+		std::size_t size() const {
+			return length;
+		}
+
+		bool empty() const {
+			return length == 0;
+		}
+
+		std::ptrdiff_t getStride() const {
+			return stride;
+		}
+
+		T* data() const {
+			return first;
+		}
+
+		T& operator[](std::size_t i) const {
+			assert_lt(i, length);
+			return first[std::ptrdiff_t(i) * stride];
+		}
+
+		// copies the viewed elements to a destination with the given spacing
+		template<typename U>
+		void copyTo(U* dst, std::ptrdiff_t dst_stride = 1) const {
+			const T* src = first;
+			for(std::size_t i = 0; i < length; ++i, src += stride, dst += dst_stride) {
+				*dst = *src;
+			}
+		}
+
+		// copies elements from a source with the given spacing to the viewed elements
+		template<typename U>
+		void copyFrom(const U* src, std::ptrdiff_t src_stride = 1) const {
+			T* dst = first;
+			for(std::size_t i = 0; i < length; ++i, src += src_stride, dst += stride) {
+				*dst = *src;
+			}
+		}
+
+		// assigns the given value to all viewed elements
+		void fill(const T& value) const {
+			T* dst = first;
+			for(std::size_t i = 0; i < length; ++i, dst += stride) {
+				*dst = value;
+			}
+		}
+
+		std::vector<std::remove_const_t<T>> toVector() const {
+			std::vector<std::remove_const_t<T>> res(length);
+			copyTo(res.data());
+			return res;
+		}
+
+	};
+
 	namespace detail {
 
 		template<unsigned ... sizes>
@@ -82,72 +166,36 @@ namespace data {
 		};
 
 		template<typename T, std::size_t... Sizes>
-		std::vector<T> getBoundary(const Direction& dir, const utils::StaticGrid<T,Sizes...>& data) { // returns vector of boundary data in each direction
+		StridedView<T> getBoundaryView(const Direction& dir, utils::StaticGrid<T,Sizes...>& data) { // returns view on the boundary data in each direction
 			int size[] = { Sizes... };
-			int xSize = size[0];
-			int ySize = size[1];
+			std::ptrdiff_t xSize = size[0];
+			std::ptrdiff_t ySize = size[1];
+			T* origin = getOrigin(data);
+			// element (x,y) is located at origin + x * ySize + y
 			switch(dir) {
-				case Up: { // returns data from top strip of domain to neighbor
-					std::vector<T> res(xSize);
-					for(int i = 0; i < xSize; i++)
-						res[i] = data[{ i, ySize - 1}];
-					return res;
-				}
-				case Down: { // returns data from bottom strip of domain to neighbor
-					std::vector<T> res(xSize);
-					for(int i = 0; i < xSize; i++)
-						res[i] = data[{ i, 0 }];
-					return res;
-				}
-				case Left: {
-					std::vector<T> res(ySize);
-					for(int i = 0; i < ySize; i++) {
-						res[i] = data[{ 0, i }];
-					}
-					return res;
-				}
-				case Right: {
-					std::vector<T> res(ySize);
-					for(int i = 0; i < ySize; i++)
-						res[i] = data[{ xSize - 1, i }];
-					return res;
-				}
+				case Up:    return { origin + (ySize - 1), ySize, std::size_t(xSize) };        // top strip of domain
+				case Down:  return { origin, ySize, std::size_t(xSize) };                      // bottom strip of domain
+				case Left:  return { origin, 1, std::size_t(ySize) };                          // left strip of domain
+				case Right: return { origin + (xSize - 1) * ySize, 1, std::size_t(ySize) };    // right strip of domain
 			}
-			return std::vector<T>();
+			return {};
 		}
 
 		template<typename T, std::size_t... Sizes>
-		void setBoundary(const Direction& dir, utils::StaticGrid<T, Sizes...>& data, const std::vector<T>& boundary) {
-			int size[] = { Sizes... };
-			int xSize = size[0];
-			int ySize = size[1];
+		StridedView<const T> getBoundaryView(const Direction& dir, const utils::StaticGrid<T,Sizes...>& data) {
+			return getBoundaryView(dir, const_cast<utils::StaticGrid<T,Sizes...>&>(data));
+		}
 
-			switch(dir) {
-				case Up: {
-					assert_eq(boundary.size(), (size_t)xSize);
-					for(int i = 0; i < xSize; i++)
-						data[{ i, ySize - 1 }] = boundary[i];
-					return;
-				}
-				case Down: {
-					assert_eq(boundary.size(), (size_t)xSize);
-					for(int i = 0; i < xSize; i++)
-						data[{ i, 0 }] = boundary[i];
-					return;
-				}
-				case Left: {
-					assert_eq(boundary.size(), (size_t)ySize);
-					for(int i = 0; i < ySize; i++)
-						data[{ 0, i }] = boundary[i];
-					return;
-				}
-				case Right: {
-					assert_eq(boundary.size(), (size_t)ySize);
-					for(int i = 0; i < ySize; i++)
-						data[{ xSize - 1, i }] = boundary[i];
-					return;
-				}
-			}
+		template<typename T, std::size_t... Sizes>
+		std::vector<T> getBoundary(const Direction& dir, const utils::StaticGrid<T,Sizes...>& data) { // returns vector of boundary data in each direction
+			return getBoundaryView(dir, data).toVector();
+		}
+
+		template<typename T, std::size_t... Sizes>
+		void setBoundary(const Direction& dir, utils::StaticGrid<T, Sizes...>& data, const std::vector<T>& boundary) {
+			auto view = getBoundaryView(dir, data);
+			assert_eq(boundary.size(), view.size());
+			view.copyFrom(boundary.data());
 		}
 
 
@@ -246,6 +294,15 @@ namespace data {
 			}
 		}
 
+		void refineFromLayerLinear(unsigned layer) {
+			if(layer == getLayerNumber()) {
+				// interpolate cells on nested layer
+				detail::refineLinear(nested, data);
+			} else {
+				nested.refineFromLayerLinear(layer);
+			}
+		}
+
 		template <typename Refiner>
 		void refineFromLayerGrid(unsigned layer, const Refiner& refiner) {
 			if(layer == getLayerNumber()) {
@@ -274,10 +331,32 @@ namespace data {
 		}
 
 		std::vector<T> getBoundary(unsigned layer, Direction dir) const { // returns vector of boundary data in each direction
+			return getBoundaryView(layer, dir).toVector();
+		}
+
+		StridedView<const T> getBoundaryView(unsigned layer, Direction dir) const {
+			if(layer == getLayerNumber()) {
+				return detail::getBoundaryView(dir, data);
+			}
+			return nested.getBoundaryView(layer, dir);
+		}
+
+		StridedView<T> getBoundaryView(unsigned layer, Direction dir) {
+			if(layer == getLayerNumber()) {
+				return detail::getBoundaryView(dir, data);
+			}
+			return nested.getBoundaryView(layer, dir);
+		}
+
+		T* getLayerOrigin(unsigned layer) {
 			if(layer == getLayerNumber()) {
-				return detail::getBoundary(dir, data);
+				return detail::getOrigin(data);
 			}
-			return nested.getBoundary(layer, dir);
+			return nested.getLayerOrigin(layer);
+		}
+
+		const T* getLayerOrigin(unsigned layer) const {
+			return const_cast<GridLayerData&>(*this).getLayerOrigin(layer);
 		}
 
 		void setBoundary(unsigned layer, Direction dir, const std::vector<T>& boundary) {
@@ -293,6 +372,10 @@ namespace data {
 			writer.write(nested);
 		}
 
+		std::size_t size_hint() const {
+			return utils::size_hint(data) + utils::size_hint(nested);
+		}
+
 		static GridLayerData load(utils::ArchiveReader& reader) {
 			auto data = std::move(reader.read<data_type>());
 			auto nested = std::move(reader.read<nested_type>());
@@ -354,6 +437,10 @@ namespace data {
 			assert_fail() << "Error: trying to access layer " << layer << " --no such layer!";
 		}
 
+		void refineFromLayerLinear(unsigned layer) {
+			assert_fail() << "Error: trying to access layer " << layer << " --no such layer!";
+		}
+
 		template <typename Refiner>
 		void refineFromLayerGrid(unsigned layer, const Refiner&) {
 			assert_fail() << "Error: trying to access layer " << layer << " --no such layer!";
@@ -374,6 +461,25 @@ namespace data {
 			return detail::getBoundary(dir, data);
 		}
 
+		StridedView<const T> getBoundaryView(__allscale_unused unsigned layer, Direction dir) const {
+			assert_eq(0, layer) << "No such layer";
+			return detail::getBoundaryView(dir, data);
+		}
+
+		StridedView<T> getBoundaryView(__allscale_unused unsigned layer, Direction dir) {
+			assert_eq(0, layer) << "No such layer";
+			return detail::getBoundaryView(dir, data);
+		}
+
+		T* getLayerOrigin(__allscale_unused unsigned layer) {
+			assert_eq(0, layer) << "No such layer";
+			return detail::getOrigin(data);
+		}
+
+		const T* getLayerOrigin(unsigned layer) const {
+			return const_cast<GridLayerData&>(*this).getLayerOrigin(layer);
+		}
+
 		void setBoundary(__allscale_unused unsigned layer, Direction dir, const std::vector<T>& boundary) {
 			assert_eq(0, layer) << "No such layer";
 			detail::setBoundary(dir, data, boundary);
@@ -383,6 +489,10 @@ namespace data {
 			writer.write(data);
 		}
 
+		std::size_t size_hint() const {
+			return utils::size_hint(data);
+		}
+
 		static GridLayerData<T, detail::size<Sizes...>, layers<>> load(utils::ArchiveReader& reader) {
 			GridLayerData<T, detail::size<Sizes...>, layers<>> grid;
 			grid.data = std::move(reader.read<data_type>());
@@ -440,6 +550,10 @@ namespace data {
 			return data.getLayerSize(active_layer);
 		}
 
+		allscale::utils::Vector<std::size_t, Dims> getLayerSize(unsigned layer) const {
+			return data.getLayerSize(layer);
+		}
+
 		void setActiveLayer(unsigned level) {
 			active_layer = level;
 		}
@@ -475,6 +589,13 @@ namespace data {
 			active_layer--;
 		}
 
+		// refines the active layer by bilinear interpolation of the cell values (2D only)
+		void refineLinear() {
+			assert_gt(active_layer, 0) << "Cannot refine any further";
+			data.refineFromLayerLinear(active_layer);
+			active_layer--;
+		}
+
 		template<typename Refiner>
 		void refineGrid(const Refiner& refiner) {
 			assert_gt(active_layer, 0) << "Cannot refine any further";
@@ -504,11 +625,91 @@ namespace data {
 			data.setBoundary(active_layer, dir, boundary);
 		}
 
+		// allocation-free access to the boundary of the active layer
+		StridedView<const T> getBoundaryView(Direction dir) const {
+			return data.getBoundaryView(active_layer, dir);
+		}
+
+		StridedView<T> getBoundaryView(Direction dir) {
+			return data.getBoundaryView(active_layer, dir);
+		}
+
+		// allocation-free access to the boundary of an arbitrary layer
+		StridedView<const T> getBoundaryView(unsigned layer, Direction dir) const {
+			return data.getBoundaryView(layer, dir);
+		}
+
+		void fillBoundary(Direction dir, const T& value) {
+			getBoundaryView(dir).fill(value);
+		}
+
+		/**
+		 * Copies the active layer into a row-major destination buffer whose consecutive rows
+		 * (along the first dimension) are row_stride elements apart.
+		 */
+		void copyActiveLayerTo(T* dst, std::ptrdiff_t row_stride) const {
+			copyLayerTo(active_layer, dst, row_stride);
+		}
+
+		/**
+		 * Copies an arbitrary layer into a row-major destination buffer whose consecutive rows
+		 * (along the first dimension) are row_stride elements apart.
+		 */
+		void copyLayerTo(unsigned layer, T* dst, std::ptrdiff_t row_stride) const {
+			static_assert(Dims == 2, "Only supported for 2D cells");
+			const auto size = data.getLayerSize(layer);
+			const T* src = data.getLayerOrigin(layer);
+			for(std::size_t x = 0; x < size[0]; ++x, src += size[1], dst += row_stride) {
+				std::copy(src, src + size[1], dst);
+			}
+		}
+
+		/**
+		 * Copies the strip of the given depth along the boundary of a layer in the given direction
+		 * into a row-major destination buffer whose consecutive rows (along the first dimension)
+		 * are row_stride elements apart. The strip retains its orientation within the layer, e.g.
+		 * the Right strip consists of depth rows of Y elements, the Up strip of X rows of depth elements.
+		 */
+		void copyBoundaryStripTo(unsigned layer, Direction dir, std::size_t depth, T* dst, std::ptrdiff_t row_stride) const {
+			static_assert(Dims == 2, "Only supported for 2D cells");
+			const auto size = data.getLayerSize(layer);
+			const std::size_t X = size[0];
+			const std::size_t Y = size[1];
+			std::size_t x0 = 0, x1 = X, y0 = 0, y1 = Y;
+			switch(dir) {
+				case Up:    assert_le(depth, Y); y0 = Y - depth; break;
+				case Down:  assert_le(depth, Y); y1 = depth;     break;
+				case Left:  assert_le(depth, X); x1 = depth;     break;
+				case Right: assert_le(depth, X); x0 = X - depth; break;
+			}
+			const T* src = data.getLayerOrigin(layer);
+			for(std::size_t x = x0; x < x1; ++x, dst += row_stride) {
+				std::copy(src + x * Y + y0, src + x * Y + y1, dst);
+			}
+		}
+
+		/**
+		 * Copies the active layer from a row-major source buffer whose consecutive rows
+		 * (along the first dimension) are row_stride elements apart.
+		 */
+		void copyActiveLayerFrom(const T* src, std::ptrdiff_t row_stride) {
+			static_assert(Dims == 2, "Only supported for 2D cells");
+			const auto size = getActiveLayerSize();
+			T* dst = data.getLayerOrigin(active_layer);
+			for(std::size_t x = 0; x < size[0]; ++x, src += row_stride, dst += size[1]) {
+				std::copy(src, src + size[1], dst);
+			}
+		}
+
 		void store(utils::ArchiveWriter& writer) const {
 			writer.write(active_layer);
 			writer.write(data);
 		}
 
+		std::size_t size_hint() const {
+			return utils::size_hint(active_layer) + utils::size_hint(data);
+		}
+
 		static AdaptiveGridCell load(utils::ArchiveReader& reader) {
 			AdaptiveGridCell cell;
 			cell.active_layer = std::move(reader.read<unsigned>());
@@ -518,6 +719,66 @@ namespace data {
 
 	};
 
+	/**
+	 * Gathers the given layer of the cell at position idx together with a halo of the given width
+	 * into a row-major buffer of size (X+2*halo)x(Y+2*halo), where (X,Y) is the size of the layer.
+	 * The halo is taken from the boundary strips of the direct neighbors on the same layer, thus
+	 * neighbors have to maintain this layer regardless of their active one, and the halo may not
+	 * be wider than the layer. Halo elements on the outer border of the grid as well as the
+	 * corners of the buffer are not modified.
+	 *
+	 * @return a bit mask with bit (1 << dir) set for each direction the halo has been filled in
+	 */
+	template<typename T, typename CellConfig>
+	unsigned gatherExtended(const Grid<AdaptiveGridCell<T,CellConfig>,2>& grid, const GridPoint<2>& idx, unsigned layer, T* dst, std::size_t halo) {
+		const auto& cell = grid[idx];
+		const auto size = cell.getLayerSize(layer);
+		const std::ptrdiff_t X = std::ptrdiff_t(size[0]);
+		const std::ptrdiff_t Y = std::ptrdiff_t(size[1]);
+		const std::ptrdiff_t h = std::ptrdiff_t(halo);
+		const std::ptrdiff_t ld = Y + 2 * h;
+		assert_le(h, std::min(X, Y)) << "Halo wider than the layer";
+
+		// the interior
+		cell.copyLayerTo(layer, dst + h * ld + h, ld);
+
+		// the halo
+		unsigned mask = 0;
+		if (idx.x > 0) {
+			grid[{idx.x-1, idx.y}].copyBoundaryStripTo(layer, Right, halo, dst + h, ld);
+			mask |= (1u << Left);
+		}
+		if (idx.x + 1 < grid.size().x) {
+			grid[{idx.x+1, idx.y}].copyBoundaryStripTo(layer, Left, halo, dst + (X + h) * ld + h, ld);
+			mask |= (1u << Right);
+		}
+		if (idx.y > 0) {
+			grid[{idx.x, idx.y-1}].copyBoundaryStripTo(layer, Up, halo, dst + h * ld, ld);
+			mask |= (1u << Down);
+		}
+		if (idx.y + 1 < grid.size().y) {
+			grid[{idx.x, idx.y+1}].copyBoundaryStripTo(layer, Down, halo, dst + h * ld + (Y + h), ld);
+			mask |= (1u << Up);
+		}
+		return mask;
+	}
+
+	/**
+	 * The same as above with a one element wide halo, i.e. into a buffer of size (X+2)x(Y+2).
+	 */
+	template<typename T, typename CellConfig>
+	unsigned gatherExtended(const Grid<AdaptiveGridCell<T,CellConfig>,2>& grid, const GridPoint<2>& idx, unsigned layer, T* dst) {
+		return gatherExtended(grid, idx, layer, dst, 1);
+	}
+
+	/**
+	 * The same as above, but gathers the active layer of the center cell.
+	 */
+	template<typename T, typename CellConfig>
+	unsigned gatherExtended(const Grid<AdaptiveGridCell<T,CellConfig>,2>& grid, const GridPoint<2>& idx, T* dst) {
+		return gatherExtended(grid, idx, grid[idx].getActiveLayer(), dst);
+	}
+
 	template<typename T, typename CellConfig, std::size_t Dims = 2>
 	using AdaptiveGridFragment = GridFragment<AdaptiveGridCell<T, CellConfig>, CellConfig::dims>;
 
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+
 #include "allscale/api/user/algorithm/pfor.h"
 
 #include "allscale/utils/static_grid.h"
@@ -12,54 +16,200 @@ namespace data {
 
 	namespace detail {
 
-		template<typename NestedType, typename DataType, typename RefinerType>
-		void refine(NestedType& nested, const DataType& data, const RefinerType& refiner) {
-			api::user::algorithm::detail::forEach({ 0 }, nested.data.size(), [&](const auto& index) -> void {
+		constexpr std::size_t num_elements() {
+			return 1;
+		}
+
+		template<typename ... Rest>
+		constexpr std::size_t num_elements(std::size_t a, Rest ... rest) {
+			return a * num_elements(rest...);
+		}
+
+		/**
+		 * Obtains a pointer to the first element of a layer. Elements are stored densely in
+		 * row-major order, i.e. element (x,y) of a XxY layer is located at origin + x * Y + y.
+		 */
+		template<typename T, std::size_t... Sizes>
+		T* getOrigin(utils::StaticGrid<T,Sizes...>& data) {
+			static_assert(sizeof(utils::StaticGrid<T,Sizes...>) == sizeof(T) * num_elements(Sizes...),
+					"layer data is not densely packed");
+			return &data[typename utils::StaticGrid<T,Sizes...>::addr_type(0)];
+		}
+
+		template<typename T, std::size_t... Sizes>
+		const T* getOrigin(const utils::StaticGrid<T,Sizes...>& data) {
+			return getOrigin(const_cast<utils::StaticGrid<T,Sizes...>&>(data));
+		}
+
+
+		// -- generic layer transfer kernels --
+
+		template<typename NestedData, typename Data, typename RefinerType>
+		void refineLayer(NestedData& nested, const Data& data, const RefinerType& refiner) {
+			api::user::algorithm::detail::forEach({ 0 }, nested.size(), [&](const auto& index) -> void {
 				// using the index of a cell on nested layer, computes index covering cell on this layer
-				auto newIndex = utils::elementwiseDivision(index, utils::elementwiseDivision(nested.data.size(), data.size()));
+				auto newIndex = utils::elementwiseDivision(index, utils::elementwiseDivision(nested.size(), data.size()));
 				// simply replicate data to cell on nested layer
-				nested.data[index] = refiner(data[newIndex]);
+				nested[index] = refiner(data[newIndex]);
 			});
 		}
 
-		template<typename NestedType, typename DataType, typename RefinerType>
-		void refineGrid(NestedType& nested, const DataType& data, const RefinerType& refiner) {
+		template<typename ElementType, unsigned... Dims, typename NestedData, typename Data, typename CoarsenerType>
+		void coarsenLayer(const NestedData& nested, Data& data, const CoarsenerType& coarsener) {
 			// using the index of a cell on this layer, computes index of first covered cell on nested layer
-			auto indexer = [&](const auto& index) { return utils::elementwiseProduct(index, utils::elementwiseDivision(nested.data.size(), data.size())); };
+			auto indexer = [&](const auto& index) { return utils::elementwiseProduct(index, utils::elementwiseDivision(nested.size(), data.size())); };
+
+			// compute divisor for average
+			unsigned result = 1;
+			(void)std::initializer_list<unsigned>{ (result *= Dims, 0u)... };
 
 			// iterate over cells on this layer
 			api::user::algorithm::detail::forEach({ 0 }, data.size(), [&](const auto& index) -> void {
-				const auto& res = refiner(data[index]);
+				ElementType sum = ElementType();
+				// iterate over subset of cells on nested layer, to be projected to the current cell pointed to by index
 				auto begin = indexer(index);
 				auto end = indexer(index + decltype(index){1});
-				api::user::algorithm::detail::forEach(begin, end, [&](const auto& i) {
-					nested.data[i] = res[i - indexer(index)];
+				api::user::algorithm::detail::forEach(begin, end, [&](const auto& i) -> void {
+					sum += coarsener(nested[i]);
 				});
+				data[index] = sum / result;
 			});
 		}
 
-		template<typename ElementType, unsigned... Dims, typename NestedType, typename DataType, typename CoarsenerType>
-		void coarsen(const NestedType& nested, DataType& data, const CoarsenerType& coarsener) {
+
+		// -- specialized 2D layer transfer kernels --
+
+		// In 2D the refinement ratios (e.g. 8x8 or 2x2) are compile-time constants, thus the kernels below
+		// operate on the dense layer storage with fixed-size inner loops instead of computing the covering
+		// cell of every element by index divisions.
+
+		template<typename T, std::size_t FX, std::size_t FY, std::size_t X, std::size_t Y, typename RefinerType>
+		void refineLayer(utils::StaticGrid<T,FX,FY>& nested, const utils::StaticGrid<T,X,Y>& data, const RefinerType& refiner) {
+			static_assert(FX % X == 0 && FY % Y == 0, "layer sizes must be multiples of each other");
+			constexpr std::size_t RX = FX / X;
+			constexpr std::size_t RY = FY / Y;
+
+			const T* src = getOrigin(data);
+			T* dst = getOrigin(nested);
+			for(std::size_t x = 0; x < X; ++x) {
+				for(std::size_t y = 0; y < Y; ++y) {
+					// replicate the refined value to the covered RX x RY block of the nested layer
+					const T value = refiner(src[x * Y + y]);
+					T* block = dst + (x * RX) * FY + y * RY;
+					for(std::size_t i = 0; i < RX; ++i) {
+						for(std::size_t j = 0; j < RY; ++j) {
+							block[i * FY + j] = value;
+						}
+					}
+				}
+			}
+		}
+
+		template<typename ElementType, unsigned DX, unsigned DY, typename T, std::size_t FX, std::size_t FY, std::size_t X, std::size_t Y, typename CoarsenerType>
+		void coarsenLayer(const utils::StaticGrid<T,FX,FY>& nested, utils::StaticGrid<T,X,Y>& data, const CoarsenerType& coarsener) {
+			static_assert(FX == X * DX && FY == Y * DY, "layer sizes do not match the layer ratio");
+
+			// the divisor of the average
+			const unsigned result = DX * DY;
+
+			const T* src = getOrigin(nested);
+			T* dst = getOrigin(data);
+			for(std::size_t x = 0; x < X; ++x) {
+				for(std::size_t y = 0; y < Y; ++y) {
+					// accumulate the covered DX x DY block of the nested layer
+					const T* block = src + (x * DX) * FY + y * DY;
+					ElementType sum = ElementType();
+					for(std::size_t i = 0; i < DX; ++i) {
+						for(std::size_t j = 0; j < DY; ++j) {
+							sum += coarsener(block[i * FY + j]);
+						}
+					}
+					dst[x * Y + y] = sum / result;
+				}
+			}
+		}
+
+		/**
+		 * Computes, for each element of a fine axis of length F, the lower index of the two enclosing
+		 * elements of the coarse axis of length C and the interpolation weight of the upper one. Values
+		 * are considered to be located at cell centers; beyond the outermost centers the value is
+		 * extended constantly.
+		 */
+		template<std::size_t F, std::size_t C>
+		void getLinearWeights(std::array<std::size_t,F>& lower, std::array<double,F>& weight) {
+			constexpr double ratio = double(C) / double(F);
+			for(std::size_t f = 0; f < F; ++f) {
+				if (C == 1) {
+					lower[f] = 0;
+					weight[f] = 0.0;
+					continue;
+				}
+				const double pos = std::min(std::max((f + 0.5) * ratio - 0.5, 0.0), double(C - 1));
+				lower[f] = std::min(std::size_t(pos), C - 2);
+				weight[f] = pos - double(lower[f]);
+			}
+		}
+
+		template<typename T, std::size_t FX, std::size_t FY, std::size_t X, std::size_t Y>
+		void refineLayerLinear(utils::StaticGrid<T,FX,FY>& nested, const utils::StaticGrid<T,X,Y>& data) {
+			static_assert(FX % X == 0 && FY % Y == 0, "layer sizes must be multiples of each other");
+
+			std::array<std::size_t,FX> lx;
+			std::array<std::size_t,FY> ly;
+			std::array<double,FX> wx;
+			std::array<double,FY> wy;
+			getLinearWeights<FX,X>(lx, wx);
+			getLinearWeights<FY,Y>(ly, wy);
+
+			const T* src = getOrigin(data);
+			T* dst = getOrigin(nested);
+			for(std::size_t i = 0; i < FX; ++i) {
+				const T* row0 = src + lx[i] * Y;
+				const T* row1 = (X > 1) ? row0 + Y : row0;
+				for(std::size_t j = 0; j < FY; ++j) {
+					const std::size_t k0 = ly[j];
+					const std::size_t k1 = (Y > 1) ? k0 + 1 : k0;
+					const T a = row0[k0] + (row0[k1] - row0[k0]) * wy[j];
+					const T b = row1[k0] + (row1[k1] - row1[k0]) * wy[j];
+					dst[i * FY + j] = a + (b - a) * wx[i];
+				}
+			}
+		}
+
+
+		// -- layer transfer entry points --
+
+		template<typename NestedType, typename DataType, typename RefinerType>
+		void refine(NestedType& nested, const DataType& data, const RefinerType& refiner) {
+			refineLayer(nested.data, data, refiner);
+		}
+
+		template<typename NestedType, typename DataType>
+		void refineLinear(NestedType& nested, const DataType& data) {
+			refineLayerLinear(nested.data, data);
+		}
+
+		template<typename NestedType, typename DataType, typename RefinerType>
+		void refineGrid(NestedType& nested, const DataType& data, const RefinerType& refiner) {
 			// using the index of a cell on this layer, computes index of first covered cell on nested layer
 			auto indexer = [&](const auto& index) { return utils::elementwiseProduct(index, utils::elementwiseDivision(nested.data.size(), data.size())); };
 
-			// compute divisor for average
-			unsigned result = 1;
-			(void)std::initializer_list<unsigned>{ (result *= Dims, 0u)... };
-
 			// iterate over cells on this layer
 			api::user::algorithm::detail::forEach({ 0 }, data.size(), [&](const auto& index) -> void {
-				ElementType sum = ElementType();
-				// iterate over subset of cells on nested layer, to be projected to the current cell pointed to by index
+				const auto& res = refiner(data[index]);
 				auto begin = indexer(index);
 				auto end = indexer(index + decltype(index){1});
-				api::user::algorithm::detail::forEach(begin, end, [&](const auto& i) -> void {
-					sum += coarsener(nested.data[i]);
+				api::user::algorithm::detail::forEach(begin, end, [&](const auto& i) {
+					nested.data[i] = res[i - indexer(index)];
 				});
-				data[index] = sum / result;
 			});
 		}
 
+		template<typename ElementType, unsigned... Dims, typename NestedType, typename DataType, typename CoarsenerType>
+		void coarsen(const NestedType& nested, DataType& data, const CoarsenerType& coarsener) {
+			coarsenLayer<ElementType, Dims...>(nested.data, data, coarsener);
+		}
+
 		template<typename ElementType, unsigned... Dims, typename NestedType, typename DataType, typename CoarsenerType>
 		void coarsenGrid(const NestedType& nested, DataType& data, const CoarsenerType& coarsener) {
 			// using the index of a cell on this layer, computes index of first covered cell on nested layer
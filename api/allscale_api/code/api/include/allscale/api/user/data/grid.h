@@ -6,6 +6,7 @@
 #include "allscale/api/core/data.h"
 
 #include "allscale/api/user/algorithm/pfor.h"
+#include "allscale/api/user/algorithm/preduce.h"
 
 #include "allscale/utils/assert.h"
 #include "allscale/utils/large_array.h"
@@ -653,6 +654,13 @@ namespace data {
 			writer.write(regions);
 		}
 
+		/**
+		 * The size of this region within an archive.
+		 */
+		std::size_t size_hint() const {
+			return utils::size_hint(regions);
+		}
+
 		friend std::ostream& operator<<(std::ostream& out, const GridRegion& region) {
 			return out << "{" << utils::join(",",region.regions) << "}";
 		}
@@ -833,6 +841,11 @@ namespace data {
 			assert_pred2(core::isSubRegion, region, getCoveredRegion())
 				<< "This fragment does not contain all of the requested data!";
 
+			// make space for the data of trivially serializable elements at once
+			if (utils::is_trivially_serializable<T>::value) {
+				writer.reserve(utils::size_hint(region) + region.area() * sizeof(T));
+			}
+
 			// write the requested region to the archive
 			writer.write(region);
 
@@ -1031,6 +1044,26 @@ namespace data {
 			return algorithm::pfor(coordinate_type(0), size(), [&](const auto& pos) { op((*this)[pos]); });
 		}
 
+		/**
+		 * A parallel reduction over all elements within this grid. Each worker folds the elements
+		 * of its part of the grid into a local state created by init and converted by finish, the partial
+		 * results are combined by reduce in an order not depending on the scheduling (see algorithm::preduce).
+		 */
+		template<typename FoldOp, typename ReduceOp, typename InitLocalState, typename FinishLocalState>
+		auto preduce(const FoldOp& fold, const ReduceOp& reduce, const InitLocalState& init, const FinishLocalState& finish) const {
+			using state_type = std::decay_t<decltype(init())>;
+			return algorithm::preduce(coordinate_type(0), size(), [this,fold](const coordinate_type& pos, state_type& res) { fold((*this)[pos], res); }, reduce, init, finish);
+		}
+
+		/**
+		 * A parallel reduction over all elements within this grid, see above.
+		 */
+		template<typename FoldOp, typename ReduceOp, typename InitLocalState>
+		auto preduce(const FoldOp& fold, const ReduceOp& reduce, const InitLocalState& init) const {
+			using state_type = std::decay_t<decltype(init())>;
+			return algorithm::preduce(coordinate_type(0), size(), [this,fold](const coordinate_type& pos, state_type& res) { fold((*this)[pos], res); }, reduce, init);
+		}
+
 	};
 
 } // end namespace data
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <iterator>
+#include <limits>
 #include <ostream>
 #include <tuple>
+#include <vector>
 
 #include <bitset>
 #include <cstring>
@@ -573,6 +576,27 @@ namespace data {
 					edges.push_back({from,to});
 				}
 
+				template<typename Op>
+				void forEachEdge(const Op& op) const {
+					for(const auto& cur : edges) {
+						op(cur.first,cur.second);
+					}
+				}
+
+				void remapSources(const std::vector<node_index_t>& newIndex) {
+					for(auto& cur : edges) {
+						assert_lt(cur.first,newIndex.size());
+						cur.first = NodeID(newIndex[cur.first]);
+					}
+				}
+
+				void remapTargets(const std::vector<node_index_t>& newIndex) {
+					for(auto& cur : edges) {
+						assert_lt(cur.second,newIndex.size());
+						cur.second = NodeID(newIndex[cur.second]);
+					}
+				}
+
 				bool isClosed() const {
 					return edges.empty();
 				}
@@ -684,6 +708,24 @@ namespace data {
 				getEdgeRelation<EdgeKind,Level>().addEdge(src,trg);
 			}
 
+			// visits the edges added since the last close operation
+			template<typename EdgeKind, unsigned Level, typename Op>
+			void forEachEdge(const Op& op) const {
+				getEdgeRelation<EdgeKind,Level>().forEachEdge(op);
+			}
+
+			// renumbers the sources of the edges added since the last close operation
+			template<typename EdgeKind, unsigned Level>
+			void remapSources(const std::vector<node_index_t>& newIndex) {
+				getEdgeRelation<EdgeKind,Level>().remapSources(newIndex);
+			}
+
+			// renumbers the targets of the edges added since the last close operation
+			template<typename EdgeKind, unsigned Level>
+			void remapTargets(const std::vector<node_index_t>& newIndex) {
+				getEdgeRelation<EdgeKind,Level>().remapTargets(newIndex);
+			}
+
 			void close() {
 				// for all levels
 				for(auto& level : data) {
@@ -824,6 +866,52 @@ namespace data {
 					trg = parent;
 				}
 
+				void remapParents(const std::vector<node_index_t>& newIndex) {
+					// a constant for an unknown parent
+					static const NodeID unknownParent(std::numeric_limits<node_index_t>::max());
+
+					// move the lists of children to the new positions of their parents
+					std::vector<std::vector<NodeID>> newChildren;
+					for(std::size_t i=0; i<children.size(); ++i) {
+						if (children[i].empty()) continue;
+						assert_lt(i,newIndex.size());
+						auto pos = newIndex[i];
+						if (pos >= newChildren.size()) newChildren.resize(pos + 1);
+						newChildren[pos] = std::move(children[i]);
+					}
+					children = std::move(newChildren);
+
+					// update the parents of the children
+					for(auto& cur : parents) {
+						if (cur == unknownParent) continue;
+						cur = NodeID(newIndex[cur]);
+					}
+				}
+
+				void remapChildren(const std::vector<node_index_t>& newIndex) {
+					// a constant for an unknown parent
+					static const NodeID unknownParent(std::numeric_limits<node_index_t>::max());
+
+					// update the lists of children
+					for(auto& list : children) {
+						for(auto& cur : list) {
+							assert_lt(cur,newIndex.size());
+							cur = NodeID(newIndex[cur]);
+						}
+					}
+
+					// move the parents to the new positions of their children
+					std::vector<NodeID> newParents;
+					for(std::size_t i=0; i<parents.size(); ++i) {
+						if (parents[i] == unknownParent) continue;
+						assert_lt(i,newIndex.size());
+						auto pos = newIndex[i];
+						if (pos >= newParents.size()) newParents.resize(pos + 1,unknownParent);
+						newParents[pos] = parents[i];
+					}
+					parents = std::move(newParents);
+				}
+
 				bool isClosed() const {
 					return children.empty();
 				}
@@ -958,6 +1046,18 @@ namespace data {
 				getRelation<HierarchyKind,Level-1>().addChild(parent,child);
 			}
 
+			// renumbers the parents (on the given level) of the links added since the last close operation
+			template<typename HierarchyKind, unsigned Level>
+			void remapParents(const std::vector<node_index_t>& newIndex) {
+				getRelation<HierarchyKind,Level-1>().remapParents(newIndex);
+			}
+
+			// renumbers the children (on the level below the given one) of the links added since the last close operation
+			template<typename HierarchyKind, unsigned Level>
+			void remapChildren(const std::vector<node_index_t>& newIndex) {
+				getRelation<HierarchyKind,Level-1>().remapChildren(newIndex);
+			}
+
 			void close() {
 				for(auto& level : data) {
 					for(auto& rel : level) {
@@ -2236,6 +2336,145 @@ namespace data {
 		};
 
 
+		// -- node reordering --
+
+		/**
+		 * Computes the reverse Cuthill-McKee ordering of the nodes of an undirected graph given by
+		 * its (symmetric) adjacency lists. Nodes close to each other in the graph obtain close
+		 * indices, thus ranges of indices form compact sub-graphs. Each connected component is
+		 * numbered starting from a pseudo-peripheral node (George and Liu), neighbors are visited
+		 * in the order of increasing degree, ties are broken by the index -- the result is thus
+		 * deterministic. The result maps the old index of each node to its new index.
+		 */
+		inline std::vector<node_index_t> reverseCuthillMcKee(const std::vector<std::vector<node_index_t>>& adjacency) {
+			const std::size_t n = adjacency.size();
+
+			auto lessDegree = [&](node_index_t a, node_index_t b) {
+				auto da = adjacency[a].size();
+				auto db = adjacency[b].size();
+				return da < db || (da == db && a < b);
+			};
+
+			std::vector<bool> ordered(n,false);
+			std::vector<node_index_t> order;
+			order.reserve(n);
+
+			// a breadth first search among the nodes not ordered yet, recording the depth of the nodes
+			std::vector<std::size_t> mark(n,0);
+			std::vector<std::size_t> depth(n,0);
+			std::vector<node_index_t> visited;
+			std::size_t stamp = 0;
+			auto bfs = [&](node_index_t start) {
+				++stamp;
+				visited.clear();
+				visited.push_back(start);
+				mark[start] = stamp;
+				depth[start] = 0;
+				for(std::size_t i=0; i<visited.size(); ++i) {
+					auto cur = visited[i];
+					for(auto next : adjacency[cur]) {
+						if (ordered[next] || mark[next] == stamp) continue;
+						mark[next] = stamp;
+						depth[next] = depth[cur] + 1;
+						visited.push_back(next);
+					}
+				}
+				return depth[visited.back()];
+			};
+
+			for(node_index_t first = 0; first < n; ++first) {
+				if (ordered[first]) continue;
+
+				// find a pseudo-peripheral node of the component of the first node
+				node_index_t start = first;
+				auto eccentricity = bfs(start);
+				while(true) {
+					// pick the node of minimal degree on the last level
+					node_index_t candidate = visited.back();
+					for(auto it = visited.rbegin(); it != visited.rend() && depth[*it] == eccentricity; ++it) {
+						if (lessDegree(*it,candidate)) candidate = *it;
+					}
+					auto e = bfs(candidate);
+					if (e <= eccentricity) break;
+					start = candidate;
+					eccentricity = e;
+				}
+
+				// number the component level by level (Cuthill-McKee)
+				std::size_t pos = order.size();
+				order.push_back(start);
+				ordered[start] = true;
+				for(; pos < order.size(); ++pos) {
+					std::size_t begin = order.size();
+					for(auto next : adjacency[order[pos]]) {
+						if (ordered[next]) continue;
+						ordered[next] = true;
+						order.push_back(next);
+					}
+					std::sort(order.begin() + begin, order.end(), lessDegree);
+				}
+			}
+
+			// reverse the ordering and invert it
+			assert_eq(n,order.size());
+			std::vector<node_index_t> res(n);
+			for(std::size_t i=0; i<n; ++i) {
+				res[order[i]] = n - 1 - i;
+			}
+			return res;
+		}
+
+		/**
+		 * Computes the ordering of nodes along a space filling curve (the Z-order curve) through
+		 * the given coordinates of the nodes. Nodes close to each other in space obtain close
+		 * indices. Ties are broken by the index -- the result is thus deterministic. The result maps
+		 * the old index of each node to its new index.
+		 */
+		template<std::size_t D>
+		std::vector<node_index_t> spaceFillingCurveOrder(const std::vector<std::array<double,D>>& coordinates) {
+			static_assert(D > 0, "There must be at least one dimension!");
+			const std::size_t n = coordinates.size();
+			const unsigned bits = std::min<unsigned>(64 / D, 32);
+
+			// get the bounding box
+			std::array<double,D> lo;
+			std::array<double,D> hi;
+			lo.fill(std::numeric_limits<double>::max());
+			hi.fill(std::numeric_limits<double>::lowest());
+			for(const auto& cur : coordinates) {
+				for(std::size_t d=0; d<D; ++d) {
+					lo[d] = std::min(lo[d],cur[d]);
+					hi[d] = std::max(hi[d],cur[d]);
+				}
+			}
+
+			// quantize the coordinates and interleave their bits
+			const double cells = static_cast<double>((uint64_t(1) << bits) - 1);
+			std::vector<std::pair<uint64_t,node_index_t>> keys(n);
+			for(std::size_t i=0; i<n; ++i) {
+				std::array<uint64_t,D> q;
+				for(std::size_t d=0; d<D; ++d) {
+					q[d] = (hi[d] > lo[d]) ? static_cast<uint64_t>((coordinates[i][d] - lo[d]) / (hi[d] - lo[d]) * cells) : 0;
+				}
+				uint64_t key = 0;
+				for(unsigned b = bits; b > 0; --b) {
+					for(std::size_t d=0; d<D; ++d) {
+						key = (key << 1) | ((q[d] >> (b-1)) & 0x1);
+					}
+				}
+				keys[i] = { key, i };
+			}
+
+			// sort the nodes along the curve
+			std::sort(keys.begin(),keys.end());
+			std::vector<node_index_t> res(n);
+			for(std::size_t i=0; i<n; ++i) {
+				res[keys[i].second] = i;
+			}
+			return res;
+		}
+
+
 		class NaiveMeshPartitioner {
 
 		public:
@@ -2952,6 +3191,30 @@ namespace data {
 			return preduce<Kind, Level>(map, reduce, [](){ return res_type(); }, [](res_type a) { return a; });
 		}
 
+		// -- partition quality --
+
+		/**
+		 * Counts the edges of the given kind on the given level connecting nodes in different leaf
+		 * partitions of the partition tree. This is a measure of the data exchanged between the
+		 * partitions -- the lower, the better the locality of the node numbering.
+		 */
+		template<typename EdgeKind, unsigned Level = 0>
+		std::size_t getEdgeCut() const {
+			using A = typename EdgeKind::src_node_kind;
+			using B = typename EdgeKind::trg_node_kind;
+
+			auto srcPartitions = getLeafPartitions<A,Level>();
+			auto trgPartitions = getLeafPartitions<B,Level>();
+
+			std::size_t cut = 0;
+			for(std::size_t i=0; i<srcPartitions.size(); ++i) {
+				for(const auto& trg : getSinks<EdgeKind>(NodeRef<A,Level>((node_index_t)i))) {
+					if (srcPartitions[i] != trgPartitions[trg.id]) cut++;
+				}
+			}
+			return cut;
+		}
+
 		// -- mesh data --
 
 		template<typename NodeKind, typename T, unsigned Level = 0>
@@ -3036,6 +3299,23 @@ namespace data {
 
 		}
 
+	private:
+
+		// obtains the index of the leaf partition of each node of the given kind on the given level
+		template<typename Kind, unsigned Level>
+		std::vector<std::size_t> getLeafPartitions() const {
+			std::vector<std::size_t> res(getNumNodes<Kind,Level>(),0);
+			std::size_t leaf = 0;
+			detail::SubTreeRef::root().enumerate<PartitionDepth,true>([&](const detail::SubTreeRef& ref) {
+				if (ref.getDepth() != PartitionDepth) return;
+				for(const auto& cur : partitionTree.template getNodeRange<Kind,Level>(ref)) {
+					res[cur.id] = leaf;
+				}
+				leaf++;
+			});
+			return res;
+		}
+
 	};
 
 
@@ -3124,6 +3404,132 @@ namespace data {
 			return data.hierarchySets.template addChild<HierarchyKind,LevelA>(parent,child);
 		}
 
+		// -- node reordering --
+
+		/**
+		 * Renumbers the nodes of the given kind on the given level such that node i becomes node
+		 * newIndex[i]. Edges and hierarchies linking those nodes are updated accordingly, references
+		 * to nodes obtained before have to be updated by the caller utilizing the same mapping.
+		 *
+		 * Since the partitioner splits ranges of node indices, the numbering determines the locality
+		 * of the resulting partitions, see Mesh::getEdgeCut.
+		 */
+		template<typename Kind, unsigned Level = 0>
+		void reorder(const std::vector<node_index_t>& newIndex) {
+			static_assert(Level < Levels, "Trying to reorder nodes on invalid level.");
+
+			// check that this is a permutation of the nodes
+			assert_eq(newIndex.size(),(data.template getNumNodes<Kind,Level>()))
+				<< "Permutation does not cover all nodes!";
+			assert_true([&]() {
+				std::vector<bool> covered(newIndex.size(),false);
+				for(auto cur : newIndex) {
+					if (cur >= covered.size() || covered[cur]) return false;
+					covered[cur] = true;
+				}
+				return true;
+			}()) << "Invalid permutation of nodes!";
+
+			// remap edges
+			data.forAllEdgeKinds([&](const auto& edgeKind, const auto& level) {
+				using EdgeKind = detail::plain_type<decltype(edgeKind)>;
+				using lvl = detail::get_level<decltype(level)>;
+				if (lvl::value != Level) return;
+				if (std::is_same<typename EdgeKind::src_node_kind,Kind>::value) {
+					data.edgeSets.template remapSources<EdgeKind,lvl::value>(newIndex);
+				}
+				if (std::is_same<typename EdgeKind::trg_node_kind,Kind>::value) {
+					data.edgeSets.template remapTargets<EdgeKind,lvl::value>(newIndex);
+				}
+			});
+
+			// remap hierarchies
+			data.forAllHierarchyKinds([&](const auto& hierarchyKind, const auto& level) {
+				using HierarchyKind = detail::plain_type<decltype(hierarchyKind)>;
+				using lvl = detail::get_level<decltype(level)>;
+				if (lvl::value == Level && std::is_same<typename HierarchyKind::parent_node_kind,Kind>::value) {
+					data.hierarchySets.template remapParents<HierarchyKind,lvl::value>(newIndex);
+				}
+				if (lvl::value == Level+1 && std::is_same<typename HierarchyKind::child_node_kind,Kind>::value) {
+					data.hierarchySets.template remapChildren<HierarchyKind,lvl::value>(newIndex);
+				}
+			});
+		}
+
+		/**
+		 * Renumbers the nodes of the given kind on the given level in reverse Cuthill-McKee order.
+		 * Nodes are considered adjacent if they are linked by an edge, or if they are linked to
+		 * a common node of another kind (e.g. cells sharing a face).
+		 *
+		 * @return the mapping of old to new node indices, see reorder
+		 */
+		template<typename Kind, unsigned Level = 0>
+		std::vector<node_index_t> reorderReverseCuthillMcKee() {
+			static_assert(Level < Levels, "Trying to reorder nodes on invalid level.");
+			std::vector<std::vector<node_index_t>> adjacency(data.template getNumNodes<Kind,Level>());
+
+			data.forAllEdgeKinds([&](const auto& edgeKind, const auto& level) {
+				using EdgeKind = detail::plain_type<decltype(edgeKind)>;
+				using lvl = detail::get_level<decltype(level)>;
+				if (lvl::value != Level) return;
+
+				const bool src = std::is_same<typename EdgeKind::src_node_kind,Kind>::value;
+				const bool trg = std::is_same<typename EdgeKind::trg_node_kind,Kind>::value;
+
+				// direct links
+				if (src && trg) {
+					data.edgeSets.template forEachEdge<EdgeKind,lvl::value>([&](NodeID a, NodeID b) {
+						if (a == b) return;
+						adjacency[a].push_back(b);
+						adjacency[b].push_back(a);
+					});
+					return;
+				}
+
+				// links through a common node of another kind
+				if (!src && !trg) return;
+				std::vector<std::vector<node_index_t>> shared;
+				data.edgeSets.template forEachEdge<EdgeKind,lvl::value>([&](NodeID a, NodeID b) {
+					node_index_t other = (src) ? b : a;
+					if (other >= shared.size()) shared.resize(other + 1);
+					shared[other].push_back((src) ? a : b);
+				});
+				for(const auto& list : shared) {
+					for(auto a : list) {
+						for(auto b : list) {
+							if (a != b) adjacency[a].push_back(b);
+						}
+					}
+				}
+			});
+
+			// eliminate duplicates
+			for(auto& list : adjacency) {
+				std::sort(list.begin(),list.end());
+				list.erase(std::unique(list.begin(),list.end()),list.end());
+			}
+
+			auto newIndex = detail::reverseCuthillMcKee(adjacency);
+			reorder<Kind,Level>(newIndex);
+			return newIndex;
+		}
+
+		/**
+		 * Renumbers the nodes of the given kind on the given level along a space filling curve
+		 * through the given coordinates of the nodes (e.g. cell centers).
+		 *
+		 * @return the mapping of old to new node indices, see reorder
+		 */
+		template<typename Kind, unsigned Level = 0, std::size_t D>
+		std::vector<node_index_t> reorderSpaceFillingCurve(const std::vector<std::array<double,D>>& coordinates) {
+			static_assert(Level < Levels, "Trying to reorder nodes on invalid level.");
+			assert_eq(coordinates.size(),(data.template getNumNodes<Kind,Level>()))
+				<< "Coordinates do not cover all nodes!";
+			auto newIndex = detail::spaceFillingCurveOrder(coordinates);
+			reorder<Kind,Level>(newIndex);
+			return newIndex;
+		}
+
 		// -- build mesh --
 
 		template<typename Partitioner, unsigned PartitionDepth = 0>
@@ -1,59 +1,265 @@
 #pragma once
 
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "allscale/api/core/io.h"
 #include "allscale/api/user/algorithm/pfor.h"
+#include "allscale/utils/assert.h"
 
 
 namespace allscale {
 namespace api {
 namespace user {
 
-// Save vector of vectors to binary in parallel
-template<typename T>
-void saveVecVecToFile(std::vector<std::vector<T>> vecVec, std::string filename, size_t innerSize) {
-	core::FileIOManager& manager = core::FileIOManager::getInstance();
-	size_t outerSize = vecVec.size();
+namespace detail {
 
-	// generate output data
-	core::Entry binary = manager.createEntry(filename, core::Mode::Binary);
-	auto fout = manager.openOutputStream(binary);
+	// computes the offsets of consecutive records of the given sizes, the last entry is the total size
+	inline std::vector<std::size_t> recordOffsets(const std::vector<std::size_t>& recordSizes) {
+		std::vector<std::size_t> offsets(recordSizes.size() + 1, 0);
+		for(std::size_t i = 0; i < recordSizes.size(); ++i) {
+			offsets[i+1] = offsets[i] + recordSizes[i];
+		}
+		return offsets;
+	}
 
-//	fout.write(innerSize);
+	// obtains the size of the given file in bytes
+	inline std::size_t fileSize(const std::string& filename) {
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		assert_true(file.good()) << "Unable to open file " << filename;
+		return static_cast<std::size_t>(file.tellg());
+	}
 
-	std::vector<size_t> idxVec;
-	for(size_t i = 0; i < innerSize; ++i)
-		idxVec.push_back(i);
+} // end namespace detail
 
-	algorithm::pfor(idxVec, [&](size_t& i) {
-		fout.atomic([&](auto& out) {
-			// write preamble
-			out.write(i);
+/**
+ * A binary file composed of records of known sizes which is written in parallel. Every
+ * record occupies a byte range of the file fixed in advance, such that tasks write their
+ * records straight into the memory mapped file without any synchronization, and the layout
+ * of the file does not depend on the order in which the tasks are processed.
+ *
+ * Opening and closing the writer is not thread safe (see core::FileIOManager), the writes are.
+ */
+class BinaryFileWriter {
 
-			// write data
-			for(size_t j = 0; j < outerSize; ++j) {
-				out.write(vecVec[j][i]);
-			}
-		});
-	});
+	std::string filename;
 
-	manager.close(fout);
+	std::vector<std::size_t> offsets;
 
+	std::unique_ptr<core::MemoryMappedOutput> out;
+
+	char* base;
+
+public:
+
+	/**
+	 * Creates the file of records of the given sizes (in bytes), laid out one after another.
+	 */
+	BinaryFileWriter(const std::string& filename, const std::vector<std::size_t>& recordSizes)
+		: filename(filename), offsets(detail::recordOffsets(recordSizes)), base(nullptr) {
+		if (getSize() == 0) {
+			// nothing to map, just create an empty file
+			std::ofstream(filename, std::ios::binary | std::ios::trunc);
+			return;
+		}
+		core::FileIOManager& manager = core::FileIOManager::getInstance();
+		core::Entry entry = manager.createEntry(filename, core::Mode::Binary);
+		out.reset(new core::MemoryMappedOutput(manager.openMemoryMappedOutput(entry, getSize())));
+		base = &out->access<char>();
+	}
+
+	/**
+	 * Creates the file of the given number of records of equal size (in bytes).
+	 */
+	BinaryFileWriter(const std::string& filename, std::size_t numRecords, std::size_t recordSize)
+		: BinaryFileWriter(filename, std::vector<std::size_t>(numRecords, recordSize)) {}
+
+	BinaryFileWriter(const BinaryFileWriter&) = delete;
+	BinaryFileWriter& operator=(const BinaryFileWriter&) = delete;
+
+	~BinaryFileWriter() {
+		close();
+	}
+
+	std::size_t getNumRecords() const {
+		return offsets.size() - 1;
+	}
+
+	std::size_t getSize() const {
+		return offsets.back();
+	}
+
+	std::size_t getOffset(std::size_t record) const {
+		assert_lt(record, getNumRecords());
+		return offsets[record];
+	}
+
+	std::size_t getRecordSize(std::size_t record) const {
+		assert_lt(record, getNumRecords());
+		return offsets[record+1] - offsets[record];
+	}
+
+	/**
+	 * Writes the given elements into the given record, starting at the given byte position.
+	 */
+	template<typename T>
+	void write(std::size_t record, const T* data, std::size_t count, std::size_t pos = 0) {
+		assert_true(base != nullptr || count == 0) << "Writing to closed file " << filename;
+		assert_le(pos + count * sizeof(T), getRecordSize(record))
+			<< "Out of bounds of record " << record << " of " << filename;
+		if (count == 0) return;
+		std::memcpy(base + getOffset(record) + pos, data, count * sizeof(T));
+	}
+
+	/**
+	 * Writes a single element into the given record at the given byte position of the record.
+	 */
+	template<typename T>
+	void writeValue(std::size_t record, const T& value, std::size_t pos = 0) {
+		write(record, &value, 1, pos);
+	}
+
+	/**
+	 * Flushes the file and releases the mapping -- the writer must not be used afterwards.
+	 */
+	void close() {
+		if (!out) return;
+		core::FileIOManager::getInstance().close(*out);
+		out.reset();
+		base = nullptr;
+	}
+
+};
+
+/**
+ * A reader of a binary file composed of records of known sizes, the counterpart of the
+ * BinaryFileWriter. The file is memory mapped, such that the records may be read by
+ * any number of tasks in parallel.
+ */
+class BinaryFileReader {
+
+	std::string filename;
+
+	std::vector<std::size_t> offsets;
+
+	std::unique_ptr<core::MemoryMappedInput> in;
+
+	const char* base;
+
+public:
+
+	/**
+	 * Opens the file of records of the given sizes (in bytes), the size of the file must match.
+	 */
+	BinaryFileReader(const std::string& filename, const std::vector<std::size_t>& recordSizes)
+		: filename(filename), offsets(detail::recordOffsets(recordSizes)), base(nullptr) {
+		assert_eq(getSize(), detail::fileSize(filename)) << "Unexpected size of file " << filename;
+		if (getSize() == 0) return;
+		core::FileIOManager& manager = core::FileIOManager::getInstance();
+		core::Entry entry = manager.createEntry(filename, core::Mode::Binary);
+		in.reset(new core::MemoryMappedInput(manager.openMemoryMappedInput(entry)));
+		base = &in->access<char>();
+	}
+
+	/**
+	 * Opens the file of the given number of records of equal size (in bytes).
+	 */
+	BinaryFileReader(const std::string& filename, std::size_t numRecords, std::size_t recordSize)
+		: BinaryFileReader(filename, std::vector<std::size_t>(numRecords, recordSize)) {}
+
+	BinaryFileReader(const BinaryFileReader&) = delete;
+	BinaryFileReader& operator=(const BinaryFileReader&) = delete;
+
+	~BinaryFileReader() {
+		close();
+	}
+
+	std::size_t getNumRecords() const {
+		return offsets.size() - 1;
+	}
+
+	std::size_t getSize() const {
+		return offsets.back();
+	}
+
+	std::size_t getOffset(std::size_t record) const {
+		assert_lt(record, getNumRecords());
+		return offsets[record];
+	}
+
+	std::size_t getRecordSize(std::size_t record) const {
+		assert_lt(record, getNumRecords());
+		return offsets[record+1] - offsets[record];
+	}
+
+	/**
+	 * Reads elements of the given record, starting at the given byte position.
+	 */
+	template<typename T>
+	void read(std::size_t record, T* data, std::size_t count, std::size_t pos = 0) const {
+		assert_true(base != nullptr || count == 0) << "Reading from closed file " << filename;
+		assert_le(pos + count * sizeof(T), getRecordSize(record))
+			<< "Out of bounds of record " << record << " of " << filename;
+		if (count == 0) return;
+		std::memcpy(data, base + getOffset(record) + pos, count * sizeof(T));
+	}
+
+	/**
+	 * Reads a single element of the given record at the given byte position of the record.
+	 */
+	template<typename T>
+	T readValue(std::size_t record, std::size_t pos = 0) const {
+		T value;
+		read(record, &value, 1, pos);
+		return value;
+	}
+
+	/**
+	 * Releases the mapping -- the reader must not be used afterwards.
+	 */
+	void close() {
+		if (!in) return;
+		core::FileIOManager::getInstance().close(*in);
+		in.reset();
+		base = nullptr;
+	}
+
+};
+
+// Save vector of vectors to binary in parallel: record i holds the index i followed by
+// the elements vecVec[j][i] of all the vectors, records are stored in order of indices
+template<typename T>
+void saveVecVecToFile(const std::vector<std::vector<T>>& vecVec, const std::string& filename, size_t innerSize) {
+	size_t outerSize = vecVec.size();
+
+	BinaryFileWriter fout(filename, innerSize, sizeof(size_t) + outerSize * sizeof(T));
+
+	algorithm::pfor(size_t(0), innerSize, [&](size_t i) {
+		// write preamble
+		fout.writeValue(i, i);
+
+		// write data
+		for(size_t j = 0; j < outerSize; ++j) {
+			fout.writeValue(i, vecVec[j][i], sizeof(size_t) + j * sizeof(T));
+		}
+	});
+
+	fout.close();
 }
 
 template<typename T>
-void saveVecVecToFileMM(std::vector<std::vector<T>> vecVec, std::string filename, unsigned outerSize, unsigned innerSize) {
+void saveVecVecToFileMM(const std::vector<std::vector<T>>& vecVec, const std::string& filename, unsigned outerSize, unsigned innerSize) {
 	core::FileIOManager& manager = core::FileIOManager::getInstance();
 
 	// generate output data
 	core::Entry binary = manager.createEntry(filename, core::Mode::Binary);
 	core::MemoryMappedOutput fout = manager.openMemoryMappedOutput(binary, sizeof(T)* outerSize*innerSize);
 
-	std::vector<size_t> idxVec;
-	for(size_t i = 0; i < innerSize; ++i)
-		idxVec.push_back(i);
-
 	auto dataOut = &fout.access<T>();//std::array<T, OuterSize*InnerSize>>();
-	algorithm::pfor(idxVec, [&](size_t& i) {
+	algorithm::pfor(size_t(0), size_t(innerSize), [&](size_t i) {
 		// write data
 		for(size_t j = 0; j < outerSize; ++j) {
 			dataOut[i*outerSize + j] = vecVec[j][i];
@@ -62,58 +268,45 @@ void saveVecVecToFileMM(std::vector<std::vector<T>> vecVec, std::string filename
 	manager.close(fout);
 }
 
-// Read vector of vectors to binary in parallel
+// Read vector of vectors from binary in parallel, the records may be stored in any order
 template<typename T>
-std::vector<std::vector<T>> readVecVecFromFile(std::string filename, size_t outerSize, size_t innerSize) {
-	std::vector<std::vector<T>> vecVec;
-	core::FileIOManager& manager = core::FileIOManager::getInstance();
+std::vector<std::vector<T>> readVecVecFromFile(const std::string& filename, size_t outerSize, size_t innerSize) {
+	std::vector<std::vector<T>> vecVec(outerSize, std::vector<T>(innerSize));
 
-	core::Entry binary = manager.createEntry(filename, core::Mode::Binary);
-	auto fin = manager.openInputStream(binary);
-
-	for(size_t j = 0; j < outerSize; ++j) {
-		vecVec.push_back(std::vector<T>());
-		for(size_t i = 0; i < innerSize; ++i)
-			vecVec[j].push_back(T());
-	}
+	BinaryFileReader fin(filename, innerSize, sizeof(size_t) + outerSize * sizeof(T));
 
-	for(size_t i = 0; i < innerSize; ++i) {
+	algorithm::pfor(size_t(0), innerSize, [&](size_t i) {
 		// read position from file
-		size_t idx = fin.read<size_t>();
+		size_t idx = fin.readValue<size_t>(i);
+		assert_lt(idx, innerSize) << "Corrupted record " << i << " of " << filename;
 
 		for(size_t j = 0; j < outerSize; ++j) {
 			// read data
-			vecVec[j][idx] = (fin.read<T>());
+			fin.read(i, &vecVec[j][idx], 1, sizeof(size_t) + j * sizeof(T));
 		}
-	}
+	});
 
-	manager.close(fin);
+	fin.close();
 	return vecVec;
 }
 
 
-// Read vector of vectors to binary in parallel
+// Read vector of vectors from binary in parallel
 template<typename T>
-std::vector<std::vector<T>> readVecVecFromFileMM(std::string filename, unsigned outerSize, unsigned innerSize) {
-	std::vector<std::vector<T>> vecVec;
+std::vector<std::vector<T>> readVecVecFromFileMM(const std::string& filename, unsigned outerSize, unsigned innerSize) {
+	std::vector<std::vector<T>> vecVec(outerSize, std::vector<T>(innerSize));
 	core::FileIOManager& manager = core::FileIOManager::getInstance();
 
 	core::Entry binary = manager.createEntry(filename, core::Mode::Binary);
 	auto fin = manager.openMemoryMappedInput(binary);
 	auto dataIn = &fin.access<T>();//<std::array<T, InnerSize*OuterSize>>();
 
-	for(size_t j = 0; j < outerSize; ++j) {
-		vecVec.push_back(std::vector<T>());
-		for(size_t i = 0; i < innerSize; ++i)
-			vecVec[j].push_back(T());
-	}
-
-	for(size_t i = 0; i < innerSize; ++i) {
+	algorithm::pfor(size_t(0), size_t(innerSize), [&](size_t i) {
 		for(size_t j = 0; j < outerSize; ++j) {
 			// read data
 			vecVec[j][i] = dataIn[i*outerSize + j];
 		}
-	}
+	});
 
 	manager.close(fin);
 	return vecVec;
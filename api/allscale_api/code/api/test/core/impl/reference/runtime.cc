@@ -399,6 +399,25 @@ namespace reference {
 //		EXPECT_EQ(STRESS_RES, fib_split(STRESS_N).get());
 	}
 
+	TEST(Runtime, ResizeWorkerPool) {
+		auto& pool = runtime::WorkerPool::getInstance();
+		const int max = pool.getMaxNumWorkers();
+		EXPECT_EQ(max, pool.getNumWorkers());
+
+		// shrink to a single worker and compute something
+		EXPECT_EQ(1, pool.setNumWorkers(1));
+		EXPECT_EQ(1, pool.getNumWorkers());
+		EXPECT_EQ(6765, fib_split(20).get());
+
+		// out of range requests are clamped
+		EXPECT_EQ(1, pool.setNumWorkers(0));
+		EXPECT_EQ(max, pool.setNumWorkers(max + 10));
+
+		// back to the full pool
+		EXPECT_EQ(max, pool.getNumWorkers());
+		EXPECT_EQ(6765, fib_split(20).get());
+	}
+
 } // end namespace reference
 } // end namespace impl
 } // end namespace core
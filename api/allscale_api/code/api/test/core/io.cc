@@ -1,7 +1,12 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <atomic>
+#include <limits>
+#include <sstream>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 #include "allscale/api/core/io.h"
 #include "allscale/utils/serializer.h"
@@ -220,6 +225,210 @@ namespace core {
 
 	}
 
+	TEST(IO, Text_Numbers) {
+
+		BufferIOManager manager;
+
+		std::vector<int> ints = { 0, 7, -7, 1234567, std::numeric_limits<int>::min(), std::numeric_limits<int>::max() };
+		std::vector<double> doubles = { 0.0, -0.5, 1.0/3.0, 1e-300, 2.5e+17, 123456789.0, -1e-7 };
+		unsigned long long big = std::numeric_limits<unsigned long long>::max();
+
+		Entry text = manager.createEntry("numbers", Mode::Text);
+		auto out = manager.openOutputStream(text);
+		std::stringstream expected;
+		for(int x : ints) {
+			out << x << " ";
+			expected << x << " ";
+		}
+		for(double x : doubles) {
+			out << x << "\n";
+			expected << x << "\n";
+		}
+		out << big << ' ' << 2.5f << ' ' << true;
+		expected << big << ' ' << 2.5f << ' ' << true;
+		manager.close(out);
+
+		// the formatting is the one of the standard streams
+		auto in = manager.openInputStream(text);
+		std::string content;
+		in.atomic([&](auto& in) {
+			std::stringstream all;
+			all << in.in.rdbuf();
+			content = all.str();
+		});
+		EXPECT_EQ(expected.str(), content);
+		manager.close(in);
+
+		// and so is the parsing
+		auto in2 = manager.openInputStream(text);
+		for(int x : ints) {
+			int y = 0;
+			EXPECT_TRUE(in2 >> y);
+			EXPECT_EQ(x, y);
+		}
+		for(double x : doubles) {
+			double y = 0, z = 0;
+			EXPECT_TRUE(in2 >> y);
+			std::stringstream ss;
+			ss << x;
+			ss >> z;
+			EXPECT_EQ(z, y) << "of " << x;
+		}
+		unsigned long long b = 0;
+		float f = 0;
+		bool t = false;
+		EXPECT_TRUE(in2 >> b >> f >> t);
+		EXPECT_EQ(big, b);
+		EXPECT_EQ(2.5f, f);
+		EXPECT_TRUE(t);
+
+		// nevermore
+		int x;
+		EXPECT_FALSE(in2 >> x);
+		manager.close(in2);
+	}
+
+	TEST(IO, Text_InvalidNumbers) {
+
+		BufferIOManager manager;
+
+		Entry text = manager.createEntry("invalid", Mode::Text);
+		auto out = manager.openOutputStream(text);
+		out << "300 -1.5e 12";
+		manager.close(out);
+
+		auto in = manager.openInputStream(text);
+		signed char c;
+		short s = 0;
+		EXPECT_TRUE(in >> c);
+		EXPECT_EQ('3', c);
+		EXPECT_TRUE(in >> s);
+		EXPECT_EQ(0, s);
+		double d = 0;
+		EXPECT_FALSE(in >> d);
+		EXPECT_EQ(0, d);
+		manager.close(in);
+	}
+
+	TEST(IO, Spans) {
+
+		std::vector<int> data;
+		for(int i = 0; i < 1000; ++i) {
+			data.push_back(i * i - 500);
+		}
+
+		for(Mode mode : { Mode::Text, Mode::Binary }) {
+
+			FileIOManager& manager = FileIOManager::getInstance();
+
+			Entry entry = manager.createEntry((mode == Mode::Text) ? "span.txt" : "span.bin", mode);
+			auto out = manager.openOutputStream(entry);
+			out.writeSpan(data.data(), data.size());
+			out.writeSpan(data.data(), 10);
+			manager.close(out);
+
+			auto in = manager.openInputStream(entry);
+			std::vector<int> res(2000, 0);
+			EXPECT_EQ(data.size() + 10, in.readSpan(res.data(), res.size()));
+			for(std::size_t i = 0; i < data.size(); ++i) {
+				EXPECT_EQ(data[i], res[i]);
+			}
+			for(std::size_t i = 0; i < 10; ++i) {
+				EXPECT_EQ(data[i], res[data.size() + i]);
+			}
+			EXPECT_EQ(0u, in.readSpan(res.data(), res.size()));
+			manager.close(in);
+
+			manager.remove(entry);
+		}
+	}
+
+	TEST(IO, BufferedParallelWrites) {
+
+		const int T = 4;
+		const int N = 20000;
+
+		FileIOManager& manager = FileIOManager::getInstance();
+		Entry text = manager.createEntry("buffered.txt", Mode::Text);
+		auto out = manager.openOutputStream(text);
+
+		// every thread writes its records, of several operations each
+		std::vector<std::thread> threads;
+		for(int t = 0; t < T; ++t) {
+			threads.emplace_back([&,t]() {
+				auto stream = manager.getOutputStream(text);
+				for(int i = 0; i < N; ++i) {
+					stream.atomic([&](auto& out) {
+						out << t << " " << i << " " << (t * N + i) << "\n";
+					});
+				}
+			});
+		}
+		for(auto& cur : threads) cur.join();
+		manager.close(out);
+
+		// the records are complete, and in order for each thread
+		auto in = manager.openInputStream(text);
+		std::vector<int> next(T, 0);
+		int t, i, v;
+		while(in >> t >> i >> v) {
+			ASSERT_TRUE(0 <= t && t < T);
+			EXPECT_EQ(next[t], i);
+			EXPECT_EQ(t * N + i, v);
+			next[t] = i + 1;
+		}
+		for(int t = 0; t < T; ++t) {
+			EXPECT_EQ(N, next[t]);
+		}
+		manager.close(in);
+		manager.remove(text);
+	}
+
+	TEST(IO, BufferedOrderAcrossThreads) {
+
+		const int T = 3;
+		const int N = 3000;
+
+		FileIOManager& manager = FileIOManager::getInstance();
+		Entry text = manager.createEntry("ordered.txt", Mode::Text);
+		auto out = manager.openOutputStream(text);
+
+		// the threads take turns, so every write completes before the next one starts
+		std::atomic<int> turn(0);
+		std::vector<std::thread> threads;
+		for(int t = 0; t < T; ++t) {
+			threads.emplace_back([&,t]() {
+				auto stream = manager.getOutputStream(text);
+				for(int i = t; i < N; i += T) {
+					while(turn.load() != i) std::this_thread::yield();
+					stream << i << "\n";
+					turn.store(i + 1);
+				}
+			});
+		}
+		for(auto& cur : threads) cur.join();
+
+		// the writes of a joined thread precede the ones after the join
+		out << N << "\n";
+		std::thread last([&]() {
+			manager.getOutputStream(text) << (N + 1) << "\n";
+		});
+		last.join();
+		out << (N + 2) << "\n";
+		manager.close(out);
+
+		// the records are in the order they were written, whatever thread wrote them
+		auto in = manager.openInputStream(text);
+		int next = 0, v;
+		while(in >> v) {
+			EXPECT_EQ(next, v);
+			next = v + 1;
+		}
+		EXPECT_EQ(N + 3, next);
+		manager.close(in);
+		manager.remove(text);
+	}
+
 	TEST(IO, MemoryMappedBuffers) {
 
 		using data = std::array<int,1000>;
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <cmath>
 #include <vector>
 
 #include "allscale/api/user/algorithm/preduce.h"
@@ -214,6 +215,50 @@ namespace algorithm {
 		EXPECT_EQ(cnt/10, res);
 	}
 
+	TEST(Ops, MapReduceVector2D) {
+		using Point = utils::Vector<int,2>;
+
+		const int N = 300;
+		const int M = 200;
+
+		auto fold = [](const Point& p, long& s) { s += p.x * M + p.y; };
+		auto reduce = [](long a, long b) { return a + b; };
+		auto init = []() { return 0l; };
+
+		// all points are covered once
+		EXPECT_EQ(long(N*M-1)*(N*M)/2, preduce(Point(N,M), fold, reduce, init).get());
+
+		// also in a sub-box
+		long sum = 0;
+		for(int i=10; i<20; i++) {
+			for(int j=5; j<M; j++) {
+				sum += i * M + j;
+			}
+		}
+		EXPECT_EQ(sum, preduce(Point(10,5), Point(20,M), fold, reduce, init).get());
+
+		// and the empty box
+		EXPECT_EQ(0l, preduce(Point(10,5), Point(10,M), fold, reduce, init).get());
+	}
+
+	TEST(Ops, MapReduceVector2DDeterministic) {
+		using Point = utils::Vector<int,2>;
+
+		const int N = 500;
+		const int M = 300;
+
+		// a floating point sum, sensitive to the order of operations
+		auto fold = [](const Point& p, double& s) { s += 1.0 / (1 + p.x * M + p.y); };
+		auto reduce = [](double a, double b) { return a + b; };
+		auto init = []() { return 0.0; };
+
+		double first = preduce(Point(N,M), fold, reduce, init).get();
+		EXPECT_NEAR(std::log(double(N*M)) + 0.5772, first, 1e-3);
+		for(int i=0; i<10; i++) {
+			EXPECT_EQ(first, preduce(Point(N,M), fold, reduce, init).get());
+		}
+	}
+
 } // end namespace algorithm
 } // end namespace user
 } // end namespace api
@@ -542,6 +542,90 @@ namespace algorithm {
 	INSTANTIATE_TYPED_TEST_CASE_P(Test,Stencil,test_params);
 
 
+	// --- point-to-point synchronized stencil ---
+
+	TEST(NeighborhoodSyncStencil,Grid2D) {
+
+		using Impl = implementation::neighborhood_sync_iterative;
+
+		const int N = 50;
+
+		// test for an even and an odd number of time steps
+		for(int T : { 40 , 41 , (int)(2.5 * N) }) {
+
+			// initialize the data buffer
+			data::Grid<int,2> data({N,N+10});
+			data.forEach([](int& x){
+				x = 0;
+			});
+
+			// run the stencil
+			stencil<Impl>(data, T, [=](time_t time, const data::GridPoint<2>& pos, const data::Grid<int,2>& data){
+
+				// check that the center and the direct neighbors are up-to-date
+				for(const data::GridPoint<2>& offset : { data::GridPoint<2>{0,0},
+						data::GridPoint<2>{-1,0}, data::GridPoint<2>{1,0},
+						data::GridPoint<2>{0,-1}, data::GridPoint<2>{0,1} }) {
+					auto p = pos + offset;
+					if (p[0] < 0 || p[0] >= N) continue;
+					if (p[1] < 0 || p[1] >= N+10) continue;
+					EXPECT_EQ(time,data[p]) << "Position " << pos << " + " << offset << " = " << p;
+				}
+
+				// increase the time step of current cell
+				return data[pos] + 1;
+			});
+
+			// check final state
+			data.forEach([T](int x){
+				EXPECT_EQ(T,x);
+			});
+
+		}
+
+	}
+
+	TEST(NeighborhoodSyncStencil,Grid2D_Observer) {
+
+		using Impl = implementation::neighborhood_sync_iterative;
+
+		const int N = 100;
+		const int T = N/2;
+
+		// initialize the data buffer
+		data::Grid<int,2> data({N,N});
+		data.forEach([](int& x){
+			x = 0;
+		});
+
+		// count the number of collected observations
+		int observationCounter = 0;
+
+		// run the stencil
+		stencil<Impl>(data, T,
+			[=](time_t, const data::GridPoint<2>& pos, const data::Grid<int,2>& data){
+				return data[pos] + 1;
+			},
+			observer(
+				[](time_t t) { return t % 10 == 0; },
+				[](const data::GridPoint<2>& loc) { return loc.x == N/2 && loc.y == N/3; },
+				[&observationCounter](time_t t, const data::GridPoint<2>&, int& value) {
+					EXPECT_EQ(t+1,value);
+					EXPECT_EQ(observationCounter * 10, t);
+					observationCounter++;
+				}
+			)
+		);
+
+		// check final state
+		data.forEach([T](int x){
+			EXPECT_EQ(T,x);
+		});
+		EXPECT_EQ(5,observationCounter);
+
+	}
+
+
 
 	// -- recursive stencil related tests ----------------------------------------------
 
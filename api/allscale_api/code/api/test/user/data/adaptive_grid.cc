@@ -98,6 +98,77 @@ namespace data {
 
 	}
 
+	TEST(AdaptiveGridCell, RefinementCoarseningPositions) {
+
+		// the layer configuration utilized by the amdados application: 1x1 -> 8x8 -> 16x16
+		using CellConfig2D = CellConfig<2, layers<layer<1,1>, layer<8,8>, layer<2,2>>>;
+
+		AdaptiveGridCell<double, CellConfig2D> cell;
+
+		// 16x16 -> 8x8: each coarse cell is the average of the covered 2x2 block
+		cell.setActiveLayer(0);
+		cell.forAllActiveNodes([](const GridPoint<2>& pos, double& element) { element = double(16 * pos.x + pos.y); });
+		cell.coarsen([](const double& element) { return element; });
+		EXPECT_EQ(1, cell.getActiveLayer());
+		cell.forAllActiveNodes([](const GridPoint<2>& pos, const double& element) {
+			EXPECT_DOUBLE_EQ(16 * (2 * pos.x + 0.5) + (2 * pos.y + 0.5), element) << "Position " << pos;
+		});
+
+		// 8x8 -> 1x1: the average of the covered 8x8 block
+		cell.coarsen([](const double& element) { return element; });
+		EXPECT_EQ(2, cell.getActiveLayer());
+		cell.forAllActiveNodes([](const double& element) { EXPECT_DOUBLE_EQ(16 * 7.5 + 7.5, element); });
+
+		// 1x1 -> 8x8
+		cell.forAllActiveNodes([](double& element) { element = 3.0; });
+		cell.refine([](const double& element) { return element + 1; });
+		EXPECT_EQ(1, cell.getActiveLayer());
+		cell.forAllActiveNodes([](const double& element) { EXPECT_EQ(4.0, element); });
+
+		// 8x8 -> 16x16: each fine cell is a copy of the covering coarse cell
+		cell.forAllActiveNodes([](const GridPoint<2>& pos, double& element) { element = double(8 * pos.x + pos.y); });
+		cell.refine([](const double& element) { return element + 1; });
+		EXPECT_EQ(0, cell.getActiveLayer());
+		cell.forAllActiveNodes([](const GridPoint<2>& pos, const double& element) {
+			EXPECT_EQ(double(8 * (pos.x / 2) + (pos.y / 2) + 1), element) << "Position " << pos;
+		});
+
+	}
+
+	TEST(AdaptiveGridCell, RefinementLinear) {
+
+		using CellConfig2D = CellConfig<2, layers<layer<1,1>, layer<8,8>, layer<2,2>>>;
+
+		AdaptiveGridCell<double, CellConfig2D> cell;
+
+		// a linear function is reproduced in between the outermost coarse cell centers
+		cell.setActiveLayer(1);
+		cell.forAllActiveNodes([](const GridPoint<2>& pos, double& element) { element = 16.0 * pos.x + 4.0 * pos.y; });
+		cell.refineLinear();
+		EXPECT_EQ(0, cell.getActiveLayer());
+		cell.forAllActiveNodes([](const GridPoint<2>& pos, const double& element) {
+			// fine cell i is located at coarse position i/2 - 1/4
+			auto clamp = [](double v) { return std::min(std::max(v / 2.0 - 0.25, 0.0), 7.0); };
+			EXPECT_DOUBLE_EQ(16.0 * clamp(pos.x) + 4.0 * clamp(pos.y), element) << "Position " << pos;
+		});
+
+		// coarsening the interpolated field restores the interior of the original one
+		cell.coarsen([](const double& element) { return element; });
+		EXPECT_EQ(1, cell.getActiveLayer());
+		cell.forAllActiveNodes([](const GridPoint<2>& pos, const double& element) {
+			if (pos.x == 0 || pos.x == 7 || pos.y == 0 || pos.y == 7) return;
+			EXPECT_DOUBLE_EQ(16.0 * pos.x + 4.0 * pos.y, element) << "Position " << pos;
+		});
+
+		// constant extension of a single coarse cell
+		cell.setActiveLayer(2);
+		cell.forAllActiveNodes([](double& element) { element = 5.0; });
+		cell.refineLinear();
+		EXPECT_EQ(1, cell.getActiveLayer());
+		cell.forAllActiveNodes([](const double& element) { EXPECT_EQ(5.0, element); });
+
+	}
+
 	TEST(AdaptiveGridCell, RefinementCoarseningGrid) {
 
 		AdaptiveGridCell<int, FourLayerCellConfig> cell;
@@ -253,6 +324,207 @@ namespace data {
 		
 	}
 
+	TEST(AdaptiveGridCell, BoundaryViews) {
+
+		using SpecialLayerCellConfig = CellConfig<2, layers<layer<2, 3>, layer<2, 5>>>;
+		using rT = std::vector<int>;
+
+		AdaptiveGridCell<int, SpecialLayerCellConfig> cell;
+
+		// check different layer
+		cell.setActiveLayer(1);
+		cell.forAllActiveNodes([](const GridPoint<2>& pos, int& element) { element = int(10 * pos.x + pos.y); });
+
+		const auto& ccell = cell;
+		EXPECT_EQ(3, ccell.getBoundaryView(Direction::Left).size());
+		EXPECT_EQ(2, ccell.getBoundaryView(Direction::Up).size());
+		EXPECT_EQ((rT{ 0, 1, 2 }), ccell.getBoundaryView(Direction::Left).toVector());
+		EXPECT_EQ((rT{ 10, 11, 12 }), ccell.getBoundaryView(Direction::Right).toVector());
+		EXPECT_EQ((rT{ 2, 12 }), ccell.getBoundaryView(Direction::Up).toVector());
+		EXPECT_EQ((rT{ 0, 10 }), ccell.getBoundaryView(Direction::Down).toVector());
+
+		// views and vectors agree
+		for(Direction dir : { Up, Down, Left, Right }) {
+			EXPECT_EQ(cell.getBoundary(dir), ccell.getBoundaryView(dir).toVector());
+			EXPECT_EQ(cell.getBoundary(dir), ccell.getBoundaryView(1, dir).toVector());
+		}
+
+		// write through a view
+		auto up = cell.getBoundaryView(Direction::Up);
+		up[0] = 7;
+		up[1] = 8;
+		EXPECT_EQ((rT{ 0, 1, 7 }), cell.getBoundary(Direction::Left));
+		EXPECT_EQ((rT{ 10, 11, 8 }), cell.getBoundary(Direction::Right));
+
+		cell.fillBoundary(Direction::Down, 9);
+		EXPECT_EQ((rT{ 9, 1, 7 }), cell.getBoundary(Direction::Left));
+		EXPECT_EQ((rT{ 9, 11, 8 }), cell.getBoundary(Direction::Right));
+
+		// strided copies
+		int buffer[6] = { 0 };
+		cell.getBoundaryView(Direction::Right).copyTo(buffer, 2);
+		EXPECT_EQ(9, buffer[0]);
+		EXPECT_EQ(11, buffer[2]);
+		EXPECT_EQ(8, buffer[4]);
+		EXPECT_EQ(0, buffer[1]);
+
+		// bulk copy of the active layer
+		std::vector<int> ext(4 * 5, -1);
+		cell.copyActiveLayerTo(ext.data() + 5 + 1, 5);
+		EXPECT_EQ(9, ext[1*5 + 1]);
+		EXPECT_EQ(7, ext[1*5 + 3]);
+		EXPECT_EQ(8, ext[2*5 + 3]);
+		EXPECT_EQ(-1, ext[0]);
+		EXPECT_EQ(-1, ext[1*5 + 4]);
+
+		ext[2*5 + 2] = 42;
+		cell.copyActiveLayerFrom(ext.data() + 5 + 1, 5);
+		EXPECT_EQ((rT{ 9, 42, 8 }), cell.getBoundary(Direction::Right));
+
+		// the other layer is not affected
+		cell.setActiveLayer(0);
+		EXPECT_EQ(15, cell.getBoundaryView(Direction::Left).size());
+		EXPECT_EQ(4, cell.getBoundaryView(Direction::Down).size());
+	}
+
+	TEST(AdaptiveGrid, GatherExtended) {
+
+		using SpecialLayerCellConfig = CellConfig<2, layers<layer<2, 2>>>;
+		using Cell = AdaptiveGridCell<int, SpecialLayerCellConfig>;
+
+		Grid<Cell,2> grid({2,3});
+
+		// fill cells with values encoding the cell and the position within the cell
+		for(int i = 0; i < 2; ++i) {
+			for(int j = 0; j < 3; ++j) {
+				const GridPoint<2> idx{i,j};
+				Cell& cell = grid[idx];
+				for(unsigned layer : { 0u, 1u }) {
+					cell.setActiveLayer(layer);
+					cell.forAllActiveNodes([&](const GridPoint<2>& pos, int& element) {
+						element = int(1000 * layer + 100 * idx.x + 10 * idx.y + 2 * pos.x + pos.y);
+					});
+				}
+				cell.setActiveLayer(0);
+			}
+		}
+
+		// the center cell has got peers in all but the left direction
+		std::vector<int> ext(4 * 4, -1);
+		EXPECT_EQ((1u << Right) | (1u << Up) | (1u << Down), gatherExtended(grid, {0,1}, ext.data()));
+
+		// interior
+		EXPECT_EQ(10, ext[1*4 + 1]);
+		EXPECT_EQ(11, ext[1*4 + 2]);
+		EXPECT_EQ(12, ext[2*4 + 1]);
+		EXPECT_EQ(13, ext[2*4 + 2]);
+
+		// halo: left of right peer, top of bottom peer, bottom of top peer
+		EXPECT_EQ(110, ext[3*4 + 1]);
+		EXPECT_EQ(111, ext[3*4 + 2]);
+		EXPECT_EQ(1, ext[1*4 + 0]);
+		EXPECT_EQ(3, ext[2*4 + 0]);
+		EXPECT_EQ(20, ext[1*4 + 3]);
+		EXPECT_EQ(22, ext[2*4 + 3]);
+
+		// outer border and corners are untouched
+		EXPECT_EQ(-1, ext[0*4 + 1]);
+		EXPECT_EQ(-1, ext[0*4 + 2]);
+		EXPECT_EQ(-1, ext[0]);
+		EXPECT_EQ(-1, ext[15]);
+
+		// gather the coarse layer while cells remain active on the fine one
+		grid[{1,1}].setActiveLayer(1);
+		std::vector<int> coarse(3 * 3, -1);
+		EXPECT_EQ((1u << Right) | (1u << Up) | (1u << Down), gatherExtended(grid, {0,1}, 1, coarse.data()));
+		EXPECT_EQ(0u, (grid[{0,1}].getActiveLayer()));
+		EXPECT_EQ(1010, coarse[1*3 + 1]);
+		EXPECT_EQ(1110, coarse[2*3 + 1]);
+		EXPECT_EQ(1000, coarse[1*3 + 0]);
+		EXPECT_EQ(1020, coarse[1*3 + 2]);
+		EXPECT_EQ(-1, coarse[0*3 + 1]);
+
+		// copy an arbitrary layer with a row stride
+		std::vector<int> layer(2 * 5, -1);
+		grid[{1,2}].copyLayerTo(0, layer.data(), 5);
+		EXPECT_EQ(120, layer[0]);
+		EXPECT_EQ(121, layer[1]);
+		EXPECT_EQ(-1, layer[2]);
+		EXPECT_EQ(122, layer[5]);
+		EXPECT_EQ(123, layer[6]);
+	}
+
+	TEST(AdaptiveGrid, GatherExtendedHalo) {
+
+		using Cell = AdaptiveGridCell<int, CellConfig<2, layers<layer<3, 4>>>>;
+
+		Grid<Cell,2> grid({3,3});
+
+		// fill cells with values encoding the cell and the position within the cell
+		for(int i = 0; i < 3; ++i) {
+			for(int j = 0; j < 3; ++j) {
+				const GridPoint<2> idx{i,j};
+				for(unsigned layer : { 0u, 1u }) {
+					grid[idx].setActiveLayer(layer);
+					grid[idx].forAllActiveNodes([&](const GridPoint<2>& pos, int& element) {
+						element = int(1000 * layer + 100 * idx.x + 10 * idx.y + 4 * pos.x + pos.y);
+					});
+				}
+				grid[idx].setActiveLayer(0);
+			}
+		}
+
+		// the boundary strips keep their orientation
+		std::vector<int> strip(2 * 4, -1);
+		grid[{1,1}].copyBoundaryStripTo(0, Right, 2, strip.data(), 4);
+		EXPECT_EQ(std::vector<int>({ 114, 115, 116, 117, 118, 119, 120, 121 }), strip);
+		std::fill(strip.begin(), strip.end(), -1);
+		grid[{1,1}].copyBoundaryStripTo(0, Up, 2, strip.data(), 2);
+		EXPECT_EQ(std::vector<int>({ 112, 113, 116, 117, 120, 121, -1, -1 }), strip);
+
+		// the center cell (3x4) with a two elements wide halo: 7x8 buffer
+		const int X = 3, Y = 4, h = 2, ld = Y + 2 * h;
+		std::vector<int> ext((X + 2 * h) * ld, -1);
+		EXPECT_EQ(15u, gatherExtended(grid, {1,1}, 0, ext.data(), h));
+		for(int x = 0; x < X; ++x) {
+			for(int y = 0; y < Y; ++y) {
+				EXPECT_EQ(110 + 4 * x + y, ext[(x + h) * ld + y + h]);
+			}
+		}
+		for(int d = 0; d < h; ++d) {
+			for(int y = 0; y < Y; ++y) {
+				// the left peer's last rows, the right peer's first rows
+				EXPECT_EQ(10 + 4 * (X - h + d) + y, ext[d * ld + y + h]);
+				EXPECT_EQ(210 + 4 * d + y, ext[(X + h + d) * ld + y + h]);
+			}
+			for(int x = 0; x < X; ++x) {
+				// the bottom peer's last columns, the top peer's first columns
+				EXPECT_EQ(100 + 4 * x + (Y - h + d), ext[(x + h) * ld + d]);
+				EXPECT_EQ(120 + 4 * x + d, ext[(x + h) * ld + Y + h + d]);
+			}
+		}
+		EXPECT_EQ(-1, ext[0]);
+		EXPECT_EQ(-1, ext[(h - 1) * ld + h - 1]);
+
+		// corner cell: the outer halo is untouched
+		std::fill(ext.begin(), ext.end(), -1);
+		EXPECT_EQ((1u << Right) | (1u << Up), gatherExtended(grid, {0,0}, 0, ext.data(), h));
+		EXPECT_EQ(-1, ext[0 * ld + h]);
+		EXPECT_EQ(-1, ext[h * ld + 0]);
+		EXPECT_EQ(100, ext[(X + h) * ld + h]);
+		EXPECT_EQ(10, ext[h * ld + Y + h]);
+
+		// the halo of width one matches the default
+		std::vector<int> one((X + 2) * (Y + 2), -1), def((X + 2) * (Y + 2), -1);
+		gatherExtended(grid, {1,1}, 0, one.data(), 1);
+		gatherExtended(grid, {1,1}, 0, def.data());
+		EXPECT_EQ(def, one);
+
+		// halo wider than the layer is rejected
+		std::vector<int> wide((X + 8) * (Y + 8));
+		EXPECT_DEBUG_DEATH(gatherExtended(grid, {1,1}, 1, wide.data(), 2), "Halo wider");
+	}
+
 	TEST(AdaptiveGridCell, LoadStore) {
 
 		using TwoLayerCellConfig = CellConfig<2, layers<layer<2, 2>>>;
@@ -1256,6 +1256,35 @@ namespace data {
 
 	}
 
+	TEST(Grid2D, Preduce) {
+
+		const int N = 100;
+		const int M = 200;
+
+		Grid<std::pair<int,double>,2> grid({ N,M });
+
+		grid.pforEach([](std::pair<int,double>& element) { element = { 1, 0.0 }; });
+		grid[{17,42}].second = 5.5;
+
+		// count the elements
+		auto count = grid.preduce(
+			[](const std::pair<int,double>& element, int& res) { res += element.first; },
+			[](int a, int b) { return a + b; },
+			[]() { return 0; }
+		).get();
+		EXPECT_EQ(N*M, count);
+
+		// find the maximum, converting the local state at the end
+		auto max = grid.preduce(
+			[](const std::pair<int,double>& element, double& res) { res = std::max(res, element.second); },
+			[](double a, double b) { return std::max(a, b); },
+			[]() { return -1.0; },
+			[](double res) { return 2 * res; }
+		).get();
+		EXPECT_EQ(11.0, max);
+
+	}
+
 } // end namespace data
 } // end namespace user
 } // end namespace api
@@ -1807,6 +1807,185 @@ namespace data {
 	}
 
 
+	namespace {
+
+		struct GridCell {};
+		struct GridCell2Cell : public edge<GridCell,GridCell> {};
+
+		// creates a NxN grid of cells, added in a scrambled order
+		template<typename Builder>
+		std::vector<NodeRef<GridCell>> createScrambledGrid(Builder& mb, unsigned N) {
+			std::vector<NodeRef<GridCell>> cells;
+			for(unsigned i=0; i<N*N; ++i) {
+				cells.push_back(mb.template create<GridCell>());
+			}
+			std::vector<unsigned> positions(N*N);
+			for(unsigned i=0; i<N*N; ++i) positions[i] = (i * 97) % (N*N);
+			std::vector<NodeRef<GridCell>> grid(N*N);
+			for(unsigned i=0; i<N*N; ++i) grid[positions[i]] = cells[i];
+			for(unsigned i=0; i<N; ++i) {
+				for(unsigned j=0; j<N; ++j) {
+					if (i+1 < N) {
+						mb.template link<GridCell2Cell>(grid[i*N+j],grid[(i+1)*N+j]);
+						mb.template link<GridCell2Cell>(grid[(i+1)*N+j],grid[i*N+j]);
+					}
+					if (j+1 < N) {
+						mb.template link<GridCell2Cell>(grid[i*N+j],grid[i*N+j+1]);
+						mb.template link<GridCell2Cell>(grid[i*N+j+1],grid[i*N+j]);
+					}
+				}
+			}
+			return grid;
+		}
+
+	}
+
+	TEST(MeshBuilder, ReorderReverseCuthillMcKee) {
+
+		const unsigned N = 32;
+
+		using Builder = MeshBuilder<nodes<GridCell>,edges<GridCell2Cell>>;
+
+		Builder scrambled;
+		createScrambledGrid(scrambled,N);
+		auto a = scrambled.build<3>();
+
+		Builder reordered;
+		auto grid = createScrambledGrid(reordered,N);
+		auto newIndex = reordered.reorderReverseCuthillMcKee<GridCell>();
+		auto b = reordered.build<3>();
+
+		// the reordering is a permutation
+		std::vector<node_index_t> sorted = newIndex;
+		std::sort(sorted.begin(),sorted.end());
+		for(std::size_t i=0; i<sorted.size(); ++i) {
+			EXPECT_EQ(i,sorted[i]);
+		}
+
+		// the neighborhood is preserved
+		for(unsigned i=0; i<N; ++i) {
+			for(unsigned j=0; j+1<N; ++j) {
+				NodeRef<GridCell> x(newIndex[grid[i*N+j].id]);
+				NodeRef<GridCell> y(newIndex[grid[i*N+j+1].id]);
+				auto sinks = b.getSinks<GridCell2Cell>(x);
+				EXPECT_NE(sinks.end(),std::find(sinks.begin(),sinks.end(),y));
+			}
+		}
+
+		// the partitions are more compact
+		EXPECT_LT(b.getEdgeCut<GridCell2Cell>(), a.getEdgeCut<GridCell2Cell>() / 2);
+
+		// the bandwidth is bounded by the grid size
+		for(unsigned i=0; i<N*N; ++i) {
+			NodeRef<GridCell> x((node_index_t)i);
+			for(const auto& y : b.getSinks<GridCell2Cell>(x)) {
+				EXPECT_LE(std::max(x.id,y.id) - std::min(x.id,y.id), 2*N);
+			}
+		}
+	}
+
+	TEST(MeshBuilder, ReorderSpaceFillingCurve) {
+
+		const unsigned N = 32;
+
+		using Builder = MeshBuilder<nodes<GridCell>,edges<GridCell2Cell>>;
+
+		Builder scrambled;
+		createScrambledGrid(scrambled,N);
+		auto a = scrambled.build<4>();
+
+		Builder reordered;
+		auto grid = createScrambledGrid(reordered,N);
+		std::vector<std::array<double,2>> coordinates(N*N);
+		for(unsigned i=0; i<N; ++i) {
+			for(unsigned j=0; j<N; ++j) {
+				coordinates[grid[i*N+j].id] = {{ (double)i, (double)j }};
+			}
+		}
+		auto newIndex = reordered.reorderSpaceFillingCurve<GridCell>(coordinates);
+		auto b = reordered.build<4>();
+
+		// cells are numbered along the Z-order curve
+		EXPECT_EQ(0,newIndex[grid[0].id]);
+		EXPECT_EQ(1,newIndex[grid[1].id]);
+		EXPECT_EQ(2,newIndex[grid[N].id]);
+		EXPECT_EQ(3,newIndex[grid[N+1].id]);
+
+		// every leaf partition is a square of 8x8 cells
+		EXPECT_EQ(2*(3*N + 3*N),b.getEdgeCut<GridCell2Cell>());
+		EXPECT_LT(b.getEdgeCut<GridCell2Cell>(), a.getEdgeCut<GridCell2Cell>() / 4);
+	}
+
+	TEST(MeshBuilder, ReorderMultiLevel) {
+
+		struct Cell {};
+		struct Face {};
+		struct Face2Cell : public edge<Face,Cell> {};
+		struct Cell2Child : public hierarchy<Cell,Cell> {};
+
+		MeshBuilder<
+			nodes<Cell,Face>,
+			edges<Face2Cell>,
+			hierarchies<Cell2Child>,
+			2
+		> mb;
+
+		// a row of cells in scrambled order, separated by faces
+		auto c0 = mb.create<Cell>();
+		auto c2 = mb.create<Cell>();
+		auto c1 = mb.create<Cell>();
+		auto c3 = mb.create<Cell>();
+		auto f01 = mb.create<Face>();
+		auto f12 = mb.create<Face>();
+		auto f23 = mb.create<Face>();
+		mb.link<Face2Cell>(f01,c0);
+		mb.link<Face2Cell>(f01,c1);
+		mb.link<Face2Cell>(f12,c1);
+		mb.link<Face2Cell>(f12,c2);
+		mb.link<Face2Cell>(f23,c2);
+		mb.link<Face2Cell>(f23,c3);
+
+		// the parents
+		auto p0 = mb.create<Cell,1>();
+		auto p1 = mb.create<Cell,1>();
+		mb.link<Cell2Child>(p0,c0);
+		mb.link<Cell2Child>(p0,c1);
+		mb.link<Cell2Child>(p1,c2);
+		mb.link<Cell2Child>(p1,c3);
+
+		// cells are connected through faces
+		auto newIndex = mb.reorderReverseCuthillMcKee<Cell>();
+		auto remap = [&](const NodeRef<Cell>& c) { return NodeRef<Cell>(newIndex[c.id]); };
+		auto d01 = std::max(remap(c0).id,remap(c1).id) - std::min(remap(c0).id,remap(c1).id);
+		auto d12 = std::max(remap(c1).id,remap(c2).id) - std::min(remap(c1).id,remap(c2).id);
+		auto d23 = std::max(remap(c2).id,remap(c3).id) - std::min(remap(c2).id,remap(c3).id);
+		EXPECT_EQ(1,d01);
+		EXPECT_EQ(1,d12);
+		EXPECT_EQ(1,d23);
+
+		// also reorder the parents
+		std::vector<node_index_t> parentIndex = { 1, 0 };
+		mb.reorder<Cell,1>(parentIndex);
+		NodeRef<Cell,1> q0(1);
+		NodeRef<Cell,1> q1(0);
+
+		auto m = mb.build();
+
+		// check edges
+		EXPECT_EQ(std::vector<NodeRef<Cell>>({ remap(c0), remap(c1) }), m.getSinks<Face2Cell>(f01));
+		EXPECT_EQ(std::vector<NodeRef<Cell>>({ remap(c2), remap(c3) }), m.getSinks<Face2Cell>(f23));
+		EXPECT_EQ(f01, m.getSource<Face2Cell>(remap(c0)));
+		EXPECT_EQ(f23, m.getSource<Face2Cell>(remap(c3)));
+
+		// check hierarchies
+		EXPECT_EQ(std::vector<NodeRef<Cell>>({ remap(c0), remap(c1) }), m.getChildren<Cell2Child>(q0));
+		EXPECT_EQ(std::vector<NodeRef<Cell>>({ remap(c2), remap(c3) }), m.getChildren<Cell2Child>(q1));
+		EXPECT_EQ(q0, m.getParent<Cell2Child>(remap(c1)));
+		EXPECT_EQ(q1, m.getParent<Cell2Child>(remap(c2)));
+		EXPECT_EQ(p0.id, 1 - q0.id);
+		EXPECT_EQ(p1.id, 1 - q1.id);
+	}
+
 	TEST(MeshData,IO) {
 
 		std::stringstream buffer(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
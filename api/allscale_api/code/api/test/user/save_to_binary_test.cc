@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <fstream>
+
 #include "allscale/api/user/save_to_binary.h"
 
 namespace allscale {
@@ -54,6 +57,92 @@ TEST(SaveToBinary, ArtificialVectorOfVectors) {
 
 }
 
+TEST(SaveToBinary, DeterministicLayout) {
+
+	const size_t outer = 3;
+	const size_t inner = 10000;
+	std::vector<std::vector<double>> vecVec(outer, std::vector<double>(inner));
+	for(size_t i = 0; i < outer; ++i) {
+		for(size_t j = 0; j < inner; ++j) {
+			vecVec[i][j] = 0.5 * double(i) + double(j);
+		}
+	}
+	std::string filename("testfile.dat");
+
+	saveVecVecToFile(vecVec, filename, inner);
+
+	// the records are stored in order of indices, regardless of the scheduling of tasks
+	std::ifstream file(filename, std::ios::binary);
+	for(size_t j = 0; j < inner; ++j) {
+		size_t idx;
+		file.read(reinterpret_cast<char*>(&idx), sizeof(idx));
+		EXPECT_EQ(j, idx);
+		for(size_t i = 0; i < outer; ++i) {
+			double value;
+			file.read(reinterpret_cast<char*>(&value), sizeof(value));
+			EXPECT_EQ(vecVec[i][j], value);
+		}
+	}
+	EXPECT_TRUE(file.good());
+	EXPECT_EQ(std::char_traits<char>::eof(), file.peek());
+	file.close();
+
+	auto loaded = readVecVecFromFile<double>(filename, outer, inner);
+	EXPECT_EQ(vecVec, loaded);
+	EXPECT_EQ(0, std::remove(filename.c_str()));
+}
+
+TEST(SaveToBinary, RecordsOfDifferentSizes) {
+
+	// record i holds i integers
+	const size_t n = 500;
+	std::vector<std::size_t> sizes;
+	for(size_t i = 0; i < n; ++i) {
+		sizes.push_back(i * sizeof(int));
+	}
+	std::string filename("testfile.dat");
+
+	BinaryFileWriter out(filename, sizes);
+	EXPECT_EQ(n, out.getNumRecords());
+	EXPECT_EQ(n * (n - 1) / 2 * sizeof(int), out.getSize());
+	algorithm::pfor(size_t(0), n, [&](size_t i) {
+		// odd records element-wise, even ones at once
+		std::vector<int> record(i);
+		for(size_t k = 0; k < i; ++k) {
+			record[k] = int(i * 1000 + k);
+			if (i % 2 == 1) out.writeValue(i, record[k], k * sizeof(int));
+		}
+		if (i % 2 == 0) out.write(i, record.data(), record.size());
+	});
+	out.close();
+
+	BinaryFileReader in(filename, sizes);
+	std::vector<std::vector<int>> records(n);
+	algorithm::pfor(size_t(0), n, [&](size_t i) {
+		records[i].resize(i);
+		in.read(i, records[i].data(), i);
+	});
+	in.close();
+
+	for(size_t i = 0; i < n; ++i) {
+		for(size_t k = 0; k < i; ++k) {
+			EXPECT_EQ(int(i * 1000 + k), records[i][k]);
+		}
+	}
+	EXPECT_EQ(0, std::remove(filename.c_str()));
+}
+
+TEST(SaveToBinary, EmptyFile) {
+
+	std::string filename("testfile.dat");
+	{
+		BinaryFileWriter out(filename, 4, 0);
+		EXPECT_EQ(0ul, out.getSize());
+	}
+	BinaryFileReader in(filename, 4, 0);
+	EXPECT_EQ(4ul, in.getNumRecords());
+	EXPECT_EQ(0, std::remove(filename.c_str()));
+}
 
 } // end namespace user
 } // end namespace api
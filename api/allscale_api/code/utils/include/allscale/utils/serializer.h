@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <sstream>
 #include <type_traits>
@@ -62,6 +64,13 @@ namespace utils {
 	 */
 	struct trivially_serializable {};
 
+	/**
+	 * A facade function estimating the size of the archived version of an object in bytes,
+	 * utilized for pre-sizing archives; 0 if no estimate is available for its type.
+	 */
+	template<typename T>
+	std::size_t size_hint(const T&);
+
 	/**
 	 * A facade function for packing an object into an archive.
 	 */
@@ -85,8 +94,9 @@ namespace utils {
 	namespace detail {
 
 		/**
-		 * A simple, initial, functionally complete implementation of a data buffer
-		 * for storing data within an archive.
+		 * A data buffer for storing data within an archive. By default, the buffer owns
+		 * its storage, which may be pre-sized; alternatively, it writes into an external
+		 * storage of fixed capacity (e.g. a caller supplied or memory mapped buffer).
 		 */
 		class DataBuffer {
 
@@ -96,10 +106,28 @@ namespace utils {
 			// the actual data store (std::vector handles the dynamic growing for us)
 			std::vector<char> data;
 
+			// the external store, if any, its capacity and the number of bytes used
+			char* external = nullptr;
+			std::size_t capacity = 0;
+			std::size_t used = 0;
+
 		public:
 
 			DataBuffer() {}
 
+			/**
+			 * Creates an empty buffer with space for the given number of bytes.
+			 */
+			explicit DataBuffer(std::size_t size_hint) {
+				data.reserve(size_hint);
+			}
+
+			/**
+			 * Creates an empty buffer writing to the given external storage of the given capacity.
+			 */
+			DataBuffer(char* storage, std::size_t capacity)
+				: external(storage), capacity(capacity) {}
+
 			DataBuffer(const DataBuffer&) = default;
 			DataBuffer(DataBuffer&&) = default;
 
@@ -113,53 +141,93 @@ namespace utils {
 			 * The main function for appending data to this buffer.
 			 */
 			void append(const char* start, std::size_t count) {
-				// create space
-				auto pos = data.size();
-				data.resize(pos + count / sizeof(char));
+				if (external) {
+					assert_le(used + count, capacity) << "Exceeding the capacity of the external buffer!";
+					std::memcpy(external + used, start, count);
+					used += count;
+					return;
+				}
+				// append at end, without initializing the new space first
+				data.insert(data.end(), start, start + count);
+			}
 
-				// append at end
-				std::memcpy(&data[pos],start,count);
+			/**
+			 * Makes space for appending the given number of bytes (no effect on external storage).
+			 */
+			void reserve(std::size_t count) {
+				if (external) return;
+				std::size_t required = data.size() + count;
+				if (required > data.capacity()) data.reserve(std::max(required, 2 * data.capacity()));
+			}
 
+			/**
+			 * Determines whether this buffer is writing to an external storage.
+			 */
+			bool isExternal() const {
+				return external != nullptr;
 			}
 
 			/**
 			 * Obtains the number of bytes this buffer is occupying.
 			 */
 			std::size_t size() const {
-				return data.size() * sizeof(char);
+				return (external) ? used : data.size() * sizeof(char);
 			}
 
 			/**
 			 * Obtains a pointer to the begin of the internally maintained buffer (inclusive).
 			 */
 			const char* begin() const {
-				return &data.front();
+				return (external) ? external : data.data();
 			}
 
 			/**
 			 * Obtains a pointer to the end of the internally maintained buffer (exclusive).
 			 */
 			const char* end() const {
-				return &data.back() + 1;
+				return begin() + size();
 			}
 
 			/**
 			 * Support implicit conversion of this buffer to a vector of characters.
 			 */
 			operator const std::vector<char>&() const {
+				assert_false(external) << "No vector of characters for an external buffer!";
 				return data;
 			}
 
 			/**
-			 * Also enable the implicit hand-off of the ownership of the underlying char store.
+			 * Also enable the implicit hand-off of the ownership of the underlying char store,
+			 * the content of an external store is copied.
 			 */
 			operator std::vector<char>() && {
+				if (external) return std::vector<char>(begin(), end());
 				return std::move(data);
 			}
 
 
 		};
 
+		template<typename T>
+		auto size_hint(const T& value, int) -> decltype(serializer<T>::size_hint(value)) {
+			return serializer<T>::size_hint(value);
+		}
+
+		template<typename T>
+		std::size_t size_hint(const T&, long) {
+			return 0;
+		}
+
+		template<typename T>
+		auto member_size_hint(const T& value, int) -> decltype(value.size_hint()) {
+			return value.size_hint();
+		}
+
+		template<typename T>
+		std::size_t member_size_hint(const T&, long) {
+			return 0;
+		}
+
 	} // end namespace detail
 
 
@@ -212,6 +280,10 @@ namespace utils {
 
 		static Archive load(ArchiveReader& in);
 
+		std::size_t size_hint() const {
+			return sizeof(std::size_t) + data.size();
+		}
+
 	};
 
 #if !defined(ALLSCALE_WITH_HPX)
@@ -224,6 +296,17 @@ namespace utils {
 
 		ArchiveWriter() {}
 
+		/**
+		 * Creates a writer with space for the given number of bytes, e.g. obtained by size_hint().
+		 */
+		explicit ArchiveWriter(std::size_t size_hint) : data(size_hint) {}
+
+		/**
+		 * Creates a writer serializing into the given external storage of the given capacity,
+		 * which must not be exceeded.
+		 */
+		ArchiveWriter(char* storage, std::size_t capacity) : data(storage, capacity) {}
+
 		ArchiveWriter(const ArchiveWriter&) = delete;
 		ArchiveWriter(ArchiveWriter&&) = default;
 
@@ -261,11 +344,27 @@ namespace utils {
 			serializer<T>::store(*this,value);
 		}
 
+		/**
+		 * Makes space for appending the given number of bytes, e.g. obtained by size_hint().
+		 */
+		void reserve(std::size_t count) {
+			data.reserve(count);
+		}
+
+		/**
+		 * Obtains the number of bytes written so far.
+		 */
+		std::size_t size() const {
+			return data.size();
+		}
+
 		/**
 		 * Obtains the archive produces by this writer. After the call,
-		 * this writer must not be used any more.
+		 * this writer must not be used any more. The content of an
+		 * external storage is copied into the archive.
 		 */
 		Archive toArchive() && {
+			if (data.isExternal()) return detail::DataBuffer(std::vector<char>(data.begin(), data.end()));
 			return std::move(data);
 		}
 
@@ -277,6 +376,11 @@ namespace utils {
 	public:
 		ArchiveWriter(hpx::serialization::output_archive &ar) : ar_(ar) {}
 
+		/**
+		 * Space is managed by the underlying archive.
+		 */
+		void reserve(std::size_t) {}
+
 		/**
 		 * Appends a given number of bytes to the end of the underlying data buffer.
 		 */
@@ -325,6 +429,13 @@ namespace utils {
 		ArchiveReader(const Archive& archive)
 			: cur(archive.data.begin()), end(archive.data.end()) {}
 
+		/**
+		 * An archive reader may also read from a plain buffer, e.g. a memory mapped file,
+		 * which must not be released while the reader or views obtained from it are used.
+		 */
+		ArchiveReader(const char* data, std::size_t size)
+			: cur(data), end(data + size) {}
+
 		ArchiveReader(const ArchiveReader&) = delete;
 		ArchiveReader(ArchiveReader&&) = default;
 
@@ -358,6 +469,30 @@ namespace utils {
 			}
 		}
 
+		/**
+		 * Obtains a view on the given number of trivially serializable elements in the
+		 * underlying buffer, without copying them, and moves past them. The view is valid
+		 * as long as the underlying buffer is. If the elements are not properly aligned
+		 * within the buffer, nullptr is returned and nothing is consumed -- they may be
+		 * read by copying instead.
+		 */
+		template <typename T>
+		const T* view(std::size_t count) {
+			static_assert(is_trivially_serializable<T>::value, "Views are only supported for trivially serializable types!");
+			if (reinterpret_cast<std::uintptr_t>(cur) % alignof(T) != 0) return nullptr;
+			const T* res = reinterpret_cast<const T*>(cur);
+			cur += sizeof(T) * count;
+			assert_le(cur,end);
+			return res;
+		}
+
+		/**
+		 * Obtains the number of bytes not read yet.
+		 */
+		std::size_t remaining() const {
+			return static_cast<std::size_t>(end - cur);
+		}
+
 		/**
 		 * A utility function wrapping up the de-serialization of an object
 		 * of type T from the underlying buffer.
@@ -481,6 +616,9 @@ namespace utils {
 		static void store(ArchiveWriter& a, const T& value) {
 			a.write(reinterpret_cast<const char*>(&value),sizeof(T));
 		}
+		static std::size_t size_hint(const T&) {
+			return sizeof(T);
+		}
 	};
 
 	/**
@@ -507,6 +645,10 @@ namespace utils {
 		static void store(ArchiveWriter& a, const T& value) {
 			value.store(a);
 		}
+		static std::size_t size_hint(const T& value) {
+			// types may offer a member function std::size_t size_hint() const
+			return detail::member_size_hint(value, 0);
+		}
 	};
 
 
@@ -523,11 +665,17 @@ namespace utils {
 
 
 	// -- facade functions --
+
+	template<typename T>
+	std::size_t size_hint(const T& value) {
+		return detail::size_hint(value, 0);
+	}
+
 #if !defined(ALLSCALE_WITH_HPX)
 	template<typename T>
 	typename std::enable_if<is_serializable<T>::value,Archive>::type
 	serialize(const T& value) {
-		ArchiveWriter writer;
+		ArchiveWriter writer(size_hint(value));
 		writer.write(value);
 		return std::move(writer).toArchive();
 	}
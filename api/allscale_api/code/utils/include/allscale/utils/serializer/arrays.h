@@ -58,6 +58,13 @@ namespace utils {
 				writer.write(cur);
 			}
 		}
+		static std::size_t size_hint(const std::array<T,size>& value) {
+			std::size_t res = 0;
+			for(const auto& cur : value) {
+				res += utils::size_hint(cur);
+			}
+			return res;
+		}
 	};
 
 } // end namespace utils
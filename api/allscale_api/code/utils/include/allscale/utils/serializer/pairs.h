@@ -30,6 +30,9 @@ namespace utils {
 			writer.write<A>(value.first);
 			writer.write<B>(value.second);
 		}
+		static std::size_t size_hint(const std::pair<A,B>& value) {
+			return utils::size_hint(value.first) + utils::size_hint(value.second);
+		}
 	};
 
 
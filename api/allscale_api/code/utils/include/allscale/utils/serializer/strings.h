@@ -28,6 +28,9 @@ namespace utils {
 			writer.write<std::size_t>(value.size());
 			writer.write(&value[0],value.size());
 		}
+		static std::size_t size_hint(const std::string& value) {
+			return sizeof(std::size_t) + value.size();
+		}
 	};
 
 } // end namespace utils
@@ -40,6 +40,9 @@ namespace utils {
 			// followed by all the elements
 			writer.write(&value[0],value.size());
 		}
+		static std::size_t size_hint(const std::vector<T,Allocator>& value) {
+			return sizeof(std::size_t) + sizeof(T) * value.size();
+		}
 	};
 
 
@@ -76,6 +79,13 @@ namespace utils {
 			// followed by all the elements
 			writer.write(&value[0],value.size());
 		}
+		static std::size_t size_hint(const std::vector<T,Allocator>& value) {
+			std::size_t res = sizeof(std::size_t);
+			for(const auto& cur : value) {
+				res += utils::size_hint(cur);
+			}
+			return res;
+		}
 	};
 
 } // end namespace utils
@@ -84,6 +84,14 @@ namespace utils {
 			}
 		}
 
+		std::size_t size_hint() const {
+			std::size_t res = 0;
+			for(const auto& e : data) {
+				res += utils::size_hint(e);
+			}
+			return res;
+		}
+
 		static StaticGrid load(utils::ArchiveReader& reader) {
 			StaticGrid grid;
 			for(auto& e : grid.data) {
@@ -182,6 +190,10 @@ namespace utils {
 			writer.write(data);
 		}
 
+		std::size_t size_hint() const {
+			return utils::size_hint(data);
+		}
+
 		static StaticGrid load(utils::ArchiveReader& reader) {
 			StaticGrid grid;
 			grid.data = std::move(reader.read<data_type>());
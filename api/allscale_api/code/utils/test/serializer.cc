@@ -214,5 +214,74 @@ namespace utils {
 
 	}
 
+	TEST(SizeHint, Basic) {
+		EXPECT_EQ(sizeof(int),size_hint(10));
+		EXPECT_EQ(sizeof(double),size_hint(1.5));
+
+		// the hint of an archive covers its size and content
+		Archive a = serialize(10);
+		EXPECT_EQ(sizeof(std::size_t) + sizeof(int),size_hint(a));
+	}
+
+	TEST(ArchiveWriter, PreSized) {
+		ArchiveWriter writer(3 * sizeof(int));
+		writer.write(1);
+		writer.write(2);
+		writer.write(3);
+
+		// exceeding the hint is fine
+		writer.write(4);
+		EXPECT_EQ(4 * sizeof(int),writer.size());
+
+		Archive a = std::move(writer).toArchive();
+		ArchiveReader reader(a);
+		for(int i=1; i<=4; ++i) {
+			EXPECT_EQ(i,reader.read<int>());
+		}
+	}
+
+	TEST(ArchiveWriter, ExternalBuffer) {
+		std::vector<char> buffer(2 * sizeof(int) + sizeof(double));
+		ArchiveWriter writer(buffer.data(),buffer.size());
+		writer.write(5);
+		writer.write(1.5);
+		writer.write(6);
+		EXPECT_EQ(buffer.size(),writer.size());
+
+		// the data is in the external buffer ...
+		ArchiveReader reader(buffer.data(),buffer.size());
+		EXPECT_EQ(5,reader.read<int>());
+		EXPECT_EQ(1.5,reader.read<double>());
+		EXPECT_EQ(6,reader.read<int>());
+		EXPECT_EQ(0u,reader.remaining());
+
+		// ... and copied into the archive
+		Archive a = std::move(writer).toArchive();
+		EXPECT_EQ(buffer,a.getBuffer());
+	}
+
+	TEST(ArchiveReader, View) {
+		std::vector<double> values = { 1.0, 2.0, 3.0, 4.0 };
+
+		ArchiveWriter writer;
+		writer.write(values.data(),values.size());
+		Archive a = std::move(writer).toArchive();
+
+		// the archive storage is aligned, hence a view is available
+		ArchiveReader reader(a);
+		const double* view = reader.view<double>(values.size());
+		ASSERT_NE(nullptr,view);
+		EXPECT_EQ(a.getBuffer().data(),reinterpret_cast<const char*>(view));
+		for(std::size_t i=0; i<values.size(); ++i) {
+			EXPECT_EQ(values[i],view[i]);
+		}
+		EXPECT_EQ(0u,reader.remaining());
+
+		// no view on misaligned data, which is not consumed
+		ArchiveReader misaligned(a.getBuffer().data() + 1,a.getBuffer().size() - 1);
+		EXPECT_EQ(nullptr,misaligned.view<double>(1));
+		EXPECT_EQ(a.getBuffer().size() - 1,misaligned.remaining());
+	}
+
 } // end namespace utils
 } // end namespace allscale
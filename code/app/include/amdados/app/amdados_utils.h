@@ -63,11 +63,58 @@ inline int Round(double val)
     return static_cast<int>(std::floor(val + 0.5));
 }
 
+/**
+ * A step of time integration. Each step runs a number of sub-iterations,
+ * which are enumerated globally (e.g. by stencil time) one step after
+ * another, so the step occupies global indices [first .. first + Nsubiter).
+ */
+struct TimeStep
+{
+    double time;        // physical time at the beginning of the step
+    double dt;          // length of the step
+    size_t Nsubiter;    // number of sub-iterations within the step
+    size_t first;       // global index of the first sub-iteration
+};
+
+typedef ::std::vector<TimeStep> time_schedule_t;
+
+/**
+ * Profile of a simulation run: wall-clock time of the phases, the time
+ * spent in the subdomain kernels summed over all threads and the wall-clock
+ * time of every time step.
+ */
+struct RunProfile
+{
+    double init;                    // initialization of subdomains
+    double integration;             // time integration
+    double output;                  // writing the final field
+    double kalman;                  // kernels with Kalman filter (all threads)
+    double propagation;             // kernels without sensors (all threads)
+    ::std::vector<double> steps;    // time steps
+
+    RunProfile() : init(0.0), integration(0.0), output(0.0)
+                 , kalman(0.0), propagation(0.0), steps() {}
+};
+
 void CheckFileExists(const Configuration & conf, const std::string & filename);
 
 uint64_t RandomSeed();
 
 std::string MakeFileName(const Configuration & conf, const std::string & what);
 
+std::pair<double,double> Flow(const Configuration & conf, double time);
+
+void InitTimeStepping(Configuration & conf);
+
+time_schedule_t MakeUniformTimeSchedule(size_t Nt, double dt, size_t Nsubiter);
+
+time_schedule_t MakeTimeSchedule(const Configuration & conf);
+
+size_t NumSubIterations(const time_schedule_t & schedule);
+
+size_t FindTimeStep(const time_schedule_t & schedule, size_t timestamp);
+
+size_t ObservationRow(const Configuration & conf, double time, double & weight);
+
 } // namespace amdados
 
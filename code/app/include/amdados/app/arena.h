@@ -0,0 +1,155 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace amdados {
+
+//=============================================================================
+// Memory arena keeps many vectors and matrices in a single contiguous block,
+// every array starts at a 64-byte boundary (cache line, the widest SIMD
+// register). Objects are bound to the block as non-owning views (see
+// BasicVector::View()). The layout is done in two passes by the same
+// sequence of Place() calls: the first pass, right after Reset(), only
+// measures the space needed; then Allocate() obtains the block and the
+// second pass binds the objects. The block is zero-filled by the thread
+// calling Allocate(), so under the first-touch policy of the operating
+// system its pages reside on the memory node of that thread.
+// Note, the arena must outlive the objects placed therein.
+//=============================================================================
+class Arena
+{
+public:
+    static const size_t ALIGNMENT = 64;     // alignment of every array
+
+private:
+    std::unique_ptr<char[]> m_storage;  // memory block plus alignment margin
+    char *                  m_base;     // aligned beginning of the block
+    size_t                  m_size;     // size of the block in bytes
+    size_t                  m_offset;   // offset of the next free byte
+
+    // Rounds up the number of bytes to the alignment boundary.
+    static size_t RoundUp(size_t nbytes) {
+        return ((nbytes + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+    }
+
+public:
+//-----------------------------------------------------------------------------
+// Constructor.
+//-----------------------------------------------------------------------------
+Arena() : m_storage(), m_base(nullptr), m_size(0), m_offset(0)
+{
+}
+
+// The placed objects refer to the block, so it cannot be duplicated.
+Arena(const Arena &) = delete;
+Arena & operator=(const Arena &) = delete;
+
+// Move constructor, the block changes the owner but stays in place.
+Arena(Arena && other)
+    : m_storage(std::move(other.m_storage)), m_base(other.m_base)
+    , m_size(other.m_size), m_offset(other.m_offset)
+{
+    other.m_base = nullptr;
+    other.m_size = other.m_offset = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Prints this object.
+//-----------------------------------------------------------------------------
+friend std::ostream& operator<<(std::ostream & out, const Arena & a) {
+	out << "Arena: [ " << a.m_size << " bytes ]" << std::endl;
+	return out;
+}
+
+//-----------------------------------------------------------------------------
+// Function releases the memory block and starts the measuring pass.
+// Note, the objects placed in the arena so far must not be used afterwards.
+//-----------------------------------------------------------------------------
+void Reset()
+{
+    m_storage.reset();
+    m_base = nullptr;
+    m_size = m_offset = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Function allocates and zero-fills the memory block of the size measured
+// in the first pass and starts the binding pass.
+//-----------------------------------------------------------------------------
+void Allocate()
+{
+    assert_true(m_base == nullptr) << "arena has been already allocated";
+    m_size = m_offset;
+    m_offset = 0;
+    if (m_size == 0) return;
+    m_storage.reset(new char[m_size + ALIGNMENT]);
+    const size_t misalign =
+        reinterpret_cast<uintptr_t>(m_storage.get()) % ALIGNMENT;
+    m_base = m_storage.get() + (misalign ? (ALIGNMENT - misalign) : 0);
+    std::fill(m_base, m_base + m_size, char(0));
+}
+
+//-----------------------------------------------------------------------------
+// Function returns "true" if the memory block has been allocated.
+//-----------------------------------------------------------------------------
+bool Allocated() const
+{
+    return (m_base != nullptr);
+}
+
+//-----------------------------------------------------------------------------
+// Function returns the size of the memory block in bytes (the size measured
+// so far during the first pass).
+//-----------------------------------------------------------------------------
+size_t Bytes() const
+{
+    return Allocated() ? m_size : m_offset;
+}
+
+//-----------------------------------------------------------------------------
+// Function reserves aligned space for "count" elements of type T. It returns
+// the address of that space in the binding pass and null pointer otherwise.
+//-----------------------------------------------------------------------------
+template<typename T>
+T * Take(index_t count)
+{
+    assert_true(count >= 0);
+    const size_t offset = m_offset;
+    m_offset += RoundUp(static_cast<size_t>(count) * sizeof(T));
+    if (!Allocated()) return nullptr;
+    assert_true(m_offset <= m_size) << "arena is out of space";
+    return reinterpret_cast<T*>(m_base + offset);
+}
+
+//-----------------------------------------------------------------------------
+// Function places a vector in the arena: it will be able to keep up to
+// "capacity" elements (capacity = size by default) without reallocation.
+//-----------------------------------------------------------------------------
+template<typename T>
+void Place(BasicVector<T> & v, index_t size, index_t capacity = -1)
+{
+    if (capacity < 0) capacity = size;
+    T * p = Take<T>(capacity);
+    if (p != nullptr) { v.View(p, size, capacity); }
+}
+
+//-----------------------------------------------------------------------------
+// Function places a matrix in the arena: it will be able to keep up to
+// "capacity" elements (capacity = nrows*ncols by default) without
+// reallocation.
+//-----------------------------------------------------------------------------
+template<typename T>
+void Place(BasicMatrix<T> & m, index_t nrows, index_t ncols,
+           index_t capacity = -1)
+{
+    if (capacity < 0) capacity = nrows * ncols;
+    T * p = Take<T>(capacity);
+    if (p != nullptr) { m.View(p, nrows, ncols, capacity); }
+}
+
+}; // class Arena
+
+} // namespace amdados
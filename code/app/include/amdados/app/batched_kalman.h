@@ -0,0 +1,344 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace amdados {
+
+//=============================================================================
+// Class applies Kalman filter (see the functions of KalmanFilter class) to
+// many subdomains at once: the prior estimation and the filtering step.
+// The subdomains share the model, so the model matrix is decomposed once for
+// all of them and the temporary N-by-N objects are shared as well, rather
+// than kept by every subdomain. Filtering is done in groups of subdomains
+// with the same number of sensors. Within a group, the small matrices
+// S = H*P*H^t + R, their Cholesky factors, the innovations and the matrices
+// P*H^t are stored in structure-of-arrays layout, i.e. the index of subdomain
+// runs fastest, so the loops over the tiny (1-3 sized) dimensions vectorise
+// across subdomains. The covariance matrices themselves stay with their
+// subdomains, the products over them run along the rows, which are long
+// enough to vectorise as they are. Arithmetic is done in the same order as
+// in the KalmanFilter class, hence the results are exactly the same.
+// Note, only the MPI port uses this class. The stencil of Allscale port
+// invokes its kernel on every subdomain as a separate task, so there is no
+// point where the filters of a sub-iteration could be run together without
+// a barrier that serializes them.
+//=============================================================================
+class BatchedKalmanFilter
+{
+private:
+    // Data of a subdomain: all the objects are owned by the caller.
+    struct Item {
+        Vector       * x;       // in: prior state; out: posterior one
+        Matrix       * P;       // in: prior covariance; out: posterior one
+        const Matrix * H;       // observation model
+        const Matrix * R;       // measurement noise covariance
+        const Vector * z;       // observations
+    };
+
+    // Subdomains of the same problem size and the same number of sensors.
+    struct Group {
+        index_t           N;        // problem size
+        index_t           O;        // number of observations
+        std::vector<Item> items;    // subdomains of this group
+    };
+
+    std::vector<Group>  m_groups;   // groups of subdomains
+
+    LUdecomposition     m_lu;       // decomposition of shared model matrix
+    Vector              m_x_tmp;    // placeholder for the prior state
+    Matrix              m_P_tmp;    // placeholder for the prior covariance
+
+    std::vector<double> m_y;        // innovations z - H*x: O x K
+    std::vector<double> m_invSy;    // S^{-1}*y: O x K
+    std::vector<double> m_S;        // S and its Cholesky factor: O x O x K
+    std::vector<double> m_PHt;      // P*H^t: N x O x K
+    std::vector<double> m_invSHP;   // (S^{-1}*H*P)^t: N x O x K
+    std::vector<double> m_row;      // a row of S^{-1}*H*P of an item: N
+
+    // Address of element (i,j) of an IxJ matrix of k-th item in SoA layout.
+    static size_t At(index_t i, index_t j, index_t J, index_t k, index_t K) {
+        return static_cast<size_t>((i * J + j) * K + k);
+    }
+
+public:
+//-----------------------------------------------------------------------------
+// Constructor.
+//-----------------------------------------------------------------------------
+BatchedKalmanFilter()
+    : m_groups()
+    , m_lu(), m_x_tmp(), m_P_tmp()
+    , m_y(), m_invSy(), m_S(), m_PHt(), m_invSHP(), m_row()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Prints this object.
+//-----------------------------------------------------------------------------
+friend std::ostream& operator<<(std::ostream & out,
+                                const BatchedKalmanFilter & bkf) {
+	out << "BatchedKalmanFilter: [ ";
+	for (const Group & g : bkf.m_groups) {
+		out << g.N << "x" << g.O << ":" << g.items.size() << " ";
+	}
+	out << " ]" << std::endl;
+	return out;
+}
+
+//-----------------------------------------------------------------------------
+// Function registers a subdomain. The objects must stay alive and must keep
+// their sizes until Clear() is called.
+// @param  x  state vector, updated by SolveFilter().
+// @param  P  state covariance, updated by SolveFilter().
+// @param  H  observation model: z = H*x + v.
+// @param  R  measurement noise (v) covariance.
+// @param  z  vector of observations.
+//-----------------------------------------------------------------------------
+void Add(Vector & x, Matrix & P,
+         const Matrix & H, const Matrix & R, const Vector & z)
+{
+    const index_t N = x.Size();
+    const index_t O = z.Size();
+
+    assert_true((P.NRows() == N) && (P.NCols() == N));
+    assert_true((H.NRows() == O) && (H.NCols() == N));
+    assert_true((R.NRows() == O) && (R.NCols() == O));
+
+    Item item;
+    item.x = &x;  item.P = &P;  item.H = &H;  item.R = &R;  item.z = &z;
+
+    for (Group & g : m_groups) {
+        if ((g.N == N) && (g.O == O)) {
+            g.items.push_back(item);
+            return;
+        }
+    }
+    m_groups.push_back(Group());
+    m_groups.back().N = N;
+    m_groups.back().O = O;
+    m_groups.back().items.push_back(item);
+}
+
+//-----------------------------------------------------------------------------
+// Function unregisters all the subdomains.
+//-----------------------------------------------------------------------------
+void Clear()
+{
+    m_groups.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Returns the number of groups of subdomains.
+//-----------------------------------------------------------------------------
+size_t NumGroups() const
+{
+    return m_groups.size();
+}
+
+//-----------------------------------------------------------------------------
+// Returns the number of bytes of the objects shared by all the registered
+// subdomains, which are allocated on the first use: the decomposition of
+// model matrix, the placeholders and the arrays of the largest group.
+//-----------------------------------------------------------------------------
+size_t Bytes() const
+{
+    size_t count = 0, N = 0;
+    for (const Group & g : m_groups) {
+        const size_t n = static_cast<size_t>(g.N);
+        const size_t o = static_cast<size_t>(g.O);
+        const size_t k = g.items.size();
+        N = std::max(N, n);
+        count = std::max(count, 2 * n * o * k + o * o * k + 2 * o * k);
+    }
+    count += 2 * N * N + 2 * N;     // LU factors and P_tmp, x_tmp and row
+    return count * sizeof(double) + N * sizeof(index_t);
+}
+
+//-----------------------------------------------------------------------------
+// Function propagates states and covariances of all registered subdomains
+// one timestep ahead and obtains prior estimations (see the function
+// KalmanFilter::PropagateStateInverse()). The model matrix is decomposed
+// once for all of them.
+// @param  B  inverse model matrix: B = A^{-1}, the same for all subdomains.
+// @param  Q  process noise covariance, the same for all subdomains.
+//-----------------------------------------------------------------------------
+void PropagateStateInverse(const Matrix & B, const Matrix & Q)
+{
+    if (m_groups.empty()) return;
+    assert_true(B.SameSize(Q) && B.IsSquare());
+
+    m_lu.Init(B);                       // decompose: B = L*U
+    for (const Group & g : m_groups) {
+        assert_true(g.N == B.NRows()) << "subdomains do not share the model";
+        for (const Item & it : g.items) {
+            Vector & x = *it.x;
+            Matrix & P = *it.P;
+            m_x_tmp = x;                    // copy state and covariance into
+            m_P_tmp = P;                    // the separate temporary objects
+            m_lu.Solve(x, m_x_tmp);         // x_prior = B^{-1}*x
+            m_lu.BatchSolve(m_P_tmp, P);    // P_tmp = B^{-1}*P
+            m_lu.BatchSolveTr(P, m_P_tmp);  // P_prior = A*P*A^t
+            AddMatrices(P, P, Q);           // P_prior = A*P*A^t + Q
+            Symmetrize(P);                  // correct the loss of symmetry
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function makes an iteration of Kalman filter for all registered subdomains
+// given already estimated (prior) states and their covariances.
+//-----------------------------------------------------------------------------
+void SolveFilter()
+{
+    for (const Group & g : m_groups) {
+        SolveGroup(g);
+    }
+}
+
+private:
+//-----------------------------------------------------------------------------
+// Function makes an iteration of Kalman filter for a group of subdomains.
+//-----------------------------------------------------------------------------
+void SolveGroup(const Group & g)
+{
+    const double TINY = std::numeric_limits<double>::min() /
+		       std::pow(std::numeric_limits<double>::epsilon(),3);
+
+    const index_t N = g.N;
+    const index_t O = g.O;
+    const index_t K = static_cast<index_t>(g.items.size());
+    if ((K == 0) || (O == 0)) return;
+
+    m_y.resize(static_cast<size_t>(O * K));
+    m_invSy.resize(static_cast<size_t>(O * K));
+    m_S.resize(static_cast<size_t>(O * O * K));
+    m_PHt.resize(static_cast<size_t>(N * O * K));
+    m_invSHP.resize(static_cast<size_t>(N * O * K));
+    m_row.resize(static_cast<size_t>(N));
+
+    // Per subdomain: y = z - H*x_prior, PHt = P_prior*H^t, S = H*PHt + R.
+    for (index_t k = 0; k < K; ++k) {
+        const Item   & it = g.items[static_cast<size_t>(k)];
+        const Vector & x = *it.x;
+        const Matrix & P = *it.P;
+        const Matrix & H = *it.H;
+        const Matrix & R = *it.R;
+        for (index_t o = 0; o < O; ++o) {
+            double sum = 0.0;
+            for (index_t c = 0; c < N; ++c) { sum += H(o,c) * x(c); }
+            m_y[At(0,o,O,k,K)] = (*it.z)(o) - sum;
+        }
+        for (index_t r = 0; r < N; ++r) {
+        for (index_t o = 0; o < O; ++o) {
+            double sum = 0.0;
+            for (index_t c = 0; c < N; ++c) { sum += P(r,c) * H(o,c); }
+            m_PHt[At(r,o,O,k,K)] = sum;
+        }}
+        for (index_t i = 0; i < O; ++i) {
+        for (index_t j = 0; j < O; ++j) {
+            double sum = 0.0;
+            for (index_t r = 0; r < N; ++r) {
+                sum += H(i,r) * m_PHt[At(r,j,O,k,K)];
+            }
+            m_S[At(i,j,O,k,K)] = sum + R(i,j);
+        }}
+    }
+
+    // Correct symmetry loss due to round-off errors.
+    for (index_t i = 0;     i < O; ++i) {
+    for (index_t j = i + 1; j < O; ++j) {
+        double * s_ij = &m_S[At(i,j,O,0,K)];
+        double * s_ji = &m_S[At(j,i,O,0,K)];
+        for (index_t k = 0; k < K; ++k) {
+            s_ji[k] = s_ij[k] = 0.5 * (s_ji[k] + s_ij[k]);
+        }
+    }}
+
+    // Cholesky decomposition S = L*L^t, in-place, all subdomains at once.
+    for (index_t i = 0; i < O; ++i) {
+    for (index_t j = i; j < O; ++j) {
+        double * l_ji = &m_S[At(j,i,O,0,K)];
+        for (index_t k = 0; k < K; ++k) {
+            double sum = m_S[At(i,j,O,k,K)];
+            for (index_t m = i - 1; m >= 0; m--) {
+                sum -= m_S[At(i,m,O,k,K)] * m_S[At(j,m,O,k,K)];
+            }
+            if (i == j) {
+                assert_true(sum > TINY) << "Cholesky failed, sum: " << sum;
+                l_ji[k] = std::sqrt(sum);
+            } else {
+                l_ji[k] = sum / m_S[At(i,i,O,k,K)];
+            }
+        }
+    }}
+
+    // m_invSy = S^{-1}*y, then m_invSHP = (S^{-1}*H*P_prior)^t.
+    SolveBatch(m_invSy.data(), m_y.data(), O, K);
+    for (index_t r = 0; r < N; ++r) {
+        SolveBatch(&m_invSHP[At(r,0,O,0,K)], &m_PHt[At(r,0,O,0,K)], O, K);
+    }
+
+    // Per subdomain: x = x_prior + PHt*S^{-1}*y,
+    // P = P_prior - PHt*S^{-1}*H*P_prior.
+    for (index_t k = 0; k < K; ++k) {
+        const Item & it = g.items[static_cast<size_t>(k)];
+        Vector & x = *it.x;
+        Matrix & P = *it.P;
+        for (index_t r = 0; r < N; ++r) {
+            double sum = 0.0;
+            for (index_t o = 0; o < O; ++o) {
+                sum += m_PHt[At(r,o,O,k,K)] * m_invSy[At(0,o,O,k,K)];
+            }
+            x(r) = sum + x(r);
+        }
+        for (index_t r = 0; r < N; ++r) {
+            for (index_t c = 0; c < N; ++c) {
+                double sum = 0.0;
+                for (index_t o = 0; o < O; ++o) {
+                    sum += m_PHt[At(r,o,O,k,K)] * m_invSHP[At(c,o,O,k,K)];
+                }
+                m_row[static_cast<size_t>(c)] = sum;
+            }
+            double * p = &P(r,0);
+            for (index_t c = 0; c < N; ++c) {
+                p[c] = p[c] - m_row[static_cast<size_t>(c)];
+            }
+        }
+        Symmetrize(P);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function solves the linear systems S*x = b of all subdomains of a group,
+// where S was factorized by SolveGroup(); x and b are O x K arrays.
+//-----------------------------------------------------------------------------
+void SolveBatch(double * x, const double * b, index_t O, index_t K) const
+{
+    for (index_t i = 0; i < O; i++) {
+        const double * l_ii = &m_S[At(i,i,O,0,K)];
+        for (index_t k = 0; k < K; ++k) {
+            double sum = b[At(0,i,O,k,K)];
+            for (index_t m = i - 1; m >= 0; m--) {
+                sum -= m_S[At(i,m,O,k,K)] * x[At(0,m,O,k,K)];
+            }
+            x[At(0,i,O,k,K)] = sum / l_ii[k];
+        }
+    }
+
+    for (index_t i = O - 1; i >= 0; i--) {
+        const double * l_ii = &m_S[At(i,i,O,0,K)];
+        for (index_t k = 0; k < K; ++k) {
+            double sum = x[At(0,i,O,k,K)];
+            for (index_t m = i + 1; m < O; m++) {
+                sum -= m_S[At(m,i,O,k,K)] * x[At(0,m,O,k,K)];
+            }
+            x[At(0,i,O,k,K)] = sum / l_ii[k];
+        }
+    }
+}
+
+}; // class BatchedKalmanFilter
+
+} // namespace amdados
@@ -0,0 +1,415 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace amdados {
+
+/**
+ * Function returns the lock that serializes the file operations through
+ * FileIOManager, which is not thread-safe on opening and closing streams,
+ * whereas the background checkpoint writer and the concurrent simulations
+ * (see ScenarioSweep()) share it.
+ */
+inline std::mutex & FileIOLock()
+{
+    static std::mutex lock;
+    return lock;
+}
+
+/**
+ * Function writes a matrix (its sizes followed by the elements) into the
+ * archive; empty matrix is written as well.
+ */
+template<typename T>
+void StoreArray(::allscale::utils::ArchiveWriter & writer,
+                const BasicMatrix<T> & m)
+{
+    writer.write<index_t>(m.NRows());
+    writer.write<index_t>(m.NCols());
+    if (!m.Empty()) {
+        writer.write<T>(m.begin(), static_cast<size_t>(m.Size()));
+    }
+}
+
+/**
+ * Function reads a matrix written by StoreArray(). The matrix is resized
+ * in place, so the matrices placed in the memory arena stay there.
+ */
+template<typename T>
+void LoadArray(::allscale::utils::ArchiveReader & reader, BasicMatrix<T> & m)
+{
+    const index_t nrows = reader.read<index_t>();
+    const index_t ncols = reader.read<index_t>();
+    if (nrows * ncols == 0) {
+        assert_true(m.Empty()) << "checkpoint does not match configuration";
+        return;
+    }
+    m.Resize(nrows, ncols, false);
+    reader.read<T>(m.begin(), static_cast<size_t>(m.Size()));
+}
+
+/**
+ * Function writes the variables of a subdomain, which persist from one time
+ * step to another, into the archive. The other matrices (B, Q, R, H, z)
+ * are recomputed at the beginning of every time step, so they are omitted.
+ */
+inline void StoreContext(::allscale::utils::ArchiveWriter & writer,
+                         const SubdomainContext & ctx)
+{
+    writer.write<unsigned>(ctx.layer);
+    writer.write<double>(ctx.flow.first);
+    writer.write<double>(ctx.flow.second);
+    StoreArray(writer, ctx.field);
+    StoreArray(writer, ctx.P);
+    StoreArray(writer, ctx.P_mixed);
+    writer.write<size_t>(ctx.boundaries.remote.size());
+    if (!ctx.boundaries.remote.empty()) {
+        writer.write<double>(ctx.boundaries.remote.data(),
+                             ctx.boundaries.remote.size());
+    }
+    writer.write<index_t>(ctx.Ploc.Size());
+    writer.write<index_t>(ctx.Ploc.NumEntries());
+    if (!ctx.Ploc.Empty()) {
+        writer.write<double>(&ctx.Ploc(0,0), static_cast<size_t>(
+                                ctx.Ploc.Size() * ctx.Ploc.NumEntries()));
+    }
+}
+
+/**
+ * Function returns the size of the variables of a subdomain in archive,
+ * as they are written by StoreContext().
+ */
+inline size_t ContextSizeHint(const SubdomainContext & ctx)
+{
+    return sizeof(unsigned) + 2 * sizeof(double) + ctx.field.size_hint() +
+           ctx.P.size_hint() + ctx.P_mixed.size_hint() + sizeof(size_t) +
+           ctx.boundaries.remote.size() * sizeof(double) +
+           2 * sizeof(index_t) +
+           static_cast<size_t>(ctx.Ploc.Size() * ctx.Ploc.NumEntries()) *
+           sizeof(double);
+}
+
+/**
+ * Function restores the variables of a subdomain written by StoreContext().
+ * The configuration must be the same as the one of the checkpointed run.
+ * If the restored layer differs from the initial one, the field no longer
+ * fits the memory arena, so the caller places the matrices anew.
+ */
+inline void LoadContext(::allscale::utils::ArchiveReader & reader,
+                        SubdomainContext & ctx)
+{
+    ctx.layer = reader.read<unsigned>();
+    ctx.flow.first = reader.read<double>();
+    ctx.flow.second = reader.read<double>();
+    LoadArray(reader, ctx.field);
+    LoadArray(reader, ctx.P);
+    LoadArray(reader, ctx.P_mixed);
+    ctx.boundaries.remote.resize(reader.read<size_t>());
+    if (!ctx.boundaries.remote.empty()) {
+        reader.read<double>(ctx.boundaries.remote.data(),
+                            ctx.boundaries.remote.size());
+    }
+    const index_t N = reader.read<index_t>();
+    const index_t K = reader.read<index_t>();
+    assert_true((N == ctx.Ploc.Size()) && (K == ctx.Ploc.NumEntries()))
+        << "checkpoint does not match configuration";
+    if (!ctx.Ploc.Empty()) {
+        reader.read<double>(&ctx.Ploc(0,0), static_cast<size_t>(N * K));
+    }
+}
+
+/**
+ * Class takes periodic checkpoints of the assimilation state: the state
+ * field and the persistent variables of every subdomain (see StoreContext()).
+ * A checkpoint is taken at the end of every 'checkpoint_period'-th time step.
+ * There is no global stop: as soon as a subdomain has completed the time
+ * step (see the observer in RunDataAssimilation()), it serializes itself
+ * and queues the record for a background thread, which appends it to the
+ * checkpoint file while the time integration proceeds. Thus the records
+ * are streamed one by one, and the memory held by checkpointing is that of
+ * the records queued but not yet written, rather than a snapshot of all the
+ * covariance matrices. Since a subdomain saves itself at a time step before
+ * it proceeds to the next one, the last record of a checkpoint is always
+ * queued before the last record of the next checkpoint, so the checkpoints
+ * are completed in order. A file is written under a temporary name and
+ * renamed when complete, thus a crash never damages the previous checkpoint.
+ * File layout: magic number, timestamp (index of the first sub-iteration
+ * yet to be done), grid size, then the records of subdomains in the order
+ * they have been written, each one preceded by the flat index of subdomain
+ * (row-major) and its size in bytes. Besides the state and the context,
+ * a record keeps the coarse-grid correction the subdomain is due to take up
+ * at the next sub-iteration (see CoarseCorrection), zero if there is none.
+ */
+class Checkpointer
+{
+public:
+    static const uint64_t MAGIC = 0x34544b4344414d41ull;    // "AMADCKT4"
+
+private:
+    using OutputStream = ::allscale::api::core::OutputStream;
+
+    // Record of a subdomain queued for writing.
+    struct Record {
+        size_t            timestamp;    // timestamp of checkpoint
+        size_t            pos;          // flat index of subdomain
+        std::vector<char> data;         // serialized subdomain
+    };
+
+    // Checkpoint file being written.
+    struct File {
+        std::unique_ptr<OutputStream> out;  // stream of temporary file
+        size_t                        count;// number of records written
+    };
+
+    std::string              m_filename;    // name of checkpoint file
+    point2d_t                m_grid_size;   // grid size in subdomains
+    std::vector<bool>        m_due;         // checkpoint timestamps
+    std::mutex               m_mutex;       // guards the queue
+    std::condition_variable  m_cond;        // signals the writer thread
+    std::deque<Record>       m_queue;       // records to be written
+    bool                     m_stop;        // no more records will come
+    std::thread              m_writer;      // background writer thread
+    std::map<size_t,File>    m_files;       // files being written (writer)
+    size_t                   m_num_written; // number of checkpoints written
+    double                   m_bytes;       // total size of checkpoints
+    double                   m_write_time;  // time spent in writing
+    size_t                   m_max_queued;  // peak size of the queue
+    std::atomic<int64_t>     m_save_ns;     // time spent in serialization
+
+public:
+//-----------------------------------------------------------------------------
+// Constructor; zero period disables checkpointing.
+//-----------------------------------------------------------------------------
+Checkpointer(const Configuration & conf, const time_schedule_t & schedule,
+             const point2d_t & grid_size)
+    : m_filename(MakeFileName(conf, "checkpoint")), m_grid_size(grid_size)
+    , m_due(NumSubIterations(schedule) + 1, false)
+    , m_mutex(), m_cond(), m_queue(), m_stop(false), m_writer(), m_files()
+    , m_num_written(0), m_bytes(0.0), m_write_time(0.0), m_max_queued(0)
+    , m_save_ns(0)
+{
+    const size_t period = conf.IsExist("checkpoint_period") ?
+                          conf.asUInt("checkpoint_period") : 0;
+    if (period == 0) return;
+    for (size_t k = period; k < schedule.size(); k += period) {
+        m_due[schedule[k].first] = true;
+    }
+    m_writer = std::thread([this]() { WriterLoop(); });
+}
+
+//-----------------------------------------------------------------------------
+// Destructor stops the writer thread, if \sa Finish() has not been called.
+//-----------------------------------------------------------------------------
+~Checkpointer()
+{
+    Stop();
+}
+
+//-----------------------------------------------------------------------------
+// Returns "true" if a checkpoint is taken when 'timestamp' sub-iterations
+// have been done.
+//-----------------------------------------------------------------------------
+bool IsDue(size_t timestamp) const
+{
+    return (timestamp < m_due.size()) && m_due[timestamp];
+}
+
+//-----------------------------------------------------------------------------
+// Function serializes a subdomain, which has done 'timestamp' sub-iterations,
+// along with its pending coarse-grid 'correction', and queues the record for
+// the background writer.
+//-----------------------------------------------------------------------------
+void Save(size_t timestamp, const point2d_t & idx, const subdomain_t & cell,
+          const SubdomainContext & ctx, double correction)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    // The archive is sized up front, so the data are copied just once.
+    ::allscale::utils::ArchiveWriter writer(
+            ::allscale::utils::size_hint(cell) + ContextSizeHint(ctx) +
+            sizeof(double));
+    writer.write(cell);
+    StoreContext(writer, ctx);
+    writer.write<double>(correction);
+    Record record{timestamp,
+                  static_cast<size_t>(idx.x * m_grid_size.y + idx.y),
+                  std::move(writer).toArchive()};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(record));
+        m_max_queued = std::max(m_max_queued, m_queue.size());
+    }
+    m_cond.notify_one();
+    m_save_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//-----------------------------------------------------------------------------
+// Function waits until the queued records have been written and prints
+// the cost of checkpointing.
+//-----------------------------------------------------------------------------
+void Finish()
+{
+    Stop();
+    assert_true(m_files.empty()) << "incomplete checkpoint";
+    if (m_num_written == 0) return;
+    const double MB = 1024.0 * 1024.0;
+    std::cout << "Checkpoints: " << m_num_written << " of "
+              << m_bytes / (MB * static_cast<double>(m_num_written))
+              << " MB each, serialization: "
+              << static_cast<double>(m_save_ns.load()) * 1e-9
+              << "s (all threads), writing in background: "
+              << m_write_time << "s, at most " << m_max_queued
+              << " subdomains queued" << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Function reads the checkpoint file into the state field and the contexts
+// of subdomains, which must be initialized by the same configuration, and
+// the pending coarse-grid corrections of subdomains into the matrix of
+// grid size. The records are decoded one by one as they are read.
+// Returns the timestamp the time integration should be resumed from.
+//-----------------------------------------------------------------------------
+static size_t Load(const std::string & filename, domain_t & state_field,
+                   context_domain_t & contexts, Matrix & corrections)
+{
+    using ::allscale::api::core::FileIOManager;
+    using ::allscale::api::core::Mode;
+
+    const point2d_t grid_size = state_field.size();
+    const size_t total = static_cast<size_t>(grid_size.x * grid_size.y);
+    corrections.Resize(grid_size.x, grid_size.y);
+
+    std::lock_guard<std::mutex> io_lock(FileIOLock());
+    FileIOManager & manager = FileIOManager::getInstance();
+    auto in = manager.openInputStream(
+                        manager.createEntry(filename, Mode::Binary));
+    assert_true(in) << "failed to open the checkpoint: " << filename;
+
+    uint64_t magic = 0, timestamp = 0;
+    int64_t nx = 0, ny = 0;
+    std::vector<bool> loaded(total, false);
+    std::vector<char> record;
+    in.atomic([&](auto & file) {
+        file.read(magic).read(timestamp).read(nx).read(ny);
+        if ((magic != MAGIC) || (nx != grid_size.x) || (ny != grid_size.y))
+            return;
+        for (size_t k = 0; (k < total) && file.in; ++k) {
+            const size_t pos = file.template read<uint64_t>();
+            record.resize(file.template read<uint64_t>());
+            file.in.read(record.data(),
+                         static_cast<std::streamsize>(record.size()));
+            if (!file.in || (pos >= total) || loaded[pos]) return;
+            loaded[pos] = true;
+            const point2d_t idx(static_cast<index_t>(pos) / grid_size.y,
+                                static_cast<index_t>(pos) % grid_size.y);
+            ::allscale::utils::ArchiveReader reader(record.data(),
+                                                    record.size());
+            state_field[idx] = reader.read<subdomain_t>();
+            LoadContext(reader, contexts[idx]);
+            corrections(idx.x, idx.y) = reader.read<double>();
+        }
+    });
+    assert_true(magic == MAGIC) << "not a checkpoint file: " << filename;
+    assert_true((nx == grid_size.x) && (ny == grid_size.y))
+        << "checkpoint grid size mismatch: " << filename;
+    assert_true(in && std::all_of(loaded.begin(), loaded.end(),
+                                  [](bool b) { return b; }))
+        << "failed to read the checkpoint: " << filename;
+    manager.close(in);
+    return static_cast<size_t>(timestamp);
+}
+
+private:
+//-----------------------------------------------------------------------------
+// Function lets the writer thread drain the queue and waits for it.
+//-----------------------------------------------------------------------------
+void Stop()
+{
+    if (!m_writer.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_writer.join();
+}
+
+//-----------------------------------------------------------------------------
+// Function of the background thread: writes the queued records one by one.
+//-----------------------------------------------------------------------------
+void WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cond.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+        if (m_queue.empty()) break;
+        Record record = std::move(m_queue.front());
+        m_queue.pop_front();
+        lock.unlock();
+        Write(record);
+        lock.lock();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function appends a record to its checkpoint file, which is created by
+// the first record and renamed once the last one has been written. Opening
+// and closing of the files are serialized by FileIOLock(), the writing
+// itself is done by this thread only.
+//-----------------------------------------------------------------------------
+void Write(const Record & record)
+{
+    using ::allscale::api::core::FileIOManager;
+    using ::allscale::api::core::Mode;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const std::string temp_name = m_filename + "." +
+                                  std::to_string(record.timestamp) + ".tmp";
+    FileIOManager & manager = FileIOManager::getInstance();
+    File & f = m_files[record.timestamp];
+    if (!f.out) {
+        std::lock_guard<std::mutex> io_lock(FileIOLock());
+        f.out.reset(new OutputStream(manager.openOutputStream(
+                        manager.createEntry(temp_name, Mode::Binary))));
+        f.count = 0;
+        f.out->atomic([&](auto & file) {
+            file.write(static_cast<uint64_t>(MAGIC))
+                .write(static_cast<uint64_t>(record.timestamp))
+                .write(static_cast<int64_t>(m_grid_size.x))
+                .write(static_cast<int64_t>(m_grid_size.y));
+        });
+    }
+
+    f.out->atomic([&](auto & file) {
+        file.write(static_cast<uint64_t>(record.pos))
+            .write(static_cast<uint64_t>(record.data.size()));
+        file.out.write(record.data.data(),
+                       static_cast<std::streamsize>(record.data.size()));
+    });
+    f.out->flush();     // do not keep the record in the buffer of thread
+    assert_true(*f.out) << "failed to write the checkpoint: " << temp_name;
+    m_bytes += static_cast<double>(record.data.size());
+
+    if (++f.count == static_cast<size_t>(m_grid_size.x * m_grid_size.y)) {
+        {
+            std::lock_guard<std::mutex> io_lock(FileIOLock());
+            manager.close(*f.out);
+        }
+        m_files.erase(record.timestamp);
+        // The previous checkpoint stays intact if the new one is not renamed.
+        if (std::rename(temp_name.c_str(), m_filename.c_str()) != 0) {
+            MY_LOG(ERROR) << "failed to rename the checkpoint: " << temp_name;
+        } else {
+            m_num_written += 1;
+        }
+    }
+    m_write_time += std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - start).count();
+}
+
+}; // class Checkpointer
+
+} // namespace amdados
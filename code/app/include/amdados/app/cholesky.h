@@ -35,6 +35,14 @@ friend std::ostream& operator<<(std::ostream & out, const Cholesky & c) {
 	return out;
 }
 
+//-----------------------------------------------------------------------------
+// Function places the decomposition of N-by-N matrix in the memory arena.
+//-----------------------------------------------------------------------------
+void Place(Arena & arena, index_t N)
+{
+    arena.Place(m_L, N, N);
+}
+
 //-----------------------------------------------------------------------------
 // Function computes and stores Cholesky decomposition
 // of a positive-definite symmetric matrix: A = L * L^t.
@@ -72,6 +80,14 @@ void Init(const Matrix & A)
     for (index_t j = 0; j < i; j++) { L(j,i) = 0.0; }}
 }
 
+//-----------------------------------------------------------------------------
+// Function returns the lower triangular factor L of decomposition A = L * L^t.
+//-----------------------------------------------------------------------------
+const Matrix & LowerTriangular() const
+{
+    return m_L;
+}
+
 //-----------------------------------------------------------------------------
 // Function solves a linear system A*x = b, where A is the matrix whose
 // Cholesky decomposition was computed by the Init() function.
@@ -0,0 +1,212 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace amdados {
+
+/**
+ * Class implements the coarse-grid correction of sub-iterations, which turns
+ * the block Jacobi iterations over subdomains into the two-level Schwarz
+ * method with piecewise constant (Nicolaides) coarse space: one unknown per
+ * subdomain, namely its mean value, as the coarsest layer of subdomain keeps.
+ * A subdomain is solved with the boundary values its peers had at the previous
+ * sub-iteration, so the residual of the global implicit model equation arises
+ * at the points next to the peers only. After every sub-iteration, the mean
+ * residual of each subdomain is taken, the coarse problem obtained from the
+ * model stencils by Galerkin projection (see CoarseStencil()) is solved on
+ * the grid of subdomains, and the correction is added to the subdomains.
+ * The coarse problem couples all the subdomains at once, so the information
+ * crosses the whole domain in one sub-iteration rather than one subdomain per
+ * sub-iteration.
+ * The residual and the coarse stencil of a subdomain come from the same model
+ * stencil, the one the subdomain has been solved with at its own layer.
+ * The subdomains with sensors are driven by the Kalman filter rather than
+ * the model alone, hence they are not corrected, and neither are the ones
+ * that hold their state (see HoldsState()). They are excluded from the coarse
+ * problem as well, i.e. their correction is zero, so the correction of the
+ * others accounts for the fact that these ones stay as they are.
+ * Gather() only reads the state field; it is invoked by a stencil observer
+ * on every subdomain once the sub-iteration is over, and the last subdomain
+ * solves the coarse problem. The correction is not added to the state field
+ * there, but at the beginning of the next sub-iteration, when a subdomain
+ * makes up its extended field from the state (see Correction()).
+ */
+class CoarseCorrection
+{
+private:
+    using Direction = ::allscale::api::user::data::Direction;
+
+    time_schedule_t     m_schedule;     // time steps
+    point2d_t           m_grid_size;    // grid size in subdomains
+    StencilSolver       m_solver;       // solver of the coarse problem
+    Matrix              m_coarse;       // mean residuals, then corrections
+    Matrix              m_residuals;    // residuals given by the peers
+    std::vector<ModelStencil> m_stencils;   // coarse stencils of subdomains
+    std::atomic<size_t> m_count;        // number of subdomains gathered
+    size_t              m_timestamp;    // sub-iteration of the last solution
+
+public:
+//-----------------------------------------------------------------------------
+// Constructor.
+//-----------------------------------------------------------------------------
+CoarseCorrection(const time_schedule_t & schedule, const point2d_t & grid_size)
+    : m_schedule(schedule), m_grid_size(grid_size)
+    , m_solver(), m_coarse(grid_size.x + 2, grid_size.y + 2)
+    , m_residuals(grid_size.x * grid_size.y, 4)
+    , m_stencils(static_cast<size_t>(grid_size.x * grid_size.y))
+    , m_count(0), m_timestamp(std::numeric_limits<size_t>::max())
+{
+}
+
+//-----------------------------------------------------------------------------
+// Function is invoked on every subdomain once 'timestamp' sub-iteration is
+// done. The subdomain sets up its coarse stencil and gives its peers their
+// residuals, i.e. the differences between its own new values 'cell' and
+// the ones the peers have been solved with, which the borders of their
+// extended subdomain fields keep. The subdomain that comes last solves
+// the coarse problem. Neither the state nor the contexts are modified.
+//-----------------------------------------------------------------------------
+void Gather(size_t timestamp, const point2d_t & idx, const subdomain_t & cell,
+            const context_domain_t & contexts)
+{
+    const index_t Nx = m_grid_size.x;
+    const index_t Ny = m_grid_size.y;
+    const SubdomainContext & ctx = contexts[idx];
+
+    // Coarse stencil of this subdomain, or identity if it is excluded.
+    ModelStencil & stencil =
+                    m_stencils[static_cast<size_t>(idx.x * Ny + idx.y)];
+    if (IsCorrected(ctx, timestamp)) {
+        const size2d_t sz = cell.getLayerSize(ctx.layer);
+        stencil = CoarseStencil(ctx.model, sz.x, sz.y);
+    } else {
+        stencil.centre = 1.0;
+        stencil.xm = stencil.xp = stencil.ym = stencil.yp = 0.0;
+    }
+
+    // Residuals of the peers at their points next to this subdomain.
+    auto Give = [&](Direction dir) {
+        Residual(timestamp, idx, cell, contexts, dir);
+    };
+    if (idx.x > 0)      Give(Direction::Left);
+    if (idx.x + 1 < Nx) Give(Direction::Right);
+    if (idx.y > 0)      Give(Direction::Down);
+    if (idx.y + 1 < Ny) Give(Direction::Up);
+
+    // Coarse problem is small, so it is solved by a single task, the last
+    // one; zero border: no outer correction.
+    if (m_count.fetch_add(1) + 1 < static_cast<size_t>(Nx * Ny)) return;
+    m_count = 0;
+    for (index_t x = 0; x < Nx; ++x) {
+    for (index_t y = 0; y < Ny; ++y) {
+        const index_t k = x * Ny + y;
+        m_coarse(x + 1, y + 1) = m_residuals(k,Direction::Left) +
+                                 m_residuals(k,Direction::Right) +
+                                 m_residuals(k,Direction::Down) +
+                                 m_residuals(k,Direction::Up);
+    }}
+    m_solver.Init(m_stencils, Nx, Ny);
+    m_solver.Solve(m_coarse, m_coarse);
+    m_timestamp = timestamp;
+}
+
+//-----------------------------------------------------------------------------
+// Function returns the correction of subdomain 'idx' to be added at the
+// beginning of 'timestamp' sub-iteration, i.e. the one the coarse problem
+// has been solved for once the previous sub-iteration was over; zero, if
+// the previous sub-iteration has not been gathered.
+//-----------------------------------------------------------------------------
+double Correction(size_t timestamp, const point2d_t & idx) const
+{
+    if (m_timestamp + 1 != timestamp) return 0.0;
+    return m_coarse(idx.x + 1, idx.y + 1);
+}
+
+//-----------------------------------------------------------------------------
+// Function restores the corrections of subdomains (a matrix of grid size),
+// which were pending when the checkpoint was taken, so that the time
+// integration resumed from 'timestamp' sub-iteration takes them up as the
+// checkpointed run would do.
+//-----------------------------------------------------------------------------
+void Resume(size_t timestamp, const Matrix & corrections)
+{
+    assert_true((timestamp > 0) &&
+                (corrections.NRows() == m_grid_size.x) &&
+                (corrections.NCols() == m_grid_size.y));
+    for (index_t x = 0; x < m_grid_size.x; ++x) {
+    for (index_t y = 0; y < m_grid_size.y; ++y) {
+        m_coarse(x + 1, y + 1) = corrections(x, y);
+    }}
+    m_timestamp = timestamp - 1;
+}
+
+private:
+//-----------------------------------------------------------------------------
+// Returns "true" if the subdomain is subject to correction once 'timestamp'
+// sub-iteration is done.
+//-----------------------------------------------------------------------------
+bool IsCorrected(const SubdomainContext & ctx, size_t timestamp) const
+{
+    return ctx.sensors.empty() && !HoldsState(ctx, m_schedule, timestamp);
+}
+
+//-----------------------------------------------------------------------------
+// Function computes the mean residual of the peer in direction 'dir' from
+// the subdomain 'idx' at the points next to the subdomain (the overlap with
+// wide halo), where the peer has used its extended subdomain field instead
+// of the values 'cell' of subdomain, taken at the peer's layer.
+//-----------------------------------------------------------------------------
+void Residual(size_t timestamp, const point2d_t & idx, const subdomain_t & cell,
+              const context_domain_t & contexts, Direction dir)
+{
+    point2d_t peer = idx;
+    Direction side = dir;                   // side of the peer facing 'idx'
+    switch (dir) {
+        case Direction::Left:  peer.x -= 1; side = Direction::Right; break;
+        case Direction::Right: peer.x += 1; side = Direction::Left;  break;
+        case Direction::Down:  peer.y -= 1; side = Direction::Up;    break;
+        case Direction::Up:    peer.y += 1; side = Direction::Down;  break;
+    }
+    double & res = m_residuals(peer.x * m_grid_size.y + peer.y, side);
+    res = 0.0;
+    const SubdomainContext & pctx = contexts[peer];
+    if (!IsCorrected(pctx, timestamp)) return;
+
+    const size2d_t sz = cell.getLayerSize(pctx.layer);
+    const index_t Sx = sz.x;
+    const index_t Sy = sz.y;
+    const Matrix & used = pctx.field;
+    const index_t w = (used.NRows() - Sx) / 2;      // halo width
+    const ModelStencil & s = pctx.model;
+
+    // The boundary of this subdomain facing the peer at the peer's layer.
+    const auto actual = cell.getBoundaryView(pctx.layer, dir);
+
+    double sum = 0.0;
+    switch (side) {
+        case Direction::Left:
+            for (index_t y = 0; y < Sy; ++y)
+                sum += s.xm * (used(w-1,y+w) - actual[size_t(y)]);
+            break;
+        case Direction::Right:
+            for (index_t y = 0; y < Sy; ++y)
+                sum += s.xp * (used(Sx+w,y+w) - actual[size_t(y)]);
+            break;
+        case Direction::Down:
+            for (index_t x = 0; x < Sx; ++x)
+                sum += s.ym * (used(x+w,w-1) - actual[size_t(x)]);
+            break;
+        case Direction::Up:
+            for (index_t x = 0; x < Sx; ++x)
+                sum += s.yp * (used(x+w,Sy+w) - actual[size_t(x)]);
+            break;
+    }
+    res = sum / static_cast<double>(Sx * Sy);
+}
+
+}; // class CoarseCorrection
+
+} // namespace amdados
@@ -14,7 +14,8 @@ namespace amdados {
 //          <parameter name>  <parameter value>  # comment
 // Parameter name is a single word without spaces, special symbols or
 // quotation. Parameter value is a double, an integer or a string without
-// spaces and quotation. Everything to the right of the symbol '#' is ignored.
+// spaces and quotation, e.g. a comma-separated list. Everything to the right
+// of the symbol '#' is ignored.
 // Blank lines are ignored as well.
 //=============================================================================
 class Configuration
@@ -52,10 +53,12 @@ public:
 
     bool IsExist(const char * param_name) const;
     bool IsInteger(const char * param_name) const;
+    bool IsNumeric(const char * param_name) const;
 
     void SetInt(const char * param_name, int value = 0);
     void SetDouble(const char * param_name, double value = 0.0);
     void SetString(const char * param_name, const char * value = "");
+    void SetValue(const char * param_name, const std::string & value);
 
 	friend std::ostream& operator<<(std::ostream & out,
                                     const Configuration & c) {
@@ -48,15 +48,22 @@ virtual void Accumulate(const point2d_t & idx, double diff)
 virtual void PrintProfile(const Configuration & conf, const char * entity_name)
 {
     const size_t len = m_accums[{0,0}].size();
-    double_array_t profile(len);
-    // Doing reduction sequentially.
-    m_accums.forEach([&](const double_array_t & acc) {
-        assert_true(acc.size() == len)
-            << "difference profiles of all the subdomains must have "
-            << "the same length" << std::endl;
-        std::transform(profile.begin(), profile.end(), acc.begin(),
-                       profile.begin(), std::plus<double>());
-    });
+    // Doing reduction in parallel, the result does not depend on scheduling.
+    const double_array_t profile = m_accums.preduce(
+        [len](const double_array_t & acc, double_array_t & sum) {
+            assert_true(acc.size() == len)
+                << "difference profiles of all the subdomains must have "
+                << "the same length" << std::endl;
+            std::transform(sum.begin(), sum.end(), acc.begin(),
+                           sum.begin(), std::plus<double>());
+        },
+        [](const double_array_t & a, const double_array_t & b) {
+            double_array_t sum(a.size());
+            std::transform(a.begin(), a.end(), b.begin(),
+                           sum.begin(), std::plus<double>());
+            return sum;
+        },
+        [len]() { return double_array_t(len); }).get();
 
     assert_true(entity_name != nullptr);
     const int Nx = conf.asInt("num_subdomains_x") * conf.asInt("subdomain_x");
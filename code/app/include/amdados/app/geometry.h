@@ -25,8 +25,9 @@ typedef ::allscale::api::user::data::CellConfig<2,
 
 // Levels of resolution of subdomain layers.
 enum {
-    LayerFine = 0,
-    LayerLow  = 1
+    LayerFine   = 0,
+    LayerLow    = 1,
+    LayerCoarse = 2
 };
 
 // 2D point, also "index" in parallel for (pfor) loops.
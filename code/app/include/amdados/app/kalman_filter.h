@@ -8,35 +8,47 @@
 namespace amdados {
 
 //=============================================================================
-// Class implements a Kalman filter.
+// Class implements a Kalman filter. The type T defines the storage precision
+// of the dense covariance matrix and the model matrix decomposition (see
+// KalmanFilter and KalmanFilterF below), the state and the accumulation of
+// products are always in double precision.
 //=============================================================================
-class KalmanFilter
+template<typename T>
+class BasicKalmanFilter
 {
 private:
-    Cholesky        m_chol;     // Cholesky decomposition solver
-    LUdecomposition m_lu;       // LU decomposition solver
+    Cholesky                m_chol; // Cholesky decomposition solver
+    BasicLUdecomposition<T> m_lu;   // LU decomposition solver
 
     Vector m_x_tmp;     // placeholder for the vector x_{k|k-1} = A*x
     Vector m_y;         // placeholder vector of observations
     Vector m_invSy;     // placeholder vector for S^{-1}*y
     Matrix m_S;         // placeholder for the matrix S = H*P_{k|k-1}*H^t + R
-    Matrix m_P_tmp;     // placeholder for the matrix P_{k|k-1}
+    BasicMatrix<T> m_P_tmp; // placeholder for the matrix P_{k|k-1}
     Matrix m_PHt;       // placeholder for the matrix P_{k|k-1}*H^t
     Matrix m_HP;        // placeholder for the matrix H*P_{k|k-1}
     Matrix m_invSHP;    // placeholder for the matrix S^{-1}*H*P_{k|k-1}
 
+    Vector m_a;         // placeholder for S^t*h of square-root filter
+    Vector m_b;         // placeholder for S*S^t*h of square-root filter
+
+    LocalInverseOperator m_inv;     // applies B^{-1} to localised covariance
+    LocalCovariance      m_Ploc_tmp;// placeholder for localised P_{k|k-1}
+    std::vector<index_t> m_obs_idx; // observed points picked up by H
+
 public:
 //-----------------------------------------------------------------------------
 // Constructor initializes all vector/matrix variables by zeros.
 //-----------------------------------------------------------------------------
-KalmanFilter()
+BasicKalmanFilter()
 {
 }
 
 //-----------------------------------------------------------------------------
 // Prints this object.
 //-----------------------------------------------------------------------------
-friend std::ostream& operator<<(std::ostream & out, const KalmanFilter & kf) {
+friend std::ostream& operator<<(std::ostream & out,
+                                const BasicKalmanFilter & kf) {
 	out << "KalmanFilter: [ ";
 	out << kf.m_chol << ", ";
 	out << kf.m_lu << ", ";
@@ -48,10 +60,55 @@ friend std::ostream& operator<<(std::ostream & out, const KalmanFilter & kf) {
 	out << kf.m_PHt << ", ";
 	out << kf.m_HP << ", ";
 	out << kf.m_invSHP << ", ";
+	out << kf.m_a << ", ";
+	out << kf.m_b << ", ";
+	out << kf.m_Ploc_tmp << ", ";
 	out << " ]" << std::endl;
 	return out;
 }
 
+//-----------------------------------------------------------------------------
+// Function places the temporary objects in the memory arena for the problem
+// size N and O observations. The LU decomposition of model matrix is only
+// needed by the dense covariance (dense_covar), including the square-root
+// filter (sqrt_covar), which updates its factor in place and needs just
+// a couple of vectors besides. The localised covariance keeps its own compact
+// objects outside the arena (see Bytes()).
+//-----------------------------------------------------------------------------
+void Place(Arena & arena, index_t N, index_t O,
+           bool dense_covar = true, bool sqrt_covar = false)
+{
+    if (dense_covar || sqrt_covar) {
+        m_lu.Place(arena, N);
+    }
+    arena.Place(m_x_tmp, N);
+    if (sqrt_covar) {
+        arena.Place(m_a, N);
+        arena.Place(m_b, N);
+        return;
+    }
+    m_chol.Place(arena, O);
+    arena.Place(m_y, O);
+    arena.Place(m_invSy, O);
+    arena.Place(m_S, O, O);
+    arena.Place(m_PHt, N, O);
+    arena.Place(m_HP, O, N);
+    arena.Place(m_invSHP, O, N);
+    if (dense_covar) {
+        arena.Place(m_P_tmp, N, N);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function returns the number of bytes occupied by the objects of localised
+// covariance, which are not placed in the arena.
+//-----------------------------------------------------------------------------
+size_t Bytes() const
+{
+    return m_inv.Bytes() + m_Ploc_tmp.Bytes() +
+           m_obs_idx.capacity() * sizeof(index_t);
+}
+
 //-----------------------------------------------------------------------------
 // Function propagates state and covariance one timestep ahead and obtains
 // prior estimations: x_prior = A*x, P_prior = A*P*A^t + Q, where A is
@@ -61,13 +118,13 @@ friend std::ostream& operator<<(std::ostream & out, const KalmanFilter & kf) {
 // @param  B  inverse model matrix: B = A^{-1}.
 // @param  Q  process noise covariance.
 //-----------------------------------------------------------------------------
-void PropagateStateInverse(Vector & x, Matrix & P,
+void PropagateStateInverse(Vector & x, BasicMatrix<T> & P,
                            const Matrix & B, const Matrix & Q)
 {
     assert_decl(const index_t N = x.Size());     // problem size
 
     assert_true((P.NRows() == N) && (P.NCols() == N));
-    assert_true(B.SameSize(P) && Q.SameSize(P));
+    assert_true(B.SameSize(Q) && (B.NRows() == N) && (B.NCols() == N));
 
     m_x_tmp = x;                    // copy state and covariance into
     m_P_tmp = P;                    // the separate temporary objects
@@ -93,7 +150,7 @@ void PropagateStateInverse(Vector & x, Matrix & P,
 // @param  R  measurement noise (v) covariance.
 // @param  z  vector of observations.
 //-----------------------------------------------------------------------------
-void SolveFilter(Vector & x, Matrix & P,
+void SolveFilter(Vector & x, BasicMatrix<T> & P,
                  const Matrix & H, const Matrix & R, const Vector & z)
 {
     const index_t N = x.Size();     // problem size
@@ -151,6 +208,241 @@ void SolveFilter(Vector & x, Matrix & P,
     Symmetrize(P);
 }
 
-}; // class KalmanFilter
+//-----------------------------------------------------------------------------
+// Square-root version of PropagateStateInverse(): the covariance is given by
+// its factor S, P = S*S^t. Then P_prior = (A*S)*(A*S)^t + Q, the product A*S
+// is computed in place column by column and re-triangularized by LQ
+// decomposition, then the diagonal Q is added by N rank-one updates of
+// the triangular factor (see CholeskyUpdate()). No N-by-N object is used
+// besides S itself, positive semi-definiteness and symmetry of P are
+// preserved by construction.
+// @param  x  in: current state; out: prior state estimation.
+// @param  S  in: current covariance factor;
+//            out: prior lower triangular covariance factor.
+// @param  B  inverse model matrix: B = A^{-1}.
+// @param  q  diagonal of the (diagonal) process noise covariance Q.
+//-----------------------------------------------------------------------------
+void PropagateStateInverseSqrt(Vector & x, Matrix & S,
+                               const Matrix & B, const Vector & q)
+{
+    const index_t N = x.Size();     // problem size
+
+    assert_true((S.NRows() == N) && (S.NCols() == N));
+    assert_true(B.SameSize(S) && (q.Size() == N));
+
+    m_x_tmp = x;                    // copy state into temporary object
+    m_a.Resize(N, false);
+    m_b.Resize(N, false);
+
+    m_lu.Init(B);                   // decompose: B = L*U
+    m_lu.Solve(x, m_x_tmp);         // x_prior = B^{-1}*x
+    for (index_t c = 0; c < N; ++c) {
+        for (index_t r = 0; r < N; ++r) { m_a(r) = S(r,c); }
+        m_lu.Solve(m_b, m_a);       // column of A*S = B^{-1}*S
+        for (index_t r = 0; r < N; ++r) { S(r,c) = m_b(r); }
+    }
+    LowerTriangularize(S);          // S*S^t = (A*S)*(A*S)^t
+
+    for (index_t j = 0; j < N; ++j) {
+        Fill(m_a, 0.0);
+        m_a(j) = std::sqrt(q(j));   // S*S^t += q(j) * e_j * e_j^t
+        CholeskyUpdate(S, m_a);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Square-root version of SolveFilter(). The observations are uncorrelated
+// (R is diagonal), so they are assimilated one by one (Potter's algorithm):
+// given a = S^t*h for an observation row h and the innovation variance
+// s = a^t*a + r, the state is updated as x = x + S*a*(z - h*x)/s and
+// the factor as S = S - g*S*a*a^t/s, where g = 1/(1 + sqrt(r/s)), so that
+// S*S^t = P - P*h^t*h*P/s. The cost is O(N^2) per observation instead of
+// re-factorization of the whole pre-array, and the factor is updated
+// in place. Note, the updated factor is not triangular any longer.
+// @param  x  in: prior state estimation; out: posterior state estimation.
+// @param  S  in: prior covariance factor; out: posterior covariance factor.
+// @param  H  observation model: z = H*x + v.
+// @param  R  diagonal measurement noise (v) covariance.
+// @param  z  vector of observations.
+//-----------------------------------------------------------------------------
+void SolveFilterSqrt(Vector & x, Matrix & S,
+                     const Matrix & H, const Matrix & R, const Vector & z)
+{
+    const index_t N = x.Size();     // problem size
+    const index_t O = z.Size();     // number of observations
+
+    assert_true((S.NRows() == N) && (S.NCols() == N));
+    assert_true((H.NRows() == O) && (H.NCols() == N));
+    assert_true((R.NRows() == O) && (R.NCols() == O));
+    for (index_t o = 0; o < O; ++o) {
+    for (index_t p = 0; p < O; ++p) {
+        assert_true((o == p) || (R(o,p) == 0.0))
+                << "square-root filter expects uncorrelated observations";
+    }}
+
+    m_a.Resize(N, false);
+    m_b.Resize(N, false);
+
+    for (index_t o = 0; o < O; ++o) {
+        // a = S^t*h and the innovation y = z - h*x over the non-zeros of h.
+        double y = z(o);
+        Fill(m_a, 0.0);
+        for (index_t i = 0; i < N; ++i) {
+            const double h = H(o,i);
+            if (h == 0.0) continue;
+            y -= h * x(i);
+            for (index_t k = 0; k < N; ++k) { m_a(k) += h * S(i,k); }
+        }
+
+        // s = a^t*a + r, b = S*a = P*h^t.
+        const double r = R(o,o);
+        double s = r;
+        for (index_t k = 0; k < N; ++k) { s += m_a(k) * m_a(k); }
+        assert_true(s > 0.0) << "non-positive innovation variance";
+        MatVecMult(m_b, S, m_a);
+
+        // x = x + b*y/s, S = S - g*b*a^t/s.
+        const double g = 1.0 / (1.0 + std::sqrt(r / s));
+        for (index_t i = 0; i < N; ++i) {
+            x(i) += m_b(i) * (y / s);
+            const double f = g * m_b(i) / s;
+            for (index_t k = 0; k < N; ++k) { S(i,k) -= f * m_a(k); }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function propagates state and localised covariance one timestep ahead:
+// x_prior = A*x, P_prior = taper(A*P*A^t + Q), where A = B^{-1}. Unlike the
+// dense version, the inverse model matrix B is given by its stencil and the
+// covariance is only computed within its support (see LocalInverseOperator),
+// so no N-by-N object is ever formed. The taper is applied here once per
+// time step, SolveFilter() keeps the support as is.
+// @param  x  in: current state; out: prior state estimation.
+// @param  P  in: current covariance; out: prior state covariance estimation.
+// @param  B  stencil of inverse model matrix B = A^{-1} at the internal
+//            points, the border points are passed through.
+// @param  Q  process noise covariance of the same or smaller support.
+//-----------------------------------------------------------------------------
+void PropagateStateInverse(Vector & x, LocalCovariance & P,
+                           const ModelStencil & B, const LocalCovariance & Q)
+{
+    const index_t N = x.Size();     // problem size
+
+    assert_true(P.Size() == N && Q.Size() == N);
+
+    m_inv.Init(B, P.SizeX(), P.SizeY());
+    m_inv.Solve(x);                 // x_prior = B^{-1}*x
+    m_inv.Apply(m_Ploc_tmp, P);     // P_tmp = B^{-1}*P
+    P.Transpose(m_Ploc_tmp);        // P = (B^{-1}*P)^t, where P symmetric
+    m_inv.Apply(m_Ploc_tmp, P);     // P_tmp = B^{-1}*(B^{-1}*P)^t
+    std::swap(P, m_Ploc_tmp);       // P_prior = A*P*A^t
+
+    P.Add(Q);                       // P_prior = A*P*A^t + Q
+    P.Symmetrize();                 // correct the loss of symmetry
+    P.Taper();                      // keep the covariance localised
+}
+
+//-----------------------------------------------------------------------------
+// Function makes an iteration of Kalman filter given already estimated
+// (prior) state and its localised covariance. The observation model H is
+// expected to pick up the state at sensor locations (one unit entry per
+// row), so P*H^t is just a few columns of P and the posterior covariance is
+// only updated within its support. The update only shrinks the covariance,
+// so it is not tapered again (see PropagateStateInverse()).
+// @param  x  in: prior state estimation;
+//            out: posterior state estimation.
+// @param  P  in: prior state covariance estimation;
+//            out: posterior state covariance estimation.
+// @param  H  observation model: z = H*x + v.
+// @param  R  measurement noise (v) covariance.
+// @param  z  vector of observations.
+//-----------------------------------------------------------------------------
+void SolveFilter(Vector & x, LocalCovariance & P,
+                 const Matrix & H, const Matrix & R, const Vector & z)
+{
+    const index_t N = x.Size();     // problem size
+    const index_t O = z.Size();     // number of observations
+    const index_t K = P.NumEntries();
+
+    assert_true(P.Size() == N);
+    assert_true((H.NRows() == O) && (H.NCols() == N));
+    assert_true((R.NRows() == O) && (R.NCols() == O));
+
+    // Resize temporary buffer without initialization.
+    m_y.Resize(O, false);
+    m_invSy.Resize(O, false);
+    m_S.Resize(O, O, false);
+    m_PHt.Resize(N, O);
+    m_HP.Resize(O, N, false);
+    m_invSHP.Resize(O, N, false);
+
+    // Points observed by H.
+    m_obs_idx.resize(static_cast<size_t>(O));
+    for (index_t o = 0; o < O; ++o) {
+        index_t c = 0;
+        while ((c < N) && (H(o,c) == 0.0)) ++c;
+        assert_true((c < N) && (H(o,c) == 1.0))
+                << "observation matrix must pick up the state points";
+        m_obs_idx[static_cast<size_t>(o)] = c;
+    }
+
+    // y = z - H*x_prior
+    for (index_t o = 0; o < O; ++o) {
+        m_y(o) = z(o) - x(m_obs_idx[static_cast<size_t>(o)]);
+    }
+
+    // P_prior*H^t = columns of P_prior at observed points (P is symmetric).
+    for (index_t o = 0; o < O; ++o) {
+        const index_t s = m_obs_idx[static_cast<size_t>(o)];
+        for (index_t k = 0; k < K; ++k) {
+            const index_t j = P.Neighbour(s, k);
+            if (j >= 0) m_PHt(j,o) = P(s,k);
+        }
+    }
+
+    // S = H*P_prior*H^t + R
+    for (index_t o = 0; o < O; ++o) {
+    for (index_t p = 0; p < O; ++p) {
+        m_S(o,p) = m_PHt(m_obs_idx[static_cast<size_t>(o)], p) + R(o,p);
+    }}
+
+    // Correct symmetry loss due to round-off errors.
+    Symmetrize(m_S);
+
+    // Compute Cholesky decomposition S = L*L^t to facilitate matrix inversion.
+    m_chol.Init(m_S);
+
+    // m_invSy = S^{-1}*y
+    m_chol.Solve(m_invSy, m_y);
+
+    // x = x_prior + K*y = x_prior + P_prior*H^t*S^{-1}*y
+    m_x_tmp = x;
+    MatVecMult(x, m_PHt, m_invSy);
+    AddVectors(x, x, m_x_tmp);
+
+    // m_invSHP = S^{-1}*H*P_prior
+    GetTransposed(m_HP, m_PHt);
+    m_chol.BatchSolve(m_invSHP, m_HP);
+
+    // P = P_prior - P_prior*H^t*S^{-1}*H*P_prior within the support.
+    for (index_t i = 0; i < N; ++i) {
+        for (index_t k = 0; k < K; ++k) {
+            const index_t j = P.Neighbour(i, k);
+            if (j < 0) continue;
+            double sum = 0.0;
+            for (index_t o = 0; o < O; ++o) sum += m_PHt(i,o) * m_invSHP(o,j);
+            P(i,k) -= sum;
+        }
+    }
+
+    // Correct symmetry loss due to round-off errors.
+    P.Symmetrize();
+}
+
+}; // class BasicKalmanFilter
+
+using KalmanFilter  = BasicKalmanFilter<double>;
+using KalmanFilterF = BasicKalmanFilter<float>;
 
 } // namespace amdados
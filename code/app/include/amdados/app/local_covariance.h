@@ -0,0 +1,421 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace amdados {
+
+//=============================================================================
+// Class represents a localised (compact support) covariance matrix of a 2D
+// field of size nx-by-ny laid out in row-major order, i.e. the point (x,y)
+// has the flat index x*ny + y ('y' is faster than 'x'), same as an extended
+// subdomain. Only the covariances between the points separated by at most
+// R nodes along either axis are stored: the row i keeps K = (2R+1)^2 entries
+// corresponding to the offsets (dx,dy), |dx|,|dy| <= R; entries that point
+// outside the field are zeros. Memory and the cost of all operations below
+// are O(N*K) for N = nx*ny points instead of O(N^2) or O(N^3) for a dense
+// matrix. The Gaspari-Cohn taper, which decays smoothly to zero at distance
+// R+1, is reapplied after every update to keep the covariance localised.
+//=============================================================================
+class LocalCovariance
+{
+private:
+    index_t             m_nx;       // field size in x-dimension
+    index_t             m_ny;       // field size in y-dimension
+    index_t             m_R;        // radius of the support (in nodes)
+    index_t             m_K;        // number of entries per row: (2R+1)^2
+    std::vector<double> m_data;     // N-by-K entries
+    std::vector<double> m_taper;    // taper weights per offset
+
+    // Functions convert the offset index into the offsets along the axes.
+    index_t OffsetX(index_t k) const { return k / (2*m_R + 1) - m_R; }
+    index_t OffsetY(index_t k) const { return k % (2*m_R + 1) - m_R; }
+
+    // Function returns the offset index of the opposite offset (-dx,-dy).
+    index_t Opposite(index_t k) const { return m_K - 1 - k; }
+
+public:
+//-----------------------------------------------------------------------------
+// Constructor.
+//-----------------------------------------------------------------------------
+LocalCovariance()
+    : m_nx(0), m_ny(0), m_R(0), m_K(0), m_data(), m_taper()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Prints this object.
+//-----------------------------------------------------------------------------
+friend std::ostream & operator<<(std::ostream & out,
+                                 const LocalCovariance & c) {
+    out << "LocalCovariance: [ " << c.m_nx << ", " << c.m_ny << ", "
+        << c.m_R << " ]" << std::endl;
+    return out;
+}
+
+//-----------------------------------------------------------------------------
+// Function allocates zero covariance of nx-by-ny field with given radius
+// of support. Radius 0 gives a diagonal matrix.
+//-----------------------------------------------------------------------------
+void Init(index_t nx, index_t ny, index_t radius)
+{
+    assert_true((nx > 0) && (ny > 0) && (radius >= 0));
+    m_nx = nx;
+    m_ny = ny;
+    m_R = radius;
+    m_K = (2*radius + 1) * (2*radius + 1);
+    m_data.assign(static_cast<size_t>(nx * ny * m_K), 0.0);
+
+    // Gaspari-Cohn function (5th order piecewise rational) of half-width c,
+    // which vanishes at distance 2c = R+1 and beyond.
+    const double c = 0.5 * static_cast<double>(radius + 1);
+    m_taper.resize(static_cast<size_t>(m_K));
+    for (index_t k = 0; k < m_K; ++k) {
+        const double dx = static_cast<double>(OffsetX(k));
+        const double dy = static_cast<double>(OffsetY(k));
+        const double z = std::sqrt(dx*dx + dy*dy) / c;
+        double w = 0.0;
+        if (z <= 1.0) {
+            w = (((-0.25*z + 0.5)*z + 0.625)*z - 5.0/3.0)*z*z + 1.0;
+        } else if (z < 2.0) {
+            w = ((((z/12.0 - 0.5)*z + 0.625)*z + 5.0/3.0)*z - 5.0)*z + 4.0
+                - 2.0/(3.0*z);
+        }
+        m_taper[static_cast<size_t>(k)] = std::max(w, 0.0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Accessors.
+//-----------------------------------------------------------------------------
+index_t Size() const { return m_nx * m_ny; }
+index_t SizeX() const { return m_nx; }
+index_t SizeY() const { return m_ny; }
+index_t Radius() const { return m_R; }
+index_t NumEntries() const { return m_K; }
+bool Empty() const { return m_data.empty(); }
+
+// Function returns the number of bytes occupied by the entries.
+size_t Bytes() const { return m_data.size() * sizeof(double); }
+
+// Entry of the row i at the offset index k.
+double & operator()(index_t i, index_t k) {
+    return m_data[static_cast<size_t>(i * m_K + k)];
+}
+const double & operator()(index_t i, index_t k) const {
+    return m_data[static_cast<size_t>(i * m_K + k)];
+}
+
+// Diagonal entry of the row i.
+double & Diag(index_t i) { return (*this)(i, m_K / 2); }
+const double & Diag(index_t i) const { return (*this)(i, m_K / 2); }
+
+//-----------------------------------------------------------------------------
+// Function returns the flat index of the point at the offset index k from
+// the point i, or -1 if that point is outside the field.
+//-----------------------------------------------------------------------------
+index_t Neighbour(index_t i, index_t k) const
+{
+    const index_t x = i / m_ny + OffsetX(k);
+    const index_t y = i % m_ny + OffsetY(k);
+    return ((0 <= x) && (x < m_nx) && (0 <= y) && (y < m_ny)) ?
+            (x * m_ny + y) : -1;
+}
+
+//-----------------------------------------------------------------------------
+// Function returns the offset index of the point j relative to the point i,
+// or -1 if the points are too far apart.
+//-----------------------------------------------------------------------------
+index_t OffsetIndex(index_t i, index_t j) const
+{
+    const index_t dx = j / m_ny - i / m_ny;
+    const index_t dy = j % m_ny - i % m_ny;
+    if ((std::abs(dx) > m_R) || (std::abs(dy) > m_R)) return -1;
+    return (dx + m_R) * (2*m_R + 1) + (dy + m_R);
+}
+
+//-----------------------------------------------------------------------------
+// Function returns the covariance between the points i and j.
+//-----------------------------------------------------------------------------
+double Get(index_t i, index_t j) const
+{
+    const index_t k = OffsetIndex(i, j);
+    return (k >= 0) ? (*this)(i, k) : 0.0;
+}
+
+//-----------------------------------------------------------------------------
+// Function sets all the entries to zero.
+//-----------------------------------------------------------------------------
+void Zero()
+{
+    std::fill(m_data.begin(), m_data.end(), 0.0);
+}
+
+//-----------------------------------------------------------------------------
+// Function computes: this = A^t, where A has the same layout as this one.
+//-----------------------------------------------------------------------------
+void Transpose(const LocalCovariance & A)
+{
+    assert_true((A.m_nx == m_nx) && (A.m_ny == m_ny) && (A.m_R == m_R));
+    assert_true(&A != this);
+    const index_t N = Size();
+    for (index_t i = 0; i < N; ++i) {
+    for (index_t k = 0; k < m_K; ++k) {
+        const index_t j = Neighbour(i, k);
+        (*this)(i,k) = (j >= 0) ? A(j, Opposite(k)) : 0.0;
+    }}
+}
+
+//-----------------------------------------------------------------------------
+// Function adds another covariance of the same or smaller radius of support,
+// e.g. a diagonal (radius 0) process noise covariance.
+//-----------------------------------------------------------------------------
+void Add(const LocalCovariance & Q)
+{
+    assert_true((Q.m_nx == m_nx) && (Q.m_ny == m_ny) && (Q.m_R <= m_R));
+    const index_t N = Size();
+    for (index_t i = 0; i < N; ++i) {
+    for (index_t k = 0; k < Q.m_K; ++k) {
+        const index_t j = Q.Neighbour(i, k);
+        if (j >= 0) (*this)(i, OffsetIndex(i, j)) += Q(i, k);
+    }}
+}
+
+//-----------------------------------------------------------------------------
+// Function corrects the loss of symmetry: P = (P + P^t)/2.
+//-----------------------------------------------------------------------------
+void Symmetrize()
+{
+    const index_t N = Size();
+    for (index_t i = 0; i < N; ++i) {
+    for (index_t k = 0; k < m_K / 2; ++k) {     // each pair is visited once
+        const index_t j = Neighbour(i, k);
+        if (j >= 0) {
+            double & a = (*this)(i, k);
+            double & b = (*this)(j, Opposite(k));
+            a = b = 0.5 * (a + b);
+        }
+    }}
+}
+
+//-----------------------------------------------------------------------------
+// Function applies the taper (Schur product with the Gaspari-Cohn
+// correlation function) to keep the covariance localised.
+//-----------------------------------------------------------------------------
+void Taper()
+{
+    const index_t N = Size();
+    for (index_t i = 0; i < N; ++i) {
+        double * row = &(*this)(i, 0);
+        for (index_t k = 0; k < m_K; ++k) {
+            row[k] *= m_taper[static_cast<size_t>(k)];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Functions convert to and from a dense matrix, the latter one drops
+// the entries outside the support.
+//-----------------------------------------------------------------------------
+void ToDense(Matrix & A) const
+{
+    const index_t N = Size();
+    A.Resize(N, N);
+    for (index_t i = 0; i < N; ++i) {
+    for (index_t k = 0; k < m_K; ++k) {
+        const index_t j = Neighbour(i, k);
+        if (j >= 0) A(i,j) = (*this)(i,k);
+    }}
+}
+
+void FromDense(const Matrix & A)
+{
+    const index_t N = Size();
+    assert_true((A.NRows() == N) && (A.NCols() == N));
+    for (index_t i = 0; i < N; ++i) {
+    for (index_t k = 0; k < m_K; ++k) {
+        const index_t j = Neighbour(i, k);
+        (*this)(i,k) = (j >= 0) ? A(i,j) : 0.0;
+    }}
+}
+
+}; // class LocalCovariance
+
+//=============================================================================
+// Class applies the inverse A = B^{-1} of the inverse model matrix B given by
+// its 5-point stencil (see ModelStencil) at the internal points of nx-by-ny
+// field, where the border values are passed through, to a localised
+// covariance matrix and to the state. B is never formed densely: the state
+// is solved by the band LU decomposition (see StencilSolver), and the
+// covariance by Jacobi-preconditioned Neumann series:
+// B = D + O, A = (I + D^{-1}*O)^{-1} * D^{-1} = sum_k (-D^{-1}*O)^k * D^{-1},
+// which converges when B is strictly diagonally dominant. Contributions
+// outside the support of the covariance are dropped after each term.
+// Otherwise, the covariance is solved column by column by the band LU
+// decomposition, and the columns are truncated to the support likewise.
+//=============================================================================
+class LocalInverseOperator
+{
+private:
+    index_t         m_nx, m_ny; // field sizes
+    ModelStencil    m_stencil;  // stencil of B at the internal points
+    bool            m_dominant; // B is strictly diagonally dominant
+    StencilSolver   m_solver;   // band LU decomposition of B
+    Matrix          m_column;   // column of covariance as nx-by-ny field
+    LocalCovariance m_term;     // current term of Neumann series
+    LocalCovariance m_next;     // next term of Neumann series
+
+    // Function returns "true" if the point i is an internal one.
+    bool Internal(index_t i) const {
+        const index_t x = i / m_ny, y = i % m_ny;
+        return (0 < x) && (x + 1 < m_nx) && (0 < y) && (y + 1 < m_ny);
+    }
+
+public:
+//-----------------------------------------------------------------------------
+// Constructor.
+//-----------------------------------------------------------------------------
+LocalInverseOperator()
+    : m_nx(0), m_ny(0), m_stencil(), m_dominant(false)
+    , m_solver(), m_column(), m_term(), m_next()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Function returns the number of bytes occupied by this object.
+//-----------------------------------------------------------------------------
+size_t Bytes() const
+{
+    return m_solver.Bytes() +
+           static_cast<size_t>(m_column.Size()) * sizeof(double) +
+           m_term.Bytes() + m_next.Bytes();
+}
+
+//-----------------------------------------------------------------------------
+// Function sets up the operator given the stencil of B at the internal points
+// of nx-by-ny field and returns "true" if B is strictly diagonally dominant,
+// so the Neumann series converges.
+//-----------------------------------------------------------------------------
+bool Init(const ModelStencil & stencil, index_t nx, index_t ny)
+{
+    assert_true((nx > 2) && (ny > 2));
+    m_nx = nx;
+    m_ny = ny;
+    m_stencil = stencil;
+    m_dominant = (std::fabs(stencil.xm) + std::fabs(stencil.xp) +
+                  std::fabs(stencil.ym) + std::fabs(stencil.yp) <
+                  std::fabs(stencil.centre));
+    m_solver.Init(stencil, nx - 2, ny - 2);
+    m_column.Resize(nx, ny, false);
+    return m_dominant;
+}
+
+//-----------------------------------------------------------------------------
+// Function computes: x = B^{-1} * x, where x is the nx*ny state vector.
+//-----------------------------------------------------------------------------
+void Solve(Vector & x)
+{
+    assert_true(x.Size() == m_nx * m_ny);
+    std::copy(x.begin(), x.end(), m_column.begin());
+    m_solver.Solve(m_column, m_column);
+    std::copy(m_column.begin(), m_column.end(), x.begin());
+}
+
+//-----------------------------------------------------------------------------
+// Function computes: Y = B^{-1} * X, where X and Y are localised matrices
+// of the same layout.
+//-----------------------------------------------------------------------------
+void Apply(LocalCovariance & Y, const LocalCovariance & X,
+           double rel_tol = 1e-12, int max_iter = 100)
+{
+    assert_true(X.Size() == m_nx * m_ny);
+    if (m_dominant) {
+        ApplySeries(Y, X, rel_tol, max_iter);
+    } else {
+        ApplyByColumns(Y, X);
+    }
+}
+
+private:
+//-----------------------------------------------------------------------------
+// Function computes Y = B^{-1} * X by the Neumann series. Iterations stop
+// when the next term becomes negligible.
+//-----------------------------------------------------------------------------
+void ApplySeries(LocalCovariance & Y, const LocalCovariance & X,
+                 double rel_tol, int max_iter)
+{
+    const index_t N = X.Size();
+    const index_t K = X.NumEntries();
+    const ModelStencil & s = m_stencil;
+
+    // The border rows of B are the identity ones, so D^{-1} is one there.
+    m_term = X;
+    m_next = X;
+    double norm_Y = 0.0;
+    for (index_t i = 0; i < N; ++i) {           // Y = term = D^{-1} * X
+        const double d = Internal(i) ? (1.0 / s.centre) : 1.0;
+        for (index_t k = 0; k < K; ++k) {
+            m_term(i,k) *= d;
+            norm_Y = std::max(norm_Y, std::fabs(m_term(i,k)));
+        }
+    }
+    Y = m_term;
+
+    const index_t offset[4] = { -m_ny, +m_ny, -1, +1 };
+    const double  coef[4] = { s.xm, s.xp, s.ym, s.yp };
+    for (int iter = 0; iter < max_iter; ++iter) {
+        // next = -D^{-1} * O * term, restricted to the support.
+        double norm_next = 0.0;
+        for (index_t i = 0; i < N; ++i) {
+            const bool internal = Internal(i);
+            for (index_t k = 0; k < K; ++k) {
+                const index_t j = X.Neighbour(i, k);
+                double sum = 0.0;
+                if (internal && (j >= 0)) {
+                    for (int m = 0; m < 4; ++m) {
+                        const index_t n = i + offset[m];
+                        const index_t kn = X.OffsetIndex(n, j);
+                        if (kn >= 0) sum += coef[m] * m_term(n, kn);
+                    }
+                }
+                m_next(i,k) = - sum / s.centre;
+                norm_next = std::max(norm_next, std::fabs(m_next(i,k)));
+            }
+        }
+        std::swap(m_term, m_next);
+        for (index_t i = 0; i < N; ++i) {
+        for (index_t k = 0; k < K; ++k) { Y(i,k) += m_term(i,k); }}
+        if (norm_next <= rel_tol * norm_Y) break;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function computes Y = B^{-1} * X column by column, each column within
+// the support of X is solved by the band LU decomposition.
+//-----------------------------------------------------------------------------
+void ApplyByColumns(LocalCovariance & Y, const LocalCovariance & X)
+{
+    const index_t N = X.Size();
+    const index_t K = X.NumEntries();
+    Y = X;
+    for (index_t j = 0; j < N; ++j) {
+        // X(i,j) = X(i, offset of j from i), where i is the neighbour
+        // of j at offset k, i.e. j is at the opposite offset from i.
+        Fill(m_column, 0.0);
+        for (index_t k = 0; k < K; ++k) {
+            const index_t i = X.Neighbour(j, k);
+            if (i >= 0) m_column(i / m_ny, i % m_ny) = X(i, K - 1 - k);
+        }
+        m_solver.Solve(m_column, m_column);
+        for (index_t k = 0; k < K; ++k) {
+            const index_t i = Y.Neighbour(j, k);
+            if (i >= 0) Y(i, K - 1 - k) = m_column(i / m_ny, i % m_ny);
+        }
+    }
+}
+
+}; // class LocalInverseOperator
+
+} // namespace amdados
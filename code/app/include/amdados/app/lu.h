@@ -11,23 +11,32 @@ namespace amdados {
 // Class for computing LU decomposition of a non-singular matrix. Once
 // decomposition is done in Init() function, the class instance can be used
 // to solve linear systems A*x = b and A*X = B, where x, b are vectors and X,
-// B are matrices respectively.
+// B are matrices respectively. The decomposition is always computed in double
+// precision and then stored in type T (see LUdecomposition and
+// LUdecompositionF below); the solvers accumulate in double.
 //=============================================================================
-class LUdecomposition
+template<typename T>
+class BasicLUdecomposition
 {
 private:
-    Matrix               m_LU;   // lower/upper triangular matrices of decomposition
+    BasicMatrix<T>       m_LU;   // lower/upper triangular matrices of decomposition
     std::vector<index_t> m_Perm; // row index permutation for partial pivoting
+    Matrix               m_work; // double-precision workspace if T != double
+
+    // Returns the matrix where decomposition is computed.
+    static Matrix & Workspace(Matrix & lu, Matrix &) { return lu; }
+    static Matrix & Workspace(MatrixF &, Matrix & work) { return work; }
 
 public:
 //-----------------------------------------------------------------------------
 // Constructor.
 //-----------------------------------------------------------------------------
-LUdecomposition() : m_LU(), m_Perm()
+BasicLUdecomposition() : m_LU(), m_Perm(), m_work()
 {
 }
 
-friend std::ostream& operator<<(std::ostream& out, const LUdecomposition& lud) {
+friend std::ostream& operator<<(std::ostream& out,
+                                const BasicLUdecomposition& lud) {
 	out << "LUdecomposition: [ ";
 	out << lud.m_LU;
 	for(const auto& e : lud.m_Perm) { out << ", " << e; }
@@ -35,6 +44,19 @@ friend std::ostream& operator<<(std::ostream& out, const LUdecomposition& lud) {
 	return out;
 }
 
+//-----------------------------------------------------------------------------
+// Function places the decomposition of a square matrix in the memory arena.
+// The capacity for a matrix of size up to N-by-N is reserved.
+//-----------------------------------------------------------------------------
+void Place(Arena & arena, index_t N)
+{
+    arena.Place(m_LU, N, N);
+    if (static_cast<void*>(&Workspace(m_LU, m_work)) !=
+        static_cast<void*>(&m_LU)) {
+        arena.Place(m_work, N, N);
+    }
+}
+
 //-----------------------------------------------------------------------------
 // Function computes and stores LU decomposition: M = L*U.
 // The decomposition P*M = L*U is based on so called partial pivoting of matrix
@@ -48,10 +70,10 @@ void Init(const Matrix & M)
     assert_true(M.IsSquare());
     const index_t N = M.NRows();	// problem size; M is square
 
-	m_LU = M;                  	// copy input matrix, then do decomposition
+	Matrix  & A = Workspace(m_LU, m_work);	// short-hand alias for LU
+	A = M;                     	// copy input matrix, then do decomposition
 	m_Perm.resize((size_t)N); 	// resize the permutation vector accordingly
 
-	auto    & A = m_LU;           	// short-hand alias for LU
 	index_t * P = m_Perm.data();    // short-hand alias for permutation
 
 	// There is no permutation at the beginning.
@@ -91,13 +113,19 @@ void Init(const Matrix & M)
             for (index_t k = i + 1; k < N; ++k) { A(Pj,k) -= Aji * A(Pi,k); }
         }
     }
+
+    // Store the decomposition in the target precision.
+    if (static_cast<void*>(&A) != static_cast<void*>(&m_LU)) {
+        Convert(m_LU, A);
+    }
 }
 
 //-----------------------------------------------------------------------------
 // Function solves a linear system A*x = b through the back-substitution, where
 // A is the matrix whose LU decomposition was computed by Init() function.
 //-----------------------------------------------------------------------------
-void Solve(Vector & x, const Vector & b) const
+template<typename U>
+void Solve(BasicVector<U> & x, const BasicVector<U> & b) const
 {
 	const auto    & A = m_LU;               // short-hand alias
 	const index_t * P = m_Perm.data();      // permutation
@@ -107,14 +135,16 @@ void Solve(Vector & x, const Vector & b) const
 
     for (index_t i = 0; i < N; ++i) {
         const index_t Pi = P[i];
-        x(i) = b(Pi);
-        for (index_t k = 0; k < i; ++k) { x(i) -= A(Pi,k) * x(k); }
+        double sum = b(Pi);
+        for (index_t k = 0; k < i; ++k) { sum -= A(Pi,k) * Wide(x(k)); }
+        x(i) = static_cast<U>(sum);
     }
 
     for (index_t i = N - 1; i >= 0; --i) {
         const index_t Pi = P[i];
-        for (index_t k = i + 1; k < N; ++k) { x(i) -= A(Pi,k) * x(k); }
-        x(i) /= A(Pi,i);
+        double sum = x(i);
+        for (index_t k = i + 1; k < N; ++k) { sum -= A(Pi,k) * Wide(x(k)); }
+        x(i) = static_cast<U>(sum / A(Pi,i));
     }
 }
 
@@ -123,26 +153,29 @@ void Solve(Vector & x, const Vector & b) const
 // matrix whose LU decomposition was computed by the Init() function,
 // X and B are the matrices of the same size.
 //-----------------------------------------------------------------------------
-void BatchSolve(Matrix & X, const Matrix & B) const
+template<typename U, typename V>
+void BatchSolve(BasicMatrix<U> & X, const BasicMatrix<V> & B) const
 {
     const auto    & A = m_LU;           // short-hand alias
     const index_t * P = m_Perm.data();  // permutation
     const index_t   N = A.NRows();      // problem size; A is square
     const index_t   K = X.NCols();      // number of linear systems to solve
 
-    assert_true((N == X.NRows()) && X.SameSize(B));
+    assert_true((N == X.NRows()) && (N == B.NRows()) && (K == B.NCols()));
 
     for (index_t c = 0; c < K; ++c) {
         for (index_t i = 0; i < N; ++i) {
             const index_t Pi = P[i];
-            X(i,c) = B(Pi,c);
-            for (index_t k = 0; k < i; ++k) { X(i,c) -= A(Pi,k) * X(k,c); }
+            double sum = B(Pi,c);
+            for (index_t k = 0; k < i; ++k) { sum -= A(Pi,k) * Wide(X(k,c)); }
+            X(i,c) = static_cast<U>(sum);
         }
 
         for (index_t i = N - 1; i >= 0; --i) {
             const index_t Pi = P[i];
-            for (index_t k = i + 1; k < N; ++k) { X(i,c) -= A(Pi,k) * X(k,c); }
-            X(i,c) /= A(Pi,i);
+            double sum = X(i,c);
+            for (index_t k = i + 1; k < N; ++k) { sum -= A(Pi,k) * Wide(X(k,c)); }
+            X(i,c) = static_cast<U>(sum / A(Pi,i));
         }
     }
 }
@@ -152,31 +185,47 @@ void BatchSolve(Matrix & X, const Matrix & B) const
 // right-hand size B^t, where A is the matrix whose LU decomposition was
 // computed by the Init() function, X and B are the matrices of the same size.
 //-----------------------------------------------------------------------------
-void BatchSolveTr(Matrix & X, const Matrix & Bt) const
+template<typename U, typename V>
+void BatchSolveTr(BasicMatrix<U> & X, const BasicMatrix<V> & Bt) const
 {
     const auto    & A = m_LU;           // short-hand alias
     const index_t * P = m_Perm.data();  // permutation
     const index_t   N = A.NRows();      // problem size; A is square
     const index_t   K = X.NCols();      // number of linear systems to solve
 
-    assert_true((N == X.NRows()) && X.SameSizeTr(Bt));
+    assert_true((N == X.NRows()) && (N == Bt.NCols()) && (K == Bt.NRows()));
 
     for (index_t c = 0; c < K; ++c) {
         for (index_t i = 0; i < N; ++i) {
             const index_t Pi = P[i];
-            X(i,c) = Bt(c,Pi);      // transposed B
-            for (index_t k = 0; k < i; ++k) { X(i,c) -= A(Pi,k) * X(k,c); }
+            double sum = Bt(c,Pi);      // transposed B
+            for (index_t k = 0; k < i; ++k) { sum -= A(Pi,k) * Wide(X(k,c)); }
+            X(i,c) = static_cast<U>(sum);
         }
 
         for (index_t i = N - 1; i >= 0; --i) {
             const index_t Pi = P[i];
-            for (index_t k = i + 1; k < N; ++k) { X(i,c) -= A(Pi,k) * X(k,c); }
-            X(i,c) /= A(Pi,i);
+            double sum = X(i,c);
+            for (index_t k = i + 1; k < N; ++k) { sum -= A(Pi,k) * Wide(X(k,c)); }
+            X(i,c) = static_cast<U>(sum / A(Pi,i));
         }
     }
 }
 
-}; // class LUdecomposition
+private:
+//-----------------------------------------------------------------------------
+// Promotes a value to double precision for accumulation.
+//-----------------------------------------------------------------------------
+template<typename U>
+static double Wide(U v)
+{
+    return static_cast<double>(v);
+}
+
+}; // class BasicLUdecomposition
+
+using LUdecomposition  = BasicLUdecomposition<double>;
+using LUdecompositionF = BasicLUdecomposition<float>;
 
 } // namespace amdados
 
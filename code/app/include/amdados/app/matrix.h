@@ -15,130 +15,196 @@ namespace amdados {
 using index_t = int64_t;
 
 //=============================================================================
-// Vector of double-precision floating-point values.
+// Vector of floating-point values. Normally, double-precision values are used
+// (see Vector), single-precision ones (see VectorF) serve for storage in
+// mixed-precision computations, where accumulation is still done in double.
 //=============================================================================
-class Vector
+template<typename T>
+class BasicVector
 {
 protected:
 	// Content of this vector, memory management done by STL.
-    std::vector<double> m_data;
+    // In the view mode (see View()) it is empty and unused.
+    std::vector<T> m_data;
+
+    T *     m_ptr;      // beginning of the content, owned or viewed one
+    index_t m_size;     // number of elements
+    index_t m_capacity; // capacity of external memory in the view mode
+    bool    m_view;     // true, if the content is external (view mode)
+
+    // Points to the owned content after it has been changed.
+    void Own() {
+        m_ptr = m_data.data();
+        m_size = static_cast<index_t>(m_data.size());
+        m_capacity = 0;
+        m_view = false;
+    }
 
 public:
+    // Type of vector entries.
+    using value_type = T;
+
 	// Default constructor.
-    Vector() : m_data() {}
+    BasicVector()
+        : m_data(), m_ptr(nullptr), m_size(0), m_capacity(0), m_view(false) {}
 
 	// Constructor, ensures data can fit size elements.
-	Vector(index_t size) : m_data(static_cast<size_t>(size)) {}
+	BasicVector(index_t size)
+        : m_data(static_cast<size_t>(size))
+        , m_ptr(nullptr), m_size(0), m_capacity(0), m_view(false) {
+        Own();
+    }
 
-	// Constructor.
-	Vector(const Vector &) = default;
+	// Copy constructor, the copy always owns its content.
+	BasicVector(const BasicVector & v)
+        : m_data(v.begin(), v.end())
+        , m_ptr(nullptr), m_size(0), m_capacity(0), m_view(false) {
+        Own();
+    }
 
-	// Move constructor.
-	Vector(Vector && other) {
+	// Move constructor, a view remains a view of the same memory.
+	BasicVector(BasicVector && other)
+        : m_data(), m_ptr(other.m_ptr), m_size(other.m_size)
+        , m_capacity(other.m_capacity), m_view(other.m_view) {
 		m_data.swap(other.m_data);
+        other.Own();
 	}
 
 	// Destructor.
-	~Vector() = default;
+	~BasicVector() = default;
 
     // Indexing operator provides read only access to vector elements.
 	// Using a call operator here for unified element access with
 	// multi-dimensional indices (e.g. (i,y)) in subclasses.
-	const double & operator()(index_t i) const {
+	const T & operator()(index_t i) const {
 #ifndef NDEBUG
-        if (!(static_cast<unsigned>(i) < static_cast<unsigned>(m_data.size())))
+        if (!(static_cast<size_t>(i) < static_cast<size_t>(m_size)))
             assert_true(0);
 #endif
-        return m_data[static_cast<size_t>(i)];
+        return m_ptr[i];
     }
 
     // Indexing operator provides read/write access to vector elements.
 	// Using a call operator here for unified element access with
 	// multi-dimensional indices (e.g. (i,y)) in subclasses.
-	double & operator()(index_t i) {
+	T & operator()(index_t i) {
 #ifndef NDEBUG
-        if (!(static_cast<unsigned>(i) < static_cast<unsigned>(m_data.size())))
+        if (!(static_cast<size_t>(i) < static_cast<size_t>(m_size)))
             assert_true(0);
 #endif
-        return m_data[static_cast<size_t>(i)];
+        return m_ptr[i];
     }
 
     // Functions for iterating the (constant) vector.
-    double * begin() { return &*m_data.begin(); }
-    double * end()   { return &*m_data.end();   }
+    T * begin() { return m_ptr; }
+    T * end()   { return m_ptr + m_size; }
 
-    const double * begin() const { return &*m_data.cbegin(); }
-    const double * end()   const { return &*m_data.cend();   }
+    const T * begin() const { return m_ptr; }
+    const T * end()   const { return m_ptr + m_size; }
 
     // Function returns the size of this vector (view).
-	index_t Size() const { return static_cast<index_t>(m_data.size()); }
+	index_t Size() const { return m_size; }
 
     // Function returns "true" if both vectors have the same length.
-	// TODO: Quite expensive operation, maybe replace with something faster.
-    bool SameSize(const Vector & v) const {
-        return (m_data.size() == v.m_data.size());
+    bool SameSize(const BasicVector & v) const {
+        return (m_size == v.m_size);
     }
 
     // Returns "true" if this vector-view refers to an empty object.
-    bool Empty() const { return (m_data.empty()); }
+    bool Empty() const { return (m_size == 0); }
 
-    // Returns "true" if "v" is not the same object as "*this".
-    bool IsDistinct(const Vector & v) const {
-        return (&m_data != &(v.m_data));
+    // Returns "true" if "v" is not the same object as "*this" and
+    // does not view the same memory.
+    bool IsDistinct(const BasicVector & v) const {
+        return ((this != &v) && (Empty() || (m_ptr != v.m_ptr)));
     }
 
-	// Deletes the content of this Vector.
+    // Returns "true" if the content is external (see View()).
+    bool IsView() const { return m_view; }
+
+    // Makes this object a non-owning view of external memory of "capacity"
+    // elements, the first "size" of them constitute the content. Any
+    // resizing within the capacity keeps the view, otherwise the object
+    // switches back to its own storage. Caller is responsible for the memory
+    // lifetime. The memory is used as is, no initialization is done.
+    void View(T * data, index_t size, index_t capacity) {
+        assert_true((data != nullptr) && (0 <= size) && (size <= capacity));
+        std::vector<T>().swap(m_data);
+        m_ptr = data;
+        m_size = size;
+        m_capacity = capacity;
+        m_view = true;
+    }
+
+	// Deletes the content of this Vector, a view detaches from the memory.
 	void Clear() {
 		m_data.clear();
+        Own();
 	}
 
 	// Resizes the content to fit the given size, optionally also clearing the content.
 	void Resize(index_t new_size, bool fillzero = true) {
+        if (m_view && (new_size <= m_capacity)) {
+            m_size = new_size;
+            if (fillzero) { std::fill(begin(), end(), T()); }
+            return;
+        }
+        if (m_view) {                   // switch to own storage
+            m_data.assign(begin(), end());
+        }
 		if (fillzero) { m_data.clear(); }
 		m_data.resize(static_cast<size_t>(new_size));
+        Own();
 	}
 
-	// Copy operator.
-	Vector & operator=(const Vector & vec) {
-		m_data = vec.m_data;
+	// Copy operator, a view remains a view if the content fits in.
+	BasicVector & operator=(const BasicVector & vec) {
+        if (this != &vec) {
+            Resize(vec.m_size, false);
+            std::copy(vec.begin(), vec.end(), begin());
+        }
 		return *this;
 	}
 
 	// Prints this vector. TODO: "beautify" the output.
-	friend std::ostream & operator<<(std::ostream & out, const Vector & v) {
+	friend std::ostream & operator<<(std::ostream & out,
+                                     const BasicVector & v) {
 		out << "Vector [ ";
 		out << "1x" << v.Size();
-		for(const auto & e : v.m_data) { out << ", " << e; }
+		for(const auto & e : v) { out << ", " << e; }
 		out << " ]" << std::endl;
 		return out;
 	}
 };
 
 //=============================================================================
-// Matrix of double-precision floating-point values.
+// Matrix of floating-point values (see Matrix and MatrixF below).
 // Note, the matrix is row-major (the column index is faster than the row one).
 // Note, implicit casting from matrix to vector is allowed.
 //=============================================================================
-class Matrix : public Vector
+template<typename T>
+class BasicMatrix : public BasicVector<T>
 {
+    using Vector = BasicVector<T>;      // short-hand alias of the base class
+
 private:
 	index_t m_nrows;    ///< number of rows
     index_t m_ncols;    ///< number of columns
 
 public:
     // Default constructor.
-    Matrix() : Vector(), m_nrows(0), m_ncols(0) { }
+    BasicMatrix() : Vector(), m_nrows(0), m_ncols(0) { }
 
     // Default constructor creates matrix filled by zeros.
-    Matrix(index_t numrows, index_t numcols)
+    BasicMatrix(index_t numrows, index_t numcols)
     : Vector(numrows*numcols), m_nrows(numrows), m_ncols(numcols) { }
 
     // Copy constructor. Note, user can copy a matrix but not a vector.
-    Matrix(const Matrix & mat)
+    BasicMatrix(const BasicMatrix & mat)
     : Vector(mat), m_nrows(mat.m_nrows), m_ncols(mat.m_ncols) { }
 
 	// Move constructor.
-	Matrix(Matrix && mat)
+	BasicMatrix(BasicMatrix && mat)
     : Vector(std::move(mat)), m_nrows(mat.m_nrows), m_ncols(mat.m_ncols)
 	{
 		mat.m_nrows = 0;
@@ -146,7 +212,7 @@ public:
 	}
 
 	// Destructor.
-	~Matrix() = default;
+	~BasicMatrix() = default;
 
 	// Deallocates and clears this object.
     void Clear()
@@ -165,7 +231,7 @@ public:
     }
 
     // Copy operator.
-    Matrix & operator=(const Matrix & mat)
+    BasicMatrix & operator=(const BasicMatrix & mat)
     {
 		Vector::operator=(mat);
 		m_nrows = mat.m_nrows;
@@ -176,7 +242,7 @@ public:
     // Indexing operator provides read only access to matrix element.
 	// Using a call operator here for unified element access with
 	// single-dimensional indices (e.g. (i)) in parent class.
-	const double & operator()(index_t r, index_t c) const
+	const T & operator()(index_t r, index_t c) const
     {
 #ifndef NDEBUG
         if (!((static_cast<unsigned>(r) < static_cast<unsigned>(m_nrows)) &&
@@ -189,7 +255,7 @@ public:
     // Indexing operator provides read/write access to matrix element.
 	// Using a call operator here for unified element access with
 	// single-dimensional indices (e.g. (i)) in parent class.
-	double & operator()(index_t r, index_t c)
+	T & operator()(index_t r, index_t c)
     {
 #ifndef NDEBUG
         if (!((static_cast<unsigned>(r) < static_cast<unsigned>(m_nrows)) &&
@@ -208,21 +274,36 @@ public:
 	// Returns the total number of elements of this matrix.
 	index_t Size() const { return m_nrows * m_ncols; }
 
+    // Makes this matrix a non-owning view of external memory, see the
+    // function BasicVector::View(). By default, capacity = numrows*numcols.
+    void View(T * data, index_t numrows, index_t numcols,
+              index_t capacity = -1)
+    {
+        Vector::View(data, numrows * numcols,
+                     (capacity < 0) ? (numrows * numcols) : capacity);
+        m_nrows = numrows;
+        m_ncols = numcols;
+    }
+
     // Swaps content of two matrices.
-    void swap(Matrix & x) {
+    void swap(BasicMatrix & x) {
         this->m_data.swap(x.m_data);
+        std::swap(this->m_ptr, x.m_ptr);
+        std::swap(this->m_size, x.m_size);
+        std::swap(this->m_capacity, x.m_capacity);
+        std::swap(this->m_view, x.m_view);
         std::swap(this->m_nrows, x.m_nrows);
         std::swap(this->m_ncols, x.m_ncols);
     }
 
     // Returns "true" for matrices with the same dimensions.
-    bool SameSize(const Matrix & mat) const {
+    bool SameSize(const BasicMatrix & mat) const {
         return ((m_nrows == mat.m_nrows) && (m_ncols == mat.m_ncols));
     }
 
     // Returns "true" if this matrix has the same number of rows and columns
     // as transposed(mat).
-    bool SameSizeTr(const Matrix & mat) const {
+    bool SameSizeTr(const BasicMatrix & mat) const {
         return ((m_nrows == mat.m_ncols) && (m_ncols == mat.m_nrows));
     }
 
@@ -230,7 +311,8 @@ public:
     bool IsSquare() const { return (m_nrows == m_ncols); }
 
     // Prints this matrix. TODO: "beautify" the output.
-	friend std::ostream & operator<<(std::ostream & out, const Matrix & m) {
+	friend std::ostream & operator<<(std::ostream & out,
+                                     const BasicMatrix & m) {
 		out << "Matrix [ ";
 		out << m.NRows() << "x";
 		out << m.NCols() << "; " << std::endl;
@@ -244,12 +326,37 @@ public:
 
 #ifndef AMDADOS_PLAIN_MPI
 	// Serialization: load this matrix.
-	static Matrix load(::allscale::utils::ArchiveReader & reader);
+	static BasicMatrix load(::allscale::utils::ArchiveReader & reader);
 	// Serialization: store this matrix.
 	void store(::allscale::utils::ArchiveWriter & writer) const;
+	// Serialization: size of this matrix in archive, see store().
+	size_t size_hint() const {
+		return 2 * sizeof(index_t) + static_cast<size_t>(this->Size()) * sizeof(T);
+	}
 #endif
 };
 
+using Vector  = BasicVector<double>;    // double-precision vector
+using Matrix  = BasicMatrix<double>;    // double-precision matrix
+using VectorF = BasicVector<float>;     // single-precision storage vector
+using MatrixF = BasicMatrix<float>;     // single-precision storage matrix
+
+#ifndef AMDADOS_PLAIN_MPI
+template<> Matrix Matrix::load(::allscale::utils::ArchiveReader & reader);
+template<> void Matrix::store(::allscale::utils::ArchiveWriter & writer) const;
+#endif
+
+//-----------------------------------------------------------------------------
+// Function copies a matrix into another one of possibly different precision.
+//-----------------------------------------------------------------------------
+template<typename T, typename U>
+void Convert(BasicMatrix<T> & dest, const BasicMatrix<U> & source)
+{
+    dest.Resize(source.NRows(), source.NCols(), false);
+    std::transform(source.begin(), source.end(), dest.begin(),
+                   [](U v) { return static_cast<T>(v); });
+}
+
 void MatMult(Matrix & result, const Matrix & A, const Matrix & B);
 
 void MatMultTr(Matrix & result, const Matrix & A, const Matrix & B);
@@ -272,6 +379,10 @@ void GetTransposed(Matrix & At, const Matrix & A);
 
 void Symmetrize(Matrix & A);
 
+void LowerTriangularize(Matrix & A);
+
+void CholeskyUpdate(Matrix & L, Vector & v);
+
 void ScalarMult(Vector & v, const double mult);
 
 double Norm(const Vector & v);
@@ -286,6 +397,20 @@ void MakeRandom(Vector & v, const char type);
 
 bool CheckNoNan(const Vector & v);
 
+// Mixed-precision variants: single-precision storage, double accumulation.
+
+void MatMult(MatrixF & result, const Matrix & A, const Matrix & B);
+
+void MatMultTr(Matrix & result, const MatrixF & A, const Matrix & B);
+
+void AddMatrices(MatrixF & result, const MatrixF & A, const Matrix & B);
+
+void SubtractMatrices(MatrixF & result, const MatrixF & A, const MatrixF & B);
+
+void Symmetrize(MatrixF & A);
+
+double Trace(const MatrixF & A);
+
 void WriteVector(const Vector & vec,
                         const std::string & filename, int precision = 4);
 
@@ -0,0 +1,273 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace amdados {
+
+//=============================================================================
+// Binary dataset of sensor locations and observations stored subdomain by
+// subdomain, so that a worker or an MPI process reads just the records of
+// its own subdomains instead of parsing the whole text files of sensors and
+// observations ("sensors" and "analytic") given in global coordinates.
+// Like SensorsGenerator, this class is used as a namespace with virtual
+// functions, which lets Allscale and MPI projects share the implementation.
+// File layout (native byte order): header of 8 integers (magic number, grid
+// size, subdomain size, number of time steps Nt, number of subdomains,
+// reserved), the byte offsets of subdomain records in the order of flat
+// indices of subdomains (Y is the fastest coordinate) followed by the file
+// size, then the records. A record is the number of sensors n (int64), n
+// pairs of local sensor coordinates (int32) and Nt x n observations (float,
+// a row per time step), padded to the multiple of 8 bytes. The dataset of
+// sensor locations alone (the binary counterpart of "sensors" text file) has
+// the same layout with Nt = 0.
+//=============================================================================
+class SensorDataset
+{
+public:
+    static const int64_t MAGIC = 0x3154414444414d41ll;  // "AMADDAT1"
+    static const int HEADER_SIZE = 8;                    // in int64 numbers
+
+//-----------------------------------------------------------------------------
+// Constructor takes the geometry of the dataset from configuration; the flag
+// tells whether the dataset holds observations or sensor locations alone.
+//-----------------------------------------------------------------------------
+explicit SensorDataset(const Configuration & conf, bool observations = true)
+    : m_grid_size(conf.asInt("num_subdomains_x"),
+                  conf.asInt("num_subdomains_y"))
+    , m_subdomain_size(conf.asInt("subdomain_x"), conf.asInt("subdomain_y"))
+    , m_Nt(observations ? conf.asInt("Nt") : 0)
+    , m_filename(), m_file(), m_buffer()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor.
+//-----------------------------------------------------------------------------
+virtual ~SensorDataset() {}
+
+//-----------------------------------------------------------------------------
+// Returns the number of subdomains, i.e. the number of records.
+//-----------------------------------------------------------------------------
+size_t NumSubdomains() const
+{
+    return static_cast<size_t>(m_grid_size.x * m_grid_size.y);
+}
+
+//-----------------------------------------------------------------------------
+// Returns the flat index of a subdomain, i.e. the index of its record.
+//-----------------------------------------------------------------------------
+size_t FlatIndex(const point2d_t & pos) const
+{
+    assert_true((0 <= pos.x) && (pos.x < m_grid_size.x) &&
+                (0 <= pos.y) && (pos.y < m_grid_size.y));
+    return static_cast<size_t>(pos.x * m_grid_size.y + pos.y);
+}
+
+//-----------------------------------------------------------------------------
+// Returns the size in bytes of the header and index of subdomain records.
+//-----------------------------------------------------------------------------
+size_t IndexSize() const
+{
+    return (HEADER_SIZE + NumSubdomains() + 1) * sizeof(int64_t);
+}
+
+//-----------------------------------------------------------------------------
+// Returns the size in bytes of a record of subdomain with given number
+// of sensors.
+//-----------------------------------------------------------------------------
+size_t RecordSize(size_t nsensors) const
+{
+    size_t size = sizeof(int64_t) + nsensors * 2 * sizeof(int32_t) +
+                  nsensors * static_cast<size_t>(m_Nt) * sizeof(float);
+    return (size + 7) & ~size_t(7);
+}
+
+//-----------------------------------------------------------------------------
+// Function writes the header and the index of records given the numbers of
+// sensors in subdomains (in the order of flat indices).
+//-----------------------------------------------------------------------------
+virtual void EncodeIndex(const std::vector<size_t> & nsensors,
+                         char * dst) const
+{
+    assert_true(nsensors.size() == NumSubdomains());
+    const int64_t header[HEADER_SIZE] = {
+        MAGIC,
+        static_cast<int64_t>(m_grid_size.x),
+        static_cast<int64_t>(m_grid_size.y),
+        static_cast<int64_t>(m_subdomain_size.x),
+        static_cast<int64_t>(m_subdomain_size.y),
+        static_cast<int64_t>(m_Nt),
+        static_cast<int64_t>(NumSubdomains()),
+        0
+    };
+    std::memcpy(dst, header, sizeof(header));
+    dst += sizeof(header);
+
+    int64_t offset = static_cast<int64_t>(IndexSize());
+    for (size_t i = 0; i <= nsensors.size(); ++i) {
+        std::memcpy(dst, &offset, sizeof(offset));
+        dst += sizeof(offset);
+        if (i < nsensors.size()) {
+            offset += static_cast<int64_t>(RecordSize(nsensors[i]));
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function writes a record of subdomain, the observation matrix must be of
+// the size Nt x (number of sensors) unless the dataset has no observations.
+//-----------------------------------------------------------------------------
+virtual void EncodeRecord(const point_array_t & sensors,
+                          const Matrix & observations, char * dst) const
+{
+    const int64_t n = static_cast<int64_t>(sensors.size());
+    assert_true((n == 0) || (m_Nt == 0) ||
+                ((observations.NRows() == m_Nt) && (observations.NCols() == n)))
+        << "observation matrix does not match the sensors";
+    std::memset(dst, 0, RecordSize(sensors.size()));
+    std::memcpy(dst, &n, sizeof(n));
+    dst += sizeof(n);
+    for (const auto & s : sensors) {
+        const int32_t xy[2] = { static_cast<int32_t>(s.x),
+                                static_cast<int32_t>(s.y) };
+        std::memcpy(dst, xy, sizeof(xy));
+        dst += sizeof(xy);
+    }
+    for (index_t t = 0; t < m_Nt; ++t) {
+    for (index_t k = 0; k < n; ++k) {
+        const float v = static_cast<float>(observations(t,k));
+        std::memcpy(dst, &v, sizeof(v));
+        dst += sizeof(v);
+    }}
+}
+
+//-----------------------------------------------------------------------------
+// Function parses a record of subdomain. The observation matrix is resized
+// to Nt x (number of sensors), it is left empty in the absence of sensors
+// like the text files do. Pass nullptr to skip the observations.
+//-----------------------------------------------------------------------------
+virtual void DecodeRecord(const char * src, size_t size,
+                          point_array_t & sensors, Matrix * observations) const
+{
+    int64_t n = 0;
+    assert_true(size >= sizeof(n)) << "truncated record in " << m_filename;
+    std::memcpy(&n, src, sizeof(n));
+    src += sizeof(n);
+    assert_true((n >= 0) && (size == RecordSize(static_cast<size_t>(n))))
+        << "corrupted record in " << m_filename;
+
+    sensors.resize(static_cast<size_t>(n));
+    for (auto & s : sensors) {
+        int32_t xy[2];
+        std::memcpy(xy, src, sizeof(xy));
+        src += sizeof(xy);
+        s = point2d_t(xy[0], xy[1]);
+        assert_true((0 <= s.x) && (s.x < m_subdomain_size.x) &&
+                    (0 <= s.y) && (s.y < m_subdomain_size.y))
+            << "sensor outside subdomain in " << m_filename;
+    }
+
+    if (observations == nullptr) {
+        return;
+    }
+    assert_true(m_Nt > 0) << "no observations in " << m_filename;
+    observations->Clear();
+    if (n > 0) {
+        observations->Resize(m_Nt, n, false);
+        for (index_t t = 0; t < m_Nt; ++t) {
+        for (index_t k = 0; k < n; ++k) {
+            float v = 0.0f;
+            std::memcpy(&v, src, sizeof(v));
+            src += sizeof(v);
+            (*observations)(t,k) = v;
+        }}
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function checks the header of a dataset against the configuration.
+//-----------------------------------------------------------------------------
+virtual void CheckHeader(const char * src) const
+{
+    int64_t header[HEADER_SIZE];
+    std::memcpy(header, src, sizeof(header));
+    assert_true(header[0] == MAGIC) << "not a sensor dataset: " << m_filename;
+    assert_true((header[1] == m_grid_size.x) &&
+                (header[2] == m_grid_size.y) &&
+                (header[3] == m_subdomain_size.x) &&
+                (header[4] == m_subdomain_size.y) &&
+                (header[6] == static_cast<int64_t>(NumSubdomains())))
+        << "geometry of dataset " << m_filename << " does not match "
+        << "the configuration";
+    assert_true(header[5] == m_Nt)
+        << "number of time steps in " << m_filename << " does not match "
+        << "the configuration";
+}
+
+//-----------------------------------------------------------------------------
+// Function opens the dataset for reading by \sa Read() and checks
+// its header.
+//-----------------------------------------------------------------------------
+virtual void Open(const std::string & filename)
+{
+    m_filename = filename;
+    m_file.close();
+    m_file.clear();
+    m_file.open(filename, std::ios::in | std::ios::binary);
+    assert_true(m_file.good()) << "failed to open dataset: " << filename;
+    char header[HEADER_SIZE * sizeof(int64_t)];
+    m_file.read(header, sizeof(header));
+    assert_true(m_file.good()) << "failed to read header of " << filename;
+    CheckHeader(header);
+}
+
+//-----------------------------------------------------------------------------
+// Function reads the whole index of records: the offsets of subdomain
+// records (in the order of flat indices) followed by the file size.
+//-----------------------------------------------------------------------------
+virtual std::vector<int64_t> ReadIndex()
+{
+    std::vector<int64_t> offsets(NumSubdomains() + 1);
+    m_file.seekg(static_cast<std::streamoff>(HEADER_SIZE * sizeof(int64_t)));
+    m_file.read(reinterpret_cast<char*>(offsets.data()),
+                static_cast<std::streamsize>(offsets.size() * sizeof(int64_t)));
+    assert_true(m_file.good()) << "failed to read index of " << m_filename;
+    return offsets;
+}
+
+//-----------------------------------------------------------------------------
+// Function reads the record of a subdomain by seeking straight to it
+// through the index, so the cost does not depend on the size of dataset.
+// Pass nullptr to skip the observations.
+//-----------------------------------------------------------------------------
+virtual void Read(const point2d_t & pos, point_array_t & sensors,
+                  Matrix * observations)
+{
+    int64_t range[2] = {0, 0};
+    m_file.seekg(static_cast<std::streamoff>(
+                    (HEADER_SIZE + FlatIndex(pos)) * sizeof(int64_t)));
+    m_file.read(reinterpret_cast<char*>(range), sizeof(range));
+    assert_true(m_file.good() && (range[0] <= range[1]))
+        << "failed to read index of " << m_filename;
+
+    m_buffer.resize(static_cast<size_t>(range[1] - range[0]));
+    m_file.seekg(static_cast<std::streamoff>(range[0]));
+    m_file.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    assert_true(m_file.good()) << "failed to read record of " << m_filename;
+    DecodeRecord(m_buffer.data(), m_buffer.size(), sensors, observations);
+}
+
+private:
+    size2d_t          m_grid_size;        // number of subdomains in x,y
+    size2d_t          m_subdomain_size;   // subdomain size in x,y
+    index_t           m_Nt;               // number of time steps
+    std::string       m_filename;         // name of dataset file opened
+    std::ifstream     m_file;             // dataset file opened for reading
+    std::vector<char> m_buffer;           // buffer of a record
+
+};  // class SensorDataset
+
+}   // namespace amdados
@@ -7,76 +7,380 @@
 
 namespace amdados {
 
+//=============================================================================
+// Counter-based pseudo-random generator Philox4x32-10 (J.K. Salmon et al.,
+// "Parallel random numbers: as easy as 1, 2, 3", SC'11). The k-th number of
+// a stream is a pure function of the key, the stream identifier and k, so
+// independent streams (e.g. one per subdomain) can be generated in parallel,
+// and the outcome depends neither on the order of processing nor on the
+// number of threads, processes or the platform.
+//=============================================================================
+class Philox4x32
+{
+public:
+//-----------------------------------------------------------------------------
+// Constructor takes the key (seed) and the identifier of a stream, which is
+// split into the tag (what the numbers are for) and the index (e.g. flat
+// index of subdomain).
+//-----------------------------------------------------------------------------
+Philox4x32(uint64_t key, uint32_t tag, uint64_t index)
+    : m_key{ static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32) }
+    , m_counter{ 0, tag, static_cast<uint32_t>(index),
+                         static_cast<uint32_t>(index >> 32) }
+    , m_block{ 0, 0, 0, 0 }
+    , m_pos(4)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Returns the next 32-bit number of the stream.
+//-----------------------------------------------------------------------------
+uint32_t operator()()
+{
+    if (m_pos == 4) {
+        Block(m_counter, m_key, m_block);
+        ++m_counter[0];
+        m_pos = 0;
+    }
+    return m_block[m_pos++];
+}
+
+//-----------------------------------------------------------------------------
+// Returns the next number uniformly distributed in the range [0..1).
+//-----------------------------------------------------------------------------
+double Uniform()
+{
+    const uint64_t hi = (*this)();
+    const uint64_t lo = (*this)();
+    return static_cast<double>(((hi << 32) | lo) >> 11) *
+           (1.0 / 9007199254740992.0);     // 53 random bits times 2^-53
+}
+
+//-----------------------------------------------------------------------------
+// Returns the next integer (almost) uniformly distributed in [0..n).
+//-----------------------------------------------------------------------------
+uint32_t Below(uint32_t n)
+{
+    return static_cast<uint32_t>((static_cast<uint64_t>((*this)()) * n) >> 32);
+}
+
+//-----------------------------------------------------------------------------
+// Function computes a block of 4 random numbers given counter and key.
+//-----------------------------------------------------------------------------
+static void Block(const uint32_t counter[4], const uint32_t key[2],
+                  uint32_t out[4])
+{
+    const uint64_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+    uint32_t c0 = counter[0], c1 = counter[1];
+    uint32_t c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r = 0; r < 10; ++r) {
+        const uint64_t p0 = M0 * c0;
+        const uint64_t p1 = M1 * c2;
+        const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c1 = static_cast<uint32_t>(p1);
+        c3 = static_cast<uint32_t>(p0);
+        c0 = n0;
+        c2 = n2;
+        k0 += W0;
+        k1 += W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+private:
+    uint32_t m_key[2];      // key of the generator (seed)
+    uint32_t m_counter[4];  // counter of the next block
+    uint32_t m_block[4];    // current block of random numbers
+    int      m_pos;         // position of the next number in the block
+};
+
 //=============================================================================
 // This class is used as a namespace with virtual functions, which are never
 // inlined or duplicated. The latter allows us to keep implementation in the
 // header file included in both Allscale and MPI projects.
+// The sensors of every subdomain are drawn from its own stream of counter
+// based generator (see Philox4x32), so the subdomains are processed in
+// parallel and the result is reproducible regardless of the order. Placement
+// policies ('sensor_layout' parameter):
+// "uniform"   - the sensors are held by the subdomains that come first in
+//               a pseudo-random permutation of all the subdomains,
+// "clustered" - sensors gather around 'sensor_clusters' random centres,
+// "every"     - every subdomain holds max(1, sensor_fraction * Sx * Sy)
+//               sensors at distinct points.
+// In the first two cases a subdomain holds at most one sensor. The total
+// number of sensors is that of 'sensor_fraction' of nodal points, but at
+// least one and not more than the number of subdomains: exactly in the
+// "uniform" case and in expectation in the "clustered" one, where the
+// subdomain of the first centre always holds a sensor.
 //=============================================================================
 class SensorsGenerator
 {
 public:
-// Destructor.
-virtual ~SensorsGenerator() {}
+    enum Layout { Uniform, Clustered, Every };
 
 //-----------------------------------------------------------------------------
-// Function generates pseudo-randomly distributed sensor locations.
-// N O T E, the sensor points are stored unordered and their coordinates are
-// global, i.e. defined with respected to the whole domain's coordinate system.
+// Constructor takes the parameters of sensor placement from configuration.
 //-----------------------------------------------------------------------------
-virtual void MakeSensors(const Configuration & conf,
-                         std::vector<point2d_t> & sensors) const
+explicit SensorsGenerator(const Configuration & conf)
+    : m_seed(RandomSeed())
+    , m_grid_size(conf.asInt("num_subdomains_x"),
+                  conf.asInt("num_subdomains_y"))
+    , m_subdomain_size(conf.asInt("subdomain_x"), conf.asInt("subdomain_y"))
+    , m_layout(Uniform)
+    , m_probability(0.0)
+    , m_num_sensors(0)
+    , m_half_bits(1)
+    , m_num_per_subdomain(1)
+    , m_radius(0.0)
+    , m_centres()
+    , m_anchor(0,0)
 {
-    MY_TIME_IT("Running sensors' generator ...")
-
-    const size_t Sx = conf.asUInt("subdomain_x");
-    const size_t Sy = conf.asUInt("subdomain_y");
-
-    const size_t Nx = conf.asUInt("num_subdomains_x");
-    const size_t Ny = conf.asUInt("num_subdomains_y");
+    const size_t Sx = static_cast<size_t>(m_subdomain_size.x);
+    const size_t Sy = static_cast<size_t>(m_subdomain_size.y);
+    const size_t Nx = static_cast<size_t>(m_grid_size.x);
+    const size_t Ny = static_cast<size_t>(m_grid_size.y);
     const size_t Nsubdom = Nx * Ny;                 // number of subdomains
     const size_t Ntotal = (Sx * Sy) * (Nx * Ny);    // total number of points
+    assert_true((Sx >= 1) && (Sy >= 1) && (Nsubdom >= 1));
+
+    const std::string layout = conf.IsExist("sensor_layout") ?
+                               conf.asString("sensor_layout") : "uniform";
+    if (layout == "uniform") {
+        m_layout = Uniform;
+    } else if (layout == "clustered") {
+        m_layout = Clustered;
+    } else if (layout == "every") {
+        m_layout = Every;
+    } else {
+        assert_true(0) << "unknown sensor_layout: " << layout;
+    }
 
-    // Compute the number of sensors.
-    // TODO: here we define the number
-    // of sensors as a fraction of the total number of nodal points. On the
-    // other hand, we want not more than one sensor per subdomain. Should
-    // we instead count the fraction in a number of subdomains having sensor?
+    // Compute the number of sensors: fraction of nodal points, but not more
+    // than one sensor per subdomain, except for "every" layout.
     const double fraction =
             std::min(std::max(conf.asDouble("sensor_fraction"), 0.001), 0.75);
-    const size_t Nsensors = std::min(std::max(static_cast<size_t>(
-            std::floor(fraction * Ntotal + 0.5)), size_t(1)), Nsubdom);
-    assert_true((1 <= Nsensors) && (Nsensors <= Nsubdom));
+    const double Nsensors = static_cast<double>(std::min(std::max(
+            static_cast<size_t>(std::floor(fraction * double(Ntotal) + 0.5)),
+            size_t(1)), Nsubdom));
+
+    switch (m_layout) {
+        case Uniform: {
+            // The permutation runs over the smallest domain of 4^h indices
+            // that covers all the subdomains (see Permute()).
+            m_num_sensors = static_cast<size_t>(Nsensors);
+            while ((uint64_t(1) << (2 * m_half_bits)) < uint64_t(Nsubdom)) {
+                ++m_half_bits;
+            }
+        }
+        break;
+        case Clustered: {
+            // Gaussian clusters of radius such that they would hold the
+            // expected number of sensors altogether: clusters * 2*pi*r^2 =
+            // Nsensors; the weights are scaled to compensate for the part
+            // of clusters outside the domain.
+            const double two_pi = 2.0 * std::acos(-1.0);
+            const size_t nc = conf.IsExist("sensor_clusters") ?
+                    std::max(conf.asUInt("sensor_clusters"), size_t(1)) : 4;
+            m_radius = std::max(std::sqrt(Nsensors / (two_pi * double(nc))),
+                                0.5);
+            Philox4x32 gen(m_seed, 1, 0);
+            m_centres.resize(nc);
+            double sum = 0.0;
+            const long w = static_cast<long>(std::ceil(6.0 * m_radius));
+            for (auto & c : m_centres) {
+                c.first  = gen.Uniform() * double(Nx);
+                c.second = gen.Uniform() * double(Ny);
+                const long cx = static_cast<long>(c.first);
+                const long cy = static_cast<long>(c.second);
+                for (long x = std::max(cx - w, 0L);
+                          x <= std::min(cx + w, long(Nx) - 1); ++x) {
+                for (long y = std::max(cy - w, 0L);
+                          y <= std::min(cy + w, long(Ny) - 1); ++y) {
+                    sum += ClusterWeight(c, x, y);
+                }}
+            }
+            m_probability = Nsensors / std::max(sum, 1.0);
+            m_anchor = point2d_t(static_cast<long>(m_centres[0].first),
+                                 static_cast<long>(m_centres[0].second));
+        }
+        break;
+        case Every: {
+            const size_t num_interior = NumInterior(Sx) * NumInterior(Sy);
+            m_num_per_subdomain = std::min(std::max(static_cast<size_t>(
+                    std::floor(fraction * double(Sx * Sy) + 0.5)), size_t(1)),
+                    num_interior);
+        }
+        break;
+    }
     MY_LOG(INFO) << "fraction of sensor points = " << fraction
-                 << ", #sensors = " << Nsensors
+                 << ", sensor layout: " << layout
                  << ", #subdomains = " << Nsubdom
                  << ", #nodal points = " << Ntotal;
+}
+
+// Destructor.
+virtual ~SensorsGenerator() {}
+
+//-----------------------------------------------------------------------------
+// Function generates pseudo-randomly distributed sensor locations inside
+// a subdomain; the coordinates are local to the subdomain. The result only
+// depends on the position of subdomain, so any number of subdomains can be
+// processed concurrently.
+//-----------------------------------------------------------------------------
+virtual void MakeSubdomainSensors(const point2d_t & pos,
+                                  point_array_t & sensors) const
+{
+    assert_true((0 <= pos.x) && (pos.x < m_grid_size.x) &&
+                (0 <= pos.y) && (pos.y < m_grid_size.y));
+    sensors.clear();
 
-    // Random permutation of flat subdomain indices.
-    std::vector<size_t> perm(Nsubdom);
-    for (size_t i = 0; i < Nsubdom; ++i) { perm[i] = i; }
-    std::shuffle(perm.begin(), perm.end(),
-            std::default_random_engine(static_cast<unsigned>(RandomSeed())));
-
-    // Randomly select a sub-set of subdomains with a single sensor therein.
-    std::srand(static_cast<unsigned>(RandomSeed()));
-    sensors.resize(Nsensors);
-    for (size_t i = 0; i < Nsensors; ++i) {
-        // Get positions of a randomly selected subdomain.
-        size_t xs = perm[i] % Nx;       // i = xs + ys * Nx
-        size_t ys = perm[i] / Nx;
-
-        // Get randomly selected point (sensor location) inside the subdomain.
-        size_t x = static_cast<size_t>(std::rand());
-        size_t y = static_cast<size_t>(std::rand());
-        x = (Sx >= 3) ? (1 + (x % (Sx - 2))) : (x % Sx);
-        y = (Sy >= 3) ? (1 + (y % (Sy - 2))) : (y % Sy);
-
-        // Store sensor location in global coordinates.
-        sensors[i] = Sub2Glo(point2d_t(x,y), point2d_t(xs,ys), size2d_t(Sx,Sy));
+    // Flat index of subdomain, Y is the fastest coordinate.
+    const uint64_t flat = static_cast<uint64_t>(pos.x * m_grid_size.y + pos.y);
+    Philox4x32 gen(m_seed, 0, flat);
+
+    size_t num = 0;
+    switch (m_layout) {
+        case Uniform: {
+            num = (Permute(flat) < m_num_sensors) ? 1 : 0;
+        }
+        break;
+        case Clustered: {
+            double w = 0.0;
+            for (const auto & c : m_centres) {
+                w += ClusterWeight(c, pos.x, pos.y);
+            }
+            const bool drawn = (gen.Uniform() < m_probability * w);
+            num = (drawn || (pos == m_anchor)) ? 1 : 0;
+        }
+        break;
+        case Every: {
+            num = m_num_per_subdomain;
+        }
+        break;
+    }
+    if (num == 0) {
+        return;
+    }
+
+    // Sample distinct interior points (Floyd's algorithm), the sensors are
+    // kept away from the subdomain border whenever possible.
+    const uint32_t nx = static_cast<uint32_t>(NumInterior(
+                                    static_cast<size_t>(m_subdomain_size.x)));
+    const uint32_t ny = static_cast<uint32_t>(NumInterior(
+                                    static_cast<size_t>(m_subdomain_size.y)));
+    const long     ox = (m_subdomain_size.x >= 3) ? 1 : 0;
+    const long     oy = (m_subdomain_size.y >= 3) ? 1 : 0;
+    const uint32_t N = nx * ny;
+    assert_true(num <= N);
+    std::vector<uint32_t> chosen;
+    chosen.reserve(num);
+    for (uint32_t j = N - static_cast<uint32_t>(num); j < N; ++j) {
+        const uint32_t t = gen.Below(j + 1);
+        const bool taken =
+                (std::find(chosen.begin(), chosen.end(), t) != chosen.end());
+        chosen.push_back(taken ? j : t);
+    }
+    sensors.reserve(num);
+    for (uint32_t k : chosen) {
+        sensors.push_back(point2d_t(ox + static_cast<long>(k % nx),
+                                    oy + static_cast<long>(k / nx)));
     }
 }
 
+//-----------------------------------------------------------------------------
+// Function generates pseudo-randomly distributed sensor locations of all
+// the subdomains, which are ordered by flat indices of subdomains.
+// N O T E, the coordinates are global, i.e. defined with respected to
+// the whole domain's coordinate system.
+//-----------------------------------------------------------------------------
+virtual void MakeSensors(std::vector<point2d_t> & sensors) const
+{
+    MY_TIME_IT("Running sensors' generator ...")
+
+    sensors.clear();
+    point_array_t local;
+    for (long x = 0; x < static_cast<long>(m_grid_size.x); ++x) {
+    for (long y = 0; y < static_cast<long>(m_grid_size.y); ++y) {
+        const point2d_t pos(x,y);
+        MakeSubdomainSensors(pos, local);
+        for (const auto & p : local) {
+            sensors.push_back(Sub2Glo(p, pos, m_subdomain_size));
+        }
+    }}
+    MY_LOG(INFO) << "#sensors = " << sensors.size();
+}
+
+private:
+//-----------------------------------------------------------------------------
+// Returns the position of subdomain in a pseudo-random permutation of all
+// the subdomains given its flat index. The permutation of 4^h indices is
+// made up by the 4-round Feistel network with Philox4x32 as the round
+// function; an index beyond the number of subdomains is permuted again
+// until it falls inside (cycle walking), which restricts the permutation
+// to the subdomains. It takes less than 4 rounds on average since the
+// domain is less than 4 times larger.
+//-----------------------------------------------------------------------------
+uint64_t Permute(uint64_t flat) const
+{
+    const uint64_t total = static_cast<uint64_t>(m_grid_size.x) *
+                           static_cast<uint64_t>(m_grid_size.y);
+    const uint32_t key[2] = { static_cast<uint32_t>(m_seed),
+                              static_cast<uint32_t>(m_seed >> 32) };
+    const uint64_t mask = (uint64_t(1) << m_half_bits) - 1;
+    uint64_t v = flat;
+    do {
+        uint64_t left = v >> m_half_bits, right = v & mask;
+        for (uint32_t r = 0; r < 4; ++r) {
+            // r-th block of the stream of permutation (tag 2) of 'right'.
+            const uint32_t counter[4] = { r, 2, static_cast<uint32_t>(right),
+                                          0 };
+            uint32_t out[4];
+            Philox4x32::Block(counter, key, out);
+            const uint64_t f = out[0] & mask;
+            left ^= f;
+            std::swap(left, right);
+        }
+        v = (left << m_half_bits) | right;
+    } while (v >= total);
+    return v;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the (Gaussian) weight of a cluster at subdomain (x,y).
+//-----------------------------------------------------------------------------
+double ClusterWeight(const std::pair<double,double> & centre,
+                     long x, long y) const
+{
+    const double dx = double(x) + 0.5 - centre.first;
+    const double dy = double(y) + 0.5 - centre.second;
+    return std::exp(-(dx*dx + dy*dy) / (2.0 * m_radius * m_radius));
+}
+
+//-----------------------------------------------------------------------------
+// Returns the number of points along a side of subdomain where sensors are
+// placed: the border points are excluded unless the side is too short.
+//-----------------------------------------------------------------------------
+static size_t NumInterior(size_t size)
+{
+    return (size >= 3) ? (size - 2) : size;
+}
+
+private:
+    uint64_t  m_seed;                   // key of the random generator
+    size2d_t  m_grid_size;              // number of subdomains in x,y
+    size2d_t  m_subdomain_size;         // subdomain size in x,y
+    Layout    m_layout;                 // sensor placement policy
+    double    m_probability;            // scale of cluster weights
+    size_t    m_num_sensors;            // number of sensors ("uniform")
+    unsigned  m_half_bits;              // half of bits of permuted index
+    size_t    m_num_per_subdomain;      // number of sensors ("every" layout)
+    double    m_radius;                 // radius of clusters in subdomains
+    std::vector<std::pair<double,double>> m_centres;   // cluster centres
+    point2d_t m_anchor;                 // subdomain of the first centre
+
 };  // class SensorsGenerator
 
 }   // namespace amdados
-
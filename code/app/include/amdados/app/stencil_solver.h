@@ -0,0 +1,236 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace amdados {
+
+//=============================================================================
+// Coefficients of the 5-point stencil of the inverse model matrix B at an
+// internal point (x,y) of extended subdomain; the border points are passed
+// through as is. The same stencil applies to all the internal points unless
+// the stencils are given point by point.
+//=============================================================================
+struct ModelStencil
+{
+    double centre;      // coefficient at (x,y)
+    double xm, xp;      // coefficients at (x-1,y) and (x+1,y)
+    double ym, yp;      // coefficients at (x,y-1) and (x,y+1)
+};
+
+//-----------------------------------------------------------------------------
+// Function returns the stencil of the coarse problem at a subdomain given the
+// 'stencil' of the model matrix at the layer of Sx-by-Sy points the subdomain
+// operates at: the Galerkin projection onto the constant function over the
+// subdomain, divided by the number of points. A peer couples through the Sy
+// (Sx) points along the shared side, and since the row of the inverse model
+// matrix sums up to one, so does the coarse stencil. The couplings across the
+// outer border, where the correction vanishes, are dropped the same way.
+//-----------------------------------------------------------------------------
+inline ModelStencil CoarseStencil(const ModelStencil & stencil,
+                                  index_t Sx, index_t Sy)
+{
+    ModelStencil c;
+    c.xm = stencil.xm / static_cast<double>(Sx);
+    c.xp = stencil.xp / static_cast<double>(Sx);
+    c.ym = stencil.ym / static_cast<double>(Sy);
+    c.yp = stencil.yp / static_cast<double>(Sy);
+    c.centre = 1.0 - (c.xm + c.xp + c.ym + c.yp);
+    return c;
+}
+
+//=============================================================================
+// Class solves the linear system B*x = b, where B is the inverse model matrix
+// given by its stencil (see ModelStencil), without ever forming B densely.
+// The border values of extended subdomain are passed through, so only the
+// system over the internal points is factorized. Its matrix is banded with
+// the half-bandwidth Sy (the points are ordered row-major, 'y' is faster),
+// and it has positive definite symmetric part (diffusion) plus skew-symmetric
+// one (advection), thus LU decomposition without pivoting is applicable.
+// The storage is O(Sx*Sy*Sy) instead of O((Sx*Sy)^2) of the dense B and LU.
+// The stencil may also vary from point to point, as it does in the coarse
+// problem over the grid of subdomains operating at different layers.
+//=============================================================================
+class StencilSolver
+{
+private:
+    index_t      m_Sx, m_Sy;    // size of subdomain without border points
+    ModelStencil m_stencil;     // stencil of the inverse model matrix
+    std::vector<ModelStencil> m_stencils;   // point by point stencils, if any
+    Matrix       m_band;        // LU factors in band storage: (Sx*Sy)x(2*Sy+1)
+    Vector       m_rhs;         // right-hand side over the internal points
+
+public:
+//-----------------------------------------------------------------------------
+// Constructor.
+//-----------------------------------------------------------------------------
+StencilSolver()
+    : m_Sx(0), m_Sy(0), m_stencil(), m_stencils(), m_band(), m_rhs()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Prints this object.
+//-----------------------------------------------------------------------------
+friend std::ostream& operator<<(std::ostream & out, const StencilSolver & s) {
+	out << "StencilSolver: [ " << s.m_Sx << "x" << s.m_Sy << ", ";
+	out << s.m_band << ", ";
+	out << s.m_rhs;
+	out << " ]" << std::endl;
+	return out;
+}
+
+//-----------------------------------------------------------------------------
+// Function places the solver in the memory arena, where subdomains of size
+// up to Sx-by-Sy (without border points) can be handled.
+//-----------------------------------------------------------------------------
+void Place(Arena & arena, index_t Sx, index_t Sy)
+{
+    arena.Place(m_band, Sx * Sy, 2 * Sy + 1);
+    arena.Place(m_rhs, Sx * Sy);
+}
+
+//-----------------------------------------------------------------------------
+// Function returns the number of bytes occupied by the solver.
+//-----------------------------------------------------------------------------
+size_t Bytes() const
+{
+    return static_cast<size_t>(m_band.Size() + m_rhs.Size()) * sizeof(double);
+}
+
+//-----------------------------------------------------------------------------
+// Function computes and stores band LU decomposition of the matrix B
+// restricted to the internal points of Sx-by-Sy subdomain.
+//-----------------------------------------------------------------------------
+void Init(const ModelStencil & stencil, index_t Sx, index_t Sy)
+{
+    m_stencil = stencil;
+    m_stencils.clear();
+    Factorize(Sx, Sy, [&stencil](index_t) -> const ModelStencil & {
+        return stencil;
+    });
+}
+
+//-----------------------------------------------------------------------------
+// Function computes and stores band LU decomposition of the matrix B given
+// the stencil at every internal point of Sx-by-Sy subdomain ('y' is faster).
+//-----------------------------------------------------------------------------
+void Init(const std::vector<ModelStencil> & stencils, index_t Sx, index_t Sy)
+{
+    assert_true(static_cast<index_t>(stencils.size()) == Sx * Sy);
+    m_stencils = stencils;
+    Factorize(Sx, Sy, [this](index_t i) -> const ModelStencil & {
+        return m_stencils[static_cast<size_t>(i)];
+    });
+}
+
+//-----------------------------------------------------------------------------
+// Function solves the linear system B*x = b, where x and b are the extended
+// subdomain fields of size (Sx+2)-by-(Sy+2); x and b can be the same object.
+//-----------------------------------------------------------------------------
+void Solve(Matrix & x, const Matrix & b)
+{
+    const index_t Sx = m_Sx;
+    const index_t Sy = m_Sy;
+    const index_t n = Sx * Sy;
+    const index_t w = Sy;
+    const Matrix & A = m_band;
+
+    assert_true((b.NRows() == Sx + 2) && (b.NCols() == Sy + 2));
+    assert_true(A.NRows() == n);
+
+    // Internal right-hand side: the known border values are moved there.
+    m_rhs.Resize(n, false);
+    for (index_t x1 = 1; x1 <= Sx; ++x1) {
+    for (index_t y1 = 1; y1 <= Sy; ++y1) {
+        const index_t i = (x1 - 1) * Sy + (y1 - 1);
+        const ModelStencil & s = m_stencils.empty() ? m_stencil :
+                                    m_stencils[static_cast<size_t>(i)];
+        double v = b(x1,y1);
+        if (x1 == 1)  v -= s.xm * b(0,y1);
+        if (x1 == Sx) v -= s.xp * b(Sx + 1,y1);
+        if (y1 == 1)  v -= s.ym * b(x1,0);
+        if (y1 == Sy) v -= s.yp * b(x1,Sy + 1);
+        m_rhs(i) = v;
+    }}
+
+    // Forward substitution with L (unit diagonal), then backward one with U.
+    for (index_t i = 1; i < n; ++i) {
+        double sum = m_rhs(i);
+        for (index_t j = std::max(index_t(0), i - w); j < i; ++j) {
+            sum -= A(i,j - i + w) * m_rhs(j);
+        }
+        m_rhs(i) = sum;
+    }
+    for (index_t i = n - 1; i >= 0; --i) {
+        double sum = m_rhs(i);
+        const index_t last = std::min(i + w, n - 1);
+        for (index_t j = i + 1; j <= last; ++j) {
+            sum -= A(i,j - i + w) * m_rhs(j);
+        }
+        m_rhs(i) = sum / A(i,w);
+    }
+
+    // Border values are passed through, internal ones are the solution.
+    if (static_cast<const void*>(&x) != static_cast<const void*>(&b)) {
+        x = b;
+    }
+    for (index_t x1 = 1; x1 <= Sx; ++x1) {
+    for (index_t y1 = 1; y1 <= Sy; ++y1) {
+        x(x1,y1) = m_rhs((x1 - 1) * Sy + (y1 - 1));
+    }}
+}
+
+private:
+//-----------------------------------------------------------------------------
+// Function computes and stores band LU decomposition of the matrix B given
+// the stencil at every internal point by the functor 'stencil_at'.
+//-----------------------------------------------------------------------------
+template<typename StencilAt>
+void Factorize(index_t Sx, index_t Sy, const StencilAt & stencil_at)
+{
+    const double TINY = std::numeric_limits<double>::min() /
+		       std::pow(std::numeric_limits<double>::epsilon(),3);
+
+    assert_true((Sx > 0) && (Sy > 0));
+    m_Sx = Sx;
+    m_Sy = Sy;
+
+    const index_t n = Sx * Sy;      // number of internal points
+    const index_t w = Sy;           // half-bandwidth
+
+    // Fill in the band: the entry (i,j) is kept in A(i, j - i + w).
+    Matrix & A = m_band;
+    A.Resize(n, 2 * w + 1);
+    for (index_t x = 0; x < Sx; ++x) {
+    for (index_t y = 0; y < Sy; ++y) {
+        const index_t i = x * Sy + y;
+        const ModelStencil & stencil = stencil_at(i);
+        A(i,w) = stencil.centre;
+        if (x > 0)      A(i,w - Sy) = stencil.xm;
+        if (x + 1 < Sx) A(i,w + Sy) = stencil.xp;
+        if (y > 0)      A(i,w - 1)  = stencil.ym;
+        if (y + 1 < Sy) A(i,w + 1)  = stencil.yp;
+    }}
+
+    // Gaussian elimination without pivoting keeps the fill-in within band.
+    for (index_t k = 0; k < n - 1; ++k) {
+        const double Akk = A(k,w);
+        assert_true(std::fabs(Akk) > TINY) << "LU failed, pivot: " << Akk;
+        const index_t last = std::min(k + w, n - 1);
+        for (index_t i = k + 1; i <= last; ++i) {
+            const double Aik = (A(i,k - i + w) /= Akk);
+            if (Aik == 0.0) continue;
+            for (index_t j = k + 1; j <= last; ++j) {
+                A(i,j - i + w) -= Aik * A(k,j - k + w);
+            }
+        }
+    }
+    assert_true(std::fabs(A(n - 1,w)) > TINY) << "LU failed";
+}
+
+}; // class StencilSolver
+
+} // namespace amdados
@@ -0,0 +1,142 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace amdados {
+
+const int NSIDES = 4;             // number of sides any subdomain has
+
+/**
+ * Structure keeps information about 4-side boundary of a subdomain
+ * (Up, Down, Left, Right).
+ */
+struct Boundary
+{
+    double_array_t myself; // temporary storage for this subdomain boundary
+    double_array_t remote; // temporary storage for remote boundary values
+
+    double rel_diff;       // relative mismatch with the peers on the halo
+    bool   outer[NSIDES];  // true, if side belongs to domain's outer boundary
+
+	friend std::ostream & operator<<(std::ostream & out, const Boundary & b) {
+		out << "Boundary: [ ";
+		for (const auto & e : b.myself) { out << " " << e; }
+		out << ", ";
+		for (const auto & e : b.remote) { out << " " << e; }
+		out << ", " << b.rel_diff << ",";
+		for (int i = 0; i < NSIDES; ++i) { out << " " << b.outer[i]; }
+		out << " ]" << std::endl;
+		return out;
+	}
+};
+
+typedef std::pair<double,double> flow_t;    // flow components (flow_x, flow_y)
+
+//=============================================================================
+// Variables and data associated with a sub-domain.
+//=============================================================================
+struct SubdomainContext
+{
+    Arena         arena;        // memory block of the matrices below
+
+    Matrix        field;        // sub-domain represented as a matrix
+    Boundary      boundaries;   // sub-domain boundaries
+
+    KalmanFilter  Kalman;       // Kalman filter
+    Matrix        B;            // inverse model matrix
+
+    Matrix        P;            // process model covariance or its factor
+    Matrix        Q;            // process noise covariance
+    Vector        Qdiag;        // diagonal of Q in the square-root mode
+    Matrix        H;            // observation matrix
+    Matrix        R;            // observation noise covariance
+    Vector        z;            // observation vector
+
+    KalmanFilterF Kalman_mixed; // Kalman filter in mixed precision
+    MatrixF       P_mixed;      // process model covariance in mixed precision
+
+    LocalCovariance Ploc;       // localised process model covariance
+    LocalCovariance Qloc;       // localised (diagonal) process noise covariance
+
+    point_array_t   sensors;    // sensor locations at the finest resolution
+    LUdecomposition LU;         // used for state propagation without sensors
+    Matrix          tmp_field;  // used for state propagation without sensors
+    StencilSolver   stencil;    // replaces B and LU in memory-lean mode
+    ModelStencil    model;      // model stencil of the last (sub-)iteration
+    flow_t          flow;       // current flow vector (vel_x, vel_y)
+    unsigned        layer;      // current resolution (layer) of sub-domain
+    bool            sqrt_covar; // P keeps its factor S: P = S*S^t
+    double          innov_sq;   // sum of squared innovations at sensors
+    size_t          settled;    // step where the halo has settled
+    size_t          held;       // sub-iterations held since it has settled
+
+    SubdomainContext()
+        : arena()
+        , field(), boundaries()
+        , Kalman(), B()
+        , P(), Q(), Qdiag(), H(), R(), z()
+        , Kalman_mixed(), P_mixed()
+        , Ploc(), Qloc()
+        , sensors(), LU(), tmp_field(), stencil(), model()
+        , flow(0.0, 0.0), layer(LayerFine), sqrt_covar(false)
+        , innov_sq(0.0), settled(std::numeric_limits<size_t>::max())
+        , held(0)
+    {}
+
+	friend std::ostream & operator<<(std::ostream & out,
+                                     const SubdomainContext & ctx) {
+		out << "SubdomainContext: [ ";
+		out << ctx.arena << ", ";
+		out << ctx.field << ", ";
+		out << ctx.boundaries << ", ";
+		out << ctx.Kalman << ", ";
+		out << ctx.B << ", ";
+		out << ctx.P << ", ";
+		out << ctx.Q << ", ";
+		out << ctx.Qdiag << ", ";
+		out << ctx.H << ", ";
+		out << ctx.R << ", ";
+		out << ctx.z << ", ";
+		out << ctx.Kalman_mixed << ", ";
+		out << ctx.P_mixed << ", ";
+		out << ctx.Ploc << ", ";
+		out << ctx.Qloc;
+		for (const auto & e : ctx.sensors) { out << ", " << e; }
+		out << ctx.LU << ", ";
+		out << ctx.tmp_field << ", ";
+		out << ctx.stencil << ", ";
+		out << ctx.flow.first << ", ";
+		out << ctx.flow.second << ", ";
+		out << ctx.layer << ", ";
+		out << ctx.sqrt_covar << ", ";
+		out << ctx.innov_sq << ", ";
+		out << ctx.settled << ", ";
+		out << ctx.held;
+		out << " ]" << std::endl;
+		return out;
+	}
+};
+
+// The whole domain where instead of grid cells we place sub-domain data.
+using context_domain_t = ::allscale::api::user::data::Grid<SubdomainContext,2>;
+
+/**
+ * Function returns "true" if a subdomain holds its state at the sub-iteration
+ * 'timestamp' because its halo has settled earlier in the time step (see
+ * HaloSettled()). A subdomain without sensors holds all the remaining
+ * sub-iterations but the last one, which makes up for the fractions of time
+ * step held.
+ */
+inline bool HoldsState(const SubdomainContext & ctx,
+                       const time_schedule_t  & schedule, size_t timestamp)
+{
+    const size_t t_discrete = FindTimeStep(schedule, timestamp);
+    const TimeStep & step = schedule[t_discrete];
+    return (ctx.settled == t_discrete) && (!ctx.sensors.empty() ||
+                    (timestamp + 1 < step.first + step.Nsubiter));
+}
+
+} // namespace amdados
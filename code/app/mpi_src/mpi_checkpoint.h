@@ -0,0 +1,299 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#pragma once
+
+namespace amdados {
+
+//=============================================================================
+// Class takes periodic checkpoints of the assimilation state: the current
+// field and the covariance matrix P of every subdomain plus the index of
+// time step to be done next. The other matrices are recomputed at the
+// beginning of every time step. Every process copies the data of its
+// subdomains into a buffer and posts non-blocking MPI-IO writes, which
+// proceed while the time integration goes on; they are completed right
+// before the next checkpoint or at the end of simulation. The file is
+// written under a temporary name and renamed when complete, so a crash
+// never damages the previous checkpoint.
+// File layout: header of 8 integers (magic number, time step, grid size,
+// subdomain size, number of subdomains, reserved), the offsets of subdomain
+// records (flat index of subdomain on the grid), then the records. A record
+// is 5 integers (flat index, sizes of field and P) followed by the field and
+// P. The offsets make restart independent of the number of processes.
+//=============================================================================
+class MpiCheckpoint
+{
+public:
+    static const int64_t MAGIC = 0x31544b4344414d41ll;  // "AMADCKT1"
+    static const int HEADER_SIZE = 8;                    // in int64 numbers
+    static const int RECORD_HEADER_SIZE = 5;             // in int64 numbers
+
+//-----------------------------------------------------------------------------
+// Constructor; zero period disables checkpointing.
+//-----------------------------------------------------------------------------
+MpiCheckpoint(const Configuration & conf)
+    : m_filename(MakeFileName(conf, "checkpoint"))
+    , m_period(conf.IsExist("checkpoint_period") ?
+               static_cast<long>(conf.asUInt("checkpoint_period")) : 0)
+    , m_subdomain_size(conf.asInt("subdomain_x"), conf.asInt("subdomain_y"))
+    , m_file(MPI_FILE_NULL)
+    , m_header(), m_index(), m_buffer(), m_requests()
+    , m_count(0), m_bytes(0.0), m_time(0.0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor completes the last checkpoint, if any.
+//-----------------------------------------------------------------------------
+virtual ~MpiCheckpoint()
+{
+    Complete();
+}
+
+//-----------------------------------------------------------------------------
+// Returns "true" if a checkpoint is taken at the beginning of time step t.
+//-----------------------------------------------------------------------------
+bool IsDue(long t) const
+{
+    return (m_period > 0) && (t > 0) && (t % m_period == 0);
+}
+
+//-----------------------------------------------------------------------------
+// Function starts writing the checkpoint at the beginning of time step t.
+// The previous checkpoint is completed first.
+//-----------------------------------------------------------------------------
+virtual void Write(long t, const MpiGrid & grid)
+{
+    Complete();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const size2d_t grid_size = grid.getGridSize();
+    const int64_t  Nsubdom = static_cast<int64_t>(grid_size.x * grid_size.y);
+
+    // Copy the data of local subdomains into the buffer, one record each.
+    m_buffer.clear();
+    m_index.clear();
+    grid.forAllLocal([&](const SubDomain * sd) {
+        const Matrix & field = sd->m_curr_field;
+        const Matrix & P = sd->m_P;
+        const int64_t head[RECORD_HEADER_SIZE] = {
+            static_cast<int64_t>(grid.sub2ind(sd->m_pos)),
+            static_cast<int64_t>(field.NRows()),
+            static_cast<int64_t>(field.NCols()),
+            static_cast<int64_t>(P.NRows()),
+            static_cast<int64_t>(P.NCols())
+        };
+        m_index.push_back(head[0]);
+        m_index.push_back(static_cast<int64_t>(m_buffer.size()));
+        Append(head, RECORD_HEADER_SIZE);
+        Append(field.begin(), field.Size());
+        Append(P.begin(), P.Size());
+    });
+    assert_true(m_buffer.size() < (unsigned)std::numeric_limits<int>::max());
+
+    // The records follow the header and offsets in the order of ranks.
+    MPI_Offset len = static_cast<MPI_Offset>(m_buffer.size());
+    MPI_Offset offset = 0;
+    MPI_CHECK(MPI_Exscan(&len, &offset, 1,
+                         MPI_OFFSET, MPI_SUM, MPI_COMM_WORLD));
+    if (GetRank() == 0) offset = 0;     // MPI_Exscan leaves it undefined
+    const MPI_Offset base = static_cast<MPI_Offset>(
+                        (HEADER_SIZE + Nsubdom) * sizeof(int64_t)) + offset;
+    for (size_t i = 1; i < m_index.size(); i += 2) {
+        m_index[i] += static_cast<int64_t>(base);
+    }
+
+    // Collective opening of the temporary file.
+    const std::string temp_name = m_filename + ".tmp";
+    if (MPI_File_open(MPI_COMM_WORLD, temp_name.c_str(),
+                      MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &m_file) != MPI_SUCCESS) {
+        MY_LOG(ERROR) << "failed to open file " << temp_name << " for writing";
+        PrintErrorAndExit(nullptr);
+    }
+    MPI_CHECK(MPI_File_set_size(m_file, 0));
+
+    // Post non-blocking writes: header (by the first process), offsets of
+    // the local records and the records themselves.
+    m_requests.clear();
+    if (GetRank() == 0) {
+        const int64_t head[HEADER_SIZE] = {
+            MAGIC, static_cast<int64_t>(t),
+            static_cast<int64_t>(grid_size.x),
+            static_cast<int64_t>(grid_size.y),
+            static_cast<int64_t>(m_subdomain_size.x),
+            static_cast<int64_t>(m_subdomain_size.y),
+            Nsubdom, 0
+        };
+        std::copy(head, head + HEADER_SIZE, m_header);
+        Post(0, m_header, HEADER_SIZE * sizeof(int64_t));
+    }
+    for (size_t i = 0; i < m_index.size(); i += 2) {
+        Post(static_cast<MPI_Offset>(
+                (HEADER_SIZE + m_index[i]) * (int64_t)sizeof(int64_t)),
+             &m_index[i + 1], sizeof(int64_t));
+    }
+    Post(base, m_buffer.data(), m_buffer.size());
+
+    m_count += 1;
+    m_bytes += static_cast<double>(m_buffer.size());
+    m_time += std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//-----------------------------------------------------------------------------
+// Function waits until the current checkpoint has been written, then closes
+// and renames the file. Collective operation.
+//-----------------------------------------------------------------------------
+virtual void Complete()
+{
+    if (m_file == MPI_FILE_NULL) return;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    MPI_CHECK(MPI_Waitall(static_cast<int>(m_requests.size()),
+                          m_requests.data(), MPI_STATUSES_IGNORE));
+    m_requests.clear();
+    if (MPI_File_close(&m_file) != MPI_SUCCESS) {
+        MY_LOG(ERROR) << "MPI_File_close() failed";
+        PrintErrorAndExit(nullptr);
+    }
+    m_file = MPI_FILE_NULL;
+    MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+    if (GetRank() == 0) {
+        const std::string temp_name = m_filename + ".tmp";
+        if (std::rename(temp_name.c_str(), m_filename.c_str()) != 0) {
+            MY_LOG(ERROR) << "failed to rename " << temp_name;
+            PrintErrorAndExit(nullptr);
+        }
+    }
+    m_time += std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//-----------------------------------------------------------------------------
+// Function completes the last checkpoint and prints the cost of
+// checkpointing: the largest time a process was blocked by it.
+//-----------------------------------------------------------------------------
+void Finish()
+{
+    Complete();
+    double bytes = 0.0, time = 0.0;
+    MPI_CHECK(MPI_Reduce(&m_bytes, &bytes, 1, MPI_DOUBLE,
+                         MPI_SUM, 0, MPI_COMM_WORLD));
+    MPI_CHECK(MPI_Reduce(&m_time, &time, 1, MPI_DOUBLE,
+                         MPI_MAX, 0, MPI_COMM_WORLD));
+    if ((GetRank() == 0) && (m_count > 0)) {
+        const double MB = 1024.0 * 1024.0;
+        MY_LOG(INFO) << "Checkpoints: " << m_count << " of "
+                     << bytes / (MB * static_cast<double>(m_count))
+                     << " MB each, max. blocking time per process: "
+                     << time << "s";
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function reads the checkpoint into the subdomains of this process, which
+// must be initialized by the same configuration. Returns the index of time
+// step the simulation should be resumed from. Collective operation.
+//-----------------------------------------------------------------------------
+static long Read(const Configuration & conf, const std::string & filename,
+                 MpiGrid & grid)
+{
+    MPI_File file = MPI_FILE_NULL;
+    if (MPI_File_open(MPI_COMM_WORLD, filename.c_str(), MPI_MODE_RDONLY,
+                      MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        MY_LOG(ERROR) << "failed to open the checkpoint " << filename;
+        PrintErrorAndExit(nullptr);
+    }
+
+    // Header and offsets of the records.
+    const size2d_t grid_size = grid.getGridSize();
+    const int64_t  Nsubdom = static_cast<int64_t>(grid_size.x * grid_size.y);
+    std::vector<int64_t> head(static_cast<size_t>(HEADER_SIZE + Nsubdom));
+    MPI_CHECK(MPI_File_read_at(file, 0, head.data(),
+                               static_cast<int>(head.size()), MPI_INT64_T,
+                               MPI_STATUS_IGNORE));
+    assert_true(head[0] == MAGIC) << "not a checkpoint file: " << filename;
+    assert_true((head[2] == grid_size.x) && (head[3] == grid_size.y) &&
+                (head[6] == Nsubdom) &&
+                (head[4] == conf.asInt("subdomain_x")) &&
+                (head[5] == conf.asInt("subdomain_y")))
+        << "checkpoint grid size mismatch: " << filename;
+
+    // Records of the local subdomains.
+    grid.forAllLocal([&](SubDomain * sd) {
+        const int64_t pos = static_cast<int64_t>(grid.sub2ind(sd->m_pos));
+        MPI_Offset offset = static_cast<MPI_Offset>(
+                                head[static_cast<size_t>(HEADER_SIZE + pos)]);
+        int64_t rec[RECORD_HEADER_SIZE];
+        MPI_CHECK(MPI_File_read_at(file, offset, rec, RECORD_HEADER_SIZE,
+                                   MPI_INT64_T, MPI_STATUS_IGNORE));
+        Matrix & field = sd->m_curr_field;
+        Matrix & P = sd->m_P;
+        assert_true((rec[0] == pos) &&
+                    (rec[1] == field.NRows()) && (rec[2] == field.NCols()) &&
+                    (rec[3] == P.NRows()) && (rec[4] == P.NCols()))
+            << "checkpoint does not match configuration";
+        offset += RECORD_HEADER_SIZE * sizeof(int64_t);
+        MPI_CHECK(MPI_File_read_at(file, offset, field.begin(),
+                                   static_cast<int>(field.Size()), MPI_DOUBLE,
+                                   MPI_STATUS_IGNORE));
+        offset += static_cast<MPI_Offset>(field.Size()) *
+                  static_cast<MPI_Offset>(sizeof(double));
+        if (!P.Empty()) {
+            MPI_CHECK(MPI_File_read_at(file, offset, P.begin(),
+                                       static_cast<int>(P.Size()), MPI_DOUBLE,
+                                       MPI_STATUS_IGNORE));
+        }
+    });
+
+    if (MPI_File_close(&file) != MPI_SUCCESS) {
+        MY_LOG(ERROR) << "MPI_File_close() failed";
+        PrintErrorAndExit(nullptr);
+    }
+    return static_cast<long>(head[1]);
+}
+
+private:
+//-----------------------------------------------------------------------------
+// Function appends an array to the buffer.
+//-----------------------------------------------------------------------------
+template<typename T>
+void Append(const T * data, index_t count)
+{
+    const size_t pos = m_buffer.size();
+    const size_t nbytes = static_cast<size_t>(count) * sizeof(T);
+    m_buffer.resize(pos + nbytes);
+    if (nbytes > 0) std::memcpy(m_buffer.data() + pos, data, nbytes);
+}
+
+//-----------------------------------------------------------------------------
+// Function posts a non-blocking write of a memory block at given offset.
+//-----------------------------------------------------------------------------
+void Post(MPI_Offset offset, const void * data, size_t nbytes)
+{
+    MPI_Request request = MPI_REQUEST_NULL;
+    MPI_CHECK(MPI_File_iwrite_at(m_file, offset, const_cast<void*>(data),
+                                 static_cast<int>(nbytes), MPI_BYTE,
+                                 &request));
+    m_requests.push_back(request);
+}
+
+private:
+    std::string              m_filename;    ///< name of checkpoint file
+    long                     m_period;      ///< checkpoint period in steps
+    size2d_t                 m_subdomain_size; ///< size of subdomain
+    MPI_File                 m_file;        ///< file being written
+    int64_t                  m_header[HEADER_SIZE]; ///< file header
+    std::vector<int64_t>     m_index;       ///< (flat index, offset) pairs
+    std::vector<char>        m_buffer;      ///< records of local subdomains
+    std::vector<MPI_Request> m_requests;    ///< pending write requests
+    long                     m_count;       ///< number of checkpoints
+    double                   m_bytes;       ///< total size of local records
+    double                   m_time;        ///< time this process is blocked
+
+};  // class MpiCheckpoint
+
+}   // namespace amdados
@@ -28,11 +28,41 @@ virtual ~InputData() {}
 //-----------------------------------------------------------------------------
 virtual void Load(const Configuration & conf, MpiGrid & grid) const
 {
-    LoadSensorLocations(conf, grid);
-    LoadSensorMeasurements(conf, grid);
+    if (conf.IsExist("input_format") &&
+            (conf.asString("input_format") == "binary")) {
+        LoadDataset(conf, grid);
+    } else {
+        LoadSensorLocations(conf, grid);
+        LoadSensorMeasurements(conf, grid);
+    }
 }
 
 private:
+//-----------------------------------------------------------------------------
+// Function reads sensor locations and observations of the subdomains attached
+// to this process from the binary dataset (see SensorDataset): the records of
+// the other subdomains are never touched, so the amount of data read by
+// a process is proportional to the number of its subdomains.
+//-----------------------------------------------------------------------------
+virtual void LoadDataset(const Configuration & conf, MpiGrid & grid) const
+{
+    std::string filename = MakeFileName(conf, "dataset");
+    CheckFileExists(conf, filename);
+    SensorDataset dataset(conf);
+    dataset.Open(filename);
+
+    Matrix obs;
+    grid.forAllLocal([&](SubDomain * sd) {
+        sd->StartSensorsInitialization(conf);
+        dataset.Read(sd->m_pos, sd->m_sensors, &obs);
+        sd->FinalizeSensorsInitialization(conf);
+        sd->StartObservationsInitialization(conf);
+        sd->m_observations = obs;
+        sd->FinalizeObservationsInitialization(conf);
+    });
+    MY_LOG(INFO) << "Sensor locations and observations have been loaded";
+}
+
 //-----------------------------------------------------------------------------
 // Function reads the file of sensor locations and places their coordinates
 // into subdomains attached to this process.
@@ -14,9 +14,10 @@ class MpiOutputWriter
 {
 public:
 //-----------------------------------------------------------------------------
-// Constructor open the output file for writing.
+// Constructor open the output file for writing. On restart, the first
+// 'num_kept' fields already recorded in the file are kept.
 //-----------------------------------------------------------------------------
-MpiOutputWriter(const Configuration & conf)
+MpiOutputWriter(const Configuration & conf, long num_kept = 0)
     : m_file(MPI_FILE_NULL)
     , m_buffer()
     , m_base(0)
@@ -28,8 +29,13 @@ MpiOutputWriter(const Configuration & conf)
         MY_LOG(ERROR) << "failed to open file " << filename << " for writing";
         PrintErrorAndExit(nullptr);
     }
-    MPI_CHECK(MPI_File_set_size(m_file, 0));
+    if (num_kept == 0) {
+        MPI_CHECK(MPI_File_set_size(m_file, 0));
+    }
     MPI_CHECK(MPI_File_get_position(m_file, &m_base));
+    m_base += static_cast<MPI_Offset>(num_kept) *
+              static_cast<MPI_Offset>(4 * sizeof(float)) *
+              static_cast<MPI_Offset>(conf.asInt("global_problem_size"));
 }
 
 //-----------------------------------------------------------------------------
@@ -56,26 +62,27 @@ virtual void Write(long timestamp, const MpiGrid & grid)
         size_t buffer_size = 0;
         grid.forAllLocal([&](const SubDomain * sd) {
             buffer_size += 4 * static_cast<size_t>(sd->m_size.x * sd->m_size.y);
-            assert_true((sd->m_curr_field.NRows() == sd->m_size.x + 2) &&
-                        (sd->m_curr_field.NCols() == sd->m_size.y + 2));
+            assert_true((sd->m_curr_field.NRows() == sd->m_ex_size.x) &&
+                        (sd->m_curr_field.NCols() == sd->m_ex_size.y));
         });
         if (m_buffer.empty()) m_buffer.resize(buffer_size);
         assert_true(m_buffer.size() == buffer_size);
     }
 
     // Fill up 4-column binary buffer: (time, abscissa, ordinate, value).
-    // Recall, field occupies extended subdomain so we take field(x+1,y+1)
-    // rather than field(x,y).
+    // Recall, field occupies extended subdomain so we take
+    // field(x+halo,y+halo) rather than field(x,y).
     size_t idx = 0;
     grid.forAllLocal([&idx,timestamp,this](const SubDomain * sd) {
         const Matrix & field = sd->m_curr_field;
+        const int w = static_cast<int>(sd->m_halo);
         for (int x = 0; x < sd->m_size.x; ++x) {
         for (int y = 0; y < sd->m_size.y; ++y) {
             point2d_t glo = sd->sub2glo(point2d_t(x,y)); // global coordinates
             m_buffer[idx + 0] = static_cast<float>(timestamp);
             m_buffer[idx + 1] = static_cast<float>(glo.x);
             m_buffer[idx + 2] = static_cast<float>(glo.y);
-            m_buffer[idx + 3] = static_cast<float>(field(x + 1, y + 1));
+            m_buffer[idx + 3] = static_cast<float>(field(x + w, y + w));
             idx += 4;
         }}
     });
@@ -16,11 +16,9 @@ public:
     Matrix        m_curr_field;   // current subdomain state field
     Matrix        m_next_field;   // next subdomain state field
 
-    KalmanFilter  m_Kalman;       // Kalman filter
-    Matrix        m_B;            // inverse model matrix
+    Matrix        m_B;            // inverse model matrix (no sensors)
 
     Matrix        m_P;            // process model covariance
-    Matrix        m_Q;            // process noise covariance
     Matrix        m_H;            // observation matrix
     Matrix        m_R;            // observation noise covariance
     Vector        m_z;            // observation vector
@@ -29,9 +27,11 @@ public:
     Matrix        m_observations; // all the measurements at sensors
 
     LUdecomposition m_LU;         // used for state propagation without sensors
+    StencilSolver   m_stencil;    // replaces m_B and m_LU in memory-lean mode
 
     size2d_t      m_size;         // size of this subdomain
     size2d_t      m_ex_size;      // size of extended subdomain
+    long          m_halo;         // number of extra point layers on a side
     size2d_t      m_grid_size;    // grid size in number of subdomains
     point2d_t     m_pos;          // subdomain's position on the grid
     size_t        m_Nt;           // number of time integration steps
@@ -66,38 +66,44 @@ SubDomain(const Configuration & conf, const MpiGrid & grid,
           int subdom_rank, point2d_t position)
     : m_curr_field()
     , m_next_field()
-    , m_Kalman(), m_B()
-    , m_P(), m_Q(), m_H(), m_R(), m_z()
+    , m_B()
+    , m_P(), m_H(), m_R(), m_z()
     , m_sensors(), m_observations()
-    , m_LU()
-    , m_size(), m_ex_size(), m_grid_size(grid.getGridSize()), m_pos(position)
+    , m_LU(), m_stencil()
+    , m_size(), m_ex_size(), m_halo(1)
+    , m_grid_size(grid.getGridSize()), m_pos(position)
     , m_Nt(0), m_Nsubiter(0)
     , m_ready_stage(0), m_rank(subdom_rank)
     , m_flat_pos(grid.sub2ind(position)), m_neighbour()
     , m_send_boundary(), m_recv_boundary()
     , m_send_request(), m_send_count(0)
 {
-    // Extended subdomain has extra point layers on either side and these
-    // points actually belong to the neighbour subdomains.
-    m_ex_size.x = (m_size.x = conf.asInt("subdomain_x")) + 2;
-    m_ex_size.y = (m_size.y = conf.asInt("subdomain_y")) + 2;
+    // Extended subdomain has extra point layers (halo) on either side and
+    // these points actually belong to the neighbour subdomains. With the halo
+    // wider than one point, the extended subdomains of neighbours overlap.
+    if (conf.IsExist("halo_width")) m_halo = conf.asInt("halo_width");
+    m_ex_size.x = (m_size.x = conf.asInt("subdomain_x")) + 2 * m_halo;
+    m_ex_size.y = (m_size.y = conf.asInt("subdomain_y")) + 2 * m_halo;
     assert_true((m_size.x >= 3) && (m_size.y >= 3));
+    assert_true((1 <= m_halo) && (m_halo < std::min(m_size.x, m_size.y)))
+        << "halo must be narrower than subdomain";
 
     assert_true(std::max(m_size.x, m_size.y) <= 64) <<
         "recommended subdomain size: not greater than 16x16, maximum: 64x64";
     assert_true(subdom_rank == GetRank());
 
-    m_send_boundary[Left ].resize((size_t)m_size.y);
-    m_send_boundary[Right].resize((size_t)m_size.y);
+    // Boundary strips are as deep as the halo.
+    m_send_boundary[Left ].resize((size_t)(m_halo * m_size.y));
+    m_send_boundary[Right].resize((size_t)(m_halo * m_size.y));
 
-    m_send_boundary[Down ].resize((size_t)m_size.x);
-    m_send_boundary[Up   ].resize((size_t)m_size.x);
+    m_send_boundary[Down ].resize((size_t)(m_halo * m_size.x));
+    m_send_boundary[Up   ].resize((size_t)(m_halo * m_size.x));
 
-    m_recv_boundary[Left ].resize((size_t)m_size.y);
-    m_recv_boundary[Right].resize((size_t)m_size.y);
+    m_recv_boundary[Left ].resize((size_t)(m_halo * m_size.y));
+    m_recv_boundary[Right].resize((size_t)(m_halo * m_size.y));
 
-    m_recv_boundary[Down ].resize((size_t)m_size.x);
-    m_recv_boundary[Up   ].resize((size_t)m_size.x);
+    m_recv_boundary[Down ].resize((size_t)(m_halo * m_size.x));
+    m_recv_boundary[Up   ].resize((size_t)(m_halo * m_size.x));
 
     // Neighbour subdomain sees my boundary in opposite way.
     Directions neighbour_boundary_dir[NSides];
@@ -182,7 +188,7 @@ virtual void FinalizeSensorsInitialization(const Configuration & conf)
     assert_true(m_ready_stage == 1) << "expects initialization stage 1";
     assert_true(m_observations.Size() == 0) << "no observations at this stage";
 
-    // Mind the extended subdomain: one extra point layer on either side.
+    // Mind the extended subdomain: 'm_halo' extra point layers on either side.
     const int sub_problem_size = (int)(m_ex_size.x * m_ex_size.y);
     const int Nsensors = static_cast<int>(m_sensors.size());
 
@@ -191,30 +197,57 @@ virtual void FinalizeSensorsInitialization(const Configuration & conf)
 
     m_curr_field.Resize((int)m_ex_size.x, (int)m_ex_size.y);
     m_next_field.Resize((int)m_ex_size.x, (int)m_ex_size.y);
-    m_B.Resize(sub_problem_size, sub_problem_size);
 
     // Note, we initialize the Kalman filter matrices only in the
-    // presence of sensor(s), otherwise they are useless.
+    // presence of sensor(s), otherwise they are useless. The model matrix
+    // and the process noise of those are shared by all the subdomains of
+    // the process (see BatchedKalmanFilter). In memory-lean mode, the
+    // sensorless subdomains do not need dense B either.
+    const bool memory_lean = conf.IsExist("memory_mode") &&
+                             (conf.asString("memory_mode") == "lean");
+    if ((Nsensors == 0) && !memory_lean) {
+        m_B.Resize(sub_problem_size, sub_problem_size);
+    }
     if (Nsensors > 0) {
         m_P.Resize(sub_problem_size, sub_problem_size);
-        m_Q.Resize(sub_problem_size, sub_problem_size);
         m_H.Resize(Nsensors, sub_problem_size);
         m_R.Resize(Nsensors, Nsensors);
         m_z.Resize(Nsensors);
 
         // Compute the matrix of observations H. Recall, sensor coordinates
         // were defined for normal subdomain but we operate on extended one,
-        // for this reason x+1 and y+1.
+        // for this reason x+m_halo and y+m_halo.
         for (size_t k = 0; k < m_sensors.size(); ++k) {
             long x = m_sensors[k].x;    // subdomain-local coordinates
             long y = m_sensors[k].y;
             m_H(static_cast<int>(k),
-                static_cast<int>(sub2ind_ex(x + 1, y + 1))) = 1.0;
+                static_cast<int>(sub2ind_ex(x + m_halo, y + m_halo))) = 1.0;
         }
     }
     ++m_ready_stage;
 }
 
+//-----------------------------------------------------------------------------
+// Function returns the number of bytes of the matrices of this subdomain,
+// including the LU factors allocated on the first use. The objects of
+// Kalman filter shared by the subdomains are not included.
+//-----------------------------------------------------------------------------
+size_t Bytes() const
+{
+    const index_t N = m_ex_size.x * m_ex_size.y;
+    index_t count = m_curr_field.Size() + m_next_field.Size() +
+                    m_B.Size() + m_P.Size() +
+                    m_H.Size() + m_R.Size() + m_z.Size() +
+                    m_observations.Size();
+    if (!m_B.Empty()) {
+        count += N * N;                             // LU factors of B
+    } else if (m_sensors.empty()) {
+        const index_t nx = m_ex_size.x - 2, ny = m_ex_size.y - 2;
+        count += nx * ny * (2 * ny + 2);            // stencil solver
+    }
+    return static_cast<size_t>(count) * sizeof(double);
+}
+
 //-----------------------------------------------------------------------------
 // Call this function right before loading sensor observations from file.
 //-----------------------------------------------------------------------------
@@ -256,6 +289,9 @@ virtual void FinalizeObservationsInitialization(const Configuration &)
 // e i i i i i e            e i i i i r e        r i i i i i e
 // e i i i i i e            e i i i i r e        r i i i i i e
 // e e e e e e e            e e e e e e e        e e e e e e e.
+//
+// With the halo of width w > 1 (parameter 'halo_width'), the w-deep strip
+// along the boundary is sent, so that the extended subdomains overlap.
 //-----------------------------------------------------------------------------
 virtual void SendBoundariesToNeighbours(const MpiGrid & grid, long timestamp)
 {
@@ -270,14 +306,23 @@ virtual void SendBoundariesToNeighbours(const MpiGrid & grid, long timestamp)
 //    Print();
 //}
 
-    // Get boundaries. N O T E: curr_field occupies extended subdomain.
-    for (int x = 0; x < Sx; ++x) {
-        m_send_boundary[Down][(size_t)x] = m_curr_field(x + 1, 1);
-        m_send_boundary[Up  ][(size_t)x] = m_curr_field(x + 1, Sy);
-    }
-    for (int y = 0; y < Sy; ++y) {
-        m_send_boundary[Left ][(size_t)y] = m_curr_field(1,  y + 1);
-        m_send_boundary[Right][(size_t)y] = m_curr_field(Sx, y + 1);
+    // Get boundary strips as deep as the halo, the k-th row of a strip is
+    // the k-th point layer from the boundary inwards.
+    // N O T E: curr_field occupies extended subdomain.
+    const int w = static_cast<int>(m_halo);
+    for (int k = 0; k < w; ++k) {
+        for (int x = 0; x < Sx; ++x) {
+            m_send_boundary[Down][(size_t)(k * Sx + x)] =
+                                        m_curr_field(x + w, w + k);
+            m_send_boundary[Up  ][(size_t)(k * Sx + x)] =
+                                        m_curr_field(x + w, Sy + w - 1 - k);
+        }
+        for (int y = 0; y < Sy; ++y) {
+            m_send_boundary[Left ][(size_t)(k * Sy + y)] =
+                                        m_curr_field(w + k, y + w);
+            m_send_boundary[Right][(size_t)(k * Sy + y)] =
+                                        m_curr_field(Sx + w - 1 - k, y + w);
+        }
     }
 
     // Send boundaries to all neighbour subdomains in non-blocking fashion.
@@ -329,63 +374,92 @@ virtual void ReceiveBoundariesFromNeighbours(long timestamp)
     };
 
     Matrix & field = m_curr_field;  // short-hand alias
-//if (tt == 1 && m_pos.x == 0 && m_pos.y == 1) {
-//    Print();
-//}
+    const int w = static_cast<int>(m_halo);
+
     // Set up left-most points from the right boundary of the left neighbour.
     if (m_pos.x > 0) {
         double_array_t & boundary = Receive(Left);
-        for (int y = 0; y < Sy; ++y) field(0, y+1) = boundary[(size_t)y];
-    } else {
-        for (int y = 0; y < Sy; ++y) field(0, y+1) = field(2, y+1);
+        for (int k = 0; k < w; ++k) {
+        for (int y = 0; y < Sy; ++y) {
+            field(w-1-k, y+w) = boundary[(size_t)(k * Sy + y)];
+        }}
     }
-//if (tt == 1 && m_pos.x == 0 && m_pos.y == 1) {
-//    Print();
-//}
     // Set up right-most points from the left boundary of the right neighbour.
     if (m_pos.x + 1 < m_grid_size.x) {
         double_array_t & boundary = Receive(Right);
-        for (int y = 0; y < Sy; ++y) field(Sx+1, y+1) = boundary[(size_t)y];
-    } else {
-        for (int y = 0; y < Sy; ++y) field(Sx+1, y+1) = field(Sx-1, y+1);
+        for (int k = 0; k < w; ++k) {
+        for (int y = 0; y < Sy; ++y) {
+            field(Sx+w+k, y+w) = boundary[(size_t)(k * Sy + y)];
+        }}
     }
-//if (tt == 1 && m_pos.x == 0 && m_pos.y == 1) {
-//    Print();
-//}
     // Set up bottom-most points from the top boundary of the bottom neighbour.
     if (m_pos.y > 0) {
         double_array_t & boundary = Receive(Down);
-        for (int x = 0; x < Sx; ++x) field(x+1, 0) = boundary[(size_t)x];
-    } else {
-        for (int x = 0; x < Sx; ++x) field(x+1, 0) = field(x+1, 2);
+        for (int k = 0; k < w; ++k) {
+        for (int x = 0; x < Sx; ++x) {
+            field(x+w, w-1-k) = boundary[(size_t)(k * Sx + x)];
+        }}
     }
-//if (tt == 1 && m_pos.x == 0 && m_pos.y == 1) {
-//    Print();
-//}
     // Set up top-most points from the bottom boundary of the top neighbour.
     if (m_pos.y + 1 < m_grid_size.y) {
         double_array_t & boundary = Receive(Up);
-        for (int x = 0; x < Sx; ++x) field(x+1, Sy+1) = boundary[(size_t)x];
-    } else {
-        for (int x = 0; x < Sx; ++x) field(x+1, Sy+1) = field(x+1, Sy-1);
+        for (int k = 0; k < w; ++k) {
+        for (int x = 0; x < Sx; ++x) {
+            field(x+w, Sy+w+k) = boundary[(size_t)(k * Sx + x)];
+        }}
     }
-//if (tt == 1 && m_pos.x == 0 && m_pos.y == 1) {
-//    Print();
-//}
-//if (tt == 1 && m_pos.x == 0 && m_pos.y == 0) {
-//    std::cout << "!!!(0,0)!!!" << std::endl;
-//    Print();
-//}
+    FillOuterHalo();
+}
+
+//-----------------------------------------------------------------------------
+// Function sets up the halo points that do not come from the neighbours:
+// the ones outside the whole domain are mirrored, which provides zero
+// boundary condition on the density derivative along the normal: du/dn = 0,
+// and the corners of extended subdomain. Between the exchanges (see the
+// parameter 'halo_exchange_period') this is the only update of the halo,
+// the rest of it keeps the values computed by this subdomain itself.
+//-----------------------------------------------------------------------------
+void FillOuterHalo()
+{
+    const int Sx = static_cast<int>(m_size.x);
+    const int Sy = static_cast<int>(m_size.y);
+    const int w = static_cast<int>(m_halo);
+    Matrix & field = m_curr_field;  // short-hand alias
+
+    for (int k = 0; k < w; ++k) {
+        if (m_pos.x == 0) {
+            for (int y = w; y < Sy+w; ++y) field(w-1-k, y) = field(w+1+k, y);
+        }
+        if (m_pos.x + 1 == m_grid_size.x) {
+            for (int y = w; y < Sy+w; ++y) field(Sx+w+k, y) = field(Sx+w-2-k, y);
+        }
+        if (m_pos.y == 0) {
+            for (int x = w; x < Sx+w; ++x) field(x, w-1-k) = field(x, w+1+k);
+        }
+        if (m_pos.y + 1 == m_grid_size.y) {
+            for (int x = w; x < Sx+w; ++x) field(x, Sy+w+k) = field(x, Sy+w-2-k);
+        }
+    }
+
     // The corner points are not used in finite-difference scheme applied to
     // internal subdomain points, however, Kalman filter uses the entire
     // subdomain field (as currently implemented but could be avoided).
     // For the latter reason, we have to assign some reasonable values to the
     // corner points. Note, since we operate on extended subdomains, their
-    // corners belong to unreachable diagonal neighbours.
-    field(0,0)       = (field(1,0)     + field(1,1)   + field(0,1)    ) / 3.0;
-    field(0,Sy+1)    = (field(1,Sy+1)  + field(1,Sy)  + field(0,Sy)   ) / 3.0;
-    field(Sx+1,0)    = (field(Sx,0)    + field(Sx,1)  + field(Sx+1,1) ) / 3.0;
-    field(Sx+1,Sy+1) = (field(Sx,Sy+1) + field(Sx,Sy) + field(Sx+1,Sy)) / 3.0;
+    // corners belong to unreachable diagonal neighbours. A corner block of
+    // wide halo is swept outwards, every point takes the mean of its three
+    // neighbours closer to the subdomain.
+    const int Ex = static_cast<int>(m_ex_size.x);
+    const int Ey = static_cast<int>(m_ex_size.y);
+    for (int i = 0; i < w; ++i) {
+    for (int j = 0; j < w; ++j) {
+        const int x0 = w-1-i, y0 = w-1-j;       // near the origin
+        const int x1 = Ex-w+i, y1 = Ey-w+j;     // near the far end
+        field(x0,y0) = (field(x0+1,y0) + field(x0+1,y0+1) + field(x0,y0+1))/3.0;
+        field(x0,y1) = (field(x0+1,y1) + field(x0+1,y1-1) + field(x0,y1-1))/3.0;
+        field(x1,y0) = (field(x1-1,y0) + field(x1-1,y0+1) + field(x1,y0+1))/3.0;
+        field(x1,y1) = (field(x1-1,y1) + field(x1-1,y1-1) + field(x1,y1-1))/3.0;
+    }}
 }
 
 //-----------------------------------------------------------------------------
@@ -43,13 +43,35 @@ void PrintHelp()
 	std::cout << std::endl;
 	std::cout << "configuration files. See README.md for further details.";
 	std::cout << std::endl;
+	std::cout << "The option '--restart path/to/checkpoint' resumes the simulation";
+	std::cout << std::endl;
+	std::cout << "from the checkpoint taken every 'checkpoint_period' time steps.";
+	std::cout << std::endl;
+	std::cout << "The option '--scenario sweep:path/to/sweep_file' runs the";
+	std::cout << std::endl;
+	std::cout << "simulation for every line of parameter overrides in the file.";
+	std::cout << std::endl;
+	std::cout << "The option '--scenario convert' converts the text files of";
+	std::cout << std::endl;
+	std::cout << "sensors and observations into the binary dataset, which is";
+	std::cout << std::endl;
+	std::cout << "read instead of them if 'input_format' is 'binary'.";
+	std::cout << std::endl;
+	std::cout << "The option '--scenario scaling' runs the scaling study of the";
+	std::cout << std::endl;
+	std::cout << "benchmark, see the 'scaling_*' parameters.";
+	std::cout << std::endl;
 	std::cout << "The option '--help' or '-h' prints this help.";
 	std::cout << std::endl << std::endl;
 }
 
-void ScenarioSimulation(const std::string & config);
+void ScenarioSimulation(const std::string & config,
+                        const std::string & restart);
 void ScenarioSensors(const std::string & config);
+void ScenarioConvert(const std::string & config);
 void ScenarioBenchmark(const std::string & config, int size);
+void ScenarioSweep(const std::string & config, const std::string & sweep);
+void ScenarioScaling(const std::string & config);
 
 } // namespace amdados
 
@@ -64,6 +86,7 @@ int main(int argc, char ** argv)
 
         std::string scenario = "simulation";
         std::string config_file = "amdados.conf";
+        std::string restart_file;
 
         // Parse command-line options.
         for (int a = 0; a < argc; ++a) {
@@ -76,6 +99,10 @@ int main(int argc, char ** argv)
                 if (++a < argc) {
                     config_file = argv[a];
                 }
+            } else if (token == "--restart") {
+                if (++a < argc) {
+                    restart_file = argv[a];
+                }
             } else if ((token == "--help") || (token == "-h")) {
                 amdados::PrintHelp();
                 return EXIT_SUCCESS;
@@ -85,6 +112,9 @@ int main(int argc, char ** argv)
         if (scenario == "sensors") {
             MY_LOG(INFO) << "SCENARIO: generating random sensors";
             amdados::ScenarioSensors(config_file);
+        } else if (scenario == "convert") {
+            MY_LOG(INFO) << "SCENARIO: converting sensors to binary dataset";
+            amdados::ScenarioConvert(config_file);
         } else if (scenario.substr(0,9) == "benchmark") {
             MY_LOG(INFO) << "SCENARIO: 'benchmark'";
             int N = 10;
@@ -92,9 +122,19 @@ int main(int argc, char ** argv)
                 N = atoi(scenario.c_str() + 10);
             }
             amdados::ScenarioBenchmark(config_file, N);
+        } else if (scenario == "scaling") {
+            MY_LOG(INFO) << "SCENARIO: 'scaling'";
+            amdados::ScenarioScaling(config_file);
+        } else if (scenario.substr(0,5) == "sweep") {
+            MY_LOG(INFO) << "SCENARIO: 'sweep'";
+            std::string sweep_file = "sweep.txt";
+            if (scenario.size() > 5 && scenario[5] == ':') {
+                sweep_file = scenario.substr(6);
+            }
+            amdados::ScenarioSweep(config_file, sweep_file);
         } else {
             MY_LOG(INFO) << "SCENARIO: simulation with Allscale API";
-            amdados::ScenarioSimulation(config_file);
+            amdados::ScenarioSimulation(config_file, restart_file);
         }
         return EXIT_SUCCESS;
 
@@ -4,6 +4,7 @@
 //-----------------------------------------------------------------------------
 
 #ifndef AMDADOS_PLAIN_MPI
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <iomanip>
@@ -12,6 +13,7 @@
 #include <chrono>
 #include <string>
 #include <map>
+#include <utility>
 #include <vector>
 
 #include "allscale/utils/assert.h"
@@ -76,14 +78,35 @@ std::string MakeFileName(const Configuration & conf, const std::string & what)
     filename << conf.asString("output_dir") << PathSep << what
              << "_Nx" << Nx << "_Ny" << Ny;
 
+    // The output files of a variant of parameter sweep are distinguished
+    // by suffix, whereas the input ones ("sensors", "analytic", "dataset")
+    // are shared.
+    const bool output = (what != "sensors") && (what != "analytic") &&
+                        (what != "dataset");
+    if (output && conf.IsExist("file_suffix") &&
+            !conf.asString("file_suffix").empty()) {
+        filename << "_" << conf.asString("file_suffix");
+    }
+
     if (what == "sensors") {
-        filename << ".txt";
+        // Sensor locations are stored in the format of input data.
+        const bool binary = conf.IsExist("input_format") &&
+                            (conf.asString("input_format") == "binary");
+        filename << (binary ? ".bin" : ".txt");
     } else if (what == "analytic") {
         filename << "_Nt" << conf.asInt("Nt") << ".txt";
+    } else if (what == "dataset") {
+        filename << "_Nt" << conf.asInt("Nt") << ".bin";
     } else if (what == "field") {
         filename << "_Nt" << conf.asInt("Nt") << ".bin";
     } else if (what == "final_field") {
         filename << "_Nt" << conf.asInt("Nt") << ".txt";
+    } else if (what == "analytics") {
+        filename << "_Nt" << conf.asInt("Nt") << ".txt";
+    } else if (what == "sweep") {
+        filename << "_Nt" << conf.asInt("Nt") << ".txt";
+    } else if (what == "checkpoint") {
+        filename << "_Nt" << conf.asInt("Nt") << ".ckpt";
     } else {
         assert_true(0) << "unknown entity to make a file name from";
     }
@@ -93,6 +116,177 @@ std::string MakeFileName(const Configuration & conf, const std::string & what)
     return filename.str();
 }
 
+/**
+ * Function computes flow components given the physical time.
+ * \return a pair of flow components (flow_x, flow_y).
+ */
+std::pair<double,double> Flow(const Configuration & conf, double time)
+{
+    const double max_vx = conf.asDouble("flow_model_max_vx");
+    const double max_vy = conf.asDouble("flow_model_max_vy");
+    const double t = time / (conf.asDouble("dt") * conf.asDouble("Nt"));
+    return std::make_pair( -max_vx * std::sin(0.1 * t - M_PI),
+                           -max_vy * std::sin(0.2 * t - M_PI) );
+}
+
+/**
+ * Function computes the rate (per second) of the Courant number, i.e. the
+ * number of nodal points the substance travels per second, given the flow
+ * velocity. The diffusion number is not included: it limits the step of
+ * explicit scheme, whereas the implicit one is stable for any step.
+ */
+static double CourantRate(const Configuration & conf,
+                          const std::pair<double,double> & flow)
+{
+    const double dx = conf.asDouble("dx");
+    const double dy = conf.asDouble("dy");
+    return std::fabs(flow.first) / dx + std::fabs(flow.second) / dy;
+}
+
+/**
+ * Function initializes the time step "dt" and the number of time steps "Nt".
+ * The step is chosen from the stability criteria for the worst case flow
+ * unless the user defined one is smaller. The step also defines the time grid
+ * where observations are sampled. In the adaptive mode (time_stepping is set
+ * to "adaptive") the actual integration steps are chosen on the fly, see
+ * MakeTimeSchedule(), while "dt" and "Nt" still describe the observations.
+ */
+void InitTimeStepping(Configuration & conf)
+{
+    const double D = conf.asDouble("diffusion_coef");
+    const double dx = conf.asDouble("dx");
+    const double dy = conf.asDouble("dy");
+    const double dt_base = conf.asDouble("integration_period") /
+                           conf.asDouble("integration_nsteps");
+    const double max_vx = conf.asDouble("flow_model_max_vx");
+    const double max_vy = conf.asDouble("flow_model_max_vy");
+
+    // This time step is defined according to stability criteria.
+    const double dt = std::min(dt_base,
+                        std::min( std::min(dx*dx, dy*dy)/(2.0*D + TINY),
+                                  1.0/(std::fabs(max_vx)/dx +
+                                       std::fabs(max_vy)/dy + TINY) ));
+    assert_true(dt > TINY);
+    conf.SetDouble("dt", dt);
+    conf.SetInt("Nt", static_cast<int>(
+                        std::ceil(conf.asDouble("integration_period") / dt)));
+
+    if (conf.IsExist("time_stepping")) {
+        const std::string & mode = conf.asString("time_stepping");
+        assert_true((mode == "fixed") || (mode == "adaptive"))
+            << "time_stepping must be either 'fixed' or 'adaptive'";
+        if (mode == "adaptive") {
+            assert_true(conf.asDouble("cfl_target") > 0.0);
+            assert_true(conf.asDouble("dt_max") > TINY);
+        }
+    }
+}
+
+/**
+ * Function creates the schedule of Nt steps of equal length dt,
+ * each one comprises Nsubiter sub-iterations.
+ */
+time_schedule_t MakeUniformTimeSchedule(size_t Nt, double dt, size_t Nsubiter)
+{
+    assert_true((Nt > 0) && (Nsubiter > 0));
+    time_schedule_t schedule(Nt);
+    for (size_t k = 0; k < Nt; ++k) {
+        schedule[k].time = static_cast<double>(k) * dt;
+        schedule[k].dt = dt;
+        schedule[k].Nsubiter = Nsubiter;
+        schedule[k].first = k * Nsubiter;
+    }
+    return schedule;
+}
+
+/**
+ * Function creates the schedule of time integration. In the fixed mode,
+ * there are Nt steps of length dt with "num_sub_iter" sub-iterations each.
+ * In the adaptive mode, every step is chosen from the current flow so that
+ * the Courant number does not exceed "cfl_target", which bounds the accuracy
+ * of implicit scheme for advection, and the step does not exceed "dt_max".
+ * The implicit scheme is stable anyway, so neither the diffusion number
+ * nor the explicit stability limit restrict the step, and calm periods get
+ * much longer steps. The number of sub-iterations, which
+ * iron out discrepancies along subdomain boundaries, follows the number of
+ * nodal points the substance travels per step, up to "num_sub_iter".
+ */
+time_schedule_t MakeTimeSchedule(const Configuration & conf)
+{
+    const size_t Nsubiter = conf.asUInt("num_sub_iter");
+    const bool adaptive = conf.IsExist("time_stepping") &&
+                          (conf.asString("time_stepping") == "adaptive");
+    if (!adaptive) {
+        return MakeUniformTimeSchedule(conf.asUInt("Nt"),
+                                       conf.asDouble("dt"), Nsubiter);
+    }
+
+    const double T = conf.asDouble("integration_period");
+    const double cfl = conf.asDouble("cfl_target");
+    const double dt_max = conf.asDouble("dt_max");
+
+    time_schedule_t schedule;
+    double time = 0.0;
+    size_t first = 0;
+    while (time < T * (1.0 - 1e-12)) {
+        const double rate = CourantRate(conf, Flow(conf, time));
+        TimeStep step;
+        step.time = time;
+        step.dt = std::min(std::min(dt_max, cfl / (rate + TINY)), T - time);
+        step.Nsubiter = static_cast<size_t>(std::min(
+                            std::max(std::ceil(step.dt * rate), 1.0),
+                            static_cast<double>(std::max(Nsubiter, size_t(1)))));
+        step.first = first;
+        schedule.push_back(step);
+        time += step.dt;
+        first += step.Nsubiter;
+    }
+    return schedule;
+}
+
+/**
+ * Function returns the total number of sub-iterations over all the steps.
+ */
+size_t NumSubIterations(const time_schedule_t & schedule)
+{
+    return schedule.empty() ? 0 :
+            (schedule.back().first + schedule.back().Nsubiter);
+}
+
+/**
+ * Function returns the index of the step the global sub-iteration belongs to.
+ */
+size_t FindTimeStep(const time_schedule_t & schedule, size_t timestamp)
+{
+    assert_true(timestamp < NumSubIterations(schedule));
+    auto it = std::upper_bound(schedule.begin(), schedule.end(), timestamp,
+                    [](size_t t, const TimeStep & s) { return t < s.first; });
+    return static_cast<size_t>(std::distance(schedule.begin(), it)) - 1;
+}
+
+/**
+ * Function maps the physical time onto the rows of observation matrix,
+ * which are sampled every "dt" seconds, and returns the lower row index.
+ * The observations are linearly interpolated between the lower and the next
+ * rows with the weight of the latter one returned in the 2nd parameter.
+ * Time points that (almost) hit the sampling grid get the exact row.
+ */
+size_t ObservationRow(const Configuration & conf, double time, double & weight)
+{
+    const size_t Nt = conf.asUInt("Nt");
+    double pos = std::max(time / conf.asDouble("dt"), 0.0);
+    if (std::fabs(pos - std::floor(pos + 0.5)) < 1e-9) {
+        pos = std::floor(pos + 0.5);
+    }
+    const size_t row = static_cast<size_t>(pos);
+    if (row + 1 >= Nt) {
+        weight = 0.0;
+        return Nt - 1;
+    }
+    weight = pos - static_cast<double>(row);
+    return row;
+}
+
 ///**
 // * Function returns the grid size as a number of subdomains
 // * in both dimensions.
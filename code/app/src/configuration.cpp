@@ -59,17 +59,11 @@ void Configuration::ReadConfigFile(const std::string & filename)
                 break;
             }
             // If not comment, the 1st token is the name, the 2nd one is
-            // the value. The value is a "double" if sscanf() succeeded,
-            // otherwise a "string".
+            // the value.
             if (count == 1) {
                 name = token;
             } else if (count == 2) {
-                double value = 0.0;
-                if (std::sscanf(token.c_str(), "%lf", &value) == 1) {
-                    SetDouble(name.c_str(), value);
-                } else {
-                    SetString(name.c_str(), token.c_str());
-                }
+                SetValue(name.c_str(), token);
             }
         }
         assert_true(!f.bad())
@@ -216,6 +210,16 @@ bool Configuration::IsInteger(const char * param_name) const
     return (asDouble(param_name) == asInt(param_name));
 }
 
+//-----------------------------------------------------------------------------
+// Function returns "true" if parameter has a numeric value.
+//-----------------------------------------------------------------------------
+bool Configuration::IsNumeric(const char * param_name) const
+{
+    auto it = m_params.find(param_name);
+    CheckExist(it != m_params.end(), param_name);
+    return (it->second.type == NUMERIC_T);
+}
+
 //-----------------------------------------------------------------------------
 // Function initializes an integer parameter.
 //-----------------------------------------------------------------------------
@@ -259,5 +263,20 @@ void Configuration::SetString(const char * param_name, const char * value)
     }
 }
 
-} // namespace amdados
+//-----------------------------------------------------------------------------
+// Function initializes a parameter from its textual value. The value is
+// a "double" if sscanf() has parsed it entirely, otherwise a "string".
+//-----------------------------------------------------------------------------
+void Configuration::SetValue(const char * param_name, const std::string & value)
+{
+    double dvalue = 0.0;
+    int    length = 0;
+    if ((std::sscanf(value.c_str(), "%lf%n", &dvalue, &length) == 1) &&
+            (static_cast<size_t>(length) == value.size())) {
+        SetDouble(param_name, dvalue);
+    } else {
+        SetString(param_name, value.c_str());
+    }
+}
 
+} // namespace amdados
@@ -23,72 +23,158 @@ namespace amdados {
 //-----------------------------------------------------------------------------
 // Serialization: load this matrix.
 //-----------------------------------------------------------------------------
+template<>
 Matrix Matrix::load(::allscale::utils::ArchiveReader & reader)
 {
 	Matrix res;
-	res.m_nrows = reader.read<index_t>();
-	res.m_ncols = reader.read<index_t>();
-	res.m_data.resize(static_cast<size_t>(res.m_nrows * res.m_ncols));
-	reader.read<double>(res.m_data.data(), res.m_data.size());
+	const index_t nrows = reader.read<index_t>();
+	const index_t ncols = reader.read<index_t>();
+	res.Resize(nrows, ncols, false);
+	reader.read<double>(res.begin(), static_cast<size_t>(res.Size()));
 	return res;
 }
 //-----------------------------------------------------------------------------
 // Serialization: store this matrix.
 //-----------------------------------------------------------------------------
+template<>
 void Matrix::store(::allscale::utils::ArchiveWriter & writer) const
 {
-	assert_true(m_data.size() == static_cast<size_t>(m_nrows * m_ncols));
+	assert_true(this->m_size == m_nrows * m_ncols);
 	writer.write<index_t>(m_nrows);
 	writer.write<index_t>(m_ncols);
-	writer.write<double>(m_data.data(), m_data.size());
+	writer.write<double>(begin(), static_cast<size_t>(Size()));
 }
 #endif	// AMDADOS_PLAIN_MPI
 
-//-----------------------------------------------------------------------------
-// Matrix multiplication: result = A * B.
-// @param  result  out: nrows-x-ncols matrix.
-// @param  A       nrows-x-msize matrix.
-// @param  B       msize-x-ncols matrix.
-//-----------------------------------------------------------------------------
-void MatMult(Matrix & result, const Matrix & A, const Matrix & B)
+namespace {
+
+// The kernels below are instantiated for double-precision matrices and for
+// single-precision ones, where the products are still accumulated in double.
+
+template<typename T>
+bool Distinct(const BasicVector<T> & a, const BasicVector<T> & b)
+{
+    return a.IsDistinct(b);
+}
+
+template<typename T, typename U>
+bool Distinct(const BasicVector<T> &, const BasicVector<U> &)
+{
+    return true;
+}
+
+template<typename R, typename T, typename U>
+void MatMultImpl(BasicMatrix<R> & result, const BasicMatrix<T> & A,
+                                          const BasicMatrix<U> & B)
 {
 	const index_t nrows = A.NRows();
 	const index_t msize = A.NCols();
 	const index_t ncols = B.NCols();
-    assert_true(result.IsDistinct(A) && result.IsDistinct(B));
+    assert_true(Distinct(result, A) && Distinct(result, B));
     assert_true((result.NRows() == nrows) &&
                 (result.NCols() == ncols) && (msize == B.NRows()));
 	for(index_t r = 0; r < nrows; ++r) {
 	for(index_t c = 0; c < ncols; ++c) {
         double sum = 0.0;
-        for (index_t k = 0; k < msize; ++k) { sum += A(r,k) * B(k,c); }
-        result(r,c) = sum;
+        for (index_t k = 0; k < msize; ++k) {
+            sum += static_cast<double>(A(r,k)) * static_cast<double>(B(k,c));
+        }
+        result(r,c) = static_cast<R>(sum);
     }}
 }
 
-//-----------------------------------------------------------------------------
-// Matrix multiplication with transposition: result = A * B^t.
-// Note, the matrix B is only logically but not explicitly transposed.
-// @param  result  out: nrows-x-ncols matrix.
-// @param  A       nrows-x-msize matrix.
-// @param  B       ncols-x-msize matrix.
-//-----------------------------------------------------------------------------
-void MatMultTr(Matrix & result, const Matrix & A, const Matrix & B)
+template<typename R, typename T, typename U>
+void MatMultTrImpl(BasicMatrix<R> & result, const BasicMatrix<T> & A,
+                                            const BasicMatrix<U> & B)
 {
     const index_t nrows = A.NRows();
     const index_t ncols = B.NRows();
     const index_t msize = B.NCols();
-    assert_true(result.IsDistinct(A) && result.IsDistinct(B));
+    assert_true(Distinct(result, A) && Distinct(result, B));
     assert_true((result.NRows() == nrows) &&
                 (result.NCols() == ncols) && (A.NCols() == msize));
     for (index_t r = 0; r < nrows; ++r) {
     for (index_t c = 0; c < ncols; ++c) {     // get B as transposed
         double sum = 0.0;
-        for (index_t k = 0; k < msize; ++k) { sum += A(r,k) * B(c,k); }
-        result(r,c) = sum;
+        for (index_t k = 0; k < msize; ++k) {
+            sum += static_cast<double>(A(r,k)) * static_cast<double>(B(c,k));
+        }
+        result(r,c) = static_cast<R>(sum);
     }}
 }
 
+template<typename R, typename T, typename U, typename OPERATION>
+void ElementwiseImpl(BasicMatrix<R> & result, const BasicMatrix<T> & A,
+                     const BasicMatrix<U> & B, OPERATION op)
+{
+    assert_true((result.NRows() == A.NRows()) &&
+                (result.NCols() == A.NCols()) &&
+                (result.NRows() == B.NRows()) &&
+                (result.NCols() == B.NCols()));
+    std::transform(A.begin(), A.end(), B.begin(), result.begin(),
+                   [op](T a, U b) {
+                        return static_cast<R>(op(static_cast<double>(a),
+                                                 static_cast<double>(b)));
+                   });
+}
+
+template<typename T>
+void SymmetrizeImpl(BasicMatrix<T> & A)
+{
+    const index_t nrows = A.NRows();
+    assert_true(A.IsSquare());
+    for (index_t i = 0;     i < nrows; ++i) {
+    for (index_t j = i + 1; j < nrows; ++j) {
+        A(j,i) = A(i,j) = static_cast<T>(0.5 * (static_cast<double>(A(j,i)) +
+                                                static_cast<double>(A(i,j))));
+    }}
+}
+
+template<typename T>
+double TraceImpl(const BasicMatrix<T> & A)
+{
+    const index_t nrows = A.NRows();
+    assert_true(A.IsSquare());
+    double sum = 0.0;
+    for (index_t i = 0; i < nrows; ++i) { sum += A(i,i); }
+    return sum;
+}
+
+} // anonymous namespace
+
+//-----------------------------------------------------------------------------
+// Matrix multiplication: result = A * B.
+// @param  result  out: nrows-x-ncols matrix.
+// @param  A       nrows-x-msize matrix.
+// @param  B       msize-x-ncols matrix.
+//-----------------------------------------------------------------------------
+void MatMult(Matrix & result, const Matrix & A, const Matrix & B)
+{
+    MatMultImpl(result, A, B);
+}
+
+void MatMult(MatrixF & result, const Matrix & A, const Matrix & B)
+{
+    MatMultImpl(result, A, B);
+}
+
+//-----------------------------------------------------------------------------
+// Matrix multiplication with transposition: result = A * B^t.
+// Note, the matrix B is only logically but not explicitly transposed.
+// @param  result  out: nrows-x-ncols matrix.
+// @param  A       nrows-x-msize matrix.
+// @param  B       ncols-x-msize matrix.
+//-----------------------------------------------------------------------------
+void MatMultTr(Matrix & result, const Matrix & A, const Matrix & B)
+{
+    MatMultTrImpl(result, A, B);
+}
+
+void MatMultTr(Matrix & result, const MatrixF & A, const Matrix & B)
+{
+    MatMultTrImpl(result, A, B);
+}
+
 //-----------------------------------------------------------------------------
 // Matrix-vector multiplication: result = A * v.
 //-----------------------------------------------------------------------------
@@ -132,9 +218,12 @@ void SubtractVectors(Vector & result,
 //-----------------------------------------------------------------------------
 void AddMatrices(Matrix & result, const Matrix & A, const Matrix & B)
 {
-    assert_true(result.SameSize(A) && result.SameSize(B));
-    std::transform(A.begin(), A.end(), B.begin(), result.begin(),
-                   std::plus<double>());
+    ElementwiseImpl(result, A, B, std::plus<double>());
+}
+
+void AddMatrices(MatrixF & result, const MatrixF & A, const Matrix & B)
+{
+    ElementwiseImpl(result, A, B, std::plus<double>());
 }
 
 //-----------------------------------------------------------------------------
@@ -142,9 +231,12 @@ void AddMatrices(Matrix & result, const Matrix & A, const Matrix & B)
 //-----------------------------------------------------------------------------
 void SubtractMatrices(Matrix & result, const Matrix & A, const Matrix & B)
 {
-    assert_true(result.SameSize(A) && result.SameSize(B));
-    std::transform(A.begin(), A.end(), B.begin(), result.begin(),
-                   std::minus<double>());
+    ElementwiseImpl(result, A, B, std::minus<double>());
+}
+
+void SubtractMatrices(MatrixF & result, const MatrixF & A, const MatrixF & B)
+{
+    ElementwiseImpl(result, A, B, std::minus<double>());
 }
 
 //-----------------------------------------------------------------------------
@@ -181,13 +273,84 @@ void GetTransposed(Matrix & At, const Matrix & A)
 // property. The function brings the matrix back to symmetry.
 //-----------------------------------------------------------------------------
 void Symmetrize(Matrix & A)
+{
+    SymmetrizeImpl(A);
+}
+
+void Symmetrize(MatrixF & A)
+{
+    SymmetrizeImpl(A);
+}
+
+//-----------------------------------------------------------------------------
+// Function computes LQ decomposition of a matrix A (nrows <= ncols) by
+// Householder reflections: A*T = [L 0], where T is orthogonal, and overwrites
+// A by [L 0]. The lower triangular L has non-negative diagonal. Since
+// L*L^t = A*A^t, the function re-factorizes a sum of products of square-root
+// factors without forming the product itself.
+//-----------------------------------------------------------------------------
+void LowerTriangularize(Matrix & A)
 {
     const index_t nrows = A.NRows();
-    assert_true(A.IsSquare());
-    for (index_t i = 0;     i < nrows; ++i) {
-    for (index_t j = i + 1; j < nrows; ++j) {
-        A(j,i) = A(i,j) = 0.5 * (A(j,i) + A(i,j));
-    }}
+    const index_t ncols = A.NCols();
+    assert_true(nrows <= ncols);
+    for (index_t i = 0; i < nrows; ++i) {
+        double * v = &A(i,0);                   // reflection vector, v[i:]
+        double norm = 0.0;
+        for (index_t j = i; j < ncols; ++j) { norm += v[j] * v[j]; }
+        norm = std::sqrt(norm);
+        if (norm == 0.0) continue;
+
+        // Reflect the row i onto [alpha 0 ... 0]; the sign of alpha is
+        // chosen to avoid cancellation in v[i] = v[i] - alpha.
+        // Note, |v|^2 = 2*norm*(norm + |v[i]|) after the subtraction.
+        const double alpha = (v[i] > 0.0) ? -norm : norm;
+        const double beta = 1.0 / (norm * (norm + std::fabs(v[i])));
+        v[i] -= alpha;
+        for (index_t r = i + 1; r < nrows; ++r) {
+            double * a = &A(r,0);
+            double sum = 0.0;
+            for (index_t j = i; j < ncols; ++j) { sum += a[j] * v[j]; }
+            sum *= beta;
+            for (index_t j = i; j < ncols; ++j) { a[j] -= sum * v[j]; }
+        }
+        v[i] = alpha;
+        for (index_t j = i + 1; j < ncols; ++j) { v[j] = 0.0; }
+    }
+
+    // Flipping the sign of a column keeps T orthogonal.
+    for (index_t i = 0; i < nrows; ++i) {
+        if (A(i,i) < 0.0) {
+            for (index_t r = i; r < nrows; ++r) { A(r,i) = -A(r,i); }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function updates the lower triangular factor L in place by a rank-one
+// term: L_new*L_new^t = L*L^t + v*v^t, where the vector v is destroyed.
+// The column k of L and v are rotated (Givens) so that v(k) vanishes;
+// the leading zeros of v are skipped, so the update costs O((N - first)^2)
+// for the first non-zero entry of v. The diagonal of L stays non-negative
+// given it was non-negative on entry.
+//-----------------------------------------------------------------------------
+void CholeskyUpdate(Matrix & L, Vector & v)
+{
+    const index_t N = L.NRows();
+    assert_true(L.IsSquare() && (v.Size() == N));
+    for (index_t k = 0; k < N; ++k) {
+        const double a = L(k,k), b = v(k);
+        if (b == 0.0) continue;
+        const double r = std::hypot(a, b);
+        const double c = a / r, s = b / r;
+        L(k,k) = r;
+        v(k) = 0.0;
+        for (index_t i = k + 1; i < N; ++i) {
+            const double t = L(i,k);
+            L(i,k) = c * t + s * v(i);
+            v(i) = c * v(i) - s * t;
+        }
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -227,11 +390,12 @@ double NormDiff(const Vector & a, const Vector & b)
 //-----------------------------------------------------------------------------
 double Trace(const Matrix & A)
 {
-    const index_t nrows = A.NRows();
-    assert_true(A.IsSquare());
-    double sum = 0.0;
-    for (index_t i = 0; i < nrows; ++i) { sum += A(i,i); }
-    return sum;
+    return TraceImpl(A);
+}
+
+double Trace(const MatrixF & A)
+{
+    return TraceImpl(A);
 }
 
 //-----------------------------------------------------------------------------
@@ -3,15 +3,22 @@
 // Copyright : IBM Research Ireland, 2017-2018
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <iomanip>
 #include <map>
+#include <memory>
 #include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "allscale/api/user/data/adaptive_grid.h"
 #include "allscale/api/user/algorithm/pfor.h"
 #include "allscale/api/core/io.h"
+#include "allscale/api/core/impl/reference/treeture.h"
 #include "allscale/utils/assert.h"
 #include "allscale/utils/vector.h"
 
@@ -31,7 +38,9 @@ using ::allscale::api::user::data::GridPoint;
 void InitDependentParams(Configuration & conf);
 void RunDataAssimilation(const Configuration         & conf,
                          const Grid<point_array_t,2> & sensors,
-                         const Grid<Matrix,2>        & observations);
+                         const Grid<Matrix,2>        & observations,
+                         double_array_t              * final_field,
+                         RunProfile                  * profile);
 
 // Defined in "scenario_sensors.cpp":
 void OptimizePointLocations(double_array_t & x, double_array_t & y);
@@ -55,9 +64,6 @@ void GenerateSensorData(const Configuration   & conf,
 //	const double fraction =
 //			Bound(conf.asDouble("sensor_fraction"), 0.001, 0.75);
 
-	const size2d_t finest_layer_size(conf.asUInt("subdomain_x"),
-									 conf.asUInt("subdomain_y"));
-
 	// --- initialize sensor positions ---
 
 //	// Function scales a coordinate from [0..1] range to specified size.
@@ -80,38 +86,9 @@ void GenerateSensorData(const Configuration   & conf,
 //	InitialGuess(conf, x, y, point2d_t(0,0));
 //	OptimizePointLocations(x, y);
 
-	// temporary sensor location storage
-	std::map< point2d_t, std::vector<point2d_t> > locations;
-
-//	// Save (scaled) sensor locations to temporary storage.
-//	for (int k = 0; k < Nobs; ++k) {
-//		auto xk = ScaleCoord(x[k], Nx);
-//		auto yk = ScaleCoord(y[k], Ny);
-//		// insert sensor position
-//		point2d_t pt{xk,yk};
-//		point2d_t idx = allscale::utils::elementwiseDivision(
-//													pt, finest_layer_size);
-//		assert_true((0 <= idx.x) && (idx.x < GridSize.x));
-//		assert_true((0 <= idx.y) && (idx.y < GridSize.y));
-//
-//		locations[idx].push_back(pt % finest_layer_size);
-//	}
-
-	point_array_t sensor_positions;
-	SensorsGenerator().MakeSensors(conf, sensor_positions);
-
-    // Save sensor locations to temporary storage.
-	for (size_t k = 0; k < sensor_positions.size(); ++k) {
-		auto x = sensor_positions[k].x;
-		auto y = sensor_positions[k].y;
-		// insert sensor position
-		point2d_t pt{x,y};
-		point2d_t idx =
-		        allscale::utils::elementwiseDivision(pt, finest_layer_size);
-		assert_true((0 <= idx.x) && (idx.x < GridSize.x));
-		assert_true((0 <= idx.y) && (idx.y < GridSize.y));
-		locations[idx].push_back(pt % finest_layer_size);
-	}
+	// Sensors of every subdomain are generated right in the parallel loop
+	// below, the outcome does not depend on the order of subdomains.
+	const SensorsGenerator generator(conf);
 
 	// --- initialize observations ---
 
@@ -121,7 +98,7 @@ void GenerateSensorData(const Configuration   & conf,
 	assert_eq(sensors.size(), GridSize);
 
 	::allscale::api::user::algorithm::pfor({0,0}, GridSize,
-			[&sensors, &observations, locations, Nt](const auto & idx) {
+			[&sensors, &observations, &generator, Nt](const auto & idx) {
 
 		allscale::api::core::sema::needs_write_access_on(sensors[idx]);
 		allscale::api::core::sema::needs_write_access_on(observations[idx]);
@@ -130,10 +107,8 @@ void GenerateSensorData(const Configuration   & conf,
 		sensors[idx].clear();
 		observations[idx].Clear();
 
-		// Copy sensor positions from temporary to simulation storage.
-		if (locations.find(idx) != locations.end()) {
-			sensors[idx] = locations.at(idx);
-		}
+		// Generate sensor positions of the subdomain.
+		generator.MakeSubdomainSensors(idx, sensors[idx]);
 
 		// Insert observations.
 		const auto num_observations = sensors[idx].size();
@@ -150,6 +125,76 @@ void GenerateSensorData(const Configuration   & conf,
 	});
 }
 
+//-----------------------------------------------------------------------------
+// Function reads a comma-separated list of numbers or a single number;
+// returns the default value if the parameter does not exist.
+//-----------------------------------------------------------------------------
+std::vector<double> ReadList(const Configuration & conf, const char * name,
+                             double default_value)
+{
+    std::vector<double> list;
+    if (!conf.IsExist(name)) {
+        list.push_back(default_value);
+    } else if (conf.IsNumeric(name)) {
+        list.push_back(conf.asDouble(name));
+    } else {
+        std::stringstream ss(conf.asString(name));
+        std::string token;
+        while (std::getline(ss, token, ',')) {
+            double value = 0.0;
+            int    length = 0;
+            assert_true((std::sscanf(token.c_str(), "%lf%n",
+                                     &value, &length) == 1) &&
+                        (static_cast<size_t>(length) == token.size()))
+                << "parameter " << name << ": not a number: " << token;
+            list.push_back(value);
+        }
+    }
+    assert_true(!list.empty()) << "parameter " << name << ": empty list";
+    return list;
+}
+
+//-----------------------------------------------------------------------------
+// Function returns the percentile (0 <= q <= 1) of the samples by linear
+// interpolation between the closest ranks.
+//-----------------------------------------------------------------------------
+double Percentile(std::vector<double> samples, double q)
+{
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    const double pos = q * static_cast<double>(samples.size() - 1);
+    const size_t lo = static_cast<size_t>(std::floor(pos));
+    const size_t hi = std::min(lo + 1, samples.size() - 1);
+    return samples[lo] + (pos - static_cast<double>(lo)) *
+                         (samples[hi] - samples[lo]);
+}
+
+//-----------------------------------------------------------------------------
+// Function sets the number of workers of the runtime, which must be idle,
+// and returns the actual number.
+//-----------------------------------------------------------------------------
+int SetNumWorkers(int num)
+{
+    using ::allscale::api::core::impl::reference::runtime::WorkerPool;
+    return WorkerPool::getInstance().setNumWorkers(num);
+}
+
+//-----------------------------------------------------------------------------
+// Measurements at a point of scaling study.
+//-----------------------------------------------------------------------------
+struct ScalingPoint
+{
+    int    workers;         // number of workers
+    int    size;            // number of subdomains in either dimension
+    double fraction;        // fraction of sensor points
+    size_t steps;           // number of time steps
+    double time[3];         // total time: median, 10th, 90th percentiles
+    double step[3];         // step time: median, 10th, 90th percentiles
+    double throughput;      // subdomain updates per second (time steps)
+    double efficiency;      // parallel efficiency
+    RunProfile phases;      // medians of phase times
+};
+
 }	// anonymous namespace
 
 //-----------------------------------------------------------------------------
@@ -181,6 +226,11 @@ void ScenarioBenchmark(const std::string & config_file, int problem_size)
 			  << config_file;
 	std::cout << "\" with domain size " << problem_size << "x" << problem_size;
 	std::cout << " for " << steps << " time steps ...\n";
+	std::cout << "Stencil mode: " << (conf.IsExist("stencil_mode") ?
+	                conf.asString("stencil_mode") : std::string("coarse"));
+	std::cout << ", sensor layout: " << (conf.IsExist("sensor_layout") ?
+	                conf.asString("sensor_layout") : std::string("uniform"));
+	std::cout << "\n";
 
     // --- generate sensor data ---
 
@@ -190,6 +240,25 @@ void ScenarioBenchmark(const std::string & config_file, int problem_size)
     Grid<Matrix,2> observations(GetGridSize(conf));
     GenerateSensorData(conf, sensors, observations);
 
+    // --- run reference simulation in double precision, if needed ---
+
+    const bool mixed_precision = conf.IsExist("precision") &&
+                                 (conf.asString("precision") == "mixed");
+    double_array_t reference, result;
+    if (mixed_precision) {
+        std::cout << "Running reference simulation in double precision ...\n";
+        Configuration ref_conf = conf;
+        ref_conf.SetString("precision", "double");
+        ref_conf.SetInt("checkpoint_period", 0);    // nothing to resume
+        ref_conf.SetInt("analytics_period", 0);
+        ref_conf.SetString("restart_file", "");
+        // The reference has its own output files, the benchmark run below
+        // writes the regular ones.
+        ref_conf.SetString("file_suffix", "reference");
+        RunDataAssimilation(ref_conf, sensors, observations, &reference,
+                            nullptr);
+    }
+
     // --- run simulation ---
 
     std::cout << "Running benchmark simulation ...\n";
@@ -198,7 +267,8 @@ void ScenarioBenchmark(const std::string & config_file, int problem_size)
 	// Run the simulation with data assimilation. Important: by this time
 	// some parameters had been initialized in InitDependentParams(..), so
 	// we can safely proceed to the main part of the simulation algorithm.
-	RunDataAssimilation(conf, sensors, observations);
+	RunDataAssimilation(conf, sensors, observations,
+	                    mixed_precision ? &result : nullptr, nullptr);
 
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = end - start;
@@ -211,7 +281,210 @@ void ScenarioBenchmark(const std::string & config_file, int problem_size)
 
     double throughput = (problem_size * problem_size * steps) / time;
     std::cout << "Throughput: " << throughput << " sub-domains/s\n";
+
+    // --- accuracy of mixed precision against double one ---
+
+    if (mixed_precision) {
+        assert_true(reference.size() == result.size());
+        double max_diff = 0.0, diff2 = 0.0, norm2 = 0.0;
+        for (size_t k = 0; k < reference.size(); ++k) {
+            const double d = result[k] - reference[k];
+            max_diff = std::max(max_diff, std::fabs(d));
+            diff2 += d * d;
+            norm2 += reference[k] * reference[k];
+        }
+        std::cout << "Mixed precision accuracy: max. abs. difference: "
+                  << max_diff << ", relative L2 difference: "
+                  << ((norm2 > 0.0) ? std::sqrt(diff2 / norm2) : 0.0)
+                  << "\n";
+    }
 }
 
-} // namespace amdados
+//-----------------------------------------------------------------------------
+// Function implements scaling study: the benchmark is run for all the numbers
+// of workers ('scaling_workers'), problem sizes ('scaling_sizes', number of
+// subdomains in either dimension) and sensor fractions ('scaling_fractions')
+// specified as comma-separated lists. In "strong" mode ('scaling_mode') all
+// the combinations are run, in "weak" one the workers and the sizes go in
+// pairs. Every point is run 'scaling_warmup' times to warm up, then
+// 'scaling_repeats' times to gather the statistics. The parallel efficiency
+// is the throughput per worker relative to the one of the first point with
+// the same sensor fraction (and the same size in "strong" mode). The results
+// are written into "scaling.csv" and "scaling.json" in the output directory.
+// @param config_file name of configuration file.
+//-----------------------------------------------------------------------------
+void ScenarioScaling(const std::string & config_file)
+{
+    MY_TIME_IT("Running scenario 'scaling' ...")
+
+    Configuration conf;
+    conf.ReadConfigFile(config_file.c_str());
+    conf.SetInt("checkpoint_period", 0);    // no I/O but the final field
+    conf.SetInt("analytics_period", 0);
+    conf.SetString("restart_file", "");
+
+    const int max_workers = SetNumWorkers(std::numeric_limits<int>::max());
+    const bool weak = conf.IsExist("scaling_mode") &&
+                      (conf.asString("scaling_mode") == "weak");
+    const std::vector<double> workers = ReadList(conf, "scaling_workers",
+                                                 max_workers);
+    const std::vector<double> sizes = ReadList(conf, "scaling_sizes",
+                                               conf.asInt("num_subdomains_x"));
+    const std::vector<double> fractions = ReadList(conf, "scaling_fractions",
+                                              conf.asDouble("sensor_fraction"));
+    const int repeats = conf.IsExist("scaling_repeats") ?
+                        std::max(conf.asInt("scaling_repeats"), 1) : 5;
+    const int warmup = conf.IsExist("scaling_warmup") ?
+                       std::max(conf.asInt("scaling_warmup"), 0) : 1;
+    assert_true(!weak || (workers.size() == sizes.size()))
+        << "weak scaling requires the same number of workers and sizes";
+
+    // The points of study: indices of workers and sizes.
+    std::vector<std::pair<size_t,size_t>> plan;
+    for (size_t s = 0; s < sizes.size(); ++s) {
+        if (weak) {
+            plan.emplace_back(s, s);
+        } else {
+            for (size_t w = 0; w < workers.size(); ++w) plan.emplace_back(w, s);
+        }
+    }
+
+    // The data are shared by the successive points of the same problem size
+    // and sensor fraction, e.g. by all the workers in "strong" mode.
+    Configuration c;
+    std::unique_ptr<Grid<point_array_t,2>> sensors;
+    std::unique_ptr<Grid<Matrix,2>> observations;
+
+    std::vector<ScalingPoint> points;
+    for (double fraction : fractions) {
+        size_t ref = points.size();     // reference point of efficiency
+        for (size_t n = 0; n < plan.size(); ++n) {
+            ScalingPoint pt;
+            pt.workers = static_cast<int>(workers[plan[n].first]);
+            pt.size = static_cast<int>(sizes[plan[n].second]);
+            pt.fraction = fraction;
+
+            // Generate the data, if the problem size or the sensor fraction
+            // has changed.
+            if (points.empty() || (points.back().size != pt.size) ||
+                    (points.back().fraction != fraction)) {
+                c = conf;
+                c.SetInt("num_subdomains_x", pt.size);
+                c.SetInt("num_subdomains_y", pt.size);
+                c.SetDouble("sensor_fraction", fraction);
+                InitDependentParams(c);
+                sensors.reset(new Grid<point_array_t,2>(GetGridSize(c)));
+                observations.reset(new Grid<Matrix,2>(GetGridSize(c)));
+                GenerateSensorData(c, *sensors, *observations);
+            }
+            pt.steps = c.asUInt("Nt");
+
+            pt.workers = SetNumWorkers(pt.workers);
+            std::cout << "Scaling point: " << pt.workers << " workers, "
+                      << pt.size << "x" << pt.size << " subdomains, "
+                      << "sensor fraction " << fraction << " ..." << std::endl;
+            std::vector<double> total, steps, init, integration, output;
+            std::vector<double> kalman, propagation;
+            for (int r = 0; r < warmup + repeats; ++r) {
+                RunProfile profile;
+                RunDataAssimilation(c, *sensors, *observations, nullptr,
+                                    &profile);
+                if (r < warmup) continue;
+                total.push_back(profile.init + profile.integration +
+                                profile.output);
+                steps.insert(steps.end(), profile.steps.begin(),
+                                          profile.steps.end());
+                init.push_back(profile.init);
+                integration.push_back(profile.integration);
+                output.push_back(profile.output);
+                kalman.push_back(profile.kalman);
+                propagation.push_back(profile.propagation);
+            }
+            const double q[3] = {0.5, 0.1, 0.9};
+            for (int i = 0; i < 3; ++i) {
+                pt.time[i] = Percentile(total, q[i]);
+                pt.step[i] = Percentile(steps, q[i]);
+            }
+            pt.phases.init = Percentile(init, 0.5);
+            pt.phases.integration = Percentile(integration, 0.5);
+            pt.phases.output = Percentile(output, 0.5);
+            pt.phases.kalman = Percentile(kalman, 0.5);
+            pt.phases.propagation = Percentile(propagation, 0.5);
+            pt.throughput = static_cast<double>(pt.size * pt.size) *
+                static_cast<double>(pt.steps) / pt.phases.integration;
+
+            // In strong mode, the efficiency is relative to the same size.
+            if (!weak && (points.size() > ref) &&
+                    (points[ref].size != pt.size)) {
+                ref = points.size();
+            }
+            const ScalingPoint & r = (points.size() > ref) ? points[ref] : pt;
+            pt.efficiency = (pt.throughput / pt.workers) /
+                            (r.throughput / r.workers);
+            points.push_back(pt);
+        }
+    }
+    SetNumWorkers(max_workers);
+
+    // --- write the results ---
+
+    const char * columns[] = {"workers", "size", "fraction", "steps",
+        "time_median", "time_p10", "time_p90",
+        "step_median", "step_p10", "step_p90", "throughput", "efficiency",
+        "init", "integration", "output", "kalman", "propagation"};
+    auto Values = [](const ScalingPoint & pt) {
+        return std::vector<double>{
+            static_cast<double>(pt.workers), static_cast<double>(pt.size),
+            pt.fraction, static_cast<double>(pt.steps),
+            pt.time[0], pt.time[1], pt.time[2],
+            pt.step[0], pt.step[1], pt.step[2], pt.throughput, pt.efficiency,
+            pt.phases.init, pt.phases.integration, pt.phases.output,
+            pt.phases.kalman, pt.phases.propagation};
+    };
+    const size_t ncols = sizeof(columns) / sizeof(columns[0]);
+    const std::string basename = conf.asString("output_dir") + PathSep +
+                                 "scaling";
+
+    std::fstream csv(basename + ".csv", std::ios::out | std::ios::trunc);
+    assert_true(csv.good()) << "failed to open file for writing: "
+                            << basename << ".csv";
+    for (size_t k = 0; k < ncols; ++k) csv << (k ? "," : "") << columns[k];
+    csv << std::endl;
+    for (const auto & pt : points) {
+        const std::vector<double> v = Values(pt);
+        for (size_t k = 0; k < ncols; ++k) csv << (k ? "," : "") << v[k];
+        csv << std::endl;
+    }
+
+    std::fstream json(basename + ".json", std::ios::out | std::ios::trunc);
+    assert_true(json.good()) << "failed to open file for writing: "
+                             << basename << ".json";
+    json << "{\n  \"mode\": \"" << (weak ? "weak" : "strong") << "\",\n"
+         << "  \"warmup\": " << warmup << ",\n"
+         << "  \"repeats\": " << repeats << ",\n"
+         << "  \"points\": [\n";
+    for (size_t n = 0; n < points.size(); ++n) {
+        const std::vector<double> v = Values(points[n]);
+        json << "    {";
+        for (size_t k = 0; k < ncols; ++k) {
+            json << (k ? ", " : "") << "\"" << columns[k] << "\": " << v[k];
+        }
+        json << ((n + 1 < points.size()) ? "},\n" : "}\n");
+    }
+    json << "  ]\n}" << std::endl;
+
+    // --- summarize ---
+
+    std::cout << "workers  size  fraction  median step [s]  throughput"
+                 "  efficiency" << std::endl;
+    for (const auto & pt : points) {
+        std::cout << std::setw(7) << pt.workers << std::setw(6) << pt.size
+                  << std::setw(10) << pt.fraction << std::setw(17)
+                  << pt.step[0] << std::setw(12) << pt.throughput
+                  << std::setw(12) << pt.efficiency << std::endl;
+    }
+    std::cout << "Results: " << basename << ".csv, "
+              << basename << ".json" << std::endl;
+}
 
+} // namespace amdados
@@ -3,6 +3,8 @@
 // Copyright : IBM Research Ireland, 2017-2018
 //-----------------------------------------------------------------------------
 
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
@@ -13,6 +15,7 @@
 #include "allscale/api/user/data/adaptive_grid.h"
 #include "allscale/api/user/algorithm/pfor.h"
 #include "allscale/api/user/algorithm/async.h"
+#include "allscale/api/user/save_to_binary.h"
 #include "allscale/api/core/io.h"
 #include "allscale/utils/assert.h"
 
@@ -22,9 +25,13 @@
 #include "amdados/app/matrix.h"
 #include "amdados/app/debugging.h"
 #include "amdados/app/sensors_generator.h"
+#include "amdados/app/sensor_dataset.h"
 
 namespace amdados {
 
+// Defined in "scenario_simulation.cpp":
+void InitDependentParams(Configuration & conf);
+
 namespace {
 
 using ::allscale::api::user::data::Grid;
@@ -47,6 +54,100 @@ inline point2d_t Glo2Sub(const point2d_t & p, const size2d_t & cell_size)
                      p.y % cell_size.y);
 }
 
+/**
+ * Function returns "true" if sensors and observations are read from
+ * the binary dataset (see SensorDataset) rather than the text files.
+ */
+inline bool IsBinaryInput(const Configuration & conf)
+{
+    return conf.IsExist("input_format") &&
+           (conf.asString("input_format") == "binary");
+}
+
+/**
+ * Function reads the binary dataset ("dataset" or "sensors" one, the latter
+ * holds no observations) in parallel: the file is memory mapped and every
+ * subdomain fetches its own record through the index, which is then passed
+ * to the functor along with the dataset to decode it.
+ */
+void ReadDataset(const Configuration & conf, const std::string & what,
+                 const std::function<void(const point2d_t &, const char *,
+                                     size_t, const SensorDataset &)> & f)
+{
+    using ::allscale::api::user::BinaryFileReader;
+    using ::allscale::api::user::algorithm::pfor;
+
+    const std::string filename = MakeFileName(conf, what);
+    CheckFileExists(conf, filename);
+    SensorDataset dataset(conf, what == "dataset");
+    dataset.Open(filename);
+
+    // Record 0 is the header with the index, the rest are the subdomain ones.
+    const std::vector<int64_t> offsets = dataset.ReadIndex();
+    assert_true(offsets[0] == static_cast<int64_t>(dataset.IndexSize()))
+        << "corrupted index of " << filename;
+    std::vector<size_t> sizes(offsets.size());
+    sizes[0] = dataset.IndexSize();
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        assert_true(offsets[i] <= offsets[i+1])
+            << "corrupted index of " << filename;
+        sizes[i+1] = static_cast<size_t>(offsets[i+1] - offsets[i]);
+    }
+    BinaryFileReader fin(filename, sizes);
+
+    pfor(point2d_t(0,0), GetGridSize(conf), [&](const point2d_t & idx) {
+        const size_t rec = dataset.FlatIndex(idx) + 1;
+        std::vector<char> buf(fin.getRecordSize(rec));
+        fin.read(rec, buf.data(), buf.size());
+        f(idx, buf.data(), buf.size(), dataset);
+    });
+    fin.close();
+}
+
+/**
+ * Function writes the binary dataset ("dataset" or "sensors" one, the latter
+ * holds no observations): the records are encoded and written in parallel,
+ * each one into its own byte range of the file.
+ */
+void WriteDataset(const Configuration         & conf,
+                  const std::string           & what,
+                  const Grid<point_array_t,2> & sensors,
+                  const Grid<Matrix,2>        * observations)
+{
+    using ::allscale::api::user::BinaryFileWriter;
+    using ::allscale::api::user::algorithm::pfor;
+
+    const point2d_t GridSize = GetGridSize(conf);
+    const Matrix    none;
+
+    // The layout of file is defined by the numbers of sensors in subdomains.
+    SensorDataset dataset(conf, observations != nullptr);
+    std::vector<size_t> nsensors(dataset.NumSubdomains());
+    pfor(point2d_t(0,0), GridSize, [&](const point2d_t & idx) {
+        nsensors[dataset.FlatIndex(idx)] = sensors[idx].size();
+    });
+    std::vector<size_t> sizes(nsensors.size() + 1);
+    sizes[0] = dataset.IndexSize();
+    for (size_t i = 0; i < nsensors.size(); ++i) {
+        sizes[i+1] = dataset.RecordSize(nsensors[i]);
+    }
+
+    const std::string filename = MakeFileName(conf, what);
+    BinaryFileWriter fout(filename, sizes);
+    std::vector<char> index(dataset.IndexSize());
+    dataset.EncodeIndex(nsensors, index.data());
+    fout.write(0, index.data(), index.size());
+    pfor(point2d_t(0,0), GridSize, [&](const point2d_t & idx) {
+        const size_t rec = dataset.FlatIndex(idx) + 1;
+        std::vector<char> buf(fout.getRecordSize(rec));
+        dataset.EncodeRecord(sensors[idx], (observations != nullptr) ?
+                                    (*observations)[idx] : none, buf.data());
+        fout.write(rec, buf.data(), buf.size());
+    });
+    fout.close();
+    MY_LOG(INFO) << "Saved " << filename << " (" << fout.getSize() << " bytes)";
+}
+
 ///**
 // * Function evaluates objective function and its gradient.
 // */
@@ -168,8 +269,11 @@ void InitialGuess(const Configuration & conf,
 /**
  * Function implements a special scenario of Amdados application,
  * where it creates and saves pseudo-randomly distributed sensor locations.
- * N O T E, the sensor points are stored unordered and their coordinates are
+ * N O T E, the sensor points are stored subdomain by subdomain (Y is the
+ * fastest coordinate of subdomain position) and their coordinates are
  * global, i.e. defined with respected to the whole domain's coordinate system.
+ * If 'input_format' is "binary", the locations are saved in the dataset
+ * (see SensorDataset) in coordinates local to subdomains instead.
  */
 void ScenarioSensors(const std::string & config_file)
 {
@@ -186,17 +290,40 @@ void ScenarioSensors(const std::string & config_file)
 
 #if 1
 
-    point_array_t sensors;
-    SensorsGenerator().MakeSensors(conf, sensors);
+    // Generate sensors of all the subdomains concurrently.
+    const point2d_t GridSize = GetGridSize(conf);
+    Grid<point_array_t,2> sensors(GridSize);
+    {
+        MY_TIME_IT("Running sensors' generator ...")
+        const SensorsGenerator generator(conf);
+        ::allscale::api::user::algorithm::pfor(point2d_t(0,0), GridSize,
+                                    [&](const point2d_t & idx) {
+            generator.MakeSubdomainSensors(idx, sensors[idx]);
+        });
+    }
+
+    // Save sensor locations in the format of input data.
+    if (IsBinaryInput(conf)) {
+        WriteDataset(conf, "sensors", sensors, nullptr);
+        return;
+    }
 
-    // Open file manager and the output file for writing, save sensor locations.
+    // Open file manager and the output file for writing, save sensor
+    // locations in global coordinates subdomain by subdomain.
+    const size2d_t subdomain_size(conf.asInt("subdomain_x"),
+                                  conf.asInt("subdomain_y"));
     std::string filename = MakeFileName(conf, "sensors");
     FileIOManager & manager = FileIOManager::getInstance();
     Entry e = manager.createEntry(filename, Mode::Text);
     auto out = manager.openOutputStream(e);
-    for (size_t k = 0; k < sensors.size(); ++k) {
-        out << sensors[k].x << " " << sensors[k].y << "\n";
-    }
+    for (index_t x = 0; x < GridSize.x; ++x) {
+    for (index_t y = 0; y < GridSize.y; ++y) {
+        const point2d_t idx(x,y);
+        for (const point2d_t & p : sensors[idx]) {
+            const point2d_t glo = Sub2Glo(p, idx, subdomain_size);
+            out << glo.x << " " << glo.y << "\n";
+        }
+    }}
     manager.close(out);
 
 #else
@@ -274,7 +401,8 @@ void ScenarioSensors(const std::string & config_file)
 }
 
 /**
- * Function sequentially (!) reads the file of sensor locations.
+ * Function sequentially (!) reads the file of sensor locations, or reads
+ * them in parallel from the binary dataset if 'input_format' is "binary".
  */
 void LoadSensorLocations(const Configuration   & conf,
                          Grid<point_array_t,2> & sensors)
@@ -298,35 +426,51 @@ void LoadSensorLocations(const Configuration   & conf,
         sensors[idx].clear();
     });
 
-    // Read the sensor file sequentially.
+    if (IsBinaryInput(conf)) {
+        ReadDataset(conf, "sensors", [&sensors](const point2d_t & idx,
+                                                const char * rec, size_t size,
+                                                const SensorDataset & d) {
+            d.DecodeRecord(rec, size, sensors[idx], nullptr);
+        });
+        return;
+    }
+
+    // Read the sensor file sequentially, a block of locations at a time.
     std::string filename = MakeFileName(conf, "sensors");
     CheckFileExists(conf, filename);
     FileIOManager & manager = FileIOManager::getInstance();
     Entry e = manager.createEntry(filename, Mode::Text);
     auto in = manager.openInputStream(e);
+    std::vector<index_t> coords(2 * 4096);
     while (1) {
-        point2d_t pt;
-        in.atomic([&](auto & file) { file >> pt.x >> pt.y; });
-        if (!in) {
+        const size_t n = in.readSpan(coords.data(), coords.size());
+        assert_true(n % 2 == 0) << "incomplete sensor location in " << filename;
+        for (size_t k = 0; k + 1 < n; k += 2) {
+            point2d_t pt(coords[k], coords[k+1]);
+            point2d_t idx = Glo2CellIndex(pt, finest_layer_size);
+            assert_true((0 <= idx.x) && (idx.x < GridSize.x));
+            assert_true((0 <= idx.y) && (idx.y < GridSize.y));
+            sensors[idx].push_back(Glo2Sub(pt, finest_layer_size));
+        }
+        if (n < coords.size()) {
             break;
         }
-        point2d_t idx = Glo2CellIndex(pt, finest_layer_size);
-        assert_true((0 <= idx.x) && (idx.x < GridSize.x));
-        assert_true((0 <= idx.y) && (idx.y < GridSize.y));
-        sensors[idx].push_back(Glo2Sub(pt, finest_layer_size));
     }
     manager.close(in);
 
 #ifdef AMDADOS_DEBUGGING
-    size_t num_sensors = 0;
-    sensors.forEach([&](point_array_t & arr) { num_sensors += arr.size(); });
+    const size_t num_sensors = sensors.preduce(
+        [](const point_array_t & arr, size_t & n) { n += arr.size(); },
+        [](size_t a, size_t b) { return a + b; },
+        []() { return size_t(0); }).get();
     MY_LOG(INFO) << "Average number of sensors per subdomain: " <<
             (double(num_sensors) / double(GridSize[0] * GridSize[1]));
 #endif
 }
 
 /**
- * Function sequentially (!) reads the file of sensor measurements.
+ * Function sequentially (!) reads the file of sensor measurements, or reads
+ * them in parallel from the binary dataset if 'input_format' is "binary".
  */
 void LoadSensorMeasurements(const Configuration         & conf,
                             const Grid<point_array_t,2> & sensors,
@@ -364,15 +508,28 @@ void LoadSensorMeasurements(const Configuration         & conf,
         observations[idx].Clear();
     });
 
+    if (IsBinaryInput(conf)) {
+        ReadDataset(conf, "dataset", [&](const point2d_t & idx,
+                                         const char * rec, size_t size,
+                                         const SensorDataset & d) {
+            // Check the record holds exactly the sensors loaded before.
+            point_array_t locations;
+            d.DecodeRecord(rec, size, locations, &observations[idx]);
+            assert_true(locations == sensors[idx])
+                << "sensors of subdomain " << idx << " do not match the "
+                << "ones of dataset " << MakeFileName(conf, "dataset");
+        });
+        return;
+    }
+
     // Read the sensor file sequentially.
     std::string filename = MakeFileName(conf, "analytic");
     FileIOManager & manager = FileIOManager::getInstance();
     Entry e = manager.createEntry(filename, Mode::Text);
     auto in = manager.openInputStream(e);
+    std::vector<std::pair<point2d_t,float>> records;
     while (1) {
         int t = 0, num = 0;
-        point2d_t pt;
-        float val = 0.0f;
 
         // Read the header of a new time-slice (timestamp and num. of records).
         in.atomic([&](auto & file) { file >> t >> num; });
@@ -387,10 +544,17 @@ void LoadSensorMeasurements(const Configuration         & conf,
             counters[idx] = 0;
         });
 
-        // Read all the records of the time-slice.
-        for (int i = 0; i < num; ++i) {
-            // Read the global coordinates of a sensor and a measurement.
-            in.atomic([&](auto & file) { file >> pt.x >> pt.y >> val; });
+        // Read all the records of the time-slice: the global coordinates
+        // of a sensor and a measurement.
+        records.resize(static_cast<size_t>(num));
+        in.atomic([&](auto & file) {
+            for (auto & r : records) file >> r.first.x >> r.first.y >> r.second;
+        });
+        assert_true(in) << "failed to read time-slice " << t << " of " << filename;
+
+        for (const auto & r : records) {
+            const point2d_t & pt = r.first;
+            const float       val = r.second;
 
             // Get subdomain position on the grid.
             point2d_t idx = Glo2CellIndex(pt, finest_layer_size);
@@ -427,5 +591,37 @@ void LoadSensorMeasurements(const Configuration         & conf,
     assert_true(last_timestamp + 1 == Nt);
 }
 
+/**
+ * Function implements a special scenario of Amdados application, where it
+ * converts the text files of sensor locations and observations into the
+ * binary datasets (see SensorDataset).
+ */
+void ScenarioConvert(const std::string & config_file)
+{
+    MY_TIME_IT("Running scenario 'convert' ...")
+
+    // Read configuration file, the input is always the text one.
+    Configuration conf;
+    conf.ReadConfigFile(config_file.c_str());
+    conf.SetString("input_format", "text");
+    InitDependentParams(conf);
+
+    const point2d_t GridSize = GetGridSize(conf);
+    Grid<point_array_t,2> sensors(GridSize);
+    Grid<Matrix,2> observations(GridSize);
+    LoadSensorLocations(conf, sensors);
+    LoadSensorMeasurements(conf, sensors, observations);
+
+    // The binary counterparts of both text files are written: the locations
+    // alone are read by LoadSensorLocations(), the whole dataset is read by
+    // LoadSensorMeasurements() and by MPI version.
+    conf.SetString("input_format", "binary");
+    WriteDataset(conf, "sensors", sensors, nullptr);
+    WriteDataset(conf, "dataset", sensors, &observations);
+    std::cout << "Converted sensors and observations into "
+              << MakeFileName(conf, "sensors") << " and "
+              << MakeFileName(conf, "dataset") << "\n";
+}
+
 } // namespace amdados
 
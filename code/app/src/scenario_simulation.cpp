@@ -9,11 +9,24 @@
 #include <fstream>
 #include <sstream>
 #include <chrono>
+#include <memory>
 #include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <cstdio>
+#include <numeric>
+#include <limits>
+#include <algorithm>
 
 #include "allscale/api/user/data/adaptive_grid.h"
 #include "allscale/api/user/algorithm/pfor.h"
+#include "allscale/api/user/algorithm/preduce.h"
 #include "allscale/api/user/algorithm/stencil.h"
+#include "allscale/api/user/save_to_binary.h"
 #include "allscale/api/core/io.h"
 #include "allscale/utils/assert.h"
 
@@ -22,10 +35,16 @@
 #include "amdados/app/configuration.h"
 #include "amdados/app/geometry.h"
 #include "amdados/app/matrix.h"
+#include "amdados/app/arena.h"
 #include "amdados/app/cholesky.h"
 #include "amdados/app/lu.h"
+#include "amdados/app/stencil_solver.h"
+#include "amdados/app/local_covariance.h"
 #include "amdados/app/kalman_filter.h"
 #include "amdados/app/demo_average_profile.h"
+#include "amdados/app/subdomain_context.h"
+#include "amdados/app/checkpoint.h"
+#include "amdados/app/coarse_correction.h"
 
 // There are two methods to implement multi-scaling.
 #define MY_MULTISCALE_METHOD 2
@@ -49,115 +68,59 @@ void LoadSensorMeasurements(const Configuration         & conf,
 
 namespace {
 
-const int NSIDES = 4;             // number of sides any subdomain has
-
-/**
- * Structure keeps information about 4-side boundary of a subdomain
- * (Up, Down, Left, Right).
- */
-struct Boundary
-{
-    double_array_t myself; // temporary storage for this subdomain boundary
-    double_array_t remote; // temporary storage for remote boundary values
-
-    double rel_diff;       // relative difference across in-flow borders
-    bool   inflow[NSIDES]; // true, if flow is coming in along a side
-    bool   outer[NSIDES];  // true, if side belongs to domain's outer boundary
-
-	friend std::ostream & operator<<(std::ostream & out, const Boundary & b) {
-		out << "Boundary: [ ";
-		for (const auto & e : b.myself) { out << " " << e; }
-		out << ", ";
-		for (const auto & e : b.remote) { out << " " << e; }
-		out << ", " << b.rel_diff;
-		for (int i = 0; i < NSIDES; ++i) { out << " " << b.inflow[i]; }
-		out << ", ";
-		for (int i = 0; i < NSIDES; ++i) { out << " " << b.outer[i]; }
-		out << " ]" << std::endl;
-		return out;
-	}
-};
-
-typedef std::pair<double,double> flow_t;    // flow components (flow_x, flow_y)
-
-//=============================================================================
-// Variables and data associated with a sub-domain.
-//=============================================================================
-struct SubdomainContext
-{
-    Matrix        field;        // sub-domain represented as a matrix
-    Boundary      boundaries;   // sub-domain boundaries
-
-    KalmanFilter  Kalman;       // Kalman filter
-    Matrix        B;            // inverse model matrix
-
-    Matrix        P;            // process model covariance
-    Matrix        Q;            // process noise covariance
-    Matrix        H;            // observation matrix
-    Matrix        R;            // observation noise covariance
-    Vector        z;            // observation vector
-
-    point_array_t   sensors;    // sensor locations at the finest resolution
-    LUdecomposition LU;         // used for state propagation without sensors
-    Matrix          tmp_field;  // used for state propagation without sensors
-    flow_t          flow;       // current flow vector (vel_x, vel_y)
-
-    SubdomainContext()
-        : field(), boundaries()
-        , Kalman(), B()
-        , P(), Q(), H(), R(), z()
-        , sensors(), LU(), tmp_field()
-        , flow(0.0, 0.0)
-    {}
-
-	friend std::ostream & operator<<(std::ostream & out,
-                                     const SubdomainContext & ctx) {
-		out << "SubdomainContext: [ ";
-		out << ctx.field << ", ";
-		out << ctx.boundaries << ", ";
-		out << ctx.Kalman << ", ";
-		out << ctx.B << ", ";
-		out << ctx.P << ", ";
-		out << ctx.Q << ", ";
-		out << ctx.H << ", ";
-		out << ctx.R << ", ";
-		out << ctx.z;
-		for (const auto & e : ctx.sensors) { out << ", " << e; }
-		out << ctx.LU << ", ";
-		out << ctx.tmp_field << ", ";
-		out << ctx.flow.first << ", ";
-		out << ctx.flow.second;
-		out << " ]" << std::endl;
-		return out;
-	}
-};
-
-// The whole domain where instead of grid cells we place sub-domain data.
-using context_domain_t = ::allscale::api::user::data::Grid<SubdomainContext,2>;
-
-/**
- * Function converts 2D point to a flat 1D index for extended (!!!) subdomain.
+/**
+ * Function returns the halo width, i.e. the number of point layers the
+ * extended subdomain has on either side, for a layer of the size specified.
+ * The halo is 'halo_width' points wide (one by default) but narrower than
+ * the layer itself, since the peers provide their boundary strips of the same
+ * resolution and the halo at the outer border mirrors the points inside the
+ * layer (see MatrixFromAllscale()). The halo wider than one point makes the
+ * subdomains overlap. The single point layer gets the one point halo anyway.
+ */
+inline index_t HaloWidth(const Configuration & conf, const size2d_t & layer_size)
+{
+    const index_t w = conf.IsExist("halo_width") ?
+                      static_cast<index_t>(conf.asInt("halo_width")) : 1;
+    return std::max(index_t(1),
+                    std::min(w, std::min(layer_size.x, layer_size.y) - 1));
+}
+
+/**
+ * Function returns the halo width of extended subdomain field made from
+ * a layer of the size specified.
+ */
+inline index_t HaloWidth(const Matrix & field, const size2d_t & layer_size)
+{
+    return (field.NRows() - layer_size.x) / 2;
+}
+
+/**
+ * Function converts 2D point to a flat 1D index for extended (!!!) subdomain
+ * with the halo of the width specified.
  * Index layout ('y' is faster than 'x') matches to row-major Matrix class.
  */
-inline index_t sub2ind(index_t x, index_t y, const size2d_t & layer_size)
+inline index_t sub2ind(index_t x, index_t y, const size2d_t & layer_size,
+                       index_t halo)
 {
 #ifndef NDEBUG
-    if (!((static_cast<size_t>(x) < static_cast<size_t>(layer_size.x + 2)) &&
-          (static_cast<size_t>(y) < static_cast<size_t>(layer_size.y + 2))))
+    if (!((static_cast<size_t>(x) <
+                static_cast<size_t>(layer_size.x + 2 * halo)) &&
+          (static_cast<size_t>(y) <
+                static_cast<size_t>(layer_size.y + 2 * halo))))
         assert_true(0);
 #endif
-    return (x * (layer_size.y + 2) + y);
+    return (x * (layer_size.y + 2 * halo) + y);
 }
 
 /**
- * Function returns "true" if the active layer and the field specified
+ * Function returns "true" if the layer of the size specified and the field
  * have the matching sizes.
  */
-inline bool CheckSizes(const subdomain_t & cell, const Matrix & field)
+inline bool CheckSizes(const size2d_t & sz, const Matrix & field, index_t halo)
 {
-    // Mind the extended subdomain: one extra point layer on either side.
-    const size2d_t sz = const_cast<subdomain_t&>(cell).getActiveLayerSize();
-    return ((field.NRows() == sz.x + 2) && (field.NCols() == sz.y + 2));
+    // Mind the extended subdomain: 'halo' extra point layers on either side.
+    return ((field.NRows() == sz.x + 2 * halo) &&
+            (field.NCols() == sz.y + 2 * halo));
 }
 
 #if MY_MULTISCALE_METHOD == 1
@@ -202,32 +165,25 @@ void AdjustBoundary(double_array_t & bout, const double_array_t & bin, long N)
 #endif  // MY_MULTISCALE_METHOD
 
 /**
- * Function initializes inverse matrix of implicit Euler time-integrator:
- * B * x_{t+1} = x_{t}, where B = A^{-1} is the matrix returned by this
- * function. The matrix must be inverted while iterating forward in time:
- * x_{t+1} = A * x_{t}.
- * Note, the matrix we generate here is acting on a subdomain.
- * Note, the model matrix B is supposed to be a sparse one. For now, since we
- * do not have a fast utility for sparse matrix inversion, we define B as
- * a dense one with many zeros.
+ * Function computes the stencil of inverse matrix of implicit Euler
+ * time-integrator (see InverseModelMatrix()) at the internal points of
+ * a subdomain.
  */
-void InverseModelMatrix(Matrix & B, const Configuration & conf,
-                        const flow_t & flow, const size2d_t & layer_size,
-                        unsigned resolution, int dt_divisor = 0)
+ModelStencil InverseModelStencil(const Configuration & conf,
+                                 const flow_t & flow,
+                                 const size2d_t & layer_size, double dt)
 {
     const index_t Sx = layer_size.x;
     const index_t Sy = layer_size.y;
 
-    assert_true((B.NRows() == B.NCols()) && (B.NCols() == (Sx + 2)*(Sy + 2)));
-
-    // Important: scale the space steps according to resolution.
-    const double resol_ratio =
-        (resolution == LayerFine) ? 1.0 : conf.asDouble("resolution_ratio");
+    // Important: scale the space steps according to resolution, which is
+    // the size ratio between the finest layer and the current one.
+    const double resol_ratio_x = conf.asDouble("subdomain_x") / double(Sx);
+    const double resol_ratio_y = conf.asDouble("subdomain_y") / double(Sy);
 
     const double D  = conf.asDouble("diffusion_coef");
-    const double dx = conf.asDouble("dx") * resol_ratio;
-    const double dy = conf.asDouble("dy") * resol_ratio;
-    const double dt = conf.asDouble("dt")/((dt_divisor > 0) ? dt_divisor : 1);
+    const double dx = conf.asDouble("dx") * resol_ratio_x;
+    const double dy = conf.asDouble("dy") * resol_ratio_y;
 
     const double rho_x = D * dt / std::pow(dx,2);
     const double rho_y = D * dt / std::pow(dy,2);
@@ -238,43 +194,87 @@ void InverseModelMatrix(Matrix & B, const Configuration & conf,
     const double vx = flow.first  / v0x;
     const double vy = flow.second / v0y;
 
+    ModelStencil stencil;
+    stencil.centre = 1.0 + 2*(rho_x + rho_y);
+    stencil.xm = - vx - rho_x;
+    stencil.xp = + vx - rho_x;
+    stencil.ym = - vy - rho_y;
+    stencil.yp = + vy - rho_y;
+    return stencil;
+}
+
+/**
+ * Function initializes inverse matrix of implicit Euler time-integrator:
+ * B * x_{t+1} = x_{t}, where B = A^{-1} is the matrix returned by this
+ * function. The matrix must be inverted while iterating forward in time:
+ * x_{t+1} = A * x_{t}.
+ * Note, the matrix we generate here is acting on a subdomain.
+ * Note, the model matrix B is supposed to be a sparse one. For now, since we
+ * do not have a fast utility for sparse matrix inversion, we define B as
+ * a dense one with many zeros. The sensorless subdomains can avoid it
+ * altogether in the memory-lean mode (see StencilSolver), and so do the
+ * subdomains of localised covariance (see LocalInverseOperator).
+ * Note, with the halo wider than one point, the model is also applied to the
+ * overlap with the peers, i.e. to all the points but the outermost layer.
+ */
+void InverseModelMatrix(Matrix & B, const Configuration & conf,
+                        const flow_t & flow, const size2d_t & layer_size,
+                        index_t halo, double dt)
+{
+    const index_t Ex = layer_size.x + 2 * halo;
+    const index_t Ey = layer_size.y + 2 * halo;
+
+    assert_true((B.NRows() == B.NCols()) && (B.NCols() == Ex * Ey));
+
+    const ModelStencil s = InverseModelStencil(conf, flow, layer_size, dt);
+
     // The internal and the boundary points of extended subdomain are treated
     // differently. The border values are passed through as is (B(i,i) = 1).
-    // Mind the extended subdomain: one extra point layer on either side.
+    // Mind the extended subdomain: 'halo' extra point layers on either side.
     MakeIdentityMatrix(B);
-    for (index_t x = 1; x <= Sx; ++x) {
-    for (index_t y = 1; y <= Sy; ++y) {
-        index_t i = sub2ind(x, y, layer_size);
-        B(i,i) = 1.0 + 2*(rho_x + rho_y);
-        B(i,sub2ind(x-1, y, layer_size)) = - vx - rho_x;
-        B(i,sub2ind(x+1, y, layer_size)) = + vx - rho_x;
-        B(i,sub2ind(x, y-1, layer_size)) = - vy - rho_y;
-        B(i,sub2ind(x, y+1, layer_size)) = + vy - rho_y;
+    for (index_t x = 1; x < Ex - 1; ++x) {
+    for (index_t y = 1; y < Ey - 1; ++y) {
+        index_t i = sub2ind(x, y, layer_size, halo);
+        B(i,i) = s.centre;
+        B(i,sub2ind(x-1, y, layer_size, halo)) = s.xm;
+        B(i,sub2ind(x+1, y, layer_size, halo)) = s.xp;
+        B(i,sub2ind(x, y-1, layer_size, halo)) = s.ym;
+        B(i,sub2ind(x, y+1, layer_size, halo)) = s.yp;
     }}
 }
 
 /**
  * Function computes: z = H * observations(t). Since H is a simple 0/1 matrix
  * that just picks up the observations at sensor locations, instead of
- * matrix-vector multiplication we get the observations directly.
+ * matrix-vector multiplication we get the observations directly. If the time
+ * falls between the sampling points, the observations are linearly
+ * interpolated between the row specified and the next one.
  */
-void GetObservations(Vector & z, const Matrix & observations, int timestep,
+void GetObservations(Vector & z, const Matrix & observations,
+                     index_t row, double weight,
                      const Matrix & H, const point_array_t & sensors,
-                     const size2d_t & layer_size)
+                     const size2d_t & layer_size, index_t halo)
 {
     const index_t n = observations.NCols();
     assert_true(z.Size() == n);
-    for (index_t i = 0; i < n; ++i) { z(i) = observations(timestep, i); }
+    if (weight == 0.0) {
+        for (index_t i = 0; i < n; ++i) { z(i) = observations(row, i); }
+    } else {
+        for (index_t i = 0; i < n; ++i) {
+            z(i) = (1.0 - weight) * observations(row, i) +
+                          weight  * observations(row + 1, i);
+        }
+    }
 
-    (void) H; (void) sensors; (void) layer_size;
+    (void) H; (void) sensors; (void) layer_size; (void) halo;
 #ifdef AMDADOS_DEBUGGING
     #warning "Some extra validity test"
-    // Mind the extended subdomain: one extra point layer on either side.
-    assert_true(H.NCols() == (layer_size.x + 2) * (layer_size.y + 2));
-    Matrix subfield(layer_size.x + 2, layer_size.y + 2);
+    // Mind the extended subdomain: 'halo' extra point layers on either side.
+    assert_true(H.NCols() == (layer_size.x + 2 * halo) *
+                             (layer_size.y + 2 * halo));
+    Matrix subfield(layer_size.x + 2 * halo, layer_size.y + 2 * halo);
     for (index_t i = 0; i < static_cast<index_t>(sensors.size()); ++i) {
-        subfield(sensors[i].x + 1, sensors[i].y + 1) =
-            observations(timestep, i);
+        subfield(sensors[i].x + halo, sensors[i].y + halo) = z(i);
     }
     Vector _z(n);
     MatVecMult(_z, H, subfield);    // _z = H * observations(t)
@@ -290,23 +290,21 @@ void ApplyBoundaryCondition(subdomain_t     & subdom,
                             const point2d_t & idx,
                             const point2d_t & Gridsize)
 {
-    const size2d_t subdom_size = subdom.getActiveLayerSize();
-
-    const index_t Nx = Gridsize.x, Sx = subdom_size.x;
-    const index_t Ny = Gridsize.y, Sy = subdom_size.y;
+    const index_t Nx = Gridsize.x;
+    const index_t Ny = Gridsize.y;
 
     // Set the leftmost and rightmost.
     if (idx.x == 0) {
-        subdom.setBoundary(Direction::Left,  double_array_t(Sy, 0.0));
+        subdom.fillBoundary(Direction::Left,  0.0);
     } else if (idx.x == Nx - 1) {
-        subdom.setBoundary(Direction::Right, double_array_t(Sy, 0.0));
+        subdom.fillBoundary(Direction::Right, 0.0);
     }
 
     // Set the bottommost and topmost.
     if (idx.y == 0) {
-        subdom.setBoundary(Direction::Down, double_array_t(Sx, 0.0));
+        subdom.fillBoundary(Direction::Down, 0.0);
     } else if (idx.y == Ny - 1) {
-        subdom.setBoundary(Direction::Up,   double_array_t(Sx, 0.0));
+        subdom.fillBoundary(Direction::Up,   0.0);
     }
 }
 
@@ -327,19 +325,21 @@ void InitialCovar(const Configuration & conf, Matrix & P)
     const index_t Sx = conf.asInt("subdomain_x");
     const index_t Sy = conf.asInt("subdomain_y");
     const size2d_t layer_size(Sx, Sy);      // size at the finest resolution
+    const index_t Ex = Sx + 2 * HaloWidth(conf, layer_size);
+    const index_t Ey = Sy + 2 * HaloWidth(conf, layer_size);
 
     assert_true(P.IsSquare());
-    assert_true(P.NRows() == (Sx + 2) * (Sy + 2));
+    assert_true(P.NRows() == Ex * Ey);
 
-    // Mind the extended subdomain: one extra point layer on either side.
+    // Mind the extended subdomain: 'halo' extra point layers on either side.
     Fill(P, 0.0);
-    for (index_t u = 0; u < Sx + 2; ++u) {
-    for (index_t v = 0; v < Sy + 2; ++v) {
-        index_t i = sub2ind(u, v, layer_size);
+    for (index_t u = 0; u < Ex; ++u) {
+    for (index_t v = 0; v < Ey; ++v) {
+        index_t i = u * Ey + v;
         double dx = 0.0, dy = 0.0;
-        for (index_t x = u-Rx; x <= u+Rx; ++x) { if ((0 <= x) && (x < Sx + 2)) {
-        for (index_t y = v-Ry; y <= v+Ry; ++y) { if ((0 <= y) && (y < Sy + 2)) {
-            index_t j = sub2ind(x, y, layer_size);
+        for (index_t x = u-Rx; x <= u+Rx; ++x) { if ((0 <= x) && (x < Ex)) {
+        for (index_t y = v-Ry; y <= v+Ry; ++y) { if ((0 <= y) && (y < Ey)) {
+            index_t j = x * Ey + y;
             if (i <= j) {
                 dx = (u - x) / sigma_x;
                 dy = (v - y) / sigma_y;
@@ -349,6 +349,34 @@ void InitialCovar(const Configuration & conf, Matrix & P)
     }}
 }
 
+/**
+ * Function computes the initial localised process model covariance matrix P
+ * based on exponential distance. The entries within the support are the same
+ * as the ones of the dense matrix computed by the function above.
+ */
+void InitialCovar(const Configuration & conf, LocalCovariance & P)
+{
+    const double variance = conf.asDouble("model_ini_var");
+    const double covar_radius = conf.asDouble("model_ini_covar_radius");
+    const double sigma = std::max(covar_radius, 1.0);
+    const index_t Sx = conf.asInt("subdomain_x");
+    const index_t Sy = conf.asInt("subdomain_y");
+    const index_t halo = HaloWidth(conf, size2d_t(Sx, Sy));
+    const index_t Ey = Sy + 2 * halo;
+
+    // Mind the extended subdomain: 'halo' extra point layers on either side.
+    P.Init(Sx + 2 * halo, Ey, Round(std::ceil(4.0 * sigma)));
+    for (index_t i = 0; i < P.Size(); ++i) {
+    for (index_t k = 0; k < P.NumEntries(); ++k) {
+        const index_t j = P.Neighbour(i, k);
+        if (j >= 0) {
+            const double dx = ((i / Ey) - (j / Ey)) / sigma;
+            const double dy = ((i % Ey) - (j % Ey)) / sigma;
+            P(i,k) = variance * std::exp(-0.5 * (dx*dx + dy*dy));
+        }
+    }}
+}
+
 /**
  * Function computes the process model noise covariance matrix.
  */
@@ -365,6 +393,38 @@ void ComputeQ(const Configuration & conf, Matrix & Q)
     }
 }
 
+/**
+ * Function computes the diagonal of the process model noise covariance
+ * matrix, which is all the square-root filter needs. The random values are
+ * the same as above.
+ */
+void ComputeQ(const Configuration & conf, Vector & q)
+{
+    std::uniform_real_distribution<double> distrib;
+    std::mt19937_64 gen(RandomSeed());
+    const double model_noise_Q = conf.asDouble("model_noise_Q");
+
+    for (index_t k = 0; k < q.Size(); ++k) {
+        q(k) = 1.0 + model_noise_Q * distrib(gen);      // always >= 1
+    }
+}
+
+/**
+ * Function computes the diagonal process model noise covariance matrix
+ * in localised format. The random values are the same as above.
+ */
+void ComputeQ(const Configuration & conf, LocalCovariance & Q)
+{
+    std::uniform_real_distribution<double> distrib;
+    std::mt19937_64 gen(RandomSeed());
+    const double model_noise_Q = conf.asDouble("model_noise_Q");
+
+    assert_true(Q.Radius() == 0);
+    for (index_t k = 0; k < Q.Size(); ++k) {
+        Q.Diag(k) = 1.0 + model_noise_Q * distrib(gen);     // always >= 1
+    }
+}
+
 /**
  * Function computes the measurement noise covariance matrix.
  */
@@ -386,149 +446,886 @@ void ComputeR(const Configuration & conf, Matrix & R)
  * (number of sensors in subdomain) x (number of nodal points in subdomain).
  */
 void ComputeH(const point_array_t & sensors, const size2d_t & layer_size,
-              Matrix & H)
+              index_t halo, Matrix & H)
 {
     if (sensors.empty()) {
         H.Clear();
         return;
     }
-    // Mind the extended subdomain: one extra point layer on either side.
+    // Mind the extended subdomain: 'halo' extra point layers on either side.
     assert_true(H.NRows() == static_cast<index_t>(sensors.size()));
-    assert_true(H.NCols() == (layer_size.x + 2) * (layer_size.y + 2));
+    assert_true(H.NCols() == (layer_size.x + 2 * halo) *
+                             (layer_size.y + 2 * halo));
     Fill(H, 0.0);
     for (size_t k = 0; k < sensors.size(); ++k) {
-        H(k, sub2ind(sensors[k].x + 1, sensors[k].y + 1, layer_size)) = 1.0;
+        H(k, sub2ind(sensors[k].x + halo, sensors[k].y + halo,
+                     layer_size, halo)) = 1.0;
     }
 }
 
 /**
- * Function computes flow components given a discrete time.
- * \return a pair of flow components (flow_x, flow_y).
+ * Function places the matrices of a subdomain in its memory arena, so that
+ * all of them reside in a single aligned block. The placements are done
+ * twice: the first pass measures the block size, the second one binds the
+ * matrices to the block. The sizes are the ones of extended subdomain
+ * ('ex_size') at the current layer. A sensorless subdomain, which can switch
+ * the layer, has its arena placed anew on switching (see
+ * SubdomainRoutineNoSensors()), so its matrices always take the space of
+ * the active layer only.
+ * Note, the localised covariance matrices are kept aside, and no dense model
+ * matrix is needed alongside them.
+ * In the memory-lean mode, the sensorless subdomains keep no dense matrices.
  */
-flow_t Flow(const Configuration & conf, const size_t discrete_time)
+void PlaceInArena(SubdomainContext & ctx, const Configuration & conf,
+                  const size2d_t & ex_size, index_t Nsensors)
 {
-    const double max_vx = conf.asDouble("flow_model_max_vx");
-    const double max_vy = conf.asDouble("flow_model_max_vy");
-    const double t = static_cast<double>(discrete_time) / conf.asDouble("Nt");
-    return flow_t( -max_vx * std::sin(0.1 * t - M_PI),
-                   -max_vy * std::sin(0.2 * t - M_PI) );
+    const index_t N = ex_size.x * ex_size.y;
+    const index_t O = Nsensors;
+    const std::string covar_storage = conf.IsExist("covariance_storage") ?
+                                conf.asString("covariance_storage") : "dense";
+    const bool local_covar = (covar_storage == "local");
+    const bool sqrt_covar = (covar_storage == "sqrt");
+    const bool mixed_precision = conf.IsExist("precision") &&
+                                 (conf.asString("precision") == "mixed");
+    const bool memory_lean = conf.IsExist("memory_mode") &&
+                             (conf.asString("memory_mode") == "lean");
+
+    Arena & arena = ctx.arena;
+    arena.Reset();
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass > 0) arena.Allocate();
+        arena.Place(ctx.field, ex_size.x, ex_size.y);
+        if ((O == 0) && memory_lean) {
+            // The outermost point layer of extended subdomain is not solved.
+            ctx.stencil.Place(arena, ex_size.x - 2, ex_size.y - 2);
+            continue;
+        }
+        if ((O == 0) || !local_covar) {
+            arena.Place(ctx.B, N, N);
+        }
+        if (O > 0) {
+            if (local_covar) {
+                ctx.Kalman.Place(arena, N, O, false, false);
+            } else if (mixed_precision) {
+                arena.Place(ctx.P_mixed, N, N);
+                arena.Place(ctx.Q, N, N);
+                ctx.Kalman_mixed.Place(arena, N, O);
+            } else {
+                arena.Place(ctx.P, N, N);
+                if (sqrt_covar) {
+                    arena.Place(ctx.Qdiag, N);
+                } else {
+                    arena.Place(ctx.Q, N, N);
+                }
+                ctx.Kalman.Place(arena, N, O, true, sqrt_covar);
+            }
+            arena.Place(ctx.H, O, N);
+            arena.Place(ctx.R, O, O);
+            arena.Place(ctx.z, O);
+        } else {
+            arena.Place(ctx.tmp_field, ex_size.x, ex_size.y);
+            ctx.LU.Place(arena, N);
+        }
+    }
+}
+
+/**
+ * Function returns the number of bytes occupied by the matrices of
+ * a subdomain, both placed in its memory arena and kept aside.
+ */
+size_t ContextBytes(const SubdomainContext & ctx)
+{
+    // The objects placed in the arena are accounted by the arena itself.
+    auto owned = [](const auto & v) {
+        return v.IsView() ? size_t(0)
+                          : static_cast<size_t>(v.Size()) * sizeof(*v.begin());
+    };
+    return ctx.arena.Bytes() + ctx.Ploc.Bytes() + ctx.Qloc.Bytes() +
+           ctx.Kalman.Bytes() +
+           owned(ctx.field) + owned(ctx.B) + owned(ctx.P) + owned(ctx.Q) +
+           owned(ctx.Qdiag) + owned(ctx.H) + owned(ctx.R) + owned(ctx.z) +
+           owned(ctx.P_mixed) + owned(ctx.tmp_field);
+}
+
+/**
+ * Function prints the memory budget at the beginning of simulation: the
+ * matrices of subdomains with and without sensors, the observations and
+ * the state field (the stencil keeps two copies of it).
+ */
+void ReportMemoryBudget(context_domain_t            & contexts,
+                        const Grid<Matrix,2>        & observations,
+                        const point2d_t             & GridSize)
+{
+    const double MB = 1024.0 * 1024.0;
+    size_t count[2] = {0, 0};       // [0] - with sensors, [1] - without
+    size_t total[2] = {0, 0};
+    size_t largest[2] = {0, 0};
+    size_t obs_bytes = 0;
+    for (index_t x = 0; x < GridSize.x; ++x) {
+    for (index_t y = 0; y < GridSize.y; ++y) {
+        const point2d_t idx(x, y);
+        const size_t k = contexts[idx].sensors.empty() ? 1 : 0;
+        const size_t bytes = ContextBytes(contexts[idx]);
+        count[k] += 1;
+        total[k] += bytes;
+        largest[k] = std::max(largest[k], bytes);
+        obs_bytes += static_cast<size_t>(observations[idx].Size()) *
+                     sizeof(double);
+    }}
+    const size_t state_bytes = 2 * sizeof(subdomain_t) *
+                               static_cast<size_t>(GridSize.x * GridSize.y);
+
+    std::cout << "Memory budget [MB]: "
+        << count[0] << " subdomains with sensors: " << total[0] / MB
+        << " (max. " << largest[0] / MB << " each), "
+        << count[1] << " subdomains without sensors: " << total[1] / MB
+        << " (max. " << largest[1] / MB << " each), "
+        << "observations: " << obs_bytes / MB << ", "
+        << "state field: " << state_bytes / MB << ", "
+        << "total: " << (total[0] + total[1] + obs_bytes + state_bytes) / MB
+        << std::endl;
+}
+
+
+/**
+ * Function returns the trace of the process model covariance of a subdomain,
+ * whatever the storage is; zero if there is no covariance (no sensors).
+ */
+double CovarianceTrace(const SubdomainContext & ctx)
+{
+    if (ctx.sensors.empty()) {
+        return 0.0;
+    } else if (!ctx.Ploc.Empty()) {
+        double sum = 0.0;
+        for (index_t i = 0; i < ctx.Ploc.Size(); ++i) sum += ctx.Ploc.Diag(i);
+        return sum;
+    } else if (!ctx.P_mixed.Empty()) {
+        return Trace(ctx.P_mixed);
+    } else if (ctx.sqrt_covar) {
+        // trace(S*S^t) is the sum of squared entries of S.
+        return std::inner_product(ctx.P.begin(), ctx.P.end(),
+                                  ctx.P.begin(), 0.0);
+    }
+    return Trace(ctx.P);
+}
+
+/**
+ * Class evaluates the in-situ analytics of the assimilation at the end of
+ * every 'analytics_period'-th time step, so that the monitoring does not need
+ * the full fields to be written and post-processed: the total mass of
+ * substance, the maximum concentration and its location, the RMS innovation
+ * at sensors and the trace of covariance matrices (the sum over subdomains
+ * and the largest one). As soon as a subdomain has completed the time step
+ * (see the observer in RunDataAssimilation()), it summarizes itself into its
+ * own cell of the grid of summaries, so the summaries are computed in parallel
+ * and without locking. The last subdomain of a time step launches the
+ * reduction of the grid by multi-dimensional 'preduce', but does not wait for
+ * it, so no worker is held up in the observer. The reduced time steps are
+ * appended to the time series file whenever another one is launched, and the
+ * rest of them by Finish(). The lines go in the order of time steps, although
+ * the subdomains can progress at different paces (e.g. in "neighbour" stencil
+ * mode).
+ */
+class InSituAnalytics
+{
+public:
+    // Summary of a subdomain or a group of subdomains.
+    struct Summary {
+        double    mass;         // integral of concentration
+        double    max_value;    // maximum concentration
+        point2d_t max_pos;      // its global position at the finest resolution
+        double    innov_sq;     // sum of squared innovations at sensors
+        double    num_sensors;  // number of sensors
+        double    trace;        // sum of covariance traces
+        double    max_trace;    // the largest covariance trace
+
+        Summary()
+            : mass(0.0), max_value(std::numeric_limits<double>::lowest())
+            , max_pos(0,0), innov_sq(0.0), num_sensors(0.0)
+            , trace(0.0), max_trace(0.0)
+        {}
+    };
+
+private:
+    // Time step being collected.
+    struct Round {
+        Grid<Summary,2>     summaries;      // summaries of subdomains
+        std::atomic<size_t> count;          // number of summaries so far
+        bool                launched;       // reduction has been launched
+        ::allscale::api::core::treeture<Summary> result;    // reduction
+
+        explicit Round(const point2d_t & grid_size)
+            : summaries(grid_size), count(0), launched(false), result()
+        {}
+    };
+
+    std::string              m_filename;    // name of time series file
+    point2d_t                m_grid_size;   // grid size in subdomains
+    time_schedule_t          m_schedule;    // time steps
+    std::vector<size_t>      m_timestamps;  // timestamps of analytics
+    double                   m_dx, m_dy;    // grid spacing (finest layer)
+    std::mutex               m_mutex;       // guards the members below
+    std::map<size_t,std::unique_ptr<Round>> m_rounds;   // time steps being
+                                                        // collected or reduced
+    size_t                   m_next;        // next entry of m_timestamps
+    std::fstream             m_file;        // time series file
+
+public:
+//-----------------------------------------------------------------------------
+// Constructor; zero period disables the analytics. On resumption from
+// sub-iteration 'first', the records are appended to the existing file.
+//-----------------------------------------------------------------------------
+InSituAnalytics(const Configuration & conf, const time_schedule_t & schedule,
+                const point2d_t & grid_size, size_t first)
+    : m_filename(), m_grid_size(grid_size), m_schedule(schedule)
+    , m_timestamps(), m_dx(conf.asDouble("dx")), m_dy(conf.asDouble("dy"))
+    , m_mutex(), m_rounds(), m_next(0), m_file()
+{
+    const size_t period = conf.IsExist("analytics_period") ?
+                          conf.asUInt("analytics_period") : 0;
+    if (period == 0) return;
+    for (size_t k = period; k <= schedule.size(); k += period) {
+        const size_t ts = (k < schedule.size()) ? schedule[k].first
+                                                : NumSubIterations(schedule);
+        if (ts > first) m_timestamps.push_back(ts);
+    }
+    m_filename = MakeFileName(conf, "analytics");
+
+    // On resumption, keep the records of the time steps done before 'first'.
+    std::vector<std::string> kept;
+    if (first > 0) {
+        const size_t num_done = FindTimeStep(schedule, first - 1) + 1;
+        std::ifstream in(m_filename);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || (line[0] == '#') ||
+                    (std::stoul(line) < num_done)) {
+                kept.push_back(line);
+            }
+        }
+    }
+    m_file.open(m_filename, std::ios::out | std::ios::trunc);
+    assert_true(m_file.good()) << "failed to open file for writing: "
+                               << m_filename;
+    if (kept.empty()) {
+        m_file << "# step time mass max_value max_x max_y"
+                  " rms_innovation trace_P max_trace_P" << std::endl;
+    }
+    for (const auto & line : kept) m_file << line << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Returns "true" if the analytics are evaluated when 'timestamp'
+// sub-iterations have been done.
+//-----------------------------------------------------------------------------
+bool IsDue(size_t timestamp) const
+{
+    return std::binary_search(m_timestamps.begin(), m_timestamps.end(),
+                              timestamp);
+}
+
+//-----------------------------------------------------------------------------
+// Function summarizes a subdomain, which has done 'timestamp' sub-iterations,
+// and launches the reduction of the time step once all the subdomains are in.
+//-----------------------------------------------------------------------------
+void Record(size_t timestamp, const point2d_t & idx,
+            const subdomain_t & cell, const SubdomainContext & ctx)
+{
+    const size_t total = static_cast<size_t>(m_grid_size.x * m_grid_size.y);
+    Round * round = nullptr;
+    {
+        // The lock is taken just to look up the time step.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unique_ptr<Round> & entry = m_rounds[timestamp];
+        if (!entry) entry.reset(new Round(m_grid_size));
+        round = entry.get();
+    }
+    round->summaries[idx] = Summarize(idx, cell, ctx);
+    if (++round->count < total) return;
+
+    // All the subdomains are in, the grid of summaries is reduced as is by
+    // the tasks of 'preduce', which this one does not wait for.
+    auto result = round->summaries.preduce(
+        [](const Summary & elem, Summary & res) { res = Combine(res, elem); },
+        [](const Summary & a, const Summary & b) { return Combine(a, b); },
+        []() { return Summary(); });
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    round->result = std::move(result);
+    round->launched = true;
+    Flush(false);
+}
+
+//-----------------------------------------------------------------------------
+// Function waits for the remaining reductions, writes them and closes
+// the time series file.
+//-----------------------------------------------------------------------------
+void Finish()
+{
+    if (m_timestamps.empty()) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Flush(true);
+    assert_true(m_rounds.empty() && (m_next == m_timestamps.size()))
+        << "incomplete in-situ analytics";
+    m_file.close();
+    std::cout << "In-situ analytics: " << m_next << " records written to "
+              << m_filename << std::endl;
+}
+
+private:
+//-----------------------------------------------------------------------------
+// Function writes the records of time steps in their order as long as their
+// reductions are done; if 'wait' is set, it waits for the launched ones.
+// The caller holds the lock.
+//-----------------------------------------------------------------------------
+void Flush(bool wait)
+{
+    while (m_next < m_timestamps.size()) {
+        const size_t ts = m_timestamps[m_next];
+        auto it = m_rounds.find(ts);
+        if ((it == m_rounds.end()) || !it->second->launched ||
+                (!wait && !it->second->result.isDone())) {
+            break;
+        }
+        Write(ts, it->second->result.get());
+        m_rounds.erase(it);
+        ++m_next;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function computes the summary of a subdomain.
+//-----------------------------------------------------------------------------
+Summary Summarize(const point2d_t & idx, const subdomain_t & cell,
+                  const SubdomainContext & ctx) const
+{
+    // Scale of the active layer relative to the finest one.
+    const size2d_t layer_size = cell.getActiveLayerSize();
+    const size2d_t fine_size = cell.getLayerSize(LayerFine);
+    const index_t rx = fine_size.x / layer_size.x;
+    const index_t ry = fine_size.y / layer_size.y;
+
+    Summary s;
+    point2d_t max_loc(0,0);
+    cell.forAllActiveNodes([&](const point2d_t & loc, double val) {
+        s.mass += val;
+        if (val > s.max_value) { s.max_value = val; max_loc = loc; }
+    });
+    s.mass *= m_dx * m_dy * static_cast<double>(rx * ry);
+    const point2d_t glo = Sub2Glo(max_loc, idx, layer_size);
+    s.max_pos = point2d_t(glo.x * rx, glo.y * ry);
+    s.innov_sq = ctx.innov_sq;
+    s.num_sensors = static_cast<double>(ctx.sensors.size());
+    s.trace = s.max_trace = CovarianceTrace(ctx);
+    return s;
+}
+
+//-----------------------------------------------------------------------------
+// Function combines two summaries; the ties of maximum concentration are
+// resolved by position, so the result does not depend on the order.
+//-----------------------------------------------------------------------------
+static Summary Combine(const Summary & a, const Summary & b)
+{
+    Summary s;
+    s.mass = a.mass + b.mass;
+    const bool b_max = (b.max_value > a.max_value) ||
+        ((b.max_value == a.max_value) &&
+            ((b.max_pos.x < a.max_pos.x) ||
+             ((b.max_pos.x == a.max_pos.x) && (b.max_pos.y < a.max_pos.y))));
+    s.max_value = b_max ? b.max_value : a.max_value;
+    s.max_pos   = b_max ? b.max_pos   : a.max_pos;
+    s.innov_sq = a.innov_sq + b.innov_sq;
+    s.num_sensors = a.num_sensors + b.num_sensors;
+    s.trace = a.trace + b.trace;
+    s.max_trace = std::max(a.max_trace, b.max_trace);
+    return s;
+}
+
+//-----------------------------------------------------------------------------
+// Function writes the record of the time step that ends at 'timestamp'.
+//-----------------------------------------------------------------------------
+void Write(size_t timestamp, const Summary & s)
+{
+    const size_t k = FindTimeStep(m_schedule, timestamp - 1);
+    const double rms = (s.num_sensors > 0.0) ?
+                        std::sqrt(s.innov_sq / s.num_sensors) : 0.0;
+    m_file << k << " " << (m_schedule[k].time + m_schedule[k].dt) << " "
+           << s.mass << " " << s.max_value << " "
+           << s.max_pos.x << " " << s.max_pos.y << " "
+           << rms << " " << s.trace << " " << s.max_trace << std::endl;
+}
+
+}; // class InSituAnalytics
+
+/**
+ * Function fills in the halo of extended subdomain field, which is not taken
+ * from the peers: beyond the outer border of the whole domain the points
+ * inside the subdomain are mirrored, and the corner blocks are interpolated.
+ */
+void FillOuterHalo(Matrix & field, const point2d_t & idx,
+                   const point2d_t & grid_size, const size2d_t & layer_size,
+                   index_t halo)
+{
+    const index_t Nx = grid_size.x;
+    const index_t Ny = grid_size.y;
+    const index_t Sx = layer_size.x;
+    const index_t Sy = layer_size.y;
+    const index_t w  = halo;
+
+    // At the outer border of the whole domain: du/dn = 0.
+    for (index_t k = 0; k < w; ++k) {
+        if (idx.x == 0) {
+            for (index_t y = w; y < Sy+w; ++y)
+                field(w-1-k, y) = field(w+1+k, y);
+        }
+        if (idx.x+1 == Nx) {
+            for (index_t y = w; y < Sy+w; ++y)
+                field(Sx+w+k, y) = field(Sx+w-2-k, y);
+        }
+        if (idx.y == 0) {
+            for (index_t x = w; x < Sx+w; ++x)
+                field(x, w-1-k) = field(x, w+1+k);
+        }
+        if (idx.y+1 == Ny) {
+            for (index_t x = w; x < Sx+w; ++x)
+                field(x, Sy+w+k) = field(x, Sy+w-2-k);
+        }
+    }
+
+    // The corner points are not used in finite-difference scheme applied to
+    // internal subdomain points, however, Kalman filter uses the entire
+    // subdomain field (as currently implemented but could be easily avoided).
+    // For the latter reason, we have to assign some feasible values to the
+    // corner points. Note, since we operate on extended subdomains, their
+    // corners belong to unreachable diagonal peers. A corner block of wide
+    // halo is swept outwards, every point takes the mean of its three
+    // neighbours closer to the subdomain.
+    const index_t Ex = Sx + 2*w;
+    const index_t Ey = Sy + 2*w;
+    for (index_t i = 0; i < w; ++i) {
+    for (index_t j = 0; j < w; ++j) {
+        const index_t x0 = w-1-i, y0 = w-1-j;       // near the origin
+        const index_t x1 = Ex-w+i, y1 = Ey-w+j;     // near the far end
+        field(x0,y0) = (field(x0+1,y0) + field(x0+1,y0+1) + field(x0,y0+1))/3.0;
+        field(x0,y1) = (field(x0+1,y1) + field(x0+1,y1-1) + field(x0,y1-1))/3.0;
+        field(x1,y0) = (field(x1-1,y0) + field(x1-1,y0+1) + field(x1,y0+1))/3.0;
+        field(x1,y1) = (field(x1-1,y1) + field(x1-1,y1-1) + field(x1,y1-1))/3.0;
+    }}
 }
 
 /**
  * Function copies an Allscale subdomain to the matrix. The output matrix
- * represents so called "extended subdomain" where one extra point layer on
- * either side is added by copying values from the peer subdomains' boundaries.
- * When a subdomain is located at the outer boundary of the whole domain,
+ * represents so called "extended subdomain" where 'halo' extra point layers
+ * on either side are added by copying values from the peer subdomains'
+ * boundary strips of the same depth. With the halo wider than one point,
+ * the extended subdomains of the peers overlap (Schwarz method). When
+ * a subdomain is located at the outer boundary of the whole domain,
  * we initialize the extended points in a way that provides zero boundary
  * condition on the density derivative along the normal: du/dn = 0. For example,
- * at the left boundary we set (see the code): field(0,:) = field(2,:);
- * Here field(0,:) addresses the points outside the domain (because this is an
- * extended subdomain) and field(1,:) addresses the points on the global outer
- * boundary. Derivative at the left outer boundary reads:
+ * at the left boundary with one point halo we set (see the code):
+ * field(0,:) = field(2,:); Here field(0,:) addresses the points outside the
+ * domain (because this is an extended subdomain) and field(1,:) addresses the
+ * points on the global outer boundary. Derivative at the left outer boundary
+ * reads:
             d(field(1,y))/dx = (field(2,y) - field(0,y))/2 = 0,
- * according to above condition.
+ * according to above condition. The wider halo is mirrored the same way.
+ * If 'exchange' is false, the peers are not consulted: only the subdomain
+ * itself is copied, whereas its halo keeps the values of the previous
+ * sub-iteration, i.e. the ones from the last exchange advanced by the local
+ * solver over the overlap (see 'halo_exchange_period' parameter).
  */
-void MatrixFromAllscale(Matrix & field,
-                        const domain_t & dom, const point2d_t & idx)
+void MatrixFromAllscale(Matrix & field, const domain_t & dom,
+                        const point2d_t & idx, unsigned layer,
+                        index_t halo, bool exchange)
 {
-    const unsigned layer_no = dom[idx].getActiveLayer();
-    const index_t Nx = dom.size().x;
-    const index_t Ny = dom.size().y;
-    const index_t Sx = const_cast<subdomain_t&>(dom[idx]).getActiveLayerSize().x;
-    const index_t Sy = const_cast<subdomain_t&>(dom[idx]).getActiveLayerSize().y;
+    const index_t Sx = dom[idx].getLayerSize(layer).x;
+    const index_t Sy = dom[idx].getLayerSize(layer).y;
+    const index_t w  = halo;
 
     // Copy the internal points of a subdomain to the (internal part of) output
-    // field. Mind the extended subdomain: an extra point layer on either side.
-    assert_true(CheckSizes(dom[idx], field));
-    dom[idx].forAllActiveNodes([&](const point2d_t & pos, const double & val) {
-        field(pos.x + 1, pos.y + 1) = val;
-    });
+    // field. Mind the extended subdomain: 'halo' extra point layers on either
+    // side.
+    assert_true(CheckSizes(dom[idx].getLayerSize(layer), field, halo));
+    if (!exchange) {
+        dom[idx].copyLayerTo(layer, &field(w,w), field.NCols());
+    } else {
+#if MY_MULTISCALE_METHOD == 1
+        const index_t Nx = dom.size().x;
+        const index_t Ny = dom.size().y;
+        assert_true(dom[idx].getActiveLayer() == layer);
+        assert_true(halo == 1) << "wide halo requires multiscale method 2";
+        dom[idx].forAllActiveNodes([&](const point2d_t & pos,
+                                       const double & val) {
+            field(pos.x + 1, pos.y + 1) = val;
+        });
+
+        double_array_t boundary;    // placeholder of boundary points
+
+        // Set up left-most points from the right boundary of the left peer.
+        if (idx.x > 0) {
+            AdjustBoundary(boundary,
+                       dom[{idx.x-1, idx.y}].getBoundary(Direction::Right), Sy);
+            for (index_t y = 0; y < Sy; ++y) field(0, y+1) = boundary[y];
+        }
 
-    double_array_t boundary;    // placeholder of boundary points
+        // Set up right-most points from the left boundary of the right peer.
+        if (idx.x+1 < Nx) {
+            AdjustBoundary(boundary,
+                       dom[{idx.x+1, idx.y}].getBoundary(Direction::Left), Sy);
+            for (index_t y = 0; y < Sy; ++y) field(Sx+1, y+1) = boundary[y];
+        }
 
-    // Set up left-most points from the right boundary of the left peer.
-    if (idx.x > 0) {
-#if MY_MULTISCALE_METHOD == 1
-        AdjustBoundary(boundary,
-                   dom[{idx.x-1, idx.y}].getBoundary(Direction::Right), Sy);
+        // Set up bottom-most points from the top boundary of the bottom peer.
+        if (idx.y > 0) {
+            AdjustBoundary(boundary,
+                       dom[{idx.x, idx.y-1}].getBoundary(Direction::Up), Sx);
+            for (index_t x = 0; x < Sx; ++x) field(x+1, 0) = boundary[x];
+        }
+
+        // Set up top-most points from the bottom boundary of the top peer.
+        if (idx.y+1 < Ny) {
+            AdjustBoundary(boundary,
+                       dom[{idx.x, idx.y+1}].getBoundary(Direction::Down), Sx);
+            for (index_t x = 0; x < Sx; ++x) field(x+1, Sy+1) = boundary[x];
+        }
 #else // method == 2
-        boundary = dom[{idx.x-1, idx.y}].data.getBoundary(layer_no,
-                                                          Direction::Right);
+        // Bulk copy of the subdomain and the boundary strips of its peers
+        // taken at the same resolution straight into the extended field,
+        // no temporaries. All the layers are kept up to date, so any of them
+        // can be gathered.
+        ::allscale::api::user::data::gatherExtended(dom, idx, layer,
+                            field.begin(), static_cast<size_t>(halo));
 #endif
-        assert_true(boundary.size() == size_t(Sy));
-        for (index_t y = 0; y < Sy; ++y) field(0, y+1) = boundary[y];
-    } else {
-        for (index_t y = 0; y < Sy; ++y) field(0, y+1) = field(2, y+1);
     }
+    FillOuterHalo(field, idx, dom.size(), size2d_t(Sx, Sy), w);
+}
 
-    // Set up right-most points from the left boundary of the right peer.
-    if (idx.x+1 < Nx) {
-#if MY_MULTISCALE_METHOD == 1
-        AdjustBoundary(boundary,
-                   dom[{idx.x+1, idx.y}].getBoundary(Direction::Left), Sy);
-#else // method == 2
-        boundary = dom[{idx.x+1, idx.y}].data.getBoundary(layer_no,
-                                                          Direction::Left);
-#endif
-        assert_true(boundary.size() == size_t(Sy));
-        for (index_t y = 0; y < Sy; ++y) field(Sx+1, y+1) = boundary[y];
-    } else {
-        for (index_t y = 0; y < Sy; ++y) field(Sx+1, y+1) = field(Sx-1, y+1);
+/**
+ * Function adds the coarse-grid correction, pending since the previous
+ * sub-iteration (see CoarseCorrection), to the extended subdomain field made
+ * from the state of that sub-iteration: the subdomain's own correction to
+ * its points and the correction of every peer to the halo strip the peer has
+ * provided. The correction is piecewise constant, so it does not matter at
+ * which layer the strip has been taken. As the subdomain routines do after
+ * an update, the density stays non-negative and vanishes at the outer border;
+ * the halo beyond the border and in the corners is then filled in anew.
+ */
+void CorrectExtendedField(Matrix & field, const CoarseCorrection & correction,
+                          size_t timestamp, const point2d_t & idx,
+                          const point2d_t & grid_size,
+                          const size2d_t & layer_size)
+{
+    const index_t Nx = grid_size.x;
+    const index_t Ny = grid_size.y;
+    const index_t Sx = layer_size.x;
+    const index_t Sy = layer_size.y;
+    const index_t w  = HaloWidth(field, layer_size);
+    const index_t Ex = Sx + 2*w;
+    const index_t Ey = Sy + 2*w;
+
+    bool corrected = false;
+    auto Add = [&](index_t x0, index_t x1, index_t y0, index_t y1,
+                   const point2d_t & pos) {
+        const double c = correction.Correction(timestamp, pos);
+        if (c == 0.0) return;
+        corrected = true;
+        for (index_t x = x0; x < x1; ++x) {
+        for (index_t y = y0; y < y1; ++y) {
+            field(x,y) = std::max(field(x,y) + c, 0.0);
+        }}
+    };
+    Add(w, Sx+w, w, Sy+w, idx);
+    if (idx.x > 0)    Add(0, w, w, Sy+w, point2d_t(idx.x-1, idx.y));
+    if (idx.x+1 < Nx) Add(Sx+w, Ex, w, Sy+w, point2d_t(idx.x+1, idx.y));
+    if (idx.y > 0)    Add(w, Sx+w, 0, w, point2d_t(idx.x, idx.y-1));
+    if (idx.y+1 < Ny) Add(w, Sx+w, Sy+w, Ey, point2d_t(idx.x, idx.y+1));
+    if (!corrected) return;
+
+    // Dirichlet zero boundary condition, see ApplyBoundaryCondition().
+    if (idx.x == 0) {
+        for (index_t y = 0; y < Ey; ++y) field(w,y) = 0.0;
+    } else if (idx.x == Nx - 1) {
+        for (index_t y = 0; y < Ey; ++y) field(Sx+w-1,y) = 0.0;
     }
+    if (idx.y == 0) {
+        for (index_t x = 0; x < Ex; ++x) field(x,w) = 0.0;
+    } else if (idx.y == Ny - 1) {
+        for (index_t x = 0; x < Ex; ++x) field(x,Sy+w-1) = 0.0;
+    }
+    FillOuterHalo(field, idx, grid_size, layer_size, w);
+}
 
-    // Set up bottom-most points from the top boundary of the bottom peer.
-    if (idx.y > 0) {
-#if MY_MULTISCALE_METHOD == 1
-        AdjustBoundary(boundary,
-                   dom[{idx.x, idx.y-1}].getBoundary(Direction::Up), Sx);
-#else // method == 2
-        boundary = dom[{idx.x, idx.y-1}].data.getBoundary(layer_no,
-                                                          Direction::Up);
+/**
+ * Function copies a matrix, which represents an extended subdomain,
+ * to Allscale subdomain structure; the halo is dropped.
+ */
+void AllscaleFromMatrix(subdomain_t & cell, const Matrix & field)
+{
+    const index_t halo = HaloWidth(field, cell.getActiveLayerSize());
+    assert_true((halo > 0) &&
+                CheckSizes(cell.getActiveLayerSize(), field, halo));
+    cell.copyActiveLayerFrom(&field(halo,halo), field.NCols());
+}
+
+/**
+ * Function makes up the layers [finest..coarsest] of a subdomain from the
+ * active one, so the peer subdomains can pick up its boundary at whatever
+ * resolution they operate (see LayersInUse()). The finer layers are either
+ * piecewise constant or bilinearly interpolated, the coarser ones are
+ * averaged. The active layer is intact, the layers out of range are not
+ * touched.
+ */
+void MakeUpLayers(const Configuration & conf, subdomain_t & cell,
+                  unsigned finest, unsigned coarsest)
+{
+#if MY_MULTISCALE_METHOD == 2
+    const unsigned layer = cell.getActiveLayer();
+    const bool bilinear = conf.IsExist("prolongation") &&
+                         (conf.asString("prolongation") == "bilinear");
+    while (cell.getActiveLayer() > finest) {
+        if (bilinear) {
+            cell.refineLinear();
+        } else {
+            cell.refine([](const double & elem) { return elem; });
+        }
+    }
+    cell.setActiveLayer(layer);
+    while (cell.getActiveLayer() < coarsest) {
+        cell.coarsen([](const double & elem) { return elem; });
+    }
+    cell.setActiveLayer(layer);
+#else
+    (void) conf; (void) cell; (void) finest; (void) coarsest;
 #endif
-        assert_true(boundary.size() == size_t(Sx));
-        for (index_t x = 0; x < Sx; ++x) field(x+1, 0) = boundary[x];
-    } else {
-        for (index_t x = 0; x < Sx; ++x) field(x+1, 0) = field(x+1, 2);
+}
+
+/**
+ * Function returns "true" if the subdomains without sensors can switch their
+ * resolution at the sub-iteration specified, i.e. at the beginning of every
+ * 'adapt_period'-th time step (see SubdomainRoutineNoSensors()).
+ */
+bool LayerSwitchDue(const Configuration & conf,
+                    const time_schedule_t & schedule, size_t timestamp)
+{
+    const size_t adapt_period = conf.IsExist("adapt_period") ?
+                                conf.asUInt("adapt_period") : 0;
+    if ((adapt_period == 0) || (timestamp >= NumSubIterations(schedule))) {
+        return false;
     }
+    const size_t t_discrete = FindTimeStep(schedule, timestamp);
+    return (schedule[t_discrete].first == timestamp) &&
+           (t_discrete % adapt_period == 0);
+}
 
-    // Set up top-most points from the bottom boundary of the top peer.
-    if (idx.y+1 < Ny) {
-#if MY_MULTISCALE_METHOD == 1
-        AdjustBoundary(boundary,
-                   dom[{idx.x, idx.y+1}].getBoundary(Direction::Down), Sx);
-#else // method == 2
-        boundary = dom[{idx.x, idx.y+1}].data.getBoundary(layer_no,
-                                                          Direction::Down);
-#endif
-        assert_true(boundary.size() == size_t(Sx));
-        for (index_t x = 0; x < Sx; ++x) field(x+1, Sy+1) = boundary[x];
-    } else {
-        for (index_t x = 0; x < Sx; ++x) field(x+1, Sy+1) = field(x+1, Sy-1);
+/**
+ * Function returns the range of layers a subdomain should keep up to date
+ * once it has done the sub-iteration 'timestamp': the layers its 4 direct
+ * peers operate at, as they pick up its boundary at their own resolution on
+ * the next sub-iteration, and its own 'layer'. The functor 'peer_layer' gives
+ * the active layer of a peer by its position in the grid of subdomains.
+ * Around the switch of resolution, i.e. if a peer could have switched at this
+ * sub-iteration or could switch at the next one, all the layers are kept.
+ */
+template<typename PeerLayer>
+std::pair<unsigned,unsigned> LayersInUse(const Configuration & conf,
+                                         const time_schedule_t & schedule,
+                                         size_t timestamp,
+                                         const point2d_t & grid_size,
+                                         const point2d_t & idx,
+                                         unsigned layer,
+                                         const PeerLayer & peer_layer)
+{
+    if (LayerSwitchDue(conf, schedule, timestamp) ||
+            LayerSwitchDue(conf, schedule, timestamp + 1)) {
+        return std::make_pair(static_cast<unsigned>(LayerFine),
+                              static_cast<unsigned>(LayerCoarse));
     }
+    unsigned finest = layer, coarsest = layer;
+    auto Peer = [&](index_t x, index_t y) {
+        const unsigned l = peer_layer(point2d_t(x,y));
+        finest = std::min(finest, l);
+        coarsest = std::max(coarsest, l);
+    };
+    if (idx.x > 0)                  Peer(idx.x - 1, idx.y);
+    if (idx.x + 1 < grid_size.x)    Peer(idx.x + 1, idx.y);
+    if (idx.y > 0)                  Peer(idx.x, idx.y - 1);
+    if (idx.y + 1 < grid_size.y)    Peer(idx.x, idx.y + 1);
+    return std::make_pair(finest, coarsest);
+}
 
-    // The corner points are not used in finite-difference scheme applied to
-    // internal subdomain points, however, Kalman filter uses the entire
-    // subdomain field (as currently implemented but could be easily avoided).
-    // For the latter reason, we have to assign some feasible values to the
-    // corner points. Note, since we operate on extended subdomains, their
-    // corners belong to unreachable diagonal peers.
-    field(0,0)       = (field(1,0)     + field(1,1)   + field(0,1)    ) / 3.0;
-    field(0,Sy+1)    = (field(1,Sy+1)  + field(1,Sy)  + field(0,Sy)   ) / 3.0;
-    field(Sx+1,0)    = (field(Sx,0)    + field(Sx,1)  + field(Sx+1,1) ) / 3.0;
-    field(Sx+1,Sy+1) = (field(Sx,Sy+1) + field(Sx,Sy) + field(Sx+1,Sy)) / 3.0;
+/**
+ * The same as above, the peers' active layers are taken from the state field
+ * 'state' the sub-iteration started from, where they stay until a switch of
+ * resolution.
+ */
+std::pair<unsigned,unsigned> LayersInUse(const Configuration & conf,
+                                         const time_schedule_t & schedule,
+                                         size_t timestamp,
+                                         const domain_t & state,
+                                         const point2d_t & idx,
+                                         unsigned layer)
+{
+    return LayersInUse(conf, schedule, timestamp, state.size(), idx, layer,
+                       [&state](const point2d_t & peer) {
+                           return state[peer].getActiveLayer();
+                       });
 }
 
 /**
- * Function copies a matrix, which represents an extended subdomain,
- * to Allscale subdomain structure.
+ * Function evaluates a cheap error indicator on the extended subdomain field
+ * and returns the layer the subdomain should operate at. The indicator is the
+ * largest undivided central difference, i.e. the variation of the density
+ * across a single cell of the current layer, which grows with the cell size.
+ * The subdomain goes one layer finer (coarser) if the indicator exceeds
+ * (drops below) the refinement (coarsening) tolerance, staying within
+ * [LayerFine..LayerCoarse].
  */
-void AllscaleFromMatrix(subdomain_t & cell, const Matrix & field)
+unsigned ChooseLayer(const Configuration & conf, const Matrix & field,
+                     index_t halo, unsigned layer)
 {
-    // Mind the extended subdomain: one extra point layer on either side.
-    assert_true(CheckSizes(cell, field));
-    cell.forAllActiveNodes([&](const point2d_t & pos, double & val) {
-        val = field(pos.x + 1, pos.y + 1);
-    });
+    // Mind the extended subdomain: 'halo' extra point layers on either side.
+    const index_t w  = halo;
+    const index_t Sx = field.NRows() - 2 * w;
+    const index_t Sy = field.NCols() - 2 * w;
+    double indicator = 0.0;
+    for (index_t x = w; x < Sx+w; ++x) {
+    for (index_t y = w; y < Sy+w; ++y) {
+        indicator = std::max(indicator,
+            0.5 * (std::fabs(field(x+1,y) - field(x-1,y)) +
+                   std::fabs(field(x,y+1) - field(x,y-1))));
+    }}
+
+    if ((indicator > conf.asDouble("adapt_refine_tol")) &&
+            (layer > static_cast<unsigned>(LayerFine))) {
+        return layer - 1;
+    }
+    if ((indicator < conf.asDouble("adapt_coarsen_tol")) &&
+            (layer < static_cast<unsigned>(LayerCoarse))) {
+        return layer + 1;
+    }
+    return layer;
+}
+
+/**
+ * Function copies the halo of extended subdomain, i.e. the whole strips of
+ * 'halo' width along the 4 sides, into 'b.remote'. Being called before the
+ * halo is picked up from the peers, it keeps the halo as the subdomain has
+ * computed it at the previous sub-iteration (see MeasureHaloMismatch()).
+ * A field of another resolution leaves nothing to compare with.
+ */
+void KeepHalo(Boundary & b, const Matrix & field, index_t halo,
+              const size2d_t & layer_size)
+{
+    const index_t w  = halo;
+    const index_t Sx = layer_size.x;
+    const index_t Sy = layer_size.y;
+    b.remote.clear();
+    if ((field.NRows() != Sx + 2*w) || (field.NCols() != Sy + 2*w)) return;
+
+    b.remote.reserve(static_cast<size_t>(2 * w * (Sx + Sy)));
+    for (index_t k = 0; k < w; ++k) {
+        const index_t xr = Sx + 2*w - 1 - k;    // k-th layer from the right
+        const index_t yu = Sy + 2*w - 1 - k;    // k-th layer from the top
+        for (index_t y = w; y < Sy+w; ++y) b.remote.push_back(field(k,  y));
+        for (index_t y = w; y < Sy+w; ++y) b.remote.push_back(field(xr, y));
+        for (index_t x = w; x < Sx+w; ++x) b.remote.push_back(field(x,  k));
+        for (index_t x = w; x < Sx+w; ++x) b.remote.push_back(field(x, yu));
+    }
+}
+
+/**
+ * Function measures the mismatch between a subdomain and its peers on the
+ * halo of extended subdomain, i.e. on the overlap of subdomains in the
+ * Schwarz iterations. 'b.remote' keeps the halo as the subdomain has computed
+ * it at the previous sub-iteration (see KeepHalo()), whereas 'field' has just
+ * picked up the values the peers have computed at the same sub-iteration.
+ * The inner layers of wide halo are solved by both sides; the outermost one
+ * is the peers' values the subdomain has been solved with, so their mismatch
+ * is the residual of the global model equation along the interface. The norm
+ * of mismatch relative to the one of the peers' values is placed in
+ * 'b.rel_diff'. Sides on the outer border of the whole domain have no peers,
+ * so they are excluded. Returns "false" if there is nothing to compare with,
+ * i.e. on the very first call or after the resolution has been switched.
+ */
+bool MeasureHaloMismatch(Boundary & b, const Matrix & field, index_t halo,
+                         const point2d_t & idx, const point2d_t & grid_size)
+{
+    const index_t w  = halo;
+    const index_t Sx = field.NRows() - 2 * w;
+    const index_t Sy = field.NCols() - 2 * w;
+
+    b.outer[Direction::Left ] = (idx.x == 0);
+    b.outer[Direction::Right] = (idx.x + 1 == grid_size.x);
+    b.outer[Direction::Down ] = (idx.y == 0);
+    b.outer[Direction::Up   ] = (idx.y + 1 == grid_size.y);
+
+    if (b.remote.size() != static_cast<size_t>(2 * w * (Sx + Sy))) {
+        return false;
+    }
+
+    double diff = 0.0, norm = 0.0;
+    size_t pos = 0;
+    auto Compare = [&](int side, double val) {
+        if (!b.outer[side]) {
+            diff += std::pow(val - b.remote[pos], 2);
+            norm += val * val;
+        }
+        ++pos;
+    };
+    for (index_t k = 0; k < w; ++k) {
+        const index_t xr = Sx + 2*w - 1 - k;    // k-th layer from the right
+        const index_t yu = Sy + 2*w - 1 - k;    // k-th layer from the top
+        for (index_t y = w; y < Sy+w; ++y) Compare(Direction::Left,  field(k,  y));
+        for (index_t y = w; y < Sy+w; ++y) Compare(Direction::Right, field(xr, y));
+        for (index_t x = w; x < Sx+w; ++x) Compare(Direction::Down,  field(x,  k));
+        for (index_t x = w; x < Sx+w; ++x) Compare(Direction::Up,    field(x, yu));
+    }
+    assert_true(pos == b.remote.size());
+
+    b.rel_diff = std::sqrt(diff) / (std::sqrt(norm) + TINY);
+    return true;
+}
+
+/**
+ * Function returns "true" if the halo of extended subdomain is exchanged with
+ * the peers at the sub-iteration specified, i.e. every 'halo_exchange_period'
+ * sub-iterations (every one by default) starting from the first one of a time
+ * step. In between, the subdomain is advanced with its own halo, which makes
+ * sense for the halo wider than one point (see MatrixFromAllscale()).
+ */
+bool HaloExchangeDue(const Configuration & conf, size_t sub_iter)
+{
+    const size_t period = conf.IsExist("halo_exchange_period") ?
+                          conf.asUInt("halo_exchange_period") : 1;
+    return (sub_iter % std::max(period, size_t(1)) == 0);
+}
+
+/**
+ * Function implements the convergence control of sub-iterations: it returns
+ * "true" if the halo of a subdomain has settled by the current sub-iteration,
+ * i.e. its mismatch with the peers is less than 'sub_iter_tol' (see
+ * MeasureHaloMismatch()), and at least 'min_sub_iter' sub-iterations of the
+ * time step have been made including the current one. The subdomain then
+ * holds its state over the remaining sub-iterations of the time step, so its
+ * peers keep reading the values of the sub-iteration it has settled at.
+ * Zero (default) tolerance disables the control, so every time step makes
+ * all its sub-iterations. It is called once the halo has been picked up from
+ * the peers into 'ctx.field', the halo computed by the subdomain itself is
+ * kept before that by KeepHalo().
+ */
+bool HaloSettled(const Configuration & conf, SubdomainContext & ctx,
+                 const TimeStep & step, size_t sub_iter, index_t halo,
+                 const point2d_t & idx, const point2d_t & grid_size)
+{
+    const double tol = conf.IsExist("sub_iter_tol") ?
+                       conf.asDouble("sub_iter_tol") : 0.0;
+    if (tol <= 0.0) return false;
+    const size_t min_sub_iter = conf.IsExist("min_sub_iter") ?
+                                conf.asUInt("min_sub_iter") : 1;
+    const bool measured = MeasureHaloMismatch(ctx.boundaries, ctx.field,
+                                              halo, idx, grid_size);
+    return measured && (ctx.boundaries.rel_diff < tol) &&
+           (sub_iter + 1 >= min_sub_iter) && (sub_iter + 1 < step.Nsubiter);
 }
 
 /**
@@ -536,16 +1333,16 @@ void AllscaleFromMatrix(subdomain_t & cell, const Matrix & field)
  * during the time integration. For such a subdomain the Kalman filter governs
  * the simulation by pulling it towards the observed ground-truth.
  */
-void SubdomainRoutineKalman(const Configuration & conf,
-                            const point_array_t & sensors,
-                            const Matrix        & observations,
-                            const size_t          timestamp,
-                            const domain_t      & curr_state,
-                            subdomain_t         & next_state,
-                            SubdomainContext    & ctx,
-                            const point2d_t     & idx,
-                            const size_t          Nsubiter,
-                            const size_t          Nt)
+void SubdomainRoutineKalman(const Configuration   & conf,
+                            const point_array_t   & sensors,
+                            const Matrix          & observations,
+                            const time_schedule_t & schedule,
+                            const size_t            timestamp,
+                            const domain_t        & curr_state,
+                            subdomain_t           & next_state,
+                            SubdomainContext      & ctx,
+                            const point2d_t       & idx,
+                            const CoarseCorrection & correction)
 {
     const unsigned resolution = static_cast<unsigned>(LayerFine);
 
@@ -557,11 +1354,12 @@ void SubdomainRoutineKalman(const Configuration & conf,
         const_cast<subdomain_t&>(curr_state[idx]).getActiveLayerSize();
 
     // Get the discrete time (index of iteration) in the range [0..Nt) and
-    // the index of sub-iteration in the range [0..Nsubiter).
-    assert_true(timestamp < Nt * Nsubiter);
-	(void)Nt; // silence unused parameter warning
-    const size_t t_discrete = timestamp / Nsubiter;
-    const size_t sub_iter   = timestamp % Nsubiter;
+    // the index of sub-iteration in the range [0..Nsubiter) of that step.
+    const size_t     Nt = schedule.size();
+    const size_t     t_discrete = FindTimeStep(schedule, timestamp);
+    const TimeStep & step = schedule[t_discrete];
+    const size_t     sub_iter = timestamp - step.first;
+	(void)Nt; // silence unused variable warning
 
 #ifdef AMDADOS_DEBUGGING    // printing progress
     if ((idx == point2d_t(0,0)) && (sub_iter == 0)) {
@@ -571,32 +1369,96 @@ void SubdomainRoutineKalman(const Configuration & conf,
     }
 #endif
 
-    // Compute flow velocity vector.
-    ctx.flow = Flow(conf, t_discrete);
+    // The layers the peers pick up at the next sub-iteration.
+    const std::pair<unsigned,unsigned> layers = LayersInUse(conf, schedule,
+                                    timestamp, curr_state, idx, resolution);
 
-    // Copy state field into the matrix object.
-    MatrixFromAllscale(ctx.field, curr_state, idx);
+    // The remaining sub-iterations after the halo has settled leave the
+    // subdomain as is, though a peer can switch the resolution.
+    if (HoldsState(ctx, schedule, timestamp)) {
+        next_state = curr_state[idx];
+        ctx.held += 1;
+        MakeUpLayers(conf, next_state, layers.first, layers.second);
+        return;
+    }
+
+    // Compute flow velocity vector.
+    ctx.flow = Flow(conf, step.time);
+
+    // Copy state field into the matrix object. The halo can only settle
+    // when it has been exchanged.
+    const index_t halo = HaloWidth(conf, layer_size);
+    const bool exchange = HaloExchangeDue(conf, sub_iter);
+    if (exchange) KeepHalo(ctx.boundaries, ctx.field, halo, layer_size);
+    MatrixFromAllscale(ctx.field, curr_state, idx, resolution, halo, exchange);
+    CorrectExtendedField(ctx.field, correction, timestamp, idx,
+                         curr_state.size(), layer_size);
+    if (exchange && HaloSettled(conf, ctx, step, sub_iter, halo,
+                                idx, curr_state.size())) {
+        ctx.settled = t_discrete;
+        ctx.held = 0;
+    }
 
     // At the beginning of a regular iteration (i.e. at the first
     // sub-iteration) do: (1) get the new observations; (2) obtain new noise
     // covariance matrices; (3) compute the prior state estimation.
     if (sub_iter == 0) {
-        // Get the current sensor measurements.
-        GetObservations(ctx.z, observations, static_cast<int>(t_discrete),
-                        ctx.H, sensors, layer_size);
+        // Get the sensor measurements at the current time.
+        double weight = 0.0;
+        const index_t row = static_cast<index_t>(
+                                ObservationRow(conf, step.time, weight));
+        GetObservations(ctx.z, observations, row, weight,
+                        ctx.H, sensors, layer_size, halo);
 
         // Covariance matrices can change over time.
-        ComputeQ(conf, ctx.Q);
         ComputeR(conf, ctx.R);
+        if (ctx.Ploc.Empty()) {
+            InverseModelMatrix(ctx.B, conf, ctx.flow, layer_size, halo,
+                               step.dt);
+        } else {
+            ctx.model = InverseModelStencil(conf, ctx.flow, layer_size,
+                                            step.dt);
+        }
 
         // Prior estimation.
-        InverseModelMatrix(ctx.B, conf, ctx.flow, layer_size, resolution);
-        ctx.Kalman.PropagateStateInverse(ctx.field, ctx.P, ctx.B, ctx.Q);
-    }
+        if (ctx.sqrt_covar) {
+            ComputeQ(conf, ctx.Qdiag);
+            ctx.Kalman.PropagateStateInverseSqrt(ctx.field, ctx.P,
+                                                 ctx.B, ctx.Qdiag);
+        } else if (!ctx.P_mixed.Empty()) {
+            ComputeQ(conf, ctx.Q);
+            ctx.Kalman_mixed.PropagateStateInverse(ctx.field, ctx.P_mixed,
+                                                   ctx.B, ctx.Q);
+        } else if (ctx.Ploc.Empty()) {
+            ComputeQ(conf, ctx.Q);
+            ctx.Kalman.PropagateStateInverse(ctx.field, ctx.P, ctx.B, ctx.Q);
+        } else {
+            ComputeQ(conf, ctx.Qloc);
+            ctx.Kalman.PropagateStateInverse(ctx.field, ctx.Ploc,
+                                             ctx.model, ctx.Qloc);
+        }
 
+        // Innovation (new observations minus prior estimation) at sensors,
+        // see the in-situ analytics.
+        ctx.innov_sq = 0.0;
+        for (index_t k = 0; k < static_cast<index_t>(sensors.size()); ++k) {
+            const double d = ctx.z(k) - ctx.field(sensors[k].x + halo,
+                                                  sensors[k].y + halo);
+            ctx.innov_sq += d * d;
+        }
+    }
 
     // Filtering by Kalman filter.
-    ctx.Kalman.SolveFilter(ctx.field, ctx.P, ctx.H, ctx.R, ctx.z);
+    if (ctx.sqrt_covar) {
+        ctx.Kalman.SolveFilterSqrt(ctx.field, ctx.P, ctx.H, ctx.R, ctx.z);
+    } else if (!ctx.P_mixed.Empty()) {
+        ctx.Kalman_mixed.SolveFilter(ctx.field, ctx.P_mixed,
+                                     ctx.H, ctx.R, ctx.z);
+    } else if (ctx.Ploc.Empty()) {
+        ctx.Kalman.SolveFilter(ctx.field, ctx.P, ctx.H, ctx.R, ctx.z);
+    } else {
+        ctx.Kalman.SolveFilter(ctx.field, ctx.Ploc, ctx.H, ctx.R, ctx.z);
+    }
 
     // Put new estimation back to the Allscale state field.
     AllscaleFromMatrix(next_state, ctx.field);
@@ -607,42 +1469,34 @@ void SubdomainRoutineKalman(const Configuration & conf,
     // Ensure non-negative (physically plausible) density.
     next_state.forAllActiveNodes([](double & v){ if (v < 0.0) v = 0.0; });
 
-#if MY_MULTISCALE_METHOD == 2
-    // Make up the coarse layer (so the peer subdomains can use either
-    // fine or low resolution one), then go back to the default resolution.
-    next_state.coarsen([](const double & elem) { return elem; });
-    next_state.setActiveLayer(resolution);
-#endif
+    // Make up the layers the peer subdomains operate at.
+    MakeUpLayers(conf, next_state, layers.first, layers.second);
 }
 
 /**
  * Function is invoked for each sub-domain without sensors therein
  * during the time integration.
  */
-void SubdomainRoutineNoSensors(const Configuration & conf,
-                               const size_t          timestamp,
-                               const domain_t      & curr_state,
-                               subdomain_t         & next_state,
-                               SubdomainContext    & ctx,
-                               const point2d_t     & idx,
-                               const size_t          Nsubiter,
-                               const size_t          Nt)
+void SubdomainRoutineNoSensors(const Configuration   & conf,
+                               const time_schedule_t & schedule,
+                               const size_t            timestamp,
+                               const domain_t        & curr_state,
+                               subdomain_t           & next_state,
+                               SubdomainContext      & ctx,
+                               const point2d_t       & idx,
+                               const CoarseCorrection & correction)
 {
-    const unsigned resolution = static_cast<unsigned>(LayerLow);
-
     // Important: synchronize active layers, otherwise when we exchange data
     // at the borders of neighbour subdomains the size mismatch can happen.
-    assert_true(curr_state[idx].getActiveLayer() == resolution);
-    next_state.setActiveLayer(resolution);
-    const size2d_t layer_size =
-        const_cast<subdomain_t&>(curr_state[idx]).getActiveLayerSize();
+    assert_true(curr_state[idx].getActiveLayer() == ctx.layer);
 
     // Get the discrete time (index of iteration) in the range [0..Nt) and
-    // the index of sub-iteration in the range [0..Nsubiter).
-    assert_true(timestamp < Nt * Nsubiter);
-	(void)Nt; // silence unused parameter warning
-    const size_t t_discrete = timestamp / Nsubiter;
-    const size_t sub_iter   = timestamp % Nsubiter;  (void) sub_iter;
+    // the index of sub-iteration in the range [0..Nsubiter) of that step.
+    const size_t     Nt = schedule.size();
+    const size_t     t_discrete = FindTimeStep(schedule, timestamp);
+    const TimeStep & step = schedule[t_discrete];
+    const size_t     sub_iter = timestamp - step.first;
+	(void)Nt; // silence unused variable warning
 
 #ifdef AMDADOS_DEBUGGING    // printing progress
     if ((idx == point2d_t(0,0)) && (sub_iter == 0)) {
@@ -652,18 +1506,79 @@ void SubdomainRoutineNoSensors(const Configuration & conf,
     }
 #endif
 
+    // The remaining sub-iterations after the halo has settled leave the
+    // subdomain as is but the last one, see below, though a peer can switch
+    // the resolution.
+    if (HoldsState(ctx, schedule, timestamp)) {
+        next_state = curr_state[idx];
+        ctx.held += 1;
+        const std::pair<unsigned,unsigned> layers = LayersInUse(conf,
+                                schedule, timestamp, curr_state, idx, ctx.layer);
+        MakeUpLayers(conf, next_state, layers.first, layers.second);
+        return;
+    }
+
     // Compute flow velocity vector.
-    ctx.flow = Flow(conf, t_discrete);
+    ctx.flow = Flow(conf, step.time);
 
     // Copy state field into the matrix object.
-    MatrixFromAllscale(ctx.field, curr_state, idx);
-
-    // Prior estimation.
-    InverseModelMatrix(ctx.B, conf, ctx.flow, layer_size,
-                       resolution, static_cast<int>(Nsubiter));
-    ctx.tmp_field = ctx.field;              // copy state into a temporary one
-    ctx.LU.Init(ctx.B);                     // decompose: B = L*U
-    ctx.LU.Solve(ctx.field, ctx.tmp_field); // new_field = B^{-1}*old_field
+    const size2d_t active_size = curr_state[idx].getLayerSize(ctx.layer);
+    index_t halo = HaloWidth(conf, active_size);
+    const bool exchange = HaloExchangeDue(conf, sub_iter);
+    if (exchange) KeepHalo(ctx.boundaries, ctx.field, halo, active_size);
+    MatrixFromAllscale(ctx.field, curr_state, idx, ctx.layer, halo, exchange);
+
+    // Every 'adapt_period' steps, at the beginning of a regular iteration,
+    // choose the resolution according to the error indicator. On switching,
+    // place the matrices anew at the size of the new layer and pick up the
+    // field at the new resolution, which is available because all the layers
+    // are kept around the switch (see LayersInUse()). The other matrices are
+    // recomputed at every sub-iteration.
+    if (LayerSwitchDue(conf, schedule, timestamp)) {
+        const unsigned layer = ChooseLayer(conf, ctx.field, halo, ctx.layer);
+        if (layer != ctx.layer) {
+            ctx.layer = layer;
+            const size2d_t sz = curr_state[idx].getLayerSize(layer);
+            halo = HaloWidth(conf, sz);
+            PlaceInArena(ctx, conf, size2d_t(sz.x + 2*halo, sz.y + 2*halo), 0);
+            MatrixFromAllscale(ctx.field, curr_state, idx, ctx.layer,
+                               halo, true);
+            ctx.boundaries.remote.clear();
+        }
+    }
+    next_state.setActiveLayer(ctx.layer);
+    const size2d_t layer_size = next_state.getActiveLayerSize();
+    CorrectExtendedField(ctx.field, correction, timestamp, idx,
+                         curr_state.size(), layer_size);
+
+    // Prior estimation: every sub-iteration makes a fraction of time step.
+    // Once the halo has settled, the subdomain holds its state, so the peers
+    // keep reading the values of the same fraction, and the last sub-iteration
+    // makes all the fractions held at once (implicit scheme is stable anyway).
+    // Without dense model matrix (memory-lean mode) its stencil is used.
+    double num_fractions = 1.0;
+    if (ctx.settled == t_discrete) {
+        num_fractions += static_cast<double>(ctx.held);
+        ctx.held = 0;
+    } else if (exchange && HaloSettled(conf, ctx, step, sub_iter, halo,
+                                       idx, curr_state.size())) {
+        ctx.settled = t_discrete;
+        ctx.held = 0;
+    }
+    const double dt = step.dt * num_fractions /
+                      static_cast<double>(step.Nsubiter);
+    ctx.model = InverseModelStencil(conf, ctx.flow, layer_size, dt);
+    if (ctx.B.Empty()) {
+        // All the points but the outermost layer of extended subdomain.
+        ctx.stencil.Init(ctx.model,
+                         ctx.field.NRows() - 2, ctx.field.NCols() - 2);
+        ctx.stencil.Solve(ctx.field, ctx.field);    // field = B^{-1}*field
+    } else {
+        InverseModelMatrix(ctx.B, conf, ctx.flow, layer_size, halo, dt);
+        ctx.tmp_field = ctx.field;              // copy state into a temporary
+        ctx.LU.Init(ctx.B);                     // decompose: B = L*U
+        ctx.LU.Solve(ctx.field, ctx.tmp_field); // new_field = B^{-1}*old_field
+    }
 
     // Put the estimation back to the Allscale state field.
     AllscaleFromMatrix(next_state, ctx.field);
@@ -674,12 +1589,74 @@ void SubdomainRoutineNoSensors(const Configuration & conf,
     // Ensure non-negative (physically plausible) density.
     next_state.forAllActiveNodes([](double & v){ if (v < 0.0) v = 0.0; });
 
-#if MY_MULTISCALE_METHOD == 2
-    // Make up the fine layer (so the peer subdomains can use either
-    // fine or low resolution one), then go back to the default resolution.
-    next_state.refine([](const double & elem) { return elem; });
-    next_state.setActiveLayer(resolution);
-#endif
+    // Make up the layers the peer subdomains operate at.
+    const std::pair<unsigned,unsigned> layers = LayersInUse(conf, schedule,
+                                    timestamp, curr_state, idx, ctx.layer);
+    MakeUpLayers(conf, next_state, layers.first, layers.second);
+}
+
+/**
+ * Function writes the field at the finest resolution into the binary file
+ * of (time, abscissa, ordinate, value) float records, as the MPI version does.
+ * Every subdomain occupies its own range of the file, known in advance, so
+ * the subdomains are written in parallel without locking and the file content
+ * does not depend on scheduling. Subdomains follow in row-major order.
+ */
+void WriteBinaryField(const Configuration & conf, const domain_t & state_field,
+                      size_t timestamp)
+{
+    using ::allscale::api::user::BinaryFileWriter;
+
+    subdomain_t temp;
+    temp.setActiveLayer(LayerFine);
+    const size2d_t fine_size = temp.getActiveLayerSize();
+    const size2d_t grid_size = state_field.size();
+    const size_t record_len = 4 * static_cast<size_t>(fine_size.x * fine_size.y);
+    const size_t num_records = static_cast<size_t>(grid_size.x * grid_size.y);
+
+    const std::string filename = MakeFileName(conf, "field");
+    std::unique_ptr<BinaryFileWriter> writer;
+    {
+        std::lock_guard<std::mutex> io_lock(FileIOLock());
+        writer.reset(new BinaryFileWriter(filename, num_records,
+                                          record_len * sizeof(float)));
+    }
+    pfor(point2d_t(0,0), grid_size, [&](const point2d_t & idx) {
+        subdomain_t cell = state_field[idx];
+        while (cell.getActiveLayer() != LayerFine) {
+            cell.refine([](const double & elem) { return elem; });
+        }
+        float_array_t buffer(record_len);
+        size_t k = 0;
+        cell.forAllActiveNodes([&](const point2d_t & loc, double val) {
+            point2d_t glo = Sub2Glo(loc, idx, fine_size);
+            buffer[k + 0] = static_cast<float>(timestamp);
+            buffer[k + 1] = static_cast<float>(glo.x);
+            buffer[k + 2] = static_cast<float>(glo.y);
+            buffer[k + 3] = static_cast<float>(val);
+            k += 4;
+        });
+        assert_true(k == record_len);
+        writer->write(static_cast<size_t>(idx.x * grid_size.y + idx.y),
+                      buffer.data(), buffer.size());
+    });
+    std::lock_guard<std::mutex> io_lock(FileIOLock());
+    writer->close();
+}
+
+/**
+ * Function runs time integration by the stencil implementation specified
+ * as the template parameter. The subdomain kernel only reads its own context
+ * and the boundaries of 4 direct peers (Up, Down, Left, Right) at the previous
+ * time step, so it can safely run under any of the iterative implementations
+ * including the point-to-point one that has no global barrier between steps.
+ */
+template<typename StencilImpl, typename Kernel, typename ... Monitors>
+void RunStencil(domain_t & state_field, size_t nsteps,
+                const Kernel & kernel, const Monitors & ... monitors)
+{
+    ::allscale::api::user::algorithm::stencil<StencilImpl>(
+                                    state_field, nsteps, kernel, monitors...);
 }
 
 } // anonymous namespace
@@ -691,20 +1668,37 @@ void SubdomainRoutineNoSensors(const Configuration & conf,
  * global solution seam-less along subdomain boundaries. On top of that, the
  * Kalman filters (separate filter in each subdomain) drive the solution
  * towards the observations at sensor locations (data assimilation).
+ * If 'final_field' is not null, it receives the final field at the finest
+ * resolution in the order of the output file. If 'profile' is not null,
+ * it receives the timing of the phases and the time steps.
  */
 void RunDataAssimilation(const Configuration         & conf,
                          const Grid<point_array_t,2> & sensors,
-                         const Grid<Matrix,2>        & observations)
+                         const Grid<Matrix,2>        & observations,
+                         double_array_t              * final_field,
+                         RunProfile                  * profile)
 {
     using ::allscale::api::core::FileIOManager;
     using ::allscale::api::core::Entry;
     using ::allscale::api::core::Mode;
+    using hr_clock = std::chrono::high_resolution_clock;
+
+    // Function returns the number of seconds elapsed since a time point.
+    auto Seconds = [](const hr_clock::time_point & since) {
+        return std::chrono::duration<double>(hr_clock::now() - since).count();
+    };
+    const hr_clock::time_point start_time = hr_clock::now();
 
     const point2d_t GridSize = GetGridSize(conf);   // size in subdomains
     const size_t    Nt = conf.asUInt("Nt");
-    const size_t    Nsubiter = conf.asUInt("num_sub_iter");
 	//const size_t    Nwrite = std::min(Nt, conf.asUInt("write_num_fields"));
 
+    // Time steps and their sub-iterations (fixed or adaptive ones).
+    const time_schedule_t schedule = MakeTimeSchedule(conf);
+    const size_t Nsubiter_total = NumSubIterations(schedule);
+    MY_LOG(INFO) << "Number of time steps: " << schedule.size()
+                 << ", sub-iterations: " << Nsubiter_total;
+
     context_domain_t contexts(GridSize);    // variables of each sub-domain
     domain_t         state_field(GridSize); // grid of sub-domains
 
@@ -715,105 +1709,285 @@ void RunDataAssimilation(const Configuration         & conf,
     }
 
     // Initialize the observation and model covariance matrices.
+    const std::string covar_storage = conf.IsExist("covariance_storage") ?
+                                conf.asString("covariance_storage") : "dense";
+    const bool local_covar = (covar_storage == "local");
+    const bool sqrt_covar = (covar_storage == "sqrt");
+    const bool mixed_precision = conf.IsExist("precision") &&
+                                 (conf.asString("precision") == "mixed");
+    const bool memory_lean = conf.IsExist("memory_mode") &&
+                             (conf.asString("memory_mode") == "lean");
     pfor(point2d_t(0,0), GridSize, [&,conf](const point2d_t & idx) {
         // Zero field at the beginning for all the resolutions.
-        static_assert(LayerFine <= LayerLow, "");
-        for (int layer = LayerFine; layer <= LayerLow; ++layer) {
+        static_assert(LayerFine <= LayerLow && LayerLow <= LayerCoarse, "");
+        for (int layer = LayerFine; layer <= LayerCoarse; ++layer) {
             state_field[idx].setActiveLayer(layer);
             state_field[idx].forAllActiveNodes([](double & v) { v = 0.0; });
             ApplyBoundaryCondition(state_field[idx], idx, state_field.size());
         }
 
         // If there is at least one sensor in a subdomain, then we operate at
-        // the fine resolution, otherwise at the low resolution.
+        // the fine resolution, otherwise start at the low resolution, which
+        // can be adapted later on (see 'adapt_period' parameter).
         const index_t Nsensors = static_cast<index_t>(sensors[idx].size());
-        if (Nsensors > 0) {
-            state_field[idx].setActiveLayer(LayerFine);
-        } else {
-            state_field[idx].setActiveLayer(LayerLow);
-        }
+        SubdomainContext & ctx = contexts[idx];
+        ctx.layer = static_cast<unsigned>((Nsensors > 0) ? LayerFine
+                                                          : LayerLow);
+        state_field[idx].setActiveLayer(ctx.layer);
 
         const size2d_t layer_size = state_field[idx].getActiveLayerSize();
-        const index_t Sx = layer_size.x;
-        const index_t Sy = layer_size.y;
-        const index_t sub_prob_size = (Sx + 2) * (Sy + 2);
+        const index_t halo = HaloWidth(conf, layer_size);
+        const index_t Ex = layer_size.x + 2 * halo;
+        const index_t Ey = layer_size.y + 2 * halo;
+        const index_t sub_prob_size = Ex * Ey;
+
+        // All the matrices of the subdomain reside in a single memory block.
+        PlaceInArena(ctx, conf, size2d_t(Ex, Ey), Nsensors);
 
         // Note, we initialize the Kalman filter matrices only in the
-        // presence of sensor(s), otherwise they are useless. Also,
-        // mind the extended subdomain: one extra point layer on either side.
-        SubdomainContext & ctx = contexts[idx];
-        ctx.field.Resize(Sx + 2, Sy + 2);
-        ctx.B.Resize(sub_prob_size, sub_prob_size);
+        // presence of sensor(s), otherwise they are useless. In memory-lean
+        // mode, the sensorless subdomains do not need dense B either, nor
+        // the ones of localised covariance. Also, mind the extended
+        // subdomain: 'halo' extra point layers on either side.
+        ctx.field.Resize(Ex, Ey);
+        if ((Nsensors > 0) ? !local_covar : !memory_lean) {
+            ctx.B.Resize(sub_prob_size, sub_prob_size);
+        }
         if (Nsensors > 0) {
-            ctx.P.Resize(sub_prob_size, sub_prob_size);
-            ctx.Q.Resize(sub_prob_size, sub_prob_size);
+            if (local_covar) {
+                InitialCovar(conf, ctx.Ploc);
+                ctx.Qloc.Init(Ex, Ey, 0);
+            } else {
+                ctx.P.Resize(sub_prob_size, sub_prob_size);
+                if (sqrt_covar) {
+                    ctx.Qdiag.Resize(sub_prob_size);
+                } else {
+                    ctx.Q.Resize(sub_prob_size, sub_prob_size);
+                }
+                InitialCovar(conf, ctx.P);
+                if (sqrt_covar) {
+                    Cholesky chol;
+                    chol.Init(ctx.P);
+                    ctx.P = chol.LowerTriangular();
+                    ctx.sqrt_covar = true;
+                } else if (mixed_precision) {
+                    Convert(ctx.P_mixed, ctx.P);
+                    Matrix().swap(ctx.P);       // release the memory
+                }
+            }
             ctx.H.Resize(Nsensors, sub_prob_size);
             ctx.R.Resize(Nsensors, Nsensors);
             ctx.z.Resize(Nsensors);
             ctx.sensors = sensors[idx];
-            ComputeH(sensors[idx], layer_size, ctx.H);
-            InitialCovar(conf, ctx.P);
+            ComputeH(sensors[idx], layer_size, halo, ctx.H);
         }
     });
 
-
-
-    // Time integration forward in time. We want to make Nt (normal) iterations
-    // and Nsubiter sub-iterations within each (normal) iteration.
-    ::allscale::api::user::algorithm::stencil<allscale::api::user::algorithm::implementation::coarse_grained_iterative>(
-        state_field, Nt * Nsubiter,
-        [&,conf,Nsubiter,Nt](time_t t, const point2d_t & idx, const domain_t & state)
+    // Resume from the checkpoint, if specified: 'first' sub-iterations
+    // have been done by the checkpointed run, which leaves the coarse-grid
+    // corrections pending for sub-iteration 'first'.
+    size_t first = 0;
+    Matrix pending;
+    if (conf.IsExist("restart_file") &&
+            !conf.asString("restart_file").empty()) {
+        const std::string & restart_file = conf.asString("restart_file");
+        first = Checkpointer::Load(restart_file, state_field, contexts,
+                                   pending);
+        assert_true(first < Nsubiter_total) << "nothing to resume";
+        // A sensorless subdomain could have switched the layer in the
+        // checkpointed run, so its matrices are placed anew at the size of
+        // the restored layer, as on switching, and the field is put back.
+        pfor(point2d_t(0,0), GridSize, [&,conf](const point2d_t & idx) {
+            SubdomainContext & ctx = contexts[idx];
+            if (!ctx.sensors.empty()) return;
+            const size2d_t sz = state_field[idx].getLayerSize(ctx.layer);
+            const index_t halo = HaloWidth(conf, sz);
+            const Matrix field(ctx.field);
+            PlaceInArena(ctx, conf, size2d_t(sz.x + 2*halo, sz.y + 2*halo), 0);
+            ctx.field = field;
+        });
+        std::cout << "Resuming from " << restart_file << " at sub-iteration "
+                  << first << " of " << Nsubiter_total << std::endl;
+    }
+    ReportMemoryBudget(contexts, observations, GridSize);
+    Checkpointer checkpointer(conf, schedule, GridSize);
+
+    // Profiling: the time spent in the kernels (all threads) and the moments
+    // of completion of time steps, i.e. when the last subdomain is done.
+    std::atomic<int64_t> kalman_ns(0), propagation_ns(0);
+    std::atomic<size_t> num_skipped(0);     // by sub-iteration control
+    std::vector<std::atomic<size_t>> step_count(schedule.size());
+    std::vector<double> step_end(schedule.size(), 0.0);
+    if (profile != nullptr) {
+        profile->init = Seconds(start_time);
+    }
+    const hr_clock::time_point integration_start = hr_clock::now();
+
+    // The coarse-grid correction, if requested, is gathered by an observer
+    // once a sub-iteration is over, and added by the subdomains at the next
+    // one, see CorrectExtendedField().
+    const bool coarse_correction = conf.IsExist("coarse_correction") &&
+                                   (conf.asUInt("coarse_correction") > 0);
+    CoarseCorrection correction(schedule, GridSize);
+    if (first > 0) correction.Resume(first, pending);
+
+    // Time integration forward in time. We want to make all the scheduled
+    // (normal) iterations and the sub-iterations within each of them.
+    // The stencil starts off at sub-iteration 'first'.
+    auto kernel = [&,conf](time_t t, const point2d_t & idx,
+                           const domain_t & state)
         -> const subdomain_t
         {
+            // Note, the routines below modify the context of this subdomain
+            // only and read the 4 direct peers of the current state.
+            const size_t timestamp = first + size_t(t);
+            const bool with_sensors = (contexts[idx].sensors.size() > 0);
+            if (HoldsState(contexts[idx], schedule, timestamp)) {
+                ++num_skipped;
+            }
+            hr_clock::time_point kernel_start;
+            if (profile != nullptr) kernel_start = hr_clock::now();
             subdomain_t temp_field;
-            if (contexts[idx].sensors.size() > 0) {
+            if (with_sensors) {
                 SubdomainRoutineKalman(conf, sensors[idx],
-                            observations[idx], size_t(t),
-                            state, temp_field, contexts[idx], idx, Nsubiter, Nt);
+                            observations[idx], schedule, timestamp,
+                            state, temp_field, contexts[idx], idx,
+                            correction);
             } else {
-               SubdomainRoutineNoSensors(conf, size_t(t),
-                           state, temp_field, contexts[idx], idx, Nsubiter, Nt);
+               SubdomainRoutineNoSensors(conf, schedule, timestamp,
+                           state, temp_field, contexts[idx], idx, correction);
+            }
+            if (profile != nullptr) {
+                const int64_t ns = std::chrono::duration_cast<
+                        std::chrono::nanoseconds>(hr_clock::now() -
+                                                  kernel_start).count();
+                (with_sensors ? kalman_ns : propagation_ns) += ns;
             }
             return temp_field;
+        };
+
+    // In-situ analytics: the same as for the checkpoints below, the context
+    // of subdomain is consistent with the state field in the observer.
+    InSituAnalytics analytics(conf, schedule, GridSize, first);
+    auto monitor = ::allscale::api::user::algorithm::observer(
+        [&](time_t t) { return analytics.IsDue(first + size_t(t) + 1); },
+        [](const point2d_t &) { return true; },
+        [&](time_t t, const point2d_t & idx, const subdomain_t & cell) {
+            analytics.Record(first + size_t(t) + 1, idx, cell, contexts[idx]);
+        }
+    );
+
+    // Checkpointing: every stencil implementation calls the observer for
+    // a subdomain after its update and before its next one, so the context
+    // of subdomain is consistent with the state field at that moment.
+    auto checkpoint = ::allscale::api::user::algorithm::observer(
+        [&](time_t t) { return checkpointer.IsDue(first + size_t(t) + 1); },
+        [](const point2d_t &) { return true; },
+        [&](time_t t, const point2d_t & idx, const subdomain_t & cell) {
+            const size_t ts = first + size_t(t) + 1;
+            checkpointer.Save(ts, idx, cell, contexts[idx],
+                              correction.Correction(ts, idx));
+        }
+    );
+
+    // Timing of time steps, if requested.
+    const size_t Nsubdomains = static_cast<size_t>(GridSize.x * GridSize.y);
+    auto timing = ::allscale::api::user::algorithm::observer(
+        [&](time_t t) {
+            const size_t ts = first + size_t(t) + 1;
+            return (profile != nullptr) && ((ts == Nsubiter_total) ||
+                    (schedule[FindTimeStep(schedule, ts)].first == ts));
         },
-        // Monitoring.
-        ::allscale::api::user::algorithm::observer(
-            // Time filter: choose time-slices evenly distributed on time axis.
-            [=](time_t /*t*/) {
-                // Filter out the first sub-iteration, skip the others.
-                //if ((t % time_t(Nsubiter)) != 0) return false;
-                //t /= time_t(Nsubiter);
-                //return ((((Nwrite-1)*(t-1))/(Nt-1) != ((Nwrite-1)*t)/(Nt-1)));
-				return false;
-            },
-            // Space filter: no specific points.
-            [](const point2d_t &) { return true; },
-            // Append a full field to the file of simulation results.
-            [&,Nsubiter](time_t /*t*/, const point2d_t & /*idx*/, const subdomain_t & /*cell*/) {
-//                t /= time_t(Nsubiter);
-//                // Important: we save field at the finest resolution.
-//                subdomain_t temp;
-//                temp = cell;
-//                while (temp.getActiveLayer() != LayerFine) {
-//                    temp.refine([](const double & elem) { return elem; });
-//                }
-//                const size2d_t finest_layer_size = temp.getActiveLayerSize();
-//                // Write the subdomain into file.
-//                temp.forAllActiveNodes([&](const point2d_t & loc, double val) {
-//                    point2d_t glo = Sub2Glo(loc, idx, finest_layer_size);
-//                    out_stream.atomic([=](auto & file) {
-//                        file << t << " " << glo.x << " " << glo.y << " " << val << "\n";
-//                    });
-//                });
+        [](const point2d_t &) { return true; },
+        [&](time_t t, const point2d_t &, const subdomain_t &) {
+            const size_t k = FindTimeStep(schedule, first + size_t(t));
+            if (++step_count[k] == Nsubdomains) {
+                step_end[k] = Seconds(integration_start);
             }
-        )
+        }
+    );
+
+    // Choose the stencil implementation: "coarse" - barrier after each
+    // time step, "fine" - dependencies on the full (3x3) neighbourhood,
+    // "neighbour" - point-to-point dependencies on the 4 direct neighbours.
+    const std::string stencil_mode = conf.IsExist("stencil_mode") ?
+                                conf.asString("stencil_mode") : "coarse";
+    auto Integrate = [&](size_t nsteps, const auto & ... monitors) {
+        using namespace ::allscale::api::user::algorithm::implementation;
+        if (stencil_mode == "coarse") {
+            RunStencil<coarse_grained_iterative>(state_field, nsteps,
+                                                 kernel, monitors...);
+        } else if (stencil_mode == "fine") {
+            RunStencil<fine_grained_iterative>(state_field, nsteps,
+                                               kernel, monitors...);
+        } else if (stencil_mode == "neighbour") {
+            RunStencil<neighborhood_sync_iterative>(state_field, nsteps,
+                                                    kernel, monitors...);
+        } else {
+            assert_true(false) << "unknown stencil_mode: " << stencil_mode;
+        }
+    };
+
+    // The coarse problem needs the residuals of all the subdomains before any
+    // of them proceeds, which the coarse stencil ensures (see
+    // InitDependentParams()). There is no sub-iteration to take up the
+    // correction after the last one. The coarse stencil also runs every
+    // observer over all the subdomains in turn, so the correction has been
+    // solved by the time a checkpoint saves it for the restart.
+    auto gather = ::allscale::api::user::algorithm::observer(
+        [&](time_t t) {
+            const size_t ts = first + size_t(t) + 1;
+            return coarse_correction && (ts < Nsubiter_total);
+        },
+        [](const point2d_t &) { return true; },
+        [&](time_t t, const point2d_t & idx, const subdomain_t & cell) {
+            correction.Gather(first + size_t(t), idx, cell, contexts);
+        }
     );
 
+    Integrate(Nsubiter_total - first, gather,
+              monitor, checkpoint, timing);
+    checkpointer.Finish();
+    analytics.Finish();
+    if (conf.IsExist("sub_iter_tol") && (conf.asDouble("sub_iter_tol") > 0)) {
+        std::cout << "Sub-iterations skipped as the halos have "
+                  << "settled: " << num_skipped.load() << " of "
+                  << (Nsubiter_total - first) * Nsubdomains << std::endl;
+    }
+    if (profile != nullptr) {
+        profile->integration = Seconds(integration_start);
+        profile->kalman = 1e-9 * static_cast<double>(kalman_ns.load());
+        profile->propagation = 1e-9 * static_cast<double>(propagation_ns.load());
+        profile->steps.clear();
+        const size_t first_step = (first > 0) ? FindTimeStep(schedule, first)
+                                              : 0;
+        for (size_t k = first_step; k < schedule.size(); ++k) {
+            profile->steps.push_back(step_end[k] -
+                                     ((k > first_step) ? step_end[k-1] : 0.0));
+        }
+    }
+    const hr_clock::time_point output_start = hr_clock::now();
+
+    // Report the final distribution of subdomains over resolutions.
+    if (conf.IsExist("adapt_period") && (conf.asUInt("adapt_period") > 0)) {
+        size_t count[LayerCoarse + 1] = {0};
+        for (index_t i = 0; i < GridSize.x; ++i) {
+        for (index_t j = 0; j < GridSize.y; ++j) {
+            ++count[contexts[point2d_t(i,j)].layer];
+        }}
+        MY_LOG(INFO) << "Subdomains per layer (fine, low, coarse): "
+                     << count[LayerFine] << ", " << count[LayerLow] << ", "
+                     << count[LayerCoarse];
+    }
+
 
     // Print the final field in textual format.
 	std::string filename = MakeFileName(conf, "final_field");
 	::allscale::api::user::algorithm::async([=,&state_field]() {
+		if (final_field != nullptr) final_field->clear();
+
 		// Open file manager and the output file for writing.
+		std::lock_guard<std::mutex> io_lock(FileIOLock());
 		FileIOManager & file_manager = FileIOManager::getInstance();
 		Entry stream_entry = file_manager.createEntry(filename, Mode::Text);
 		auto out_stream = file_manager.openOutputStream(stream_entry);
@@ -833,13 +2007,20 @@ void RunDataAssimilation(const Configuration         & conf,
 					point2d_t glo = Sub2Glo(loc, idx, finest_layer_size);
 					out_stream << t << " " << glo.x << " "
                                             << glo.y << " " << val << "\n";
+					if (final_field != nullptr) final_field->push_back(val);
 				});
 			}
 		}
     		file_manager.close(out_stream);
 		// need to output result file name for the CI system to pick it up
 	}).wait();
-
+    if (conf.IsExist("final_field_binary") &&
+            (conf.asInt("final_field_binary") != 0)) {
+        WriteBinaryField(conf, state_field, static_cast<size_t>(Nt - 1));
+    }
+    if (profile != nullptr) {
+        profile->output = Seconds(output_start);
+    }
 }
 
 /**
@@ -890,6 +2071,94 @@ void InitDependentParams(Configuration & conf)
     const double D = conf.asDouble("diffusion_coef");
     assert_true(D > 0.0);
 
+    // Dynamic resolution switching: the coarsening tolerance must be below
+    // the refinement one, otherwise a subdomain would oscillate between layers.
+    if (conf.IsExist("adapt_period") && (conf.asUInt("adapt_period") > 0)) {
+        assert_true(conf.asDouble("adapt_coarsen_tol") <
+                    conf.asDouble("adapt_refine_tol"))
+                        << "adapt_coarsen_tol must be below adapt_refine_tol";
+    }
+
+    if (conf.IsExist("covariance_storage")) {
+        const std::string & storage = conf.asString("covariance_storage");
+        assert_true((storage == "dense") || (storage == "local") ||
+                    (storage == "sqrt"))
+            << "covariance_storage must be 'dense', 'local' or 'sqrt'";
+    }
+    if (conf.IsExist("memory_mode")) {
+        const std::string & mode = conf.asString("memory_mode");
+        assert_true((mode == "normal") || (mode == "lean"))
+            << "memory_mode must be either 'normal' or 'lean'";
+    }
+    if (conf.IsExist("checkpoint_period")) {
+        assert_true(conf.IsInteger("checkpoint_period") &&
+                    (conf.asInt("checkpoint_period") >= 0))
+            << "checkpoint_period must be a non-negative integer";
+    }
+    if (conf.IsExist("final_field_binary")) {
+        assert_true(conf.IsInteger("final_field_binary") &&
+                    (conf.asInt("final_field_binary") >= 0) &&
+                    (conf.asInt("final_field_binary") <= 1))
+            << "final_field_binary must be either 0 or 1";
+    }
+    if (conf.IsExist("analytics_period")) {
+        assert_true(conf.IsInteger("analytics_period") &&
+                    (conf.asInt("analytics_period") >= 0))
+            << "analytics_period must be a non-negative integer";
+    }
+    if (conf.IsExist("sub_iter_tol")) {
+        assert_true(conf.asDouble("sub_iter_tol") >= 0.0)
+            << "sub_iter_tol must be non-negative";
+    }
+    if (conf.IsExist("min_sub_iter")) {
+        assert_true(conf.IsInteger("min_sub_iter") &&
+                    (conf.asInt("min_sub_iter") >= 1))
+            << "min_sub_iter must be a positive integer";
+    }
+    if (conf.IsExist("precision")) {
+        const std::string & precision = conf.asString("precision");
+        assert_true((precision == "double") || (precision == "mixed"))
+            << "precision must be either 'double' or 'mixed'";
+        assert_true((precision == "double") ||
+                    !conf.IsExist("covariance_storage") ||
+                    (conf.asString("covariance_storage") == "dense"))
+            << "mixed precision requires dense covariance_storage";
+    }
+
+    if (conf.IsExist("halo_width")) {
+        assert_true(conf.IsInteger("halo_width") &&
+                    (conf.asInt("halo_width") >= 1) &&
+                    (conf.asInt("halo_width") < std::min(Sx, Sy)))
+            << "halo_width must be a positive integer less than "
+               "the subdomain size";
+    }
+    if (conf.IsExist("halo_exchange_period")) {
+        assert_true(conf.IsInteger("halo_exchange_period") &&
+                    (conf.asInt("halo_exchange_period") >= 1))
+            << "halo_exchange_period must be a positive integer";
+    }
+    if (conf.IsExist("input_format")) {
+        assert_true((conf.asString("input_format") == "text") ||
+                    (conf.asString("input_format") == "binary"))
+            << "input_format must be either 'text' or 'binary'";
+    }
+    if (conf.IsExist("coarse_correction")) {
+        assert_true(conf.IsInteger("coarse_correction") &&
+                    (conf.asInt("coarse_correction") >= 0) &&
+                    (conf.asInt("coarse_correction") <= 1))
+            << "coarse_correction must be either 0 or 1";
+        // The coarse problem couples all the subdomains, so it can only be
+        // solved between the sweeps of the stencil with a barrier.
+        assert_true((conf.asInt("coarse_correction") == 0) ||
+                    !conf.IsExist("stencil_mode") ||
+                    (conf.asString("stencil_mode") == "coarse"))
+            << "coarse_correction requires stencil_mode coarse";
+#if MY_MULTISCALE_METHOD == 1
+        assert_true(conf.asInt("coarse_correction") == 0)
+            << "coarse_correction requires multiscale method 2";
+#endif
+    }
+
     conf.SetInt("global_problem_size", static_cast<int>(nx * ny));
     const double dx = conf.asDouble("domain_size_x") / (nx - 1);
     const double dy = conf.asDouble("domain_size_y") / (ny - 1);
@@ -897,35 +2166,25 @@ void InitDependentParams(Configuration & conf)
     conf.SetDouble("dx", dx);
     conf.SetDouble("dy", dy);
 
-    // Deduce the optimal time step from the stability criteria.
-    const double dt_base = conf.asDouble("integration_period") /
-                           conf.asDouble("integration_nsteps");
-    const double max_vx = conf.asDouble("flow_model_max_vx");
-    const double max_vy = conf.asDouble("flow_model_max_vy");
-    // This time step is defined according to stability criteria.
-//    const double dt = std::min(dt_base,
-//                        std::min( std::min(dx*dx, dy*dy)/(2.0*D + TINY),
-//                                  1.0/(std::fabs(max_vx)/dx +
-//                                       std::fabs(max_vy)/dy + TINY) ));
-std::cout << "A T T E N T I O N: hard-coded dt" << std::endl;
-const double dt = dt_base;      // XXX
-    assert_true(dt > TINY);
-    conf.SetDouble("dt", dt);
-    conf.SetInt("Nt", static_cast<int>(
-                        std::ceil(conf.asDouble("integration_period") / dt)));
+    // Deduce the time step from the stability criteria.
+    InitTimeStepping(conf);
 }
 
 /**
  * The main function of this application runs simulation with data
  * assimilation using method to handle domain subdivision.
  */
-void ScenarioSimulation(const std::string & config_file)
+void ScenarioSimulation(const std::string & config_file,
+                        const std::string & restart_file)
 {
 
     // Read application parameters from configuration file,
     // prepare the output directory.
     Configuration conf;
     conf.ReadConfigFile(config_file);
+    if (!restart_file.empty()) {
+        conf.SetString("restart_file", restart_file.c_str());
+    }
     InitDependentParams(conf);
     conf.PrintParameters();
 
@@ -952,7 +2211,7 @@ void ScenarioSimulation(const std::string & config_file)
     auto start = std::chrono::high_resolution_clock::now();
 
     MY_TIME_IT("Running the simulation with data assimilation ...")
-    RunDataAssimilation(conf, sensors, observations);
+    RunDataAssimilation(conf, sensors, observations, nullptr, nullptr);
 
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = end - start;
@@ -0,0 +1,195 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+//             Fearghal O'Donncha, feardonn@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "allscale/api/user/data/adaptive_grid.h"
+#include "allscale/api/user/algorithm/pfor.h"
+#include "allscale/utils/assert.h"
+
+#include "amdados/app/amdados_utils.h"
+#include "amdados/app/configuration.h"
+#include "amdados/app/geometry.h"
+#include "amdados/app/matrix.h"
+#include "amdados/app/debugging.h"
+
+namespace amdados {
+
+using ::allscale::api::user::data::Grid;
+
+// Defined in "scenario_simulation.cpp":
+void InitDependentParams(Configuration & conf);
+void RunDataAssimilation(const Configuration         & conf,
+                         const Grid<point_array_t,2> & sensors,
+                         const Grid<Matrix,2>        & observations,
+                         double_array_t              * final_field,
+                         RunProfile                  * profile);
+
+// Defined in "scenario_sensors.cpp":
+void LoadSensorLocations(const Configuration   & conf,
+                         Grid<point_array_t,2> & sensors);
+void LoadSensorMeasurements(const Configuration         & conf,
+                            const Grid<point_array_t,2> & sensors,
+                            Grid<Matrix,2>              & observations);
+
+namespace {
+
+//-----------------------------------------------------------------------------
+// Variant of parameter sweep: the overrides of configuration parameters.
+//-----------------------------------------------------------------------------
+struct SweepVariant
+{
+    std::vector<std::pair<std::string,std::string>> overrides;
+    std::string text;       // the overrides as they appear in the sweep file
+    double      seconds;    // execution time
+};
+
+//-----------------------------------------------------------------------------
+// Function reads the sweep file: one variant per line as a sequence of
+// '<name> <value>' pairs optionally followed by a comment; empty lines and
+// the ones starting with '#' are skipped.
+//-----------------------------------------------------------------------------
+std::vector<SweepVariant> ReadSweepFile(const std::string & filename)
+{
+    std::fstream f(filename, std::ios::in);
+    assert_true(f.good()) << "ERROR: failed to open sweep file " << filename;
+    std::vector<SweepVariant> variants;
+    std::string line, name, value;
+    for (int lineNo = 1; std::getline(f, line); ++lineNo) {
+        line = line.substr(0, line.find('#'));
+        std::stringstream ss(line);
+        SweepVariant v;
+        while (ss >> name) {
+            assert_true(static_cast<bool>(ss >> value))
+                << "ERROR at line " << filename << ":" << lineNo << "\n"
+                << "the valid line layout: '<name> <value> ... <comment>'";
+            v.overrides.emplace_back(name, value);
+            v.text += (v.text.empty() ? "" : " ") + name + " " + value;
+        }
+        if (!v.overrides.empty()) {
+            v.seconds = 0.0;
+            variants.push_back(v);
+        }
+    }
+    assert_true(!f.bad()) << "ERROR: failure while reading " << filename;
+    assert_true(!variants.empty()) << "ERROR: no variants in " << filename;
+    return variants;
+}
+
+//-----------------------------------------------------------------------------
+// Function makes the configuration of a variant from the primary parameters,
+// as they were read from configuration file, and the overrides.
+//-----------------------------------------------------------------------------
+Configuration MakeVariantConfig(const Configuration & primary,
+                                const SweepVariant  & variant,
+                                size_t                index)
+{
+    Configuration conf = primary;
+    for (const auto & o : variant.overrides) {
+        conf.SetValue(o.first.c_str(), o.second);
+    }
+    // Every variant has its own output files, and never resumes.
+    conf.SetString("file_suffix", ("v" + std::to_string(index)).c_str());
+    conf.SetString("restart_file", "");
+    InitDependentParams(conf);
+    return conf;
+}
+
+}   // anonymous namespace
+
+//-----------------------------------------------------------------------------
+// Function implements the parameter sweep: the simulation is run for every
+// variant of parameters listed in the sweep file. The sensors and observations
+// are loaded once and shared by all the variants in read-only fashion, which
+// run concurrently on the worker pool, at most 'sweep_concurrency' ones at
+// a time (0 - all at once); the next variant starts as soon as any running
+// one has finished. Hence, the variants may change the parameters of
+// model, filter and solver but not the ones the inputs depend on: the grid
+// and the time sampling of observations.
+// @param config_file name of configuration file.
+// @param sweep_file  name of file of parameter overrides.
+//-----------------------------------------------------------------------------
+void ScenarioSweep(const std::string & config_file,
+                   const std::string & sweep_file)
+{
+    MY_TIME_IT("Running scenario 'sweep' ...")
+
+    // Read the configuration file and the variants.
+    Configuration primary;
+    primary.ReadConfigFile(config_file);
+    primary.SetString("restart_file", "");
+    Configuration conf = primary;
+    InitDependentParams(conf);
+    conf.PrintParameters();
+
+    std::vector<SweepVariant> variants = ReadSweepFile(sweep_file);
+    std::vector<Configuration> confs;
+    for (size_t k = 0; k < variants.size(); ++k) {
+        confs.push_back(MakeVariantConfig(primary, variants[k], k));
+        const Configuration & c = confs.back();
+        assert_true((GetGridSize(c) == GetGridSize(conf)) &&
+                    (c.asInt("Nt") == conf.asInt("Nt")) &&
+                    (c.asDouble("dt") == conf.asDouble("dt")))
+            << "variant " << k << " (" << variants[k].text << ") changes "
+            << "the grid or the time sampling of observations";
+    }
+
+    // Load sensor data obtained from Python code, once for all the variants.
+    Grid<point_array_t,2> sensors(GetGridSize(conf));
+    Grid<Matrix,2> observations(GetGridSize(conf));
+    LoadSensorLocations(conf, sensors);
+    LoadSensorMeasurements(conf, sensors, observations);
+
+    const size_t total = variants.size();
+    const size_t concurrency = conf.IsExist("sweep_concurrency") ?
+                               conf.asUInt("sweep_concurrency") : 0;
+    const size_t window = (concurrency > 0) ? std::min(concurrency, total)
+                                            : total;
+    std::cout << "Running parameter sweep of " << total << " variants based "
+              << "on configuration file \"" << config_file << "\", "
+              << window << " at a time ...\n";
+
+    // Sliding window: every lane picks up the next variant as soon as it has
+    // finished the previous one, so a slow variant holds up its lane only.
+    auto start = std::chrono::high_resolution_clock::now();
+    std::atomic<size_t> next(0);
+    ::allscale::api::user::algorithm::pfor(size_t(0), window, [&](size_t) {
+        for (size_t k = next++; k < total; k = next++) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            RunDataAssimilation(confs[k], sensors, observations, nullptr,
+                                nullptr);
+            variants[k].seconds = std::chrono::duration<double>(
+                    std::chrono::high_resolution_clock::now() - t0).count();
+        }
+    });
+    const double time = std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - start).count();
+
+    // --- summarize performance data ---
+    const std::string filename = MakeFileName(conf, "sweep");
+    std::fstream f(filename, std::ios::out | std::ios::trunc);
+    assert_true(f.good()) << "failed to open file for writing: " << filename;
+    f << "# variant seconds overrides" << std::endl;
+    for (size_t k = 0; k < total; ++k) {
+        f << k << " " << variants[k].seconds << " "
+          << variants[k].text << std::endl;
+    }
+    std::cout << "Sweep took " << time << "s, summary: " << filename << "\n";
+    std::cout << "Throughput: " << static_cast<double>(total) / time
+              << " variants/s\n";
+}
+
+} // namespace amdados
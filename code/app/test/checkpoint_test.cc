@@ -0,0 +1,213 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#ifndef AMDADOS_PLAIN_MPI
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "allscale/api/user/data/adaptive_grid.h"
+#include "allscale/api/user/algorithm/pfor.h"
+#include "allscale/api/core/io.h"
+#include "allscale/utils/assert.h"
+#include "amdados/app/debugging.h"
+#include "amdados/app/amdados_utils.h"
+#include "amdados/app/configuration.h"
+#include "amdados/app/geometry.h"
+#include "amdados/app/matrix.h"
+#include "amdados/app/arena.h"
+#include "amdados/app/cholesky.h"
+#include "amdados/app/lu.h"
+#include "amdados/app/stencil_solver.h"
+#include "amdados/app/local_covariance.h"
+#include "amdados/app/kalman_filter.h"
+#include "amdados/app/subdomain_context.h"
+#include "amdados/app/checkpoint.h"
+
+namespace {
+
+using ::amdados::index_t;
+using ::amdados::point2d_t;
+using ::amdados::domain_t;
+using ::amdados::context_domain_t;
+using ::amdados::SubdomainContext;
+
+//-----------------------------------------------------------------------------
+// Function fills in the parameters the checkpointing depends on.
+//-----------------------------------------------------------------------------
+void MakeConfiguration(::amdados::Configuration & conf)
+{
+    conf.SetString("output_dir", ".");
+    conf.SetString("file_suffix", "checkpoint_test");
+    conf.SetInt("num_subdomains_x", 3);
+    conf.SetInt("num_subdomains_y", 2);
+    conf.SetInt("subdomain_x", 16);
+    conf.SetInt("subdomain_y", 16);
+    conf.SetInt("Nt", 6);
+    conf.SetInt("checkpoint_period", 2);
+}
+
+//-----------------------------------------------------------------------------
+// Function gives the subdomain 'idx' the structure of the simulation: dense
+// covariance in one subdomain, the localised one in another, no covariance
+// in the rest.
+//-----------------------------------------------------------------------------
+void InitContext(SubdomainContext & ctx, const point2d_t & idx)
+{
+    ctx.field.Resize(18, 18);
+    if ((idx.x == 0) && (idx.y == 0)) {
+        ctx.P.Resize(5, 5);
+    } else if ((idx.x == 1) && (idx.y == 1)) {
+        ctx.Ploc.Init(6, 4, 1);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Function fills in the state of subdomain 'idx' by the values unique to
+// the subdomain and the 'version' of the state.
+//-----------------------------------------------------------------------------
+void MakeState(::amdados::subdomain_t & cell, SubdomainContext & ctx,
+               const point2d_t & idx, int version)
+{
+    const double base = 1000.0 * version + 100.0 * idx.x + 10.0 * idx.y;
+    double v = base;
+    cell.setActiveLayer(::amdados::LayerFine);
+    cell.forAllActiveNodes([&v](double & x) { x = (v += 1.0); });
+    ctx.layer = static_cast<unsigned>(idx.x % 2);
+    ctx.flow = ::amdados::flow_t(base + 0.5, base - 0.5);
+    for (auto & x : ctx.field) x = (v += 1.0);
+    for (auto & x : ctx.P) x = (v += 1.0);
+    for (index_t i = 0; i < ctx.Ploc.Size(); ++i) {
+    for (index_t k = 0; k < ctx.Ploc.NumEntries(); ++k) {
+        ctx.Ploc(i,k) = (v += 1.0);
+    }}
+    ctx.boundaries.remote.assign(static_cast<size_t>(version + idx.y), base);
+}
+
+//-----------------------------------------------------------------------------
+// Function checks the restored state of subdomain 'idx' against the one
+// made by MakeState().
+//-----------------------------------------------------------------------------
+void CheckState(::amdados::subdomain_t & cell, const SubdomainContext & ctx,
+                const point2d_t & idx, int version)
+{
+    ::amdados::subdomain_t ref_cell;
+    SubdomainContext ref;
+    InitContext(ref, idx);
+    MakeState(ref_cell, ref, idx, version);
+
+    EXPECT_EQ(cell.getActiveLayer(), ref_cell.getActiveLayer());
+    std::vector<double> values, ref_values;
+    cell.forAllActiveNodes([&](double & x) { values.push_back(x); });
+    ref_cell.forAllActiveNodes([&](double & x) { ref_values.push_back(x); });
+    EXPECT_EQ(values, ref_values);
+
+    EXPECT_EQ(ctx.layer, ref.layer);
+    EXPECT_EQ(ctx.flow, ref.flow);
+    EXPECT_TRUE(std::equal(ctx.field.begin(), ctx.field.end(),
+                           ref.field.begin(), ref.field.end()));
+    EXPECT_TRUE(std::equal(ctx.P.begin(), ctx.P.end(),
+                           ref.P.begin(), ref.P.end()));
+    EXPECT_TRUE(ctx.P_mixed.Empty());
+    EXPECT_EQ(ctx.boundaries.remote, ref.boundaries.remote);
+    ASSERT_EQ(ctx.Ploc.Size(), ref.Ploc.Size());
+    for (index_t i = 0; i < ctx.Ploc.Size(); ++i) {
+    for (index_t k = 0; k < ctx.Ploc.NumEntries(); ++k) {
+        EXPECT_EQ(ctx.Ploc(i,k), ref.Ploc(i,k));
+    }}
+}
+
+//-----------------------------------------------------------------------------
+// Returns the pending coarse-grid correction of a subdomain in a version.
+//-----------------------------------------------------------------------------
+double Correction(const point2d_t & idx, int version)
+{
+    return 0.25 * version - 0.5 * static_cast<double>(idx.x * 10 + idx.y);
+}
+
+//-----------------------------------------------------------------------------
+// Returns "true" if the file exists.
+//-----------------------------------------------------------------------------
+bool FileExists(const std::string & filename)
+{
+    return std::ifstream(filename).good();
+}
+
+} // anonymous namespace
+
+//-----------------------------------------------------------------------------
+// Subdomains save themselves concurrently at two successive checkpoints, the
+// background thread writes the records in the order they come, and the last
+// complete checkpoint restores every subdomain at its own place.
+//-----------------------------------------------------------------------------
+TEST(Checkpointer, WriteAndRestore)
+{
+    using ::allscale::api::user::algorithm::pfor;
+
+    ::amdados::Configuration conf;
+    MakeConfiguration(conf);
+    const ::amdados::time_schedule_t schedule =
+                    ::amdados::MakeUniformTimeSchedule(6, 1.0, 2);
+    const point2d_t grid_size(3, 2);
+    const std::string filename = ::amdados::MakeFileName(conf, "checkpoint");
+    std::remove(filename.c_str());
+
+    {
+        ::amdados::Checkpointer checkpointer(conf, schedule, grid_size);
+        // The checkpoints are taken after the time steps 2 and 4.
+        for (size_t t = 0; t <= ::amdados::NumSubIterations(schedule); ++t) {
+            EXPECT_EQ(checkpointer.IsDue(t), (t == 4) || (t == 8));
+        }
+
+        domain_t state(grid_size);
+        context_domain_t contexts(grid_size);
+        for (int version = 1; version <= 2; ++version) {
+            const size_t timestamp = 4 * static_cast<size_t>(version);
+            pfor(point2d_t(0,0), grid_size, [&](const point2d_t & idx) {
+                if (version == 1) InitContext(contexts[idx], idx);
+                MakeState(state[idx], contexts[idx], idx, version);
+                checkpointer.Save(timestamp, idx, state[idx], contexts[idx],
+                                  Correction(idx, version));
+            });
+        }
+        checkpointer.Finish();
+    }
+    ASSERT_TRUE(FileExists(filename));
+    EXPECT_FALSE(FileExists(filename + ".4.tmp"));
+    EXPECT_FALSE(FileExists(filename + ".8.tmp"));
+
+    // The state to be restored has the structure of the simulation.
+    domain_t state(grid_size);
+    context_domain_t contexts(grid_size);
+    pfor(point2d_t(0,0), grid_size, [&](const point2d_t & idx) {
+        InitContext(contexts[idx], idx);
+        state[idx].setActiveLayer(::amdados::LayerCoarse);
+    });
+    ::amdados::Matrix corrections;
+    const size_t timestamp = ::amdados::Checkpointer::Load(filename,
+                                        state, contexts, corrections);
+    EXPECT_EQ(timestamp, 8u);
+    ASSERT_EQ(corrections.NRows(), grid_size.x);
+    ASSERT_EQ(corrections.NCols(), grid_size.y);
+    for (index_t x = 0; x < grid_size.x; ++x) {
+    for (index_t y = 0; y < grid_size.y; ++y) {
+        const point2d_t idx(x, y);
+        CheckState(state[idx], contexts[idx], idx, 2);
+        EXPECT_EQ(corrections(x, y), Correction(idx, 2));
+    }}
+    std::remove(filename.c_str());
+}
+
+#endif  // AMDADOS_PLAIN_MPI
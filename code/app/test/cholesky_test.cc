@@ -13,8 +13,10 @@
 #include <fstream>
 #include <string>
 #include <limits>
+#include <memory>
 #include "amdados/app/amdados_utils.h"
 #include "amdados/app/matrix.h"
+#include "amdados/app/arena.h"
 #include "amdados/app/cholesky.h"
 
 // Tolerance on relative error.
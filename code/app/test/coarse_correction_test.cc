@@ -0,0 +1,325 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#ifndef AMDADOS_PLAIN_MPI
+
+#include <gtest/gtest.h>
+#include "allscale/api/user/data/adaptive_grid.h"
+#include "allscale/api/user/algorithm/pfor.h"
+#include "allscale/utils/assert.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "amdados/app/debugging.h"
+#include "amdados/app/amdados_utils.h"
+#include "amdados/app/configuration.h"
+#include "amdados/app/geometry.h"
+#include "amdados/app/matrix.h"
+#include "amdados/app/arena.h"
+#include "amdados/app/cholesky.h"
+#include "amdados/app/lu.h"
+#include "amdados/app/stencil_solver.h"
+#include "amdados/app/local_covariance.h"
+#include "amdados/app/kalman_filter.h"
+#include "amdados/app/subdomain_context.h"
+#include "amdados/app/coarse_correction.h"
+
+namespace {
+
+using ::amdados::index_t;
+using ::amdados::Matrix;
+using ::amdados::ModelStencil;
+using ::amdados::StencilSolver;
+
+//-----------------------------------------------------------------------------
+// Function initializes the solver of the coarse problem over the grid of
+// N-by-N subdomains of S-by-S points. The subdomain 'excluded', if any, gets
+// the identity row.
+//-----------------------------------------------------------------------------
+void InitCoarseSolver(StencilSolver & coarse_solver, const ModelStencil & s,
+                      index_t N, index_t S, index_t excluded)
+{
+    std::vector<ModelStencil> stencils(static_cast<size_t>(N * N),
+                                       ::amdados::CoarseStencil(s, S, S));
+    if (excluded >= 0) {
+        ModelStencil & e = stencils[static_cast<size_t>(excluded)];
+        e.centre = 1.0;
+        e.xm = e.xp = e.ym = e.yp = 0.0;
+    }
+    coarse_solver.Init(stencils, N, N);
+}
+
+//-----------------------------------------------------------------------------
+// Function computes the coarse-grid correction of the reference solver: the
+// mean residual of each subdomain arises at the points next to its peers,
+// where the old values 'used' have been used instead of the new ones 'u_new'
+// (both matrices are global with the border). The subdomain 'excluded', if
+// any, is not corrected.
+//-----------------------------------------------------------------------------
+void ReferenceCorrection(Matrix & coarse, StencilSolver & coarse_solver,
+                         const ModelStencil & s, index_t N, index_t S,
+                         const Matrix & used, const Matrix & u_new,
+                         index_t excluded)
+{
+    coarse.Resize(N + 2, N + 2);
+    ::amdados::Fill(coarse, 0.0);
+    for (index_t X = 0; X < N; ++X) {
+    for (index_t Y = 0; Y < N; ++Y) {
+        if (X * N + Y == excluded) continue;
+        const index_t x0 = X * S + 1, x1 = X * S + S;
+        const index_t y0 = Y * S + 1, y1 = Y * S + S;
+        double sum = 0.0;
+        for (index_t k = 0; k < S; ++k) {
+            if (X > 0)     sum += s.xm * (used(x0 - 1, y0 + k) -
+                                          u_new(x0 - 1, y0 + k));
+            if (X + 1 < N) sum += s.xp * (used(x1 + 1, y0 + k) -
+                                          u_new(x1 + 1, y0 + k));
+            if (Y > 0)     sum += s.ym * (used(x0 + k, y0 - 1) -
+                                          u_new(x0 + k, y0 - 1));
+            if (Y + 1 < N) sum += s.yp * (used(x0 + k, y1 + 1) -
+                                          u_new(x0 + k, y1 + 1));
+        }
+        coarse(X + 1, Y + 1) = sum / static_cast<double>(S * S);
+    }}
+    coarse_solver.Solve(coarse, coarse);
+}
+
+//-----------------------------------------------------------------------------
+// Function solves the implicit model equation B*u = f with the zero border
+// over the grid of N-by-N subdomains of S-by-S points by the sub-iterations
+// of the application: every subdomain is solved with the boundary values its
+// peers had at the previous sub-iteration (block Jacobi), then, optionally,
+// the coarse-grid correction is added. The subdomain 'excluded', if any, is
+// not corrected, like a subdomain driven by Kalman filter. Function returns
+// the number of sub-iterations until the residual drops below 'tol'.
+//-----------------------------------------------------------------------------
+int CountSubIterations(const ModelStencil & s, index_t N, index_t S,
+                       bool correction, index_t excluded = -1)
+{
+    const double tol = 1e-6;
+    const int max_iter = 1000;
+    const index_t G = N * S;                // global size without border
+
+    Matrix f(G, G), u(G + 2, G + 2), used(G + 2, G + 2);
+    ::amdados::MakeRandom(f, 'u');
+
+    StencilSolver solver, coarse_solver;
+    solver.Init(s, S, S);
+    InitCoarseSolver(coarse_solver, s, N, S, excluded);
+
+    Matrix field(S + 2, S + 2), coarse;
+    for (int iter = 1; iter <= max_iter; ++iter) {
+        // Every subdomain is solved independently: u_new = B^{-1}*f given
+        // the halo of the old u, which the matrix 'used' remembers.
+        Matrix u_new = u;
+        for (index_t X = 0; X < N; ++X) {
+        for (index_t Y = 0; Y < N; ++Y) {
+            for (index_t x = 0; x < S + 2; ++x) {
+            for (index_t y = 0; y < S + 2; ++y) {
+                const index_t gx = X * S + x, gy = Y * S + y;
+                const bool internal = (0 < x) && (x <= S) &&
+                                      (0 < y) && (y <= S);
+                field(x,y) = internal ? f(gx - 1, gy - 1) : u(gx, gy);
+                if (!internal) used(gx, gy) = u(gx, gy);
+            }}
+            solver.Solve(field, field);
+            for (index_t x = 1; x <= S; ++x) {
+            for (index_t y = 1; y <= S; ++y) {
+                u_new(X * S + x, Y * S + y) = field(x,y);
+            }}
+        }}
+
+        if (correction) {
+            ReferenceCorrection(coarse, coarse_solver, s, N, S,
+                                used, u_new, excluded);
+            for (index_t X = 0; X < N; ++X) {
+            for (index_t Y = 0; Y < N; ++Y) {
+                if (X * N + Y == excluded) {
+                    EXPECT_EQ(0.0, coarse(X + 1, Y + 1));
+                    continue;
+                }
+                for (index_t x = 1; x <= S; ++x) {
+                for (index_t y = 1; y <= S; ++y) {
+                    u_new(X * S + x, Y * S + y) += coarse(X + 1, Y + 1);
+                }}
+            }}
+        }
+        u = u_new;
+
+        // Residual of the global equation.
+        double res = 0.0, norm = 0.0;
+        for (index_t x = 1; x <= G; ++x) {
+        for (index_t y = 1; y <= G; ++y) {
+            const double Bu = s.centre * u(x,y) +
+                              s.xm * u(x - 1,y) + s.xp * u(x + 1,y) +
+                              s.ym * u(x,y - 1) + s.yp * u(x,y + 1);
+            res = std::max(res, std::fabs(f(x - 1,y - 1) - Bu));
+            norm = std::max(norm, std::fabs(f(x - 1,y - 1)));
+        }}
+        if (res < tol * norm) return iter;
+    }
+    return max_iter;
+}
+
+//-----------------------------------------------------------------------------
+// Function returns the stencil of implicit Euler step of advection-diffusion
+// equation, where the diffusion spans a few subdomains.
+//-----------------------------------------------------------------------------
+ModelStencil MakeStencil()
+{
+    const double rho = 300.0, v = 0.5;
+    ModelStencil s;
+    s.centre = 1.0 + 4 * rho;
+    s.xm = - v - rho;  s.xp = + v - rho;
+    s.ym = - v - rho;  s.yp = + v - rho;
+    return s;
+}
+
+} // anonymous namespace
+
+//-----------------------------------------------------------------------------
+// The solver of variable stencil agrees with the one of constant stencil.
+//-----------------------------------------------------------------------------
+TEST(CoarseCorrection, VariableStencil)
+{
+    using namespace ::amdados;
+    const ModelStencil s = MakeStencil();
+    const index_t Sx = 5, Sy = 7;
+    StencilSolver constant, variable;
+    constant.Init(s, Sx, Sy);
+    variable.Init(std::vector<ModelStencil>(size_t(Sx * Sy), s), Sx, Sy);
+
+    Matrix b(Sx + 2, Sy + 2), x_constant, x_variable;
+    MakeRandom(b, 'u');
+    x_constant = b;
+    x_variable = b;
+    constant.Solve(x_constant, x_constant);
+    variable.Solve(x_variable, x_variable);
+    EXPECT_EQ(0.0, NormDiff(x_constant, x_variable));
+
+    // The coarse stencil keeps the row sum of the model stencil.
+    const ModelStencil c = CoarseStencil(s, Sx, Sy);
+    const double sum = s.centre + s.xm + s.xp + s.ym + s.yp;
+    EXPECT_NEAR(sum, c.centre + c.xm + c.xp + c.ym + c.yp,
+                10 * std::numeric_limits<double>::epsilon() * s.centre);
+}
+
+//-----------------------------------------------------------------------------
+// The number of sub-iterations of block Jacobi method grows with the number
+// of subdomains, whereas the coarse-grid correction keeps it (nearly) flat.
+//-----------------------------------------------------------------------------
+TEST(CoarseCorrection, SubIterationsAsGridGrows)
+{
+    const ModelStencil s = MakeStencil();
+    const index_t S = 8;
+    int plain[3], corrected[3], excluded[3];
+    for (int k = 0; k < 3; ++k) {
+        const index_t N = index_t(2) << k;          // 2, 4, 8 subdomains
+        plain[k] = CountSubIterations(s, N, S, false);
+        corrected[k] = CountSubIterations(s, N, S, true);
+        excluded[k] = CountSubIterations(s, N, S, true, N + 1);
+        RecordProperty(("plain_" + std::to_string(N)).c_str(), plain[k]);
+        RecordProperty(("corrected_" + std::to_string(N)).c_str(),
+                       corrected[k]);
+        RecordProperty(("excluded_" + std::to_string(N)).c_str(),
+                       excluded[k]);
+    }
+    EXPECT_GT(plain[2], 2 * plain[0]);
+    for (int k = 0; k < 3; ++k) {
+        EXPECT_LT(corrected[k], plain[k]);
+        EXPECT_LE(corrected[k], corrected[0] + corrected[0] / 10);
+        EXPECT_LT(excluded[k], plain[k]);
+    }
+
+    // A subdomain left out of the correction costs extra sub-iterations
+    // on its own, which do not grow any further with the grid.
+    EXPECT_LE(excluded[2], excluded[1] + excluded[1] / 10);
+}
+
+//-----------------------------------------------------------------------------
+// The coarse-grid correction of the application, gathered from the
+// subdomains concurrently, agrees with the one of the reference solver,
+// including the subdomain excluded from the correction. The correction is
+// only available at the sub-iteration that follows the gathered one.
+//-----------------------------------------------------------------------------
+TEST(CoarseCorrection, MatchesReference)
+{
+    using ::allscale::api::user::algorithm::pfor;
+    using ::amdados::point2d_t;
+
+    const ModelStencil s = MakeStencil();
+    const index_t N = 3;
+    const index_t excluded = 5;                     // subdomain (1,2)
+    const point2d_t grid_size(N, N);
+    const ::amdados::time_schedule_t schedule =
+                    ::amdados::MakeUniformTimeSchedule(4, 1.0, 2);
+
+    // The subdomains and their contexts at the finest resolution.
+    ::amdados::domain_t state(grid_size);
+    ::amdados::context_domain_t contexts(grid_size);
+    state[point2d_t(0,0)].setActiveLayer(::amdados::LayerFine);
+    const index_t S = state[point2d_t(0,0)].getActiveLayerSize().x;
+    const index_t G = N * S;
+    for (index_t X = 0; X < N; ++X) {
+    for (index_t Y = 0; Y < N; ++Y) {
+        const point2d_t idx(X, Y);
+        state[idx].setActiveLayer(::amdados::LayerFine);
+        contexts[idx].layer = ::amdados::LayerFine;
+        contexts[idx].model = s;
+        contexts[idx].field.Resize(S + 2, S + 2);
+        if (X * N + Y == excluded) {
+            contexts[idx].sensors.push_back(point2d_t(0,0));
+        }
+    }}
+
+    StencilSolver coarse_solver;
+    InitCoarseSolver(coarse_solver, s, N, S, excluded);
+    ::amdados::CoarseCorrection correction(schedule, grid_size);
+    Matrix used(G + 2, G + 2), u_new(G + 2, G + 2), coarse;
+    Matrix field(S + 2, S + 2);
+    for (size_t timestamp = 0; timestamp < 3; ++timestamp) {
+        // Subdomains have been solved with the halo 'used' and got 'u_new'.
+        ::amdados::MakeRandom(used, 'u');
+        for (index_t x = 0; x < G + 2; ++x) {
+        for (index_t y = 0; y < G + 2; ++y) {
+            u_new(x,y) = used(y,x) * static_cast<double>(timestamp + 1);
+        }}
+        for (index_t X = 0; X < N; ++X) {
+        for (index_t Y = 0; Y < N; ++Y) {
+            const point2d_t idx(X, Y);
+            for (index_t x = 0; x < S + 2; ++x) {
+            for (index_t y = 0; y < S + 2; ++y) {
+                contexts[idx].field(x,y) = used(X * S + x, Y * S + y);
+                field(x,y) = u_new(X * S + x, Y * S + y);
+            }}
+            state[idx].copyActiveLayerFrom(&field(1,1), field.NCols());
+        }}
+
+        pfor(point2d_t(0,0), grid_size, [&](const point2d_t & idx) {
+            correction.Gather(timestamp, idx, state[idx], contexts);
+        });
+        ReferenceCorrection(coarse, coarse_solver, s, N, S,
+                            used, u_new, excluded);
+
+        for (index_t X = 0; X < N; ++X) {
+        for (index_t Y = 0; Y < N; ++Y) {
+            const point2d_t idx(X, Y);
+            const double c = coarse(X + 1, Y + 1);
+            EXPECT_NE(0.0, (X * N + Y == excluded) ? 1.0 : c);
+            EXPECT_NEAR(c, correction.Correction(timestamp + 1, idx),
+                        1e-12 * (1.0 + std::fabs(c)));
+            EXPECT_EQ(0.0, correction.Correction(timestamp, idx));
+            EXPECT_EQ(0.0, correction.Correction(timestamp + 2, idx));
+        }}
+        EXPECT_EQ(0.0, correction.Correction(timestamp + 1,
+                                             point2d_t(1, 2)));
+    }
+}
+
+#endif  // AMDADOS_PLAIN_MPI
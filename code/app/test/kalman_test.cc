@@ -12,12 +12,18 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <memory>
 #include <random>
+#include <vector>
 #include "amdados/app/amdados_utils.h"
 #include "amdados/app/matrix.h"
+#include "amdados/app/arena.h"
 #include "amdados/app/cholesky.h"
 #include "amdados/app/lu.h"
+#include "amdados/app/stencil_solver.h"
+#include "amdados/app/local_covariance.h"
 #include "amdados/app/kalman_filter.h"
+#include "amdados/app/batched_kalman.h"
 
 //-----------------------------------------------------------------------------
 // Function for testing a Kalman filter on a toy 2D problem.
@@ -122,4 +128,278 @@ TEST(KalmanFilter, Basic)
     log_file << std::endl << std::flush;
 }
 
+//-----------------------------------------------------------------------------
+// Function compares the localised covariance propagation and filtering
+// against the dense ones on a small 2D field given the stencil of implicit
+// model at the internal points, the border points are passed through.
+// The diffusion stencil is diagonally dominant (Neumann series), the
+// advection one is not (band LU decomposition column by column).
+//-----------------------------------------------------------------------------
+class KalmanFilterLocal : public ::testing::TestWithParam<bool>
+{
+};
+
+TEST_P(KalmanFilterLocal, LocalCovariance)
+{
+    using namespace ::amdados;
+
+    const index_t NX = 7, NY = 6, N = NX * NY, RADIUS = 3;
+    const double  ALPHA = 0.1, V = GetParam() ? 0.0 : 0.5;
+
+    // Implicit model: B = I + ALPHA * (4-point Laplacian) + advection.
+    ModelStencil s;
+    s.centre = 1.0 + 4.0 * ALPHA;
+    s.xm = - V - ALPHA;  s.xp = + V - ALPHA;
+    s.ym = - V - ALPHA;  s.yp = + V - ALPHA;
+    Matrix B(N, N);
+    MakeIdentityMatrix(B);
+    for (index_t x = 1; x + 1 < NX; ++x) {
+    for (index_t y = 1; y + 1 < NY; ++y) {
+        const index_t i = x * NY + y;
+        B(i,i) = s.centre;
+        B(i, i - NY) = s.xm;
+        B(i, i + NY) = s.xp;
+        B(i, i - 1)  = s.ym;
+        B(i, i + 1)  = s.yp;
+    }}
+
+    // Initial covariance with short correlation length, diagonal noise.
+    LocalCovariance Ploc, Qloc;
+    Ploc.Init(NX, NY, RADIUS);
+    Qloc.Init(NX, NY, 0);
+    for (index_t i = 0; i < N; ++i) {
+        for (index_t k = 0; k < Ploc.NumEntries(); ++k) {
+            const index_t j = Ploc.Neighbour(i, k);
+            if (j >= 0) {
+                const double dx = static_cast<double>(i / NY - j / NY);
+                const double dy = static_cast<double>(i % NY - j % NY);
+                Ploc(i,k) = std::exp(-0.5 * (dx*dx + dy*dy));
+            }
+        }
+        Qloc.Diag(i) = 0.5;
+    }
+    EXPECT_LT(Ploc.Bytes(), static_cast<size_t>(N * N) * sizeof(double) * 2);
+
+    Matrix P, Q;
+    Ploc.ToDense(P);
+    Qloc.ToDense(Q);
+
+    // Without diagonal dominance, B^{-1}*P is exact within the support.
+    LocalInverseOperator inv;
+    EXPECT_EQ(GetParam(), inv.Init(s, NX, NY));
+    if (!GetParam()) {
+        LocalCovariance Y;
+        Matrix Y_dense(N, N);
+        LUdecomposition lu;
+        lu.Init(B);
+        lu.BatchSolve(Y_dense, P);
+        inv.Apply(Y, Ploc);
+        for (index_t i = 0; i < N; ++i) {
+        for (index_t k = 0; k < Y.NumEntries(); ++k) {
+            const index_t j = Y.Neighbour(i, k);
+            if (j >= 0) {
+                EXPECT_NEAR(Y_dense(i,j), Y(i,k), 1e-12);
+            }
+        }}
+    }
+
+    Vector x(N), xloc(N);
+    for (index_t i = 0; i < N; ++i) { x(i) = std::sin(0.3 * i); }
+    xloc = x;
+
+    // Prior estimation: the state is exactly the same, the diagonal of
+    // covariance matrix is close as the inverse of B decays quickly.
+    KalmanFilter kf, kf_loc;
+    kf.PropagateStateInverse(x, P, B, Q);
+    kf_loc.PropagateStateInverse(xloc, Ploc, s, Qloc);
+    const double tol = GetParam() ? 1e-3 : 1e-2;  // advection spreads wider
+    for (index_t i = 0; i < N; ++i) {
+        EXPECT_NEAR(x(i), xloc(i), 1e-12);
+        EXPECT_NEAR(P(i,i), Ploc.Diag(i), tol * P(i,i));
+    }
+
+    // Localisation damps the covariance by the taper, so the dense filter
+    // starts from the tapered prior in order to compare like with like.
+    Ploc.ToDense(P);
+
+    // Filtering with a couple of sensors.
+    const index_t NOBS = 2;
+    Matrix H(NOBS, N), R(NOBS, NOBS);
+    Vector z(NOBS);
+    H(0, 2 * NY + 2) = 1.0;
+    H(1, 5 * NY + 3) = 1.0;
+    MakeIdentityMatrix(R);
+    z(0) = 1.0;
+    z(1) = -1.0;
+    kf.SolveFilter(x, P, H, R, z);
+    kf_loc.SolveFilter(xloc, Ploc, H, R, z);
+    for (index_t i = 0; i < N; ++i) {
+        EXPECT_NEAR(x(i), xloc(i), 1e-12);
+        EXPECT_NEAR(P(i,i), Ploc.Diag(i), 1e-12);
+        EXPECT_GT(Ploc.Diag(i), 0.0);
+    }
+
+    // The result is symmetric and vanishes beyond the support radius.
+    for (index_t i = 0; i < N; ++i) {
+    for (index_t j = 0; j < N; ++j) {
+        EXPECT_DOUBLE_EQ(Ploc.Get(i,j), Ploc.Get(j,i));
+        if (std::abs(i / NY - j / NY) > RADIUS) {
+            EXPECT_EQ(0.0, Ploc.Get(i,j));
+        }
+    }}
+}
+
+INSTANTIATE_TEST_CASE_P(Model, KalmanFilterLocal,
+                        ::testing::Values(true, false));
+
+//-----------------------------------------------------------------------------
+// Fixture of the alternative covariance storages: "sqrt" - the square-root
+// filter, "mixed" - single-precision covariance (see kalman_filter.h).
+//-----------------------------------------------------------------------------
+class KalmanFilterStorage : public ::testing::TestWithParam<std::string>
+{
+};
+
+//-----------------------------------------------------------------------------
+// Function checks that the filter with alternative storage of covariance
+// reproduces the conventional one in double precision at every time step.
+//-----------------------------------------------------------------------------
+TEST_P(KalmanFilterStorage, ReproducesConventional)
+{
+    using namespace ::amdados;
+
+    const index_t N = 30, NOBS = 4, NUM_TIME_STEPS = 50;
+    const bool    sqrt_covar = (GetParam() == "sqrt");
+    const double  TOL = sqrt_covar ? 1e-10 : 1e-5;  // float storage is coarse
+
+    // Non-symmetric, diagonally dominant inverse model matrix.
+    Matrix B(N, N);
+    for (index_t i = 0; i < N; ++i) {
+        B(i,i) = 1.5;
+        if (i > 0)     B(i, i - 1) = -0.3;
+        if (i + 1 < N) B(i, i + 1) = -0.1;
+    }
+
+    Matrix P(N, N), Q(N, N), H(NOBS, N), R(NOBS, NOBS);
+    Vector Qdiag(N);                    // the square-root filter takes diag(Q)
+    MakeIdentityMatrix(P);
+    for (index_t i = 0; i < N; ++i) { Qdiag(i) = Q(i,i) = 0.1 + 0.01 * i; }
+    for (index_t k = 0; k < NOBS; ++k) {
+        H(k, 7 * k + 1) = 1.0;
+        R(k,k) = 0.5 + 0.1 * k;
+    }
+    Matrix  S = P;                      // identity is its own factor
+    MatrixF P_mixed;
+    Convert(P_mixed, P);
+
+    Vector x(N), x_alt(N), z(NOBS);
+    Fill(x, 0.0);
+    x_alt = x;
+
+    KalmanFilter  kf, kf_sqrt;
+    KalmanFilterF kf_mixed;
+    Matrix P_alt(N, N);                 // covariance of alternative filter
+    for (index_t t = 0; t < NUM_TIME_STEPS; ++t) {
+        for (index_t k = 0; k < NOBS; ++k) {
+            z(k) = std::sin(0.1 * static_cast<double>(t + 3 * k));
+        }
+        kf.PropagateStateInverse(x, P, B, Q);
+        kf.SolveFilter(x, P, H, R, z);
+        if (sqrt_covar) {
+            // The prior factor is triangular, the posterior one is not.
+            kf_sqrt.PropagateStateInverseSqrt(x_alt, S, B, Qdiag);
+            for (index_t i = 0; i < N; ++i) {
+                EXPECT_GT(S(i,i), 0.0);
+                for (index_t j = i + 1; j < N; ++j) { EXPECT_EQ(0.0, S(i,j)); }
+            }
+            kf_sqrt.SolveFilterSqrt(x_alt, S, H, R, z);
+            MatMultTr(P_alt, S, S);
+        } else {
+            kf_mixed.PropagateStateInverse(x_alt, P_mixed, B, Q);
+            kf_mixed.SolveFilter(x_alt, P_mixed, H, R, z);
+            Convert(P_alt, P_mixed);
+        }
+
+        EXPECT_LT(NormDiff(x, x_alt), TOL * Norm(x)) << "time step " << t;
+        for (index_t i = 0; i < N; ++i) {
+        for (index_t j = 0; j < N; ++j) {
+            EXPECT_NEAR(P(i,j), P_alt(i,j), TOL * P(i,i));
+            EXPECT_EQ(P_alt(i,j), P_alt(j,i));
+        }}
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(KalmanFilter, KalmanFilterStorage,
+                        ::testing::Values("sqrt", "mixed"));
+
+//-----------------------------------------------------------------------------
+// Function checks that the batched filter gives exactly the same result as
+// the filters applied to the subdomains one by one, both the prior
+// estimation and the filtering.
+//-----------------------------------------------------------------------------
+TEST(KalmanFilter, Batched)
+{
+    using namespace ::amdados;
+
+    const index_t N = 20;
+    const index_t NOBS[] = {1, 2, 1, 3, 2, 1, 1};
+    const size_t  NUM = sizeof(NOBS) / sizeof(NOBS[0]);
+
+    std::vector<Vector> x(NUM), x_batch(NUM), z(NUM);
+    std::vector<Matrix> P(NUM), P_batch(NUM), H(NUM), R(NUM);
+    Matrix B(N, N), Q(N, N);
+    for (index_t i = 0; i < N; ++i) {
+        B(i,i) = 1.5;
+        if (i > 0)     B(i, i - 1) = -0.3;
+        if (i + 1 < N) B(i, i + 1) = -0.1;
+        Q(i,i) = 0.1 + 0.01 * static_cast<double>(i);
+    }
+    for (size_t k = 0; k < NUM; ++k) {
+        const index_t O = NOBS[k];
+        x[k].Resize(N);
+        P[k].Resize(N, N);
+        H[k].Resize(O, N);
+        R[k].Resize(O, O);
+        z[k].Resize(O);
+        for (index_t i = 0; i < N; ++i) {
+            x[k](i) = std::cos(0.2 * static_cast<double>(i + 5 * k));
+            for (index_t j = 0; j < N; ++j) {
+                P[k](i,j) = std::exp(-0.1 * static_cast<double>(
+                                (i - j) * (i - j) + static_cast<index_t>(k)));
+            }
+        }
+        for (index_t o = 0; o < O; ++o) {
+            H[k](o, (3 * o + static_cast<index_t>(k)) % N) = 1.0;
+            R[k](o,o) = 1.0 + 0.1 * static_cast<double>(o);
+            z[k](o) = static_cast<double>(o + k);
+        }
+        x_batch[k] = x[k];
+        P_batch[k] = P[k];
+    }
+
+    BatchedKalmanFilter bkf;
+    for (size_t k = 0; k < NUM; ++k) {
+        bkf.Add(x_batch[k], P_batch[k], H[k], R[k], z[k]);
+    }
+    EXPECT_EQ(3u, bkf.NumGroups());
+
+    for (int iter = 0; iter < 3; ++iter) {
+        KalmanFilter kf;
+        for (size_t k = 0; k < NUM; ++k) {
+            if (iter == 1) kf.PropagateStateInverse(x[k], P[k], B, Q);
+            kf.SolveFilter(x[k], P[k], H[k], R[k], z[k]);
+        }
+        if (iter == 1) bkf.PropagateStateInverse(B, Q);
+        bkf.SolveFilter();
+        for (size_t k = 0; k < NUM; ++k) {
+            for (index_t i = 0; i < N; ++i) {
+                EXPECT_EQ(x[k](i), x_batch[k](i));
+                for (index_t j = 0; j < N; ++j) {
+                    EXPECT_EQ(P[k](i,j), P_batch[k](i,j));
+                }
+            }
+        }
+    }
+}
+
 #endif  // AMDADOS_PLAIN_MPI
@@ -13,9 +13,12 @@
 #include <fstream>
 #include <string>
 #include <limits>
+#include <memory>
 #include "amdados/app/amdados_utils.h"
 #include "amdados/app/matrix.h"
+#include "amdados/app/arena.h"
 #include "amdados/app/lu.h"
+#include "amdados/app/stencil_solver.h"
 
 // Tolerance on relative error.
 const double TOL = std::sqrt(std::sqrt(std::numeric_limits<double>::epsilon()));
@@ -104,4 +107,57 @@ TEST(LU, Basic)
              << max_rel_err << std::endl << std::endl << std::flush;
 }
 
+//-----------------------------------------------------------------------------
+// Function tests the banded solver of 5-point stencil against the dense LU
+// decomposition of the same matrix acting on extended subdomain.
+//-----------------------------------------------------------------------------
+TEST(LU, StencilSolver)
+{
+    using namespace ::amdados;
+    const double EPS = std::numeric_limits<double>::epsilon();
+
+    for (index_t Sx = 1; Sx <= 9; Sx += 4) {
+    for (index_t Sy = 1; Sy <= 11; Sy += 5) {
+        // Diffusion plus dominant advection: not diagonally dominant.
+        ModelStencil s;
+        s.centre = 1.0 + 2 * (0.05 + 0.03);
+        s.xm = -0.4 - 0.05;  s.xp = +0.4 - 0.05;
+        s.ym = +0.3 - 0.03;  s.yp = -0.3 - 0.03;
+
+        // Dense matrix: border points are passed through.
+        const index_t N = (Sx + 2) * (Sy + 2);
+        auto ind = [Sy](index_t x, index_t y) { return x * (Sy + 2) + y; };
+        Matrix B(N, N);
+        MakeIdentityMatrix(B);
+        for (index_t x = 1; x <= Sx; ++x) {
+        for (index_t y = 1; y <= Sy; ++y) {
+            const index_t i = ind(x, y);
+            B(i,i) = s.centre;
+            B(i,ind(x - 1, y)) = s.xm;  B(i,ind(x + 1, y)) = s.xp;
+            B(i,ind(x, y - 1)) = s.ym;  B(i,ind(x, y + 1)) = s.yp;
+        }}
+
+        Matrix b(Sx + 2, Sy + 2), x_dense(Sx + 2, Sy + 2);
+        Matrix x_stencil(Sx + 2, Sy + 2), x_inplace;
+        MakeRandom(b, 'u');
+        LUdecomposition lu;
+        lu.Init(B);
+        lu.Solve(x_dense, b);
+
+        StencilSolver solver;
+        solver.Init(s, Sx, Sy);
+        solver.Solve(x_stencil, b);
+        x_inplace = b;
+        solver.Solve(x_inplace, x_inplace);
+
+        EXPECT_LT(NormDiff(x_dense, x_stencil), 100 * EPS * Norm(x_dense));
+        EXPECT_EQ(0.0, NormDiff(x_stencil, x_inplace));
+        for (index_t y = 0; y < Sy + 2; ++y) {
+            EXPECT_EQ(b(0,y), x_stencil(0,y));
+            EXPECT_EQ(b(Sx + 1,y), x_stencil(Sx + 1,y));
+        }
+        EXPECT_LT(solver.Bytes(), static_cast<size_t>(N * N) * sizeof(double));
+    }}
+}
+
 #endif  // AMDADOS_PLAIN_MPI
@@ -13,8 +13,10 @@
 #include <fstream>
 #include <string>
 #include <limits>
+#include <memory>
 #include "amdados/app/amdados_utils.h"
 #include "amdados/app/matrix.h"
+#include "amdados/app/arena.h"
 #define ARMA_USE_CXX11
 #define ARMA_DONT_USE_WRAPPER
 #define ARMA_DONT_USE_LAPACK
@@ -119,6 +121,52 @@ void TestMatrixMulVector(double & max_rel_err, int nrows, int ncols)
             "dense*vector multiplication");
 }
 
+//-----------------------------------------------------------------------------
+// Function tests re-factorization A*A^t = L*L^t by LQ decomposition.
+//-----------------------------------------------------------------------------
+void TestLowerTriangularize(double & max_rel_err, int nrows, int ncols)
+{
+    Matrix    A(nrows, ncols);
+    arma::mat B, L;
+    MakeRandom(A, 'u');
+    CopyToArma(B, A);
+
+    LowerTriangularize(A);
+    CopyToArma(L, A);
+    for (int r = 0; r < nrows; ++r) {
+        EXPECT_GE(A(r,r), 0.0);
+        for (int c = r + 1; c < ncols; ++c) { EXPECT_EQ(0.0, A(r,c)); }
+    }
+    RelativeErrorCheckAndUpdate(B * B.t(), L * L.t(), max_rel_err,
+            "LQ decomposition");
+}
+
+//-----------------------------------------------------------------------------
+// Function tests the rank-one update of lower triangular factor.
+//-----------------------------------------------------------------------------
+void TestCholeskyUpdate(double & max_rel_err, int size)
+{
+    Matrix    L(size, size);
+    Vector    v(size);
+    arma::mat A, Lu;
+    arma::vec V;
+    MakeRandom(L, 'u');
+    LowerTriangularize(L);
+    MakeRandom(v, 'u');
+    v(0) = 0.0;                             // leading zeros are skipped
+    CopyToArma(A, L);
+    CopyToArma(V, v);
+
+    CholeskyUpdate(L, v);
+    CopyToArma(Lu, L);
+    for (int r = 0; r < size; ++r) {
+        EXPECT_GE(L(r,r), 0.0);
+        for (int c = r + 1; c < size; ++c) { EXPECT_EQ(0.0, L(r,c)); }
+    }
+    RelativeErrorCheckAndUpdate(A * A.t() + V * V.t(), Lu * Lu.t(),
+            max_rel_err, "rank-one update of triangular factor");
+}
+
 //-----------------------------------------------------------------------------
 // Function tests the matrix library written by means of Allscale API.
 //-----------------------------------------------------------------------------
@@ -145,7 +193,82 @@ TEST(MatrixTests, Basic)
         TestMatrixMulVector(max_rel_err, PRIMES[i], PRIMES[k]);
     }}
     log_file << "TestMatrixMulVector(): max. relative error: "
+             << max_rel_err << std::endl;
+
+    // Test re-factorization by LQ decomposition.
+    max_rel_err = 0.0;
+    for (int i = 0; i < NumPrimes; ++i) {
+    for (int k = i; k < NumPrimes; ++k) {
+        TestLowerTriangularize(max_rel_err, PRIMES[i], PRIMES[k]);
+    }}
+    log_file << "TestLowerTriangularize(): max. relative error: "
+             << max_rel_err << std::endl;
+
+    // Test rank-one update of triangular factor.
+    max_rel_err = 0.0;
+    for (int i = 0; i < NumPrimes; ++i) {
+        TestCholeskyUpdate(max_rel_err, PRIMES[i]);
+    }
+    log_file << "TestCholeskyUpdate(): max. relative error: "
              << max_rel_err << std::endl << std::endl << std::flush;
 }
 
+//-----------------------------------------------------------------------------
+// Function tests the matrices placed in memory arena as non-owning views.
+//-----------------------------------------------------------------------------
+TEST(MatrixTests, ArenaViews)
+{
+    const index_t N = 7, M = 5;
+    Arena  arena;
+    Matrix A, B, C;
+    Vector v;
+
+    // Measuring pass leaves the objects intact, binding pass makes views.
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass > 0) arena.Allocate();
+        arena.Place(A, N, M);
+        arena.Place(B, M, N, 2 * M * N);
+        arena.Place(C, N, N);
+        arena.Place(v, N);
+        EXPECT_EQ(pass > 0, A.IsView() && B.IsView() && C.IsView());
+    }
+    EXPECT_TRUE(v.IsView());
+    EXPECT_EQ(0u, arena.Bytes() % Arena::ALIGNMENT);
+    for (const double * p : {A.begin(), B.begin(), C.begin(), v.begin()}) {
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p) % Arena::ALIGNMENT);
+        EXPECT_TRUE(p >= A.begin() &&
+                    p < A.begin() + arena.Bytes() / sizeof(double));
+    }
+    EXPECT_TRUE(A.IsDistinct(B) && B.IsDistinct(C));
+
+    // Arithmetic on views is the same as on the ordinary matrices.
+    MakeRandom(A, 'n');
+    MakeRandom(B, 'n');
+    Matrix A2(A), B2(B), C2(N, N);
+    EXPECT_FALSE(A2.IsView());
+    MatMult(C, A, B);
+    MatMult(C2, A2, B2);
+    EXPECT_TRUE(std::equal(C.begin(), C.end(), C2.begin(), C2.end()));
+
+    // Resizing within the capacity and assignment keep the view.
+    const double * b = B.begin();
+    B.Resize(2 * M, N, false);
+    EXPECT_TRUE(B.IsView() && (B.begin() == b));
+    B = B2;
+    EXPECT_TRUE(B.IsView() && (B.begin() == b) && B.SameSize(B2));
+    EXPECT_TRUE(std::equal(B.begin(), B.end(), B2.begin(), B2.end()));
+
+    // Resizing beyond the capacity switches to own storage, content is kept.
+    A.Resize(N + 1, M, false);
+    EXPECT_FALSE(A.IsView());
+    EXPECT_TRUE(std::equal(A2.begin(), A2.end(), A.begin()));
+
+    // Swap and move keep the views of the same memory.
+    const double * c = C.begin();
+    C.swap(C2);
+    EXPECT_TRUE(C2.IsView() && (C2.begin() == c) && !C.IsView());
+    Matrix D(std::move(C2));
+    EXPECT_TRUE(D.IsView() && (D.begin() == c) && C2.Empty());
+}
+
 #endif  // AMDADOS_PLAIN_MPI
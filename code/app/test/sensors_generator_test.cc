@@ -0,0 +1,236 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#ifndef AMDADOS_PLAIN_MPI
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "allscale/api/user/data/adaptive_grid.h"
+#include "allscale/api/user/algorithm/pfor.h"
+#include "allscale/utils/assert.h"
+#include "amdados/app/amdados_utils.h"
+#include "amdados/app/configuration.h"
+#include "amdados/app/geometry.h"
+#include "amdados/app/debugging.h"
+#include "amdados/app/sensors_generator.h"
+
+namespace {
+
+using ::allscale::api::user::data::Grid;
+using ::amdados::point2d_t;
+using ::amdados::point_array_t;
+
+//-----------------------------------------------------------------------------
+// Function fills in the parameters the sensor generator depends on.
+//-----------------------------------------------------------------------------
+void MakeConfiguration(::amdados::Configuration & conf, const char * layout,
+                       double fraction)
+{
+    conf.SetInt("num_subdomains_x", 40);
+    conf.SetInt("num_subdomains_y", 30);
+    conf.SetInt("subdomain_x", 16);
+    conf.SetInt("subdomain_y", 12);
+    conf.SetDouble("sensor_fraction", fraction);
+    conf.SetString("sensor_layout", layout);
+}
+
+//-----------------------------------------------------------------------------
+// Function generates sensors of all the subdomains in parallel.
+//-----------------------------------------------------------------------------
+void Generate(const ::amdados::Configuration & conf,
+              Grid<point_array_t,2> & sensors)
+{
+    const ::amdados::SensorsGenerator generator(conf);
+    ::allscale::api::user::algorithm::pfor(point2d_t(0,0), sensors.size(),
+                                    [&](const point2d_t & idx) {
+        generator.MakeSubdomainSensors(idx, sensors[idx]);
+    });
+}
+
+} // anonymous namespace
+
+TEST(Philox4x32, KnownAnswers)
+{
+    // Known-answer tests of Random123 library for Philox4x32-10.
+    const uint32_t ctr0[4] = {0, 0, 0, 0}, key0[2] = {0, 0};
+    const uint32_t ctr1[4] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+    const uint32_t key1[2] = {0xffffffff, 0xffffffff};
+    const uint32_t ctr2[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+    const uint32_t key2[2] = {0xa4093822, 0x299f31d0};
+    uint32_t out[4];
+
+    ::amdados::Philox4x32::Block(ctr0, key0, out);
+    EXPECT_EQ(0x6627e8d5u, out[0]);
+    EXPECT_EQ(0xe169c58du, out[1]);
+    EXPECT_EQ(0xbc57ac4cu, out[2]);
+    EXPECT_EQ(0x9b00dbd8u, out[3]);
+
+    ::amdados::Philox4x32::Block(ctr1, key1, out);
+    EXPECT_EQ(0x408f276du, out[0]);
+    EXPECT_EQ(0x41c83b0eu, out[1]);
+    EXPECT_EQ(0xa20bc7c6u, out[2]);
+    EXPECT_EQ(0x6d5451fdu, out[3]);
+
+    ::amdados::Philox4x32::Block(ctr2, key2, out);
+    EXPECT_EQ(0xd16cfe09u, out[0]);
+    EXPECT_EQ(0x94fdccebu, out[1]);
+    EXPECT_EQ(0x5001e420u, out[2]);
+    EXPECT_EQ(0x24126ea1u, out[3]);
+}
+
+TEST(Philox4x32, Streams)
+{
+    ::amdados::Philox4x32 a(2063, 0, 7), b(2063, 0, 7), c(2063, 0, 8);
+    int same = 0;
+    for (int i = 0; i < 100; ++i) {
+        const uint32_t va = a(), vb = b(), vc = c();
+        EXPECT_EQ(va, vb);
+        same += (va == vc) ? 1 : 0;
+    }
+    EXPECT_LT(same, 2);
+
+    for (int i = 0; i < 1000; ++i) {
+        const double u = a.Uniform();
+        EXPECT_LE(0.0, u);
+        EXPECT_LT(u, 1.0);
+        EXPECT_LT(a.Below(13), 13u);
+    }
+}
+
+TEST(SensorsGenerator, Reproducible)
+{
+    ::amdados::Configuration conf;
+    MakeConfiguration(conf, "uniform", 0.002);
+    Grid<point_array_t,2> sensors(::amdados::GetGridSize(conf));
+    Generate(conf, sensors);
+
+    // Serial generation in reverse order yields exactly the same sensors.
+    const ::amdados::SensorsGenerator generator(conf);
+    point_array_t local;
+    for (long x = 39; x >= 0; --x) {
+    for (long y = 29; y >= 0; --y) {
+        generator.MakeSubdomainSensors(point2d_t(x,y), local);
+        EXPECT_EQ(sensors[point2d_t(x,y)], local);
+    }}
+
+    // The global list is ordered by flat indices of subdomains.
+    point_array_t global;
+    generator.MakeSensors(global);
+    size_t k = 0;
+    for (long x = 0; x < 40; ++x) {
+    for (long y = 0; y < 30; ++y) {
+        for (const auto & p : sensors[point2d_t(x,y)]) {
+            ASSERT_LT(k, global.size());
+            EXPECT_EQ(::amdados::Sub2Glo(p, point2d_t(x,y), point2d_t(16,12)),
+                      global[k++]);
+        }
+    }}
+    EXPECT_EQ(k, global.size());
+}
+
+TEST(SensorsGenerator, Layouts)
+{
+    const char * layouts[] = {"uniform", "clustered", "every"};
+    for (const char * layout : layouts) {
+        ::amdados::Configuration conf;
+        MakeConfiguration(conf, layout, 0.002);
+        Grid<point_array_t,2> sensors(::amdados::GetGridSize(conf));
+        Generate(conf, sensors);
+
+        // 0.002 of 16*12*40*30 points gives 461 sensors.
+        size_t total = 0;
+        for (long x = 0; x < 40; ++x) {
+        for (long y = 0; y < 30; ++y) {
+            const point_array_t & s = sensors[point2d_t(x,y)];
+            total += s.size();
+            if (std::string(layout) == "every") {
+                EXPECT_EQ(1u, s.size());
+            } else {
+                EXPECT_LE(s.size(), 1u);
+            }
+            for (const auto & p : s) {      // interior points only
+                EXPECT_TRUE((1 <= p.x) && (p.x < 15) &&
+                            (1 <= p.y) && (p.y < 11));
+            }
+        }}
+        if (std::string(layout) == "every") {
+            EXPECT_EQ(1200u, total);
+        } else if (std::string(layout) == "uniform") {
+            EXPECT_EQ(461u, total);
+        } else {
+            EXPECT_NEAR(461.0, double(total), 150.0) << layout;
+        }
+    }
+}
+
+TEST(SensorsGenerator, ExactCount)
+{
+    // 0.001 of the points gives 230 sensors, 0.75 - one in every subdomain,
+    // so the selection of subdomains is a permutation of them.
+    const double fractions[] = {0.001, 0.0025, 0.01, 0.75};
+    const size_t expected[] = {230, 576, 1200, 1200};
+    for (int k = 0; k < 4; ++k) {
+        ::amdados::Configuration conf;
+        MakeConfiguration(conf, "uniform", fractions[k]);
+        Grid<point_array_t,2> sensors(::amdados::GetGridSize(conf));
+        Generate(conf, sensors);
+        size_t total = 0;
+        for (long x = 0; x < 40; ++x) {
+        for (long y = 0; y < 30; ++y) {
+            total += sensors[point2d_t(x,y)].size();
+        }}
+        EXPECT_EQ(expected[k], total) << fractions[k];
+    }
+}
+
+TEST(SensorsGenerator, AtLeastOneSensor)
+{
+    // 0.001 of 4*4*2*3 points is less than a sensor, yet there is one.
+    const char * layouts[] = {"uniform", "clustered"};
+    for (const char * layout : layouts) {
+        ::amdados::Configuration conf;
+        MakeConfiguration(conf, layout, 0.001);
+        conf.SetInt("num_subdomains_x", 2);
+        conf.SetInt("num_subdomains_y", 3);
+        conf.SetInt("subdomain_x", 4);
+        conf.SetInt("subdomain_y", 4);
+        Grid<point_array_t,2> sensors(::amdados::GetGridSize(conf));
+        Generate(conf, sensors);
+        size_t total = 0;
+        for (long x = 0; x < 2; ++x) {
+        for (long y = 0; y < 3; ++y) {
+            total += sensors[point2d_t(x,y)].size();
+        }}
+        if (std::string(layout) == "uniform") {
+            EXPECT_EQ(1u, total);
+        } else {
+            EXPECT_LE(1u, total);
+        }
+    }
+}
+
+TEST(SensorsGenerator, DistinctPoints)
+{
+    // 0.5 of 16*12 points gives 96 sensors in every subdomain.
+    ::amdados::Configuration conf;
+    MakeConfiguration(conf, "every", 0.5);
+    Grid<point_array_t,2> sensors(::amdados::GetGridSize(conf));
+    Generate(conf, sensors);
+    for (long x = 0; x < 40; ++x) {
+    for (long y = 0; y < 30; ++y) {
+        point_array_t s = sensors[point2d_t(x,y)];
+        ASSERT_EQ(96u, s.size());
+        std::sort(s.begin(), s.end(), [](const point2d_t & a,
+                                         const point2d_t & b) {
+            return (a.x < b.x) || ((a.x == b.x) && (a.y < b.y));
+        });
+        EXPECT_TRUE(std::adjacent_find(s.begin(), s.end()) == s.end());
+    }}
+}
+
+#endif  // AMDADOS_PLAIN_MPI
@@ -0,0 +1,156 @@
+//-----------------------------------------------------------------------------
+// Author    : Albert Akhriev, albert_akhriev@ie.ibm.com
+// Copyright : IBM Research Ireland, 2017-2018
+//-----------------------------------------------------------------------------
+
+#ifndef AMDADOS_PLAIN_MPI
+
+#include <gtest/gtest.h>
+#include "allscale/utils/assert.h"
+#include <cmath>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+#include "amdados/app/amdados_utils.h"
+#include "amdados/app/configuration.h"
+
+namespace {
+
+//-----------------------------------------------------------------------------
+// Function fills in the parameters the time stepping depends on.
+//-----------------------------------------------------------------------------
+void MakeConfiguration(::amdados::Configuration & conf, const char * mode)
+{
+    conf.SetDouble("diffusion_coef", 1.0);
+    conf.SetDouble("dx", 20.0);
+    conf.SetDouble("dy", 20.0);
+    conf.SetDouble("integration_period", 100.0);
+    conf.SetInt("integration_nsteps", 10);
+    conf.SetDouble("flow_model_max_vx", 1.0);
+    conf.SetDouble("flow_model_max_vy", 1.0);
+    conf.SetInt("num_sub_iter", 3);
+    conf.SetString("time_stepping", mode);
+    conf.SetDouble("cfl_target", 0.5);
+    conf.SetDouble("dt_max", 20.0);
+    ::amdados::InitTimeStepping(conf);
+}
+
+} // anonymous namespace
+
+TEST(TimeSchedule, Fixed)
+{
+    using namespace ::amdados;
+    Configuration conf;
+    MakeConfiguration(conf, "fixed");
+
+    // Stability: dt <= 1/(|vx|/dx + |vy|/dy) = 10 = integration_period/10.
+    EXPECT_DOUBLE_EQ(10.0, conf.asDouble("dt"));
+    EXPECT_EQ(10, conf.asInt("Nt"));
+
+    const time_schedule_t schedule = MakeTimeSchedule(conf);
+    ASSERT_EQ(10u, schedule.size());
+    EXPECT_EQ(30u, NumSubIterations(schedule));
+    for (size_t k = 0; k < schedule.size(); ++k) {
+        EXPECT_DOUBLE_EQ(10.0 * k, schedule[k].time);
+        EXPECT_EQ(3u, schedule[k].Nsubiter);
+        EXPECT_EQ(3 * k, schedule[k].first);
+        for (size_t s = 0; s < 3; ++s) {
+            EXPECT_EQ(k, FindTimeStep(schedule, 3 * k + s));
+        }
+    }
+}
+
+TEST(TimeSchedule, Adaptive)
+{
+    using namespace ::amdados;
+    Configuration conf;
+    MakeConfiguration(conf, "adaptive");
+
+    const time_schedule_t schedule = MakeTimeSchedule(conf);
+    ASSERT_FALSE(schedule.empty());
+
+    // The steps cover the integration period seamlessly, respect the limits
+    // and every sub-iteration belongs to exactly one step.
+    const double T = conf.asDouble("integration_period");
+    const double dx = conf.asDouble("dx");
+    double time = 0.0;
+    size_t first = 0;
+    for (size_t k = 0; k < schedule.size(); ++k) {
+        const TimeStep & step = schedule[k];
+        EXPECT_DOUBLE_EQ(time, step.time);
+        EXPECT_EQ(first, step.first);
+        EXPECT_GT(step.dt, 0.0);
+        EXPECT_LE(step.dt, conf.asDouble("dt_max"));
+        EXPECT_GE(step.Nsubiter, 1u);
+        EXPECT_LE(step.Nsubiter, 3u);
+
+        // Courant number does not exceed the target.
+        const std::pair<double,double> v = Flow(conf, step.time);
+        EXPECT_LE(step.dt * (std::fabs(v.first) + std::fabs(v.second)) / dx,
+                  conf.asDouble("cfl_target") * (1.0 + 1e-12));
+
+        for (size_t s = 0; s < step.Nsubiter; ++s) {
+            EXPECT_EQ(k, FindTimeStep(schedule, first + s));
+        }
+        time += step.dt;
+        first += step.Nsubiter;
+    }
+    EXPECT_NEAR(T, time, 1e-9 * T);
+    EXPECT_EQ(first, NumSubIterations(schedule));
+
+    // The flow is slow at the beginning, so the first step is longer
+    // than the fixed one derived from the maximal velocity.
+    EXPECT_GT(schedule.front().dt, conf.asDouble("dt"));
+}
+
+TEST(TimeSchedule, AdaptiveImplicit)
+{
+    using namespace ::amdados;
+    Configuration conf;
+    MakeConfiguration(conf, "adaptive");
+
+    // Strong diffusion: the explicit limit dx^2/(2*D) = 0.2 is way below
+    // the fixed step, but it does not restrict the implicit scheme.
+    conf.SetDouble("diffusion_coef", 1000.0);
+    InitTimeStepping(conf);
+    EXPECT_LT(conf.asDouble("dt"), 1.0);
+
+    const time_schedule_t schedule = MakeTimeSchedule(conf);
+    ASSERT_FALSE(schedule.empty());
+    const double dx = conf.asDouble("dx");
+    for (const TimeStep & step : schedule) {
+        const std::pair<double,double> v = Flow(conf, step.time);
+        const double courant = step.dt * (std::fabs(v.first) +
+                                          std::fabs(v.second)) / dx;
+        // The step is limited by the Courant number or by dt_max only.
+        const bool last = (step.time + step.dt >=
+                           conf.asDouble("integration_period") * (1 - 1e-12));
+        if (last) continue;
+        EXPECT_TRUE((step.dt == conf.asDouble("dt_max")) ||
+                    (std::fabs(courant - conf.asDouble("cfl_target")) <
+                     1e-9)) << "step at " << step.time;
+        EXPECT_GT(step.dt, 10.0 * conf.asDouble("dt"));
+    }
+}
+
+TEST(TimeSchedule, ObservationRow)
+{
+    using namespace ::amdados;
+    Configuration conf;
+    MakeConfiguration(conf, "adaptive");
+
+    double weight = -1.0;
+    EXPECT_EQ(0u, ObservationRow(conf, 0.0, weight));
+    EXPECT_EQ(0.0, weight);
+    EXPECT_EQ(3u, ObservationRow(conf, 30.0 * (1.0 - 1e-14), weight));
+    EXPECT_EQ(0.0, weight);
+    EXPECT_EQ(3u, ObservationRow(conf, 32.5, weight));
+    EXPECT_DOUBLE_EQ(0.25, weight);
+
+    // Beyond the last sampling point the last row is taken as is.
+    EXPECT_EQ(9u, ObservationRow(conf, 95.0, weight));
+    EXPECT_EQ(0.0, weight);
+}
+
+#endif  // AMDADOS_PLAIN_MPI